@@ -0,0 +1,111 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "glog/logging.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace util {
+    // A monotonic buffer, the memory is only released when the arena is reset or destroyed.
+    // NOT thread safe, each worker owns its arena.
+    class Arena {
+    public:
+        explicit Arena(size_t initChunkSize = 64 * 1024) : _nextChunkSize(std::max<size_t>(initChunkSize, 64)) { }
+
+        ~Arena() { reset(); }
+
+        Arena(const Arena &) = delete;
+
+        Arena(Arena &&) = delete;
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+            auto aligned = alignOffset(alignment);
+            if (_current == nullptr || aligned + size > _currentSize) {
+                newChunk(size + alignment);
+                aligned = alignOffset(alignment);
+            }
+            _pos = aligned + size;
+            _bytesUsed += size;
+            return _current + aligned;
+        }
+
+        // Copy the string into the arena, the returned view is valid until the arena is reset
+        std::string_view copy(std::string_view str) {
+            if (str.empty()) {
+                return {};
+            }
+            auto* dst = static_cast<char*>(allocate(str.size(), 1));
+            std::memcpy(dst, str.data(), str.size());
+            return {dst, str.size()};
+        }
+
+        // The destructor of T is invoked when the arena is reset
+        template<class T, class... Args>
+        T* create(Args&&... args) {
+            auto* ptr = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                _destructors.push_back({ptr, [](void* p) { static_cast<T*>(p)->~T(); }});
+            }
+            return ptr;
+        }
+
+        // Destroy all objects and release all chunks but the last (largest) one
+        void reset() {
+            for (auto it = _destructors.rbegin(); it != _destructors.rend(); it++) {
+                it->second(it->first);
+            }
+            _destructors.clear();
+            if (_chunks.size() > 1) {
+                auto last = std::move(_chunks.back());
+                _chunks.clear();
+                _chunks.push_back(std::move(last));
+            }
+            _current = _chunks.empty() ? nullptr : _chunks.back().get();
+            _pos = 0;
+            _bytesUsed = 0;
+        }
+
+        // The number of system allocations since the arena is created
+        [[nodiscard]] size_t chunkAllocCount() const { return _chunkAllocCount; }
+
+        [[nodiscard]] size_t bytesUsed() const { return _bytesUsed; }
+
+    protected:
+        // the offset of the next aligned address in the current chunk
+        [[nodiscard]] size_t alignOffset(size_t alignment) const {
+            auto addr = reinterpret_cast<uintptr_t>(_current) + _pos;
+            return _pos + ((alignment - addr % alignment) % alignment);
+        }
+
+        void newChunk(size_t minSize) {
+            auto size = std::max(_nextChunkSize, minSize);
+            _nextChunkSize = std::min<size_t>(_nextChunkSize * 2, MAX_CHUNK_SIZE);
+            _chunks.push_back(std::make_unique_for_overwrite<char[]>(size));
+            _current = _chunks.back().get();
+            _currentSize = size;
+            _pos = 0;
+            _chunkAllocCount++;
+            DLOG_IF(INFO, size >= MAX_CHUNK_SIZE) << "Allocate a large arena chunk, size: " << size;
+        }
+
+    private:
+        constexpr static size_t MAX_CHUNK_SIZE = 4 * 1024 * 1024;
+        size_t _nextChunkSize;
+        std::vector<std::unique_ptr<char[]>> _chunks;
+        char* _current = nullptr;
+        size_t _currentSize = 0;
+        size_t _pos = 0;
+        size_t _bytesUsed = 0;
+        size_t _chunkAllocCount = 0;
+        std::vector<std::pair<void*, void(*)(void*)>> _destructors;
+    };
+}
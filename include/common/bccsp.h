@@ -5,11 +5,18 @@
 #pragma once
 
 #include "common/crypto.h"
+#include "common/ed25519_batch.h"
+#include "common/thread_pool_light.h"
+#include "common/verified_signature_cache.h"
 
 #include "common/phmap.h"
+#include "bthread/countdown_event.h"
+#include <atomic>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <memory>
+#include <unordered_map>
 #include <utility>
 
 namespace util {
@@ -23,6 +30,7 @@ namespace util {
                   _privateKey(std::move(*privateKey)) {
             _publicBytes = _publicKey.getHexFromPublicKey();
             _privateBytes = _privateKey.getHexFromPrivateKey();
+            decodeBatchPublicKey();
         }
 
         // public key version
@@ -30,6 +38,7 @@ namespace util {
                 : _ski(std::move(ski)), isPrivate(false), isEphemeral(ephemeral), _publicKey(std::move(*publicKey)),
                   _privateKey(nullptr) {
             _publicBytes = _publicKey.getHexFromPublicKey();
+            decodeBatchPublicKey();
         }
 
         ~Key() = default;
@@ -88,8 +97,21 @@ namespace util {
         // Verify verifies signature against key k and digest
         // The opts argument should be appropriate for the algorithm used.
         // md is the signature, and d is the digest
+        // The valid signatures are recorded in the verified signature cache (if set), and not verified again.
+        // The check is cofactored, the same as VerifyRawBatch.
         inline bool VerifyRaw(const util::OpenSSLED25519::digestType &md, const void *d, size_t cnt) const {
-            return _publicKey.verify(md, d, cnt);
+            if (_verifiedCache == nullptr) {
+                return verifyCofactored(md, d, cnt);
+            }
+            auto fingerprint = Fingerprint(md, d, cnt);
+            if (_verifiedCache->contains(fingerprint)) {
+                return true;
+            }
+            if (!verifyCofactored(md, d, cnt)) {
+                return false;
+            }
+            _verifiedCache->insert(fingerprint);
+            return true;
         }
 
         inline bool Verify(const util::OpenSSLED25519::digestType &md, const void *d, size_t cnt) const {
@@ -97,7 +119,43 @@ namespace util {
             if (digest == std::nullopt) {
                 return false;
             }
-            return _publicKey.verify(md, digest->data(), digest->size());
+            return VerifyRaw(md, digest->data(), digest->size());
+        }
+
+        [[nodiscard]] inline VerifiedSignatureCache::Fingerprint Fingerprint(const util::OpenSSLED25519::digestType &md,
+                                                                             const void *d, size_t cnt) const {
+            return VerifiedSignatureCache::GetFingerprint(_publicBytes == nullptr ? "" : *_publicBytes, md, d, cnt);
+        }
+
+        // nullptr if the cache is disabled
+        [[nodiscard]] inline VerifiedSignatureCache* GetVerifiedSignatureCache() const {
+            return _verifiedCache.get();
+        }
+
+        // NOT thread safe, set the cache before the key is shared
+        void setVerifiedSignatureCache(std::shared_ptr<VerifiedSignatureCache> verifiedCache) {
+            _verifiedCache = std::move(verifiedCache);
+        }
+
+        // the decoded public key used in verification, nullptr if the key can not be decoded
+        [[nodiscard]] inline const ed25519::PublicKey* BatchPublicKey() const {
+            return _batchPublicKey ? &*_batchPublicKey : nullptr;
+        }
+
+    protected:
+        // a key that can not be decoded has no valid signature
+        inline bool verifyCofactored(const util::OpenSSLED25519::digestType &md, const void *d, size_t cnt) const {
+            if (_batchPublicKey == std::nullopt) {
+                return false;
+            }
+            return ed25519::Verify(*_batchPublicKey, md.data(), d, cnt);
+        }
+
+        void decodeBatchPublicKey() {
+            if (_publicBytes == nullptr || _publicBytes->size() != 32) {
+                return;
+            }
+            _batchPublicKey = ed25519::PublicKey::Decode(reinterpret_cast<const uint8_t*>(_publicBytes->data()));
         }
 
     private:
@@ -110,11 +168,21 @@ namespace util {
         // If private key exists, public key MUST exist.
         util::OpenSSLED25519 _privateKey;
         std::shared_ptr<std::string> _privateBytes;
+        std::optional<ed25519::PublicKey> _batchPublicKey;
+        std::shared_ptr<VerifiedSignatureCache> _verifiedCache;
     };
 
     using CstKeyPtr = std::shared_ptr<const Key>;
     using KeyPtr = std::shared_ptr<Key>;
 
+    // A signature to be verified in a batch, the same as key->VerifyRaw(*signature, data, size)
+    struct VerifyRawRequest {
+        CstKeyPtr key;
+        const OpenSSLED25519::digestType* signature;
+        const void* data;
+        size_t size;
+    };
+
     // default key storage
     class KeyStorage {
     public:
@@ -129,11 +197,105 @@ namespace util {
         virtual auto loadKey(std::string_view ski) -> std::optional<std::pair<std::string, bool>> = 0;
     };
 
+    // KeyDirectory maps the ski to the key. The keys are imported at startup and rarely change,
+    // but they are looked up once per signature, so the lookup must not contend on a lock.
+    // The map is an immutable snapshot: a writer copies it, modifies the copy and publishes it (RCU),
+    // each thread keeps the last snapshot it read, and reloads it only after the version changed.
+    class KeyDirectory {
+    public:
+        KeyDirectory() : _id(NextId()), _snapshot(std::make_shared<Snapshot>()) { }
+
+        KeyDirectory(const KeyDirectory &) = delete;
+
+        // Thread safe, lock free unless the directory is updated since the last lookup of this thread
+        [[nodiscard]] KeyPtr find(std::string_view ski) const {
+            const auto& snapshot = localSnapshot();
+            auto it = snapshot.find(ski);
+            if (it == snapshot.end()) {
+                return nullptr;
+            }
+            return it->second;
+        }
+
+        // Thread safe, insert or override the key
+        void insert(KeyPtr key) {
+            std::lock_guard guard(_mutex);
+            auto snapshot = std::make_shared<Snapshot>(*_snapshot);
+            (*snapshot)[std::string(key->SKI())] = std::move(key);
+            publish(std::move(snapshot));
+        }
+
+        // Thread safe, insert the key if the ski does not exist, return the key in the directory
+        KeyPtr tryInsert(KeyPtr key) {
+            std::lock_guard guard(_mutex);
+            if (auto it = _snapshot->find(key->SKI()); it != _snapshot->end()) {
+                return it->second;
+            }
+            auto snapshot = std::make_shared<Snapshot>(*_snapshot);
+            snapshot->emplace(std::string(key->SKI()), key);
+            publish(std::move(snapshot));
+            return key;
+        }
+
+        [[nodiscard]] size_t size() const { return localSnapshot().size(); }
+
+    protected:
+        struct SKIHash {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view ski) const { return std::hash<std::string_view>()(ski); }
+        };
+
+        using Snapshot = std::unordered_map<std::string, KeyPtr, SKIHash, std::equal_to<>>;
+
+        static uint64_t NextId() {
+            static std::atomic<uint64_t> id = 0;
+            return ++id;
+        }
+
+        // must hold the lock
+        void publish(std::shared_ptr<const Snapshot> snapshot) {
+            _snapshot = std::move(snapshot);
+            _version.fetch_add(1, std::memory_order_release);
+        }
+
+        const Snapshot& localSnapshot() const {
+            // shared by all the directories of this thread, the id tells which directory the snapshot belongs to
+            struct LocalCache {
+                uint64_t id = 0;
+                uint64_t version = 0;
+                std::shared_ptr<const Snapshot> snapshot;
+            };
+            thread_local LocalCache local;
+            if (local.id != _id || local.version != _version.load(std::memory_order_acquire)) {
+                std::lock_guard guard(_mutex);
+                local.id = _id;
+                local.version = _version.load(std::memory_order_relaxed);
+                local.snapshot = _snapshot;
+            }
+            return *local.snapshot;
+        }
+
+    private:
+        const uint64_t _id;
+        std::atomic<uint64_t> _version = 0;
+        // protect _snapshot, serialize the writers
+        mutable std::mutex _mutex;
+        std::shared_ptr<const Snapshot> _snapshot;
+    };
+
     // BCCSP: the blockchain cryptographic service provider
     // BCCSP keep ALL the keys
     class BCCSP {
     public:
-        explicit BCCSP(std::unique_ptr<KeyStorage> storage_) : storage(std::move(storage_)) {}
+        // verifiedCacheCapacity is the max number of signatures in the verified signature cache, 0 to disable it
+        explicit BCCSP(std::unique_ptr<KeyStorage> storage_,
+                       size_t verifiedCacheCapacity = VerifiedSignatureCache::DEFAULT_CAPACITY)
+                : storage(std::move(storage_)) {
+            if (verifiedCacheCapacity > 0) {
+                verifiedCache = std::make_shared<VerifiedSignatureCache>(verifiedCacheCapacity);
+            }
+        }
 
         virtual ~BCCSP() = default;
 
@@ -165,7 +327,8 @@ namespace util {
             }
             // generate a key object
             auto key = std::make_shared<Key>(std::string(ski), std::move(pub), std::move(pri), ephemeral);
-            cache[key->SKI()] = key;
+            key->setVerifiedSignatureCache(verifiedCache);
+            directory.insert(key);
             return key;
         }
 
@@ -215,41 +378,44 @@ namespace util {
                     storage->saveKey(ski, *ret, false, true);
                 }
             }
-            cache[key->SKI()] = key;
+            key->setVerifiedSignatureCache(verifiedCache);
+            directory.insert(key);
             return key;
         }
 
         // Thread safe (depends on storage), NOT override if exist
         CstKeyPtr ImportKeyAndSave(std::string_view ski, std::string_view raw, bool isPrivate, bool ephemeral) {
             KeyPtr key = GetKeyFromRaw(ski, raw, isPrivate, ephemeral);
+            if (key == nullptr) {
+                return nullptr;
+            }
             if (!ephemeral) {
                 storage->saveKey(ski, raw, isPrivate, true);
             }
-            cache[key->SKI()] = key;
+            key->setVerifiedSignatureCache(verifiedCache);
+            directory.insert(key);
             return key;
         }
 
         // GetKey returns the key this CSP associates to
-        // the Subject Key Identifier ski, thread safe.
+        // the Subject Key Identifier ski, thread safe, lock free if the key is loaded.
         [[nodiscard]] CstKeyPtr GetKey(std::string_view ski) const {
-            // load from cache
-            KeyPtr key = nullptr;
-            if (cache.if_contains(ski, [&](CacheType::value_type& value) { key = value.second; })) {
+            if (auto key = directory.find(ski); key != nullptr) {
                 return key;
             }
             auto ret = storage->loadKey(ski);
-            if (!ret) { // we cant find it in cache or storage
+            if (!ret) { // we cant find it in directory or storage
                 return nullptr;
             }
-            auto notExist = [&](const CacheType::constructor& ctor) {
-                // load from disk
-                auto [raw, isPrivate] = std::move(*ret);
-                key = GetKeyFromRaw(ski, raw, isPrivate, false);
-                ctor(ski, key);
-                return true;
-            };
-            cache.lazy_emplace_l(ski, [&](CacheType::value_type& value) { key = value.second; }, notExist);
-            return key;
+            // load from disk
+            auto [raw, isPrivate] = std::move(*ret);
+            auto key = GetKeyFromRaw(ski, raw, isPrivate, false);
+            if (key == nullptr) {
+                return nullptr;
+            }
+            key->setVerifiedSignatureCache(verifiedCache);
+            // another thread may load it concurrently
+            return directory.tryInsert(std::move(key));
         }
 
         [[nodiscard]] static KeyPtr GetKeyFromRaw(std::string_view ski, std::string_view raw, bool isPrivate, bool ephemeral) {
@@ -285,10 +451,88 @@ namespace util {
             return key;
         }
 
+        // The hit / miss counters of the verified signature cache, all zero if the cache is disabled
+        [[nodiscard]] VerifiedSignatureCache::Statistics getVerifiedSignatureCacheStatistics() const {
+            if (verifiedCache == nullptr) {
+                return {};
+            }
+            return verifiedCache->getStatistics();
+        }
+
+        // Verify the signatures with the randomized batch verification, thread safe.
+        // The signatures found in the verified signature cache of their keys are skipped.
+        // The requests are split into batches of at least MIN_BATCH_SIZE, one batch per worker of wp.
+        // Return true if all the signatures are valid, otherwise the signatures of the failed batches
+        // are verified one by one, and the indexes of the invalid ones are appended to invalid (if not nullptr).
+        static bool VerifyRawBatch(const std::vector<VerifyRawRequest>& requests,
+                                   std::vector<int>* invalid = nullptr,
+                                   util::thread_pool_light* wp = nullptr) {
+            const int count = (int)requests.size();
+            int numRoutines = wp == nullptr ? 1 : (int)wp->get_thread_count();
+            numRoutines = std::max(1, std::min(numRoutines, count / MIN_BATCH_SIZE));
+            const int batchSize = (count + numRoutines - 1) / numRoutines;
+            std::vector<std::vector<int>> invalidList(numRoutines);
+            bthread::CountdownEvent countdown(numRoutines);
+            for (int i = 0; i < numRoutines; i++) {
+                util::PushTask(wp, [&, start=std::min(i * batchSize, count), end=std::min((i + 1) * batchSize, count), id=i] {
+                    if (!VerifyRawBatch(requests, start, end)) {
+                        for (int j = start; j < end; j++) {
+                            const auto& it = requests[j];
+                            if (it.key == nullptr || !it.key->VerifyRaw(*it.signature, it.data, it.size)) {
+                                invalidList[id].push_back(j);
+                            }
+                        }
+                    }
+                    countdown.signal();
+                });
+            }
+            countdown.wait();
+            bool success = true;
+            for (const auto& it: invalidList) {
+                success = success && it.empty();
+                if (invalid != nullptr) {
+                    invalid->insert(invalid->end(), it.begin(), it.end());
+                }
+            }
+            return success;
+        }
+
+    protected:
+        constexpr static int MIN_BATCH_SIZE = 64;
+
+        static bool VerifyRawBatch(const std::vector<VerifyRawRequest>& requests, int start, int end) {
+            std::vector<ed25519::BatchItem> items;
+            items.reserve(end - start);
+            // the signatures to be recorded in the cache after they are verified
+            std::vector<std::pair<VerifiedSignatureCache*, VerifiedSignatureCache::Fingerprint>> missed;
+            for (int i = start; i < end; i++) {
+                const auto& it = requests[i];
+                if (it.key == nullptr || it.key->BatchPublicKey() == nullptr) {
+                    return false;
+                }
+                if (auto* verifiedCache = it.key->GetVerifiedSignatureCache(); verifiedCache != nullptr) {
+                    auto fingerprint = it.key->Fingerprint(*it.signature, it.data, it.size);
+                    if (verifiedCache->contains(fingerprint)) {
+                        continue;
+                    }
+                    missed.emplace_back(verifiedCache, fingerprint);
+                }
+                items.push_back({it.key->BatchPublicKey(), it.signature->data(), it.data, it.size});
+            }
+            if (!items.empty() && !ed25519::VerifyBatch(items.data(), items.size())) {
+                return false;
+            }
+            for (const auto& [verifiedCache, fingerprint]: missed) {
+                verifiedCache->insert(fingerprint);
+            }
+            return true;
+        }
+
     private:
-        using CacheType = util::MyFlatHashMap<std::string, KeyPtr, std::mutex>;
-        mutable CacheType cache;
+        mutable KeyDirectory directory;
         std::unique_ptr<KeyStorage> storage;
+        // shared by all the keys of this bccsp, nullptr if disabled
+        std::shared_ptr<VerifiedSignatureCache> verifiedCache;
     };
 
     class DefaultKeyStorage : public util::KeyStorage {
@@ -13,6 +13,8 @@
 #include <vector>
 #include "glog/logging.h"
 #include "ed25519_signature.h"
+#include "common/sha256_multi_buffer.h"
+#include "common/thread_local_store.h"
 
 namespace OpenSSL {
     struct DeleteMdCtx {
@@ -81,18 +83,47 @@ namespace util {
     class OpenSSLHash {
     public:
         using digestType = OpenSSL::digestType<N>;
-        // generic MD digest runner
+
+        // the short sha256 messages are hashed by the sha-ni kernel directly, skipping the EVP dispatch
+        constexpr static size_t FAST_PATH_MAX_SIZE = 128;
+
+        // generic MD digest runner, thread safe, the EVP context of the calling thread is reused
         static std::optional<OpenSSL::digestType<N>> generateDigest(const void *d, size_t cnt) {
             OpenSSL::digestType<N> md;
-            OpenSSL::EVP_MD_CTX_ptr ctx(EVP_MD_CTX_new());
-            if(EVP_DigestInit_ex(ctx.get(), OpenSSLHash::_digest, nullptr) == 1 &&
-               EVP_DigestUpdate(ctx.get(), d, cnt) == 1 &&
-               EVP_DigestFinal_ex(ctx.get(), md.data(), nullptr) == 1) {
+            if constexpr (std::string_view(mdDigestType) == OpenSSL::SHA256 && util::sha256::HAS_SHA_NI) {
+                if (cnt <= FAST_PATH_MAX_SIZE) {
+                    util::sha256::Hash(std::string_view(reinterpret_cast<const char*>(d), cnt), md);
+                    return md;
+                }
+            }
+            auto* ctx = ThreadLocalStore<LocalContext>::Get()->ctx.get();
+            if(EVP_DigestInit_ex(ctx, OpenSSLHash::_digest, nullptr) == 1 &&
+               EVP_DigestUpdate(ctx, d, cnt) == 1 &&
+               EVP_DigestFinal_ex(ctx, md.data(), nullptr) == 1) {
                 return md;
             }
             return std::nullopt;
         }
 
+        // Thread safe, feed(update) passes the message piece by piece to update(const void *d, size_t cnt).
+        // The EVP context of the calling thread is reused, feed must not call generateDigest.
+        template<class Feed>
+        static std::optional<OpenSSL::digestType<N>> generateDigestStreamed(Feed&& feed) {
+            auto* ctx = ThreadLocalStore<LocalContext>::Get()->ctx.get();
+            if (EVP_DigestInit_ex(ctx, OpenSSLHash::_digest, nullptr) != 1) {
+                return std::nullopt;
+            }
+            bool success = true;
+            feed([&](const void *d, size_t cnt) {
+                success = success && EVP_DigestUpdate(ctx, d, cnt) == 1;
+            });
+            OpenSSL::digestType<N> md;
+            if (!success || EVP_DigestFinal_ex(ctx, md.data(), nullptr) != 1) {
+                return std::nullopt;
+            }
+            return md;
+        }
+
         static inline auto toString(const digestType& md) {
             return OpenSSL::bytesToString(md);
         }
@@ -137,6 +168,11 @@ namespace util {
         }
 
     private:
+        // re-initializing a context of the same digest is much cheaper than allocating a new one
+        struct LocalContext {
+            OpenSSL::EVP_MD_CTX_ptr ctx{EVP_MD_CTX_new()};
+        };
+
         OpenSSL::EVP_MD_CTX_ptr ctx;
         static inline EVP_MD_CTX *ctxStatic = EVP_MD_CTX_create();
         static inline const EVP_MD* _digest = EVP_MD_fetch(nullptr, mdDigestType, nullptr);
@@ -0,0 +1,678 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Randomized batch verification of Ed25519 signatures (RFC 8032 encoding).
+// For random 128-bit z_i, the batch is valid if
+//     [8]([-sum(z_i * S_i)]B + sum(z_i * R_i) + sum(z_i * h_i * A_i)) == 0,
+// the points are combined with a bucketed multi-scalar multiplication (Pippenger),
+// and the coefficients of the same public key are merged before that.
+// The equation is cofactored, so is the single check (Verify), [8]([S]B - [h]A - R) == 0, it replaces the
+// cofactorless ed25519_VerifySignature reached through LightweightED25519. Both of them accept R or A with
+// a small order component, so that a signature is accepted by the batch iff it is accepted one by one.
+namespace util::ed25519 {
+    namespace detail {
+        using u128 = unsigned __int128;
+
+        constexpr uint64_t MASK51 = (1ULL << 51) - 1;
+
+        // GF(2^255 - 19), 5 limbs of 51 bits, the limbs are kept below 2^52
+        struct Fe {
+            uint64_t v[5];
+        };
+
+        inline void FeCarry(uint64_t v[5]) {
+            uint64_t c;
+            c = v[0] >> 51; v[0] &= MASK51; v[1] += c;
+            c = v[1] >> 51; v[1] &= MASK51; v[2] += c;
+            c = v[2] >> 51; v[2] &= MASK51; v[3] += c;
+            c = v[3] >> 51; v[3] &= MASK51; v[4] += c;
+            c = v[4] >> 51; v[4] &= MASK51; v[0] += c * 19;
+        }
+
+        inline Fe FeFromInt(uint64_t x) { return Fe{{x, 0, 0, 0, 0}}; }
+
+        inline Fe FeAdd(const Fe& a, const Fe& b) {
+            Fe r;
+            for (int i = 0; i < 5; i++) {
+                r.v[i] = a.v[i] + b.v[i];
+            }
+            FeCarry(r.v);
+            return r;
+        }
+
+        // a + 4p - b
+        inline Fe FeSub(const Fe& a, const Fe& b) {
+            Fe r;
+            r.v[0] = a.v[0] + 0x1fffffffffffb4 - b.v[0];
+            for (int i = 1; i < 5; i++) {
+                r.v[i] = a.v[i] + 0x1ffffffffffffc - b.v[i];
+            }
+            FeCarry(r.v);
+            return r;
+        }
+
+        inline Fe FeNeg(const Fe& a) { return FeSub(FeFromInt(0), a); }
+
+        inline Fe FeReduce(const u128 t[5]) {
+            u128 c[5] = {t[0], t[1], t[2], t[3], t[4]};
+            Fe r;
+            c[1] += c[0] >> 51; r.v[0] = (uint64_t)c[0] & MASK51;
+            c[2] += c[1] >> 51; r.v[1] = (uint64_t)c[1] & MASK51;
+            c[3] += c[2] >> 51; r.v[2] = (uint64_t)c[2] & MASK51;
+            c[4] += c[3] >> 51; r.v[3] = (uint64_t)c[3] & MASK51;
+            const u128 x = (u128)r.v[0] + (c[4] >> 51) * 19;
+            r.v[4] = (uint64_t)c[4] & MASK51;
+            r.v[0] = (uint64_t)x & MASK51;
+            r.v[1] += (uint64_t)(x >> 51);
+            return r;
+        }
+
+        inline Fe FeMul(const Fe& a, const Fe& b) {
+            const uint64_t b1 = b.v[1] * 19, b2 = b.v[2] * 19, b3 = b.v[3] * 19, b4 = b.v[4] * 19;
+            const auto* x = a.v;
+            const auto* y = b.v;
+            u128 t[5];
+            t[0] = (u128)x[0] * y[0] + (u128)x[1] * b4 + (u128)x[2] * b3 + (u128)x[3] * b2 + (u128)x[4] * b1;
+            t[1] = (u128)x[0] * y[1] + (u128)x[1] * y[0] + (u128)x[2] * b4 + (u128)x[3] * b3 + (u128)x[4] * b2;
+            t[2] = (u128)x[0] * y[2] + (u128)x[1] * y[1] + (u128)x[2] * y[0] + (u128)x[3] * b4 + (u128)x[4] * b3;
+            t[3] = (u128)x[0] * y[3] + (u128)x[1] * y[2] + (u128)x[2] * y[1] + (u128)x[3] * y[0] + (u128)x[4] * b4;
+            t[4] = (u128)x[0] * y[4] + (u128)x[1] * y[3] + (u128)x[2] * y[2] + (u128)x[3] * y[1] + (u128)x[4] * y[0];
+            return FeReduce(t);
+        }
+
+        inline Fe FeSq(const Fe& a) {
+            const auto* x = a.v;
+            const uint64_t d0 = x[0] * 2, d1 = x[1] * 2, d2 = x[2] * 2, d3 = x[3] * 2;
+            const uint64_t x3 = x[3] * 19, x4 = x[4] * 19;
+            u128 t[5];
+            t[0] = (u128)x[0] * x[0] + (u128)d1 * x4 + (u128)d2 * x3;
+            t[1] = (u128)d0 * x[1] + (u128)d2 * x4 + (u128)x[3] * x3;
+            t[2] = (u128)d0 * x[2] + (u128)x[1] * x[1] + (u128)d3 * x4;
+            t[3] = (u128)d0 * x[3] + (u128)d1 * x[2] + (u128)x[4] * x4;
+            t[4] = (u128)d0 * x[4] + (u128)d1 * x[3] + (u128)x[2] * x[2];
+            return FeReduce(t);
+        }
+
+        inline Fe FeSqN(Fe a, int n) {
+            for (int i = 0; i < n; i++) {
+                a = FeSq(a);
+            }
+            return a;
+        }
+
+        // canonical little-endian encoding
+        inline void FeToBytes(uint8_t s[32], const Fe& a) {
+            uint64_t v[5] = {a.v[0], a.v[1], a.v[2], a.v[3], a.v[4]};
+            FeCarry(v);
+            FeCarry(v);
+            // q = 1 if v >= p
+            uint64_t q = (v[0] + 19) >> 51;
+            q = (v[1] + q) >> 51;
+            q = (v[2] + q) >> 51;
+            q = (v[3] + q) >> 51;
+            q = (v[4] + q) >> 51;
+            // v - p = v + 19 - 2^255
+            v[0] += 19 * q;
+            for (int i = 0; i < 4; i++) {
+                v[i + 1] += v[i] >> 51;
+                v[i] &= MASK51;
+            }
+            v[4] &= MASK51;
+            const uint64_t w[4] = {v[0] | (v[1] << 51), (v[1] >> 13) | (v[2] << 38),
+                                   (v[2] >> 26) | (v[3] << 25), (v[3] >> 39) | (v[4] << 12)};
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 8; j++) {
+                    s[i * 8 + j] = (uint8_t)(w[i] >> (8 * j));
+                }
+            }
+        }
+
+        // the top bit is ignored
+        inline Fe FeFromBytes(const uint8_t s[32]) {
+            uint64_t w[4];
+            for (int i = 0; i < 4; i++) {
+                w[i] = 0;
+                for (int j = 0; j < 8; j++) {
+                    w[i] |= (uint64_t)s[i * 8 + j] << (8 * j);
+                }
+            }
+            return Fe{{w[0] & MASK51, ((w[0] >> 51) | (w[1] << 13)) & MASK51, ((w[1] >> 38) | (w[2] << 26)) & MASK51,
+                       ((w[2] >> 25) | (w[3] << 39)) & MASK51, (w[3] >> 12) & MASK51}};
+        }
+
+        inline bool FeEqual(const Fe& a, const Fe& b) {
+            uint8_t x[32], y[32];
+            FeToBytes(x, a);
+            FeToBytes(y, b);
+            return std::memcmp(x, y, 32) == 0;
+        }
+
+        inline bool FeIsZero(const Fe& a) { return FeEqual(a, FeFromInt(0)); }
+
+        // a^(2^250 - 1), the common part of the inversion and the square root
+        inline Fe FePow2250(const Fe& z, Fe& z11) {
+            auto t0 = FeSq(z);                      // 2
+            auto t1 = FeMul(z, FeSqN(t0, 2));       // 9
+            z11 = FeMul(t0, t1);                    // 11
+            t1 = FeMul(t1, FeSq(z11));              // 2^5 - 1
+            t1 = FeMul(FeSqN(t1, 5), t1);           // 2^10 - 1
+            auto t2 = FeMul(FeSqN(t1, 10), t1);     // 2^20 - 1
+            t2 = FeMul(FeSqN(t2, 20), t2);          // 2^40 - 1
+            t1 = FeMul(FeSqN(t2, 10), t1);          // 2^50 - 1
+            t2 = FeMul(FeSqN(t1, 50), t1);          // 2^100 - 1
+            t2 = FeMul(FeSqN(t2, 100), t2);         // 2^200 - 1
+            return FeMul(FeSqN(t2, 50), t1);        // 2^250 - 1
+        }
+
+        // a^(p - 2)
+        inline Fe FeInvert(const Fe& z) {
+            Fe z11;
+            auto t = FePow2250(z, z11);
+            return FeMul(FeSqN(t, 5), z11);
+        }
+
+        // a^((p - 5) / 8)
+        inline Fe FePow22523(const Fe& z) {
+            Fe z11;
+            auto t = FePow2250(z, z11);
+            return FeMul(FeSqN(t, 2), z);
+        }
+
+        // extended coordinates, x = X / Z, y = Y / Z, x * y = T / Z
+        struct Point {
+            Fe X, Y, Z, T;
+        };
+
+        // the addend form: (Y + X, Y - X, 2Z, 2dT)
+        struct Cached {
+            Fe YpX, YmX, Z2, T2d;
+        };
+
+        struct Constants {
+            Fe d, d2, sqrtm1;
+            Point base;
+        };
+
+        inline const Constants& GetConstants();
+
+        inline Point Identity() { return Point{FeFromInt(0), FeFromInt(1), FeFromInt(1), FeFromInt(0)}; }
+
+        inline Cached ToCached(const Point& p) {
+            return Cached{FeAdd(p.Y, p.X), FeSub(p.Y, p.X), FeAdd(p.Z, p.Z), FeMul(p.T, GetConstants().d2)};
+        }
+
+        // add-2008-hwcd-3, complete for a = -1
+        inline Point Add(const Point& p, const Cached& q) {
+            const auto a = FeMul(FeSub(p.Y, p.X), q.YmX);
+            const auto b = FeMul(FeAdd(p.Y, p.X), q.YpX);
+            const auto c = FeMul(p.T, q.T2d);
+            const auto d = FeMul(p.Z, q.Z2);
+            const auto e = FeSub(b, a), f = FeSub(d, c), g = FeAdd(d, c), h = FeAdd(b, a);
+            return Point{FeMul(e, f), FeMul(g, h), FeMul(f, g), FeMul(e, h)};
+        }
+
+        // dbl-2008-hwcd for a = -1
+        inline Point Double(const Point& p) {
+            const auto a = FeSq(p.X);
+            const auto b = FeSq(p.Y);
+            const auto c = FeAdd(FeSq(p.Z), FeSq(p.Z));
+            const auto d = FeNeg(a);
+            const auto e = FeSub(FeSub(FeSq(FeAdd(p.X, p.Y)), a), b);
+            const auto g = FeAdd(d, b);
+            const auto f = FeSub(g, c);
+            const auto h = FeSub(d, b);
+            return Point{FeMul(e, f), FeMul(g, h), FeMul(f, g), FeMul(e, h)};
+        }
+
+        inline bool IsIdentity(const Point& p) { return FeIsZero(p.X) && FeEqual(p.Y, p.Z); }
+
+        inline Cached Negate(const Cached& q) { return Cached{q.YmX, q.YpX, q.Z2, FeNeg(q.T2d)}; }
+
+        // p, 3p, 5p, ..., (2 * size - 1)p
+        template<size_t size>
+        inline std::array<Cached, size> OddMultiples(const Point& p) {
+            std::array<Cached, size> table;
+            const auto p2 = ToCached(Double(p));
+            auto acc = p;
+            table[0] = ToCached(acc);
+            for (size_t i = 1; i < size; i++) {
+                acc = Add(acc, p2);
+                table[i] = ToCached(acc);
+            }
+            return table;
+        }
+
+        // RFC 8032 5.1.3, the non-canonical encodings are rejected
+        inline bool Decompress(Point& p, const uint8_t s[32]) {
+            const auto& k = GetConstants();
+            const auto y = FeFromBytes(s);
+            uint8_t check[32];
+            FeToBytes(check, y);
+            check[31] |= s[31] & 0x80;
+            if (std::memcmp(check, s, 32) != 0) {
+                return false;
+            }
+            const int sign = s[31] >> 7;
+            const auto y2 = FeSq(y);
+            const auto u = FeSub(y2, FeFromInt(1));
+            const auto v = FeAdd(FeMul(k.d, y2), FeFromInt(1));
+            const auto v3 = FeMul(FeSq(v), v);
+            auto x = FeMul(FeMul(u, v3), FePow22523(FeMul(u, FeMul(FeSq(v3), v))));
+            const auto vxx = FeMul(v, FeSq(x));
+            if (!FeEqual(vxx, u)) {
+                if (!FeEqual(vxx, FeNeg(u))) {
+                    return false;
+                }
+                x = FeMul(x, k.sqrtm1);
+            }
+            uint8_t xb[32];
+            FeToBytes(xb, x);
+            if ((xb[0] & 1) != sign) {
+                if (FeIsZero(x)) {
+                    return false;
+                }
+                x = FeNeg(x);
+            }
+            p = Point{x, y, FeFromInt(1), FeMul(x, y)};
+            return true;
+        }
+
+        inline const Constants& GetConstants() {
+            static const Constants constants = [] {
+                Constants k{};
+                k.d = FeMul(FeNeg(FeFromInt(121665)), FeInvert(FeFromInt(121666)));
+                k.d2 = FeAdd(k.d, k.d);
+                // 2^((p - 1) / 4) = 2^((p - 5) / 8 * 2 + 1)
+                k.sqrtm1 = FeMul(FeSq(FePow22523(FeFromInt(2))), FeFromInt(2));
+                return k;
+            }();
+            return constants;
+        }
+
+        inline const Point& BasePoint() {
+            static const Point base = [] {
+                // y = 4 / 5, x is even
+                uint8_t s[32];
+                FeToBytes(s, FeMul(FeFromInt(4), FeInvert(FeFromInt(5))));
+                Point p{};
+                Decompress(p, s);
+                return p;
+            }();
+            return base;
+        }
+
+        // scalars modulo l = 2^252 + 27742317777372353535851937790883648493, 4 limbs of 64 bits
+        using Scalar = std::array<uint64_t, 4>;
+
+        constexpr uint64_t L[5] = {0x5812631a5cf5d3ed, 0x14def9dea2f79cd6, 0, 0x1000000000000000, 0};
+
+        // floor(2^512 / l) for the Barrett reduction
+        constexpr uint64_t MU[5] = {0xed9ce5a30a2c131b, 0x2106215d086329a7, 0xffffffffffffffeb, 0xffffffffffffffff, 0xf};
+
+        // r -= l if r >= l
+        inline void ScCondSub(uint64_t r[5]) {
+            uint64_t t[5];
+            uint64_t borrow = 0;
+            for (int i = 0; i < 5; i++) {
+                const u128 d = (u128)r[i] - L[i] - borrow;
+                t[i] = (uint64_t)d;
+                borrow = (uint64_t)(d >> 64) & 1;
+            }
+            if (borrow == 0) {
+                std::memcpy(r, t, sizeof(t));
+            }
+        }
+
+        // x < 2^512
+        inline Scalar ScReduce(const uint64_t x[8]) {
+            // q3 = ((x >> 192) * mu) >> 320
+            uint64_t q2[10] = {};
+            for (int i = 0; i < 5; i++) {
+                uint64_t carry = 0;
+                for (int j = 0; j < 5; j++) {
+                    const u128 t = (u128)x[3 + i] * MU[j] + q2[i + j] + carry;
+                    q2[i + j] = (uint64_t)t;
+                    carry = (uint64_t)(t >> 64);
+                }
+                q2[i + 5] = carry;
+            }
+            const uint64_t* q3 = q2 + 5;
+            // r = (x - q3 * l) mod 2^320
+            uint64_t ql[5] = {};
+            for (int i = 0; i < 5; i++) {
+                uint64_t carry = 0;
+                for (int j = 0; i + j < 5; j++) {
+                    const u128 t = (u128)q3[i] * L[j] + ql[i + j] + carry;
+                    ql[i + j] = (uint64_t)t;
+                    carry = (uint64_t)(t >> 64);
+                }
+            }
+            uint64_t r[5];
+            uint64_t borrow = 0;
+            for (int i = 0; i < 5; i++) {
+                const u128 d = (u128)x[i] - ql[i] - borrow;
+                r[i] = (uint64_t)d;
+                borrow = (uint64_t)(d >> 64) & 1;
+            }
+            ScCondSub(r);
+            ScCondSub(r);
+            return Scalar{r[0], r[1], r[2], r[3]};
+        }
+
+        inline Scalar ScMul(const Scalar& a, const Scalar& b) {
+            uint64_t x[8] = {};
+            for (int i = 0; i < 4; i++) {
+                uint64_t carry = 0;
+                for (int j = 0; j < 4; j++) {
+                    const u128 t = (u128)a[i] * b[j] + x[i + j] + carry;
+                    x[i + j] = (uint64_t)t;
+                    carry = (uint64_t)(t >> 64);
+                }
+                x[i + 4] = carry;
+            }
+            return ScReduce(x);
+        }
+
+        inline Scalar ScAdd(const Scalar& a, const Scalar& b) {
+            uint64_t r[5];
+            uint64_t carry = 0;
+            for (int i = 0; i < 4; i++) {
+                const u128 t = (u128)a[i] + b[i] + carry;
+                r[i] = (uint64_t)t;
+                carry = (uint64_t)(t >> 64);
+            }
+            r[4] = carry;
+            ScCondSub(r);
+            return Scalar{r[0], r[1], r[2], r[3]};
+        }
+
+        inline Scalar ScNeg(const Scalar& a) {
+            if ((a[0] | a[1] | a[2] | a[3]) == 0) {
+                return a;
+            }
+            Scalar r;
+            uint64_t borrow = 0;
+            for (int i = 0; i < 4; i++) {
+                const u128 d = (u128)L[i] - a[i] - borrow;
+                r[i] = (uint64_t)d;
+                borrow = (uint64_t)(d >> 64) & 1;
+            }
+            return r;
+        }
+
+        // return false if s >= l
+        inline bool ScFromCanonicalBytes(Scalar& r, const uint8_t s[32]) {
+            for (int i = 0; i < 4; i++) {
+                r[i] = 0;
+                for (int j = 0; j < 8; j++) {
+                    r[i] |= (uint64_t)s[i * 8 + j] << (8 * j);
+                }
+            }
+            for (int i = 3; i >= 0; i--) {
+                if (r[i] != L[i]) {
+                    return r[i] < L[i];
+                }
+            }
+            return false;
+        }
+
+        // bits [offset, offset + width) of the scalar
+        inline uint32_t ScDigit(const Scalar& s, int offset, int width) {
+            const int limb = offset >> 6, shift = offset & 63;
+            uint64_t bits = s[limb] >> shift;
+            if (shift + width > 64 && limb < 3) {
+                bits |= s[limb + 1] << (64 - shift);
+            }
+            return (uint32_t)(bits & ((1ULL << width) - 1));
+        }
+
+        // sum(scalars[i] * points[i]), the scalars are less than 2^bits
+        inline Point MultiScalarMul(const std::vector<Cached>& points, const std::vector<Scalar>& scalars, int bits) {
+            const auto n = points.size();
+            const int c = n < 16 ? 3 : n < 128 ? 5 : n < 1024 ? 7 : n < 8192 ? 9 : 11;
+            std::vector<Point> buckets(1 << c);
+            std::vector<bool> used(1 << c);
+            auto acc = Identity();
+            for (int offset = (bits - 1) / c * c; offset >= 0; offset -= c) {
+                for (int i = 0; i < c; i++) {
+                    acc = Double(acc);
+                }
+                std::fill(used.begin(), used.end(), false);
+                for (size_t i = 0; i < n; i++) {
+                    const auto digit = ScDigit(scalars[i], offset, std::min(c, 256 - offset));
+                    if (digit == 0) {
+                        continue;
+                    }
+                    buckets[digit] = used[digit] ? Add(buckets[digit], points[i]) : Add(Identity(), points[i]);
+                    used[digit] = true;
+                }
+                // sum(j * buckets[j])
+                auto running = Identity(), total = Identity();
+                bool started = false;
+                for (int j = (1 << c) - 1; j > 0; j--) {
+                    if (used[j]) {
+                        running = Add(running, ToCached(buckets[j]));
+                        started = true;
+                    }
+                    if (started) {
+                        total = Add(total, ToCached(running));
+                    }
+                }
+                acc = Add(acc, ToCached(total));
+            }
+            return acc;
+        }
+
+        // signed sliding window (ref10 slide), the digits are odd and in [-limit, limit], limit = 2^k - 1 <= 63
+        inline void Slide(int8_t r[256], const Scalar& s, int limit) {
+            for (int i = 0; i < 256; i++) {
+                r[i] = (int8_t)((s[i >> 6] >> (i & 63)) & 1);
+            }
+            for (int i = 0; i < 256; i++) {
+                if (r[i] == 0) {
+                    continue;
+                }
+                for (int b = 1; b <= 6 && i + b < 256; b++) {
+                    if (r[i + b] == 0) {
+                        continue;
+                    }
+                    if (r[i] + (r[i + b] << b) <= limit) {
+                        r[i] = (int8_t)(r[i] + (r[i + b] << b));
+                        r[i + b] = 0;
+                    } else if (r[i] - (r[i + b] << b) >= -limit) {
+                        r[i] = (int8_t)(r[i] - (r[i + b] << b));
+                        for (int k = i + b; k < 256; k++) {
+                            if (r[k] == 0) {
+                                r[k] = 1;
+                                break;
+                            }
+                            r[k] = 0;
+                        }
+                    } else {
+                        break;
+                    }
+                }
+            }
+        }
+
+        // B, 3B, ..., 63B
+        inline const std::array<Cached, 32>& BaseOddMultiples() {
+            static const auto table = OddMultiples<32>(BasePoint());
+            return table;
+        }
+
+        inline bool Sha512(uint8_t out[64], const uint8_t r[32], const uint8_t a[32], const void* msg, size_t size) {
+            static EVP_MD* md = EVP_MD_fetch(nullptr, "SHA512", nullptr);
+            thread_local std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx(EVP_MD_CTX_new(), &EVP_MD_CTX_free);
+            unsigned int len = 0;
+            return EVP_DigestInit_ex(ctx.get(), md, nullptr) == 1
+                   && EVP_DigestUpdate(ctx.get(), r, 32) == 1
+                   && EVP_DigestUpdate(ctx.get(), a, 32) == 1
+                   && EVP_DigestUpdate(ctx.get(), msg, size) == 1
+                   && EVP_DigestFinal_ex(ctx.get(), out, &len) == 1;
+        }
+
+        // h = SHA512(R || A || M) mod l
+        inline bool HashToScalar(Scalar& h, const uint8_t r[32], const uint8_t a[32], const void* msg, size_t size) {
+            uint8_t digest[64];
+            if (!Sha512(digest, r, a, msg, size)) {
+                return false;
+            }
+            uint64_t wide[8];
+            for (int j = 0; j < 8; j++) {
+                wide[j] = 0;
+                for (int b = 0; b < 8; b++) {
+                    wide[j] |= (uint64_t)digest[j * 8 + b] << (8 * b);
+                }
+            }
+            h = ScReduce(wide);
+            return true;
+        }
+    }
+
+    // A decoded public key, decode once and reuse it in all the batches and single checks.
+    // Return nullopt if the encoding is invalid or non-canonical.
+    class PublicKey {
+    public:
+        static std::optional<PublicKey> Decode(const uint8_t encoded[32]) {
+            PublicKey key;
+            if (!detail::Decompress(key._point, encoded)) {
+                return std::nullopt;
+            }
+            std::memcpy(key._encoded.data(), encoded, 32);
+            key._oddMultiples = detail::OddMultiples<8>(key._point);
+            return key;
+        }
+
+        [[nodiscard]] const auto& encoded() const { return _encoded; }
+
+        [[nodiscard]] const auto& cached() const { return _oddMultiples[0]; }
+
+        // A, 3A, ..., 15A
+        [[nodiscard]] const auto& oddMultiples() const { return _oddMultiples; }
+
+    private:
+        PublicKey() = default;
+
+        std::array<uint8_t, 32> _encoded{};
+        detail::Point _point{};
+        std::array<detail::Cached, 8> _oddMultiples{};
+    };
+
+    // Verify a single signature with the cofactored equation of the batch,
+    // [S]B - [h]A is computed with a Straus double scalar multiplication over the signed windows of S and h.
+    inline bool Verify(const PublicKey& key, const uint8_t signature[64], const void* message, size_t size) {
+        using namespace detail;
+        Scalar s, h;
+        Point r;
+        if (!ScFromCanonicalBytes(s, signature + 32) || !Decompress(r, signature)) {
+            return false;
+        }
+        if (!HashToScalar(h, signature, key.encoded().data(), message, size)) {
+            return false;
+        }
+        int8_t sDigits[256], hDigits[256];
+        Slide(sDigits, s, 63);
+        Slide(hDigits, h, 15);
+        int top = 255;
+        while (top >= 0 && sDigits[top] == 0 && hDigits[top] == 0) {
+            top--;
+        }
+        const auto& base = BaseOddMultiples();
+        const auto& a = key.oddMultiples();
+        auto p = Identity();
+        for (int i = top; i >= 0; i--) {
+            p = Double(p);
+            if (sDigits[i] > 0) {
+                p = Add(p, base[sDigits[i] / 2]);
+            } else if (sDigits[i] < 0) {
+                p = Add(p, Negate(base[-sDigits[i] / 2]));
+            }
+            // -[h]A
+            if (hDigits[i] > 0) {
+                p = Add(p, Negate(a[hDigits[i] / 2]));
+            } else if (hDigits[i] < 0) {
+                p = Add(p, a[-hDigits[i] / 2]);
+            }
+        }
+        p = Add(p, Negate(ToCached(r)));
+        for (int i = 0; i < 3; i++) {
+            p = Double(p);
+        }
+        return IsIdentity(p);
+    }
+
+    struct BatchItem {
+        const PublicKey* key;
+        const uint8_t* signature;   // R || S, 64 bytes
+        const void* message;
+        size_t size;
+    };
+
+    // Return true if all the signatures are valid (with overwhelming probability),
+    // return false if any of them is invalid or malformed, call the single verification to find it.
+    inline bool VerifyBatch(const BatchItem* items, size_t count) {
+        using namespace detail;
+        // the buckets do not pay off for a small batch
+        constexpr size_t MIN_BATCH_SIZE = 16;
+        if (count < MIN_BATCH_SIZE) {
+            return std::all_of(items, items + count, [](const BatchItem& item) {
+                return item.key != nullptr && Verify(*item.key, item.signature, item.message, item.size);
+            });
+        }
+        std::vector<uint64_t> random(count * 2);
+        if (RAND_bytes(reinterpret_cast<unsigned char*>(random.data()), (int)(random.size() * sizeof(uint64_t))) != 1) {
+            return false;
+        }
+        std::vector<Cached> rPoints(count);
+        std::vector<Scalar> rScalars(count);
+        // the merged coefficients of the public keys, the last one is the base point
+        std::unordered_map<const PublicKey*, size_t> keyIndex;
+        std::vector<Cached> kPoints;
+        std::vector<Scalar> kScalars;
+        Scalar sumS{};
+        for (size_t i = 0; i < count; i++) {
+            const auto& item = items[i];
+            Scalar s, h;
+            Point r;
+            if (item.key == nullptr || !ScFromCanonicalBytes(s, item.signature + 32) || !Decompress(r, item.signature)) {
+                return false;
+            }
+            if (!HashToScalar(h, item.signature, item.key->encoded().data(), item.message, item.size)) {
+                return false;
+            }
+            const Scalar z{random[i * 2], random[i * 2 + 1] | 1, 0, 0};
+            rPoints[i] = ToCached(r);
+            rScalars[i] = z;
+            sumS = ScAdd(sumS, ScMul(z, s));
+            auto [it, inserted] = keyIndex.try_emplace(item.key, kPoints.size());
+            if (inserted) {
+                kPoints.push_back(item.key->cached());
+                kScalars.push_back(Scalar{});
+            }
+            kScalars[it->second] = ScAdd(kScalars[it->second], ScMul(z, h));
+        }
+        kPoints.push_back(ToCached(BasePoint()));
+        kScalars.push_back(ScNeg(sumS));
+        auto p = MultiScalarMul(rPoints, rScalars, 128);
+        p = Add(p, ToCached(MultiScalarMul(kPoints, kScalars, 253)));
+        for (int i = 0; i < 3; i++) {
+            p = Double(p);
+        }
+        return IsIdentity(p);
+    }
+}
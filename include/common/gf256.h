@@ -0,0 +1,202 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512BW__)
+#include <immintrin.h>
+#endif
+
+// Arithmetic over GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11d).
+// The region kernels are selected at compile time (the release build uses -march=native):
+// GFNI affine > AVX-512BW shuffle > AVX2 shuffle > scalar table.
+namespace util::gf256 {
+    struct Tables {
+        uint8_t exp[512];
+        uint8_t log[256];
+        uint8_t inv[256];
+        uint8_t mul[256][256];
+        // c * x = low[c][x & 0xf] ^ high[c][x >> 4]
+        uint8_t low[256][16];
+        uint8_t high[256][16];
+        // the 8x8 bit matrix of multiplying by c, for gf2p8affine
+        uint64_t affine[256];
+    };
+
+    inline const Tables& GetTables() {
+        static const auto* tables = [] {
+            auto* t = new Tables{};
+            uint32_t x = 1;
+            for (int i = 0; i < 255; i++) {
+                t->exp[i] = (uint8_t)x;
+                t->log[x] = (uint8_t)i;
+                x <<= 1;
+                if (x & 0x100) {
+                    x ^= 0x11d;
+                }
+            }
+            for (int i = 255; i < 512; i++) {
+                t->exp[i] = t->exp[i - 255];
+            }
+            for (int a = 0; a < 256; a++) {
+                for (int b = 0; b < 256; b++) {
+                    t->mul[a][b] = (a == 0 || b == 0) ? 0 : t->exp[t->log[a] + t->log[b]];
+                }
+                t->inv[a] = a == 0 ? 0 : t->exp[255 - t->log[a]];
+                for (int n = 0; n < 16; n++) {
+                    t->low[a][n] = t->mul[a][n];
+                    t->high[a][n] = t->mul[a][n << 4];
+                }
+                // output bit i is the parity of (row i & input), row i is stored in byte 7 - i
+                uint64_t matrix = 0;
+                for (int i = 0; i < 8; i++) {
+                    uint64_t row = 0;
+                    for (int j = 0; j < 8; j++) {
+                        row |= (uint64_t)((t->mul[a][1 << j] >> i) & 1) << j;
+                    }
+                    matrix |= row << (8 * (7 - i));
+                }
+                t->affine[a] = matrix;
+            }
+            return t;
+        }();
+        return *tables;
+    }
+
+    inline uint8_t Mul(uint8_t a, uint8_t b) { return GetTables().mul[a][b]; }
+
+    inline uint8_t Inv(uint8_t a) { return GetTables().inv[a]; }
+
+    // dst = c * src (XOR = false) or dst ^= c * src (XOR = true)
+    template<bool XOR>
+    inline void MulRegion(uint8_t c, const uint8_t* src, uint8_t* dst, size_t len) {
+        if (c == 0) {
+            if constexpr (!XOR) {
+                std::memset(dst, 0, len);
+            }
+            return;
+        }
+        if (c == 1 && !XOR) {
+            std::memcpy(dst, src, len);
+            return;
+        }
+        const auto& t = GetTables();
+        size_t i = 0;
+#if defined(__AVX512BW__)
+#if defined(__GFNI__)
+        const auto matrix = _mm512_set1_epi64((long long)t.affine[c]);
+#else
+        const auto mask = _mm512_set1_epi8(0x0f);
+        uint64_t nibbles[4];    // low[c] and high[c], repeated in each 128-bit lane
+        std::memcpy(nibbles, t.low[c], 16);
+        std::memcpy(nibbles + 2, t.high[c], 16);
+        const auto lo = _mm512_set4_epi64((long long)nibbles[1], (long long)nibbles[0], (long long)nibbles[1], (long long)nibbles[0]);
+        const auto hi = _mm512_set4_epi64((long long)nibbles[3], (long long)nibbles[2], (long long)nibbles[3], (long long)nibbles[2]);
+#endif
+        for (; i + 64 <= len; i += 64) {
+            auto x = _mm512_loadu_si512((const void*)(src + i));
+#if defined(__GFNI__)
+            auto p = _mm512_gf2p8affine_epi64_epi8(x, matrix, 0);
+#else
+            auto p = _mm512_xor_si512(_mm512_shuffle_epi8(lo, _mm512_and_si512(x, mask)),
+                                      _mm512_shuffle_epi8(hi, _mm512_and_si512(_mm512_srli_epi16(x, 4), mask)));
+#endif
+            if constexpr (XOR) {
+                p = _mm512_xor_si512(p, _mm512_loadu_si512((const void*)(dst + i)));
+            }
+            _mm512_storeu_si512((void*)(dst + i), p);
+        }
+#elif defined(__AVX2__)
+#if defined(__GFNI__)
+        const auto matrix = _mm256_set1_epi64x((long long)t.affine[c]);
+#else
+        const auto mask = _mm256_set1_epi8(0x0f);
+        const auto lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t.low[c]));
+        const auto hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t.high[c]));
+#endif
+        for (; i + 32 <= len; i += 32) {
+            auto x = _mm256_loadu_si256((const __m256i*)(src + i));
+#if defined(__GFNI__)
+            auto p = _mm256_gf2p8affine_epi64_epi8(x, matrix, 0);
+#else
+            auto p = _mm256_xor_si256(_mm256_shuffle_epi8(lo, _mm256_and_si256(x, mask)),
+                                      _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(x, 4), mask)));
+#endif
+            if constexpr (XOR) {
+                p = _mm256_xor_si256(p, _mm256_loadu_si256((const __m256i*)(dst + i)));
+            }
+            _mm256_storeu_si256((__m256i*)(dst + i), p);
+        }
+#endif
+        const auto* row = t.mul[c];
+        for (; i < len; i++) {
+            if constexpr (XOR) {
+                dst[i] ^= row[src[i]];
+            } else {
+                dst[i] = row[src[i]];
+            }
+        }
+    }
+
+    // outputs[o] = sum_k matrix[o * inputs.size() + k] * inputs[k], the regions are processed
+    // in chunks so that the inputs stay in the cache while all outputs are computed.
+    inline void MulMatrix(const uint8_t* matrix, const std::vector<const uint8_t*>& inputs,
+                          const std::vector<uint8_t*>& outputs, size_t len) {
+        constexpr size_t CHUNK_SIZE = 16 * 1024;
+        const auto inputCount = inputs.size();
+        for (size_t offset = 0; offset < len; offset += CHUNK_SIZE) {
+            const auto n = std::min(CHUNK_SIZE, len - offset);
+            for (size_t o = 0; o < outputs.size(); o++) {
+                const auto* coefficients = matrix + o * inputCount;
+                MulRegion<false>(coefficients[0], inputs[0] + offset, outputs[o] + offset, n);
+                for (size_t k = 1; k < inputCount; k++) {
+                    MulRegion<true>(coefficients[k], inputs[k] + offset, outputs[o] + offset, n);
+                }
+            }
+        }
+    }
+
+    // Gauss-Jordan elimination of a n x n row-major matrix, return false if it is singular
+    inline bool InvertMatrix(std::vector<uint8_t> matrix, std::vector<uint8_t>& inverse, int n) {
+        inverse.assign(n * n, 0);
+        for (int i = 0; i < n; i++) {
+            inverse[i * n + i] = 1;
+        }
+        for (int col = 0; col < n; col++) {
+            int pivot = col;
+            while (pivot < n && matrix[pivot * n + col] == 0) {
+                pivot++;
+            }
+            if (pivot == n) {
+                return false;
+            }
+            if (pivot != col) {
+                std::swap_ranges(matrix.begin() + pivot * n, matrix.begin() + (pivot + 1) * n, matrix.begin() + col * n);
+                std::swap_ranges(inverse.begin() + pivot * n, inverse.begin() + (pivot + 1) * n, inverse.begin() + col * n);
+            }
+            const auto scale = Inv(matrix[col * n + col]);
+            for (int j = 0; j < n; j++) {
+                matrix[col * n + j] = Mul(matrix[col * n + j], scale);
+                inverse[col * n + j] = Mul(inverse[col * n + j], scale);
+            }
+            for (int row = 0; row < n; row++) {
+                const auto factor = matrix[row * n + col];
+                if (row == col || factor == 0) {
+                    continue;
+                }
+                for (int j = 0; j < n; j++) {
+                    matrix[row * n + j] ^= Mul(factor, matrix[col * n + j]);
+                    inverse[row * n + j] ^= Mul(factor, inverse[col * n + j]);
+                }
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,66 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "common/parallel_merkle_tree.h"
+
+namespace pmt {
+    // IncrementalMerkleBuilder builds the same tree as MerkleTree::New, but accepts the leaves one by one.
+    // The payloads are hashed in batches with the multi-buffer sha256, and every complete pair of nodes
+    // is hashed as soon as it is available, so that only the right edge of the tree is left to finalize.
+    // NOT thread safe, a builder is fed by a single thread.
+    class IncrementalMerkleBuilder {
+    public:
+        // the pending payloads are hashed in a batch when the count reaches BATCH_SIZE
+        constexpr static int BATCH_SIZE = 256;
+
+        IncrementalMerkleBuilder() : _levels(1) { }
+
+        IncrementalMerkleBuilder(const IncrementalMerkleBuilder&) = delete;
+
+        // the payload is NOT copied, it must stay valid until it is flushed
+        void appendPayload(ByteString payload) {
+            _pending.push_back(payload);
+            if ((int)_pending.size() >= BATCH_SIZE) {
+                flush();
+            }
+        }
+
+        // append a leaf that is already hashed
+        void appendLeaf(const HashString& leaf) {
+            flush();
+            _levels[0].push_back(leaf);
+            hashCompletePairs();
+        }
+
+        // hash the pending payloads and all the complete pairs
+        void flush();
+
+        // the number of appended leaves
+        [[nodiscard]] int size() const { return (int)(_levels[0].size() + _pending.size()); }
+
+        // the hashes of the flushed leaves, in the appended order
+        [[nodiscard]] const std::vector<HashString>& getLeaves() const { return _levels[0]; }
+
+        // drop all the appended leaves
+        void reset() {
+            _pending.clear();
+            _levels.clear();
+            _levels.resize(1);
+        }
+
+        // Finalize generates the Merkle Tree with the appended leaves, then the builder is reset.
+        // Only c.Mode, c.RunInParallel and c.NumRoutines are used, the leaves are already hashed.
+        std::unique_ptr<MerkleTree> finalize(const Config &c, std::shared_ptr<util::thread_pool_light> wpPtr=nullptr);
+
+    protected:
+        void hashCompletePairs();
+
+    private:
+        std::vector<ByteString> _pending;
+        // _levels[0] are the leaves, _levels[i + 1][j] = HashFunc(_levels[i][2j], _levels[i][2j + 1])
+        std::vector<std::vector<HashString>> _levels;
+    };
+}
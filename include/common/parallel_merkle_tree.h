@@ -74,6 +74,8 @@ namespace pmt {
         [[nodiscard]] std::string toString() const;
     };
 
+    class IncrementalMerkleBuilder;
+
     // MerkleTree implements the Merkle Tree structure
     class MerkleTree {
     private:
@@ -106,6 +108,8 @@ namespace pmt {
     protected:
         explicit MerkleTree(const Config &c) : config(c) { }
 
+        friend class IncrementalMerkleBuilder;
+
     public:
         ~MerkleTree() = default;
 
@@ -162,6 +166,11 @@ namespace pmt {
 
         bool leafGenParallel(const std::vector<std::unique_ptr<DataBlock>> &blocks);
 
+        // parents[i] = Config::HashFunc(children[2i], children[2i+1]),
+        // each worker hashes a contiguous range with the multi-buffer sha256.
+        static void HashLevel(const HashString* children, HashString* parents, int parentCount,
+                              util::thread_pool_light* wp, int numRoutines);
+
         void proofGenParallel();
 
         void updateProofsParallel(const std::vector<HashString> &buf, int bufLen, int step);
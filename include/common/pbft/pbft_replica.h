@@ -0,0 +1,311 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "common/pbft/pbft_state_machine.h"
+#include "common/bccsp.h"
+#include "common/thread_pool_light.h"
+#include "common/concurrent_queue.h"
+#include "proto/pbft_replica_message.h"
+
+#include "bthread/countdown_event.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <thread>
+#include <unordered_map>
+
+namespace util::pbft {
+    // PBFTReplica is an in-process PBFT engine that drives a PBFTStateMachine, it replaces the BFT-SMaRt instance.
+    // The leader of view v is replica v % n, a proposal is committed in three phases:
+    // 1. The leader requests a proposal, signs it, and broadcasts a PRE_PREPARE (its signature is its own prepare).
+    // 2. The replicas verify the proposals in sequence, and broadcast their signatures in PREPARE.
+    //    With 2f+1 matching signatures (verified in a batch), a proposal is prepared, a replica broadcasts COMMIT.
+    // 3. With 2f+1 COMMIT, a proposal is committed, it is delivered in sequence with the 2f+1 signatures.
+    // At most pipelineDepth proposals of the leader are in flight.
+    // The messages are signed by the sender, the signatures of a batch of received messages are verified together.
+    // The replicas broadcast heartbeats, the messages of the unfinished proposals are retransmitted,
+    // the replicas that do not hear from the leader for viewChangeTimeoutMs start a view change.
+    // A lagging replica catches up with the committed proposals in the messages and the NEW_VIEW certificates,
+    // there is no state transfer for a replica that lags more than KEEP_DELIVERED proposals behind.
+    class PBFTReplica {
+    public:
+        struct Config {
+            // all the replicas, ordered by the node id
+            std::vector<NodeConfigPtr> nodes;
+            int localId = -1;
+            // the max number of proposals in flight
+            int pipelineDepth = 8;
+            int viewChangeTimeoutMs = 2000;
+            int heartbeatIntervalMs = 200;
+            // the max number of messages processed in a batch
+            int maxBatchSize = 64;
+        };
+
+        static std::unique_ptr<PBFTReplica> NewPBFTReplica(Config config,
+                                                           std::shared_ptr<util::BCCSP> bccsp,
+                                                           std::shared_ptr<util::thread_pool_light> threadPool,
+                                                           std::shared_ptr<PBFTStateMachine> stateMachine);
+
+        ~PBFTReplica();
+
+        PBFTReplica(const PBFTReplica&) = delete;
+
+        PBFTReplica(PBFTReplica&&) = delete;
+
+        // The callback sends a message to all the replicas, including the local one.
+        // It is called by the event thread only, the messages may be lost or reordered.
+        void setBroadcastCallback(auto&& cb) { _broadcast = std::forward<decltype(cb)>(cb); }
+
+        // Thread safe, called by the transport when receiving a message
+        void onMessage(std::string raw) { _queue.enqueue(Event{Event::MESSAGE, -1, -1, false, std::move(raw), nullptr}); }
+
+        void start();
+
+        void stop();
+
+        // Block until the replica has heard from a quorum of replicas
+        void waitUntilReady() { _ready.wait(); }
+
+        [[nodiscard]] int getView() const { return _view.load(std::memory_order_acquire); }
+
+        [[nodiscard]] bool isLeader() const { return LeaderOf(getView()) == _config.localId; }
+
+        // the sequence of the last proposal returned from OnDeliver
+        [[nodiscard]] int64_t getLastDelivered() const { return _lastDelivered.load(std::memory_order_acquire); }
+
+    protected:
+        PBFTReplica(Config config, std::shared_ptr<util::BCCSP> bccsp,
+                    std::shared_ptr<util::thread_pool_light> threadPool,
+                    std::shared_ptr<PBFTStateMachine> stateMachine);
+
+        // the certificates of the recently delivered proposals are kept for the view changes and retransmissions
+        constexpr static int64_t KEEP_DELIVERED = 64;
+        // the messages too far ahead of the last delivered proposal are dropped
+        constexpr static int64_t MAX_PENDING = 1024;
+        constexpr static int MAX_VIEW_CHANGE_BACKOFF = 8;
+
+        using Clock = std::chrono::steady_clock;
+
+        struct Event {
+            enum Type {
+                MESSAGE,    // raw: the signed message
+                PROPOSED,   // raw: the proposal of the local leader, signature: its signature
+                VERIFIED,   // success: the proposal is accepted, signature: the local signature
+                DELIVERED,
+            };
+            Type type;
+            int view;
+            int64_t sequence;
+            bool success;
+            std::string raw;
+            std::unique_ptr<proto::Block::SignaturePair> signature;
+        };
+
+        struct Vote {
+            proto::HashString digest;
+            // the signature on the proposal, delivered to the state machine
+            proto::SignatureString signature;
+            // the signature on PBFTVote{view, sequence, digest}
+            proto::DigestString voteSignature;
+            bool verified;
+        };
+
+        // the state of a sequence in the current view
+        struct Slot {
+            int view = -1;
+            Clock::time_point since;
+            bool hasProposal = false;
+            std::string proposal;
+            proto::HashString digest{};
+            bool proposedLocally = false;
+            bool verifying = false;
+            // the local signature is sent
+            bool accepted = false;
+            bool prepared = false;
+            bool committed = false;
+            std::map<int, Vote> prepares;
+            std::map<int, proto::HashString> commits;
+            // the local messages of this view, for retransmission
+            std::vector<std::string> sent;
+            // the proposal prepared in the highest view
+            std::unique_ptr<proto::PBFTCertificate> certificate;
+        };
+
+        // the proposals re-proposed in a new view
+        struct NewViewPlan {
+            int64_t start;
+            int64_t end;
+            std::vector<const proto::PBFTCertificate*> certificates;
+            // the committed proposals from the last scheduled one to start, for the lagging replica
+            std::vector<const proto::PBFTCertificate*> committed;
+        };
+
+        [[nodiscard]] inline int LeaderOf(int view) const { return view % (int)_config.nodes.size(); }
+
+        [[nodiscard]] inline int quorum() const { return 2 * _f + 1; }
+
+        static inline int CountCommits(const Slot& slot) {
+            return (int)std::count_if(slot.commits.begin(), slot.commits.end(), [&](const auto& v) {
+                return v.second == slot.digest;
+            });
+        }
+
+        void run();
+
+        void runApp();
+
+        void runProposer();
+
+        void postApp(std::function<void()> task) { _appQueue.enqueue(std::move(task)); }
+
+        void handleEvents(std::vector<Event>& events, size_t count);
+
+        void onMessage(const proto::PBFTMessage& message, std::string& raw);
+
+        void onProposed(Event& event);
+
+        void onVerified(Event& event);
+
+        void onDelivered(int64_t sequence);
+
+        void onPrePrepare(const proto::PBFTMessage& message);
+
+        void onPrepare(const proto::PBFTMessage& message);
+
+        void onCommit(const proto::PBFTMessage& message);
+
+        void onHeartbeat(const proto::PBFTMessage& message);
+
+        // During a view change, the replica keeps delivering the proposals committed in the installed view
+        // without voting, so that it does not fall behind the replicas that are not in the view change.
+        void onCatchUp(const proto::PBFTMessage& message);
+
+        void onViewChange(const proto::PBFTMessage& message, std::string& raw);
+
+        void onNewView(const proto::PBFTMessage& message, std::string& raw);
+
+        void onTimer();
+
+        void retransmit(Clock::time_point now);
+
+        // the slot of sequence in view, the votes of the other views are cleared
+        Slot& getSlot(int64_t sequence, int view);
+
+        Slot& getSlot(int64_t sequence) { return getSlot(sequence, _view.load(std::memory_order_relaxed)); }
+
+        // the slot that collects the votes of sequence, nullptr if the votes are not needed.
+        // The delivered sequences only collect votes if they are re-proposed, for the lagging replicas.
+        Slot* getVotingSlot(int64_t sequence);
+
+        // verify the proposals in sequence
+        void tryAccept();
+
+        // send the local signature of the proposal
+        void accept(int64_t sequence, Slot& slot, const proto::SignatureString& signature);
+
+        void tryPrepare(int64_t sequence);
+
+        // verify the matching prepares lazily, return true if a quorum of them is valid
+        bool verifyPrepares(int64_t sequence, Slot& slot);
+
+        void setCertificate(int64_t sequence, Slot& slot);
+
+        void tryCommit(int64_t sequence);
+
+        // hand the committed proposals to the app thread in sequence
+        void tryDeliver();
+
+        void startViewChange(int view);
+
+        // sign and broadcast VIEW_CHANGE of the current view with the latest certificates
+        void sendViewChange();
+
+        void trySendNewView();
+
+        // return false if the message is not valid
+        bool computeNewViewPlan(const std::vector<proto::PBFTViewChange>& viewChanges, NewViewPlan* plan);
+
+        bool verifyCertificate(const proto::PBFTCertificate& certificate);
+
+        void startLeading();
+
+        // sign and broadcast the message, the signed message is returned
+        std::string send(const proto::PBFTMessage& message);
+
+        std::optional<proto::DigestString> signVote(int view, int64_t sequence, const proto::HashString& digest);
+
+        // split the signature from a signed message
+        static bool ParseMessage(std::string_view raw, proto::PBFTMessage* message, std::string_view* body, proto::DigestString* signature);
+
+    private:
+        const Config _config;
+        const int _f;
+        std::shared_ptr<util::BCCSP> _bccsp;
+        std::shared_ptr<util::thread_pool_light> _threadPool;
+        std::shared_ptr<PBFTStateMachine> _stateMachine;
+        // the keys of the replicas
+        std::vector<CstKeyPtr> _keys;
+        std::unordered_map<std::string, int> _skiToId;
+        std::function<void(std::string raw)> _broadcast;
+
+        std::atomic<bool> _running = false;
+        std::unique_ptr<std::thread> _eventThread;
+        std::unique_ptr<std::thread> _appThread;
+        std::unique_ptr<std::thread> _proposerThread;
+        util::BlockingConcurrentQueue<Event> _queue;
+        // the callbacks of the state machine, executed in order
+        util::BlockingConcurrentQueue<std::function<void()>> _appQueue;
+        bthread::CountdownEvent _ready;
+
+        // the proposer requests a proposal if it leads _proposeView, and less than pipelineDepth proposals are in flight
+        std::mutex _proposeMutex;
+        std::condition_variable _proposeCV;
+        int _proposeView = -1;
+        int _inFlight = 0;
+
+        std::atomic<int> _view = 0;
+        std::atomic<int64_t> _lastDelivered = 0;
+
+        // the following members are accessed by the event thread only
+        bool _inViewChange = false;
+        // the view of the last NEW_VIEW, it differs from _view during a view change
+        int _installedView = 0;
+        // the last sequence handed to the app thread for delivery
+        int64_t _lastScheduled = 0;
+        // the next sequence to verify
+        int64_t _acceptNext = 1;
+        // the next sequence to propose (leader)
+        int64_t _nextSequence = 1;
+        // the new leader starts proposing after delivering the re-proposed proposals
+        int64_t _pendingLeaderStart = -1;
+        std::map<int64_t, Slot> _slots;
+
+        bool _isReady = false;
+        std::vector<bool> _heard;
+        // the views and the last delivered sequences in the heartbeats of the replicas
+        std::vector<int> _peerView;
+        std::vector<int64_t> _peerDelivered;
+        std::vector<Clock::time_point> _peerHeardAt;
+
+        Clock::time_point _leaderHeardAt;
+        Clock::time_point _heartbeatAt;
+        Clock::time_point _retransmitAt;
+        Clock::time_point _viewChangeAt;
+        int _viewChangeBackoff = 1;
+        // the backoff is reset after delivering a proposal after it
+        int64_t _backoffUntil = 0;
+        // view -> sender -> the signed VIEW_CHANGE
+        std::map<int, std::map<int, std::string>> _viewChanges;
+        // the highest view of VIEW_CHANGE from each replica
+        std::vector<int> _peerViewChange;
+        std::string _localViewChange;
+        // the NEW_VIEW of the current view
+        std::string _newView;
+        bool _newViewSent = false;
+    };
+}
@@ -4,11 +4,15 @@
 
 #pragma once
 
-#include "common/parallel_merkle_tree.h"
+#include "common/incremental_merkle_tree.h"
 #include "proto/block.h"
+#include "bthread/countdown_event.h"
 
 namespace util {
     using ValidateHandleType = std::function<bool(const proto::SignatureString& signature, const OpenSSLSHA256::digestType& hash)>;
+    // validate all the signatures in one call, hashes[i] is the digest of the payload of envelops[i]
+    using BatchValidateHandleType = std::function<bool(const std::vector<const proto::Envelop*>& envelops,
+                                                       const std::vector<OpenSSLSHA256::digestType>& hashes)>;
     class UserRequestMTGenerator {
     public:
         [[nodiscard]] static std::unique_ptr<pmt::MerkleTree> GenerateMerkleTree(
@@ -31,6 +35,91 @@ namespace util {
             return pmt::MerkleTree::New(pmtConfig, blocks, std::move(wp));
         }
 
+        // Builder hashes the user requests as they arrive, instead of waiting for the full batch.
+        // The envelops are not copied, they must stay alive until build returns.
+        class Builder {
+        public:
+            void append(const proto::Envelop& envelop) {
+                _envelops.push_back(&envelop);
+                _builder.appendPayload(envelop.getPayload());
+            }
+
+            [[nodiscard]] int size() const { return (int)_envelops.size(); }
+
+            // Validate the signatures with the leaf hashes (if validateHandle is set), then generate the tree.
+            // The builder is reset afterward.
+            [[nodiscard]] std::unique_ptr<pmt::MerkleTree> build(
+                    const ValidateHandleType& validateHandle,
+                    pmt::ModeType nodeType = pmt::ModeType::ModeProofGenAndTreeBuild,
+                    std::shared_ptr<util::thread_pool_light> wp = nullptr) {
+                prepare();
+                if (validateHandle && !validate(validateHandle, wp.get())) {
+                    return reset();
+                }
+                return finalize(nodeType, std::move(wp));
+            }
+
+            // The same as build, but the signatures are validated together, e.g. with batch verification.
+            [[nodiscard]] std::unique_ptr<pmt::MerkleTree> buildWithBatchValidation(
+                    const BatchValidateHandleType& validateHandle,
+                    pmt::ModeType nodeType = pmt::ModeType::ModeProofGenAndTreeBuild,
+                    std::shared_ptr<util::thread_pool_light> wp = nullptr) {
+                prepare();
+                if (validateHandle && !validateHandle(_envelops, _builder.getLeaves())) {
+                    LOG(ERROR) << "Validate userRequests failed!";
+                    return reset();
+                }
+                return finalize(nodeType, std::move(wp));
+            }
+
+        protected:
+            void prepare() {
+                if (_envelops.size() == 1) {   // special case: block has only 1 user request
+                    _builder.appendPayload(_envelops[0]->getPayload());
+                }
+                _builder.flush();
+            }
+
+            std::unique_ptr<pmt::MerkleTree> reset() {
+                _envelops.clear();
+                _builder.reset();
+                return nullptr;
+            }
+
+            std::unique_ptr<pmt::MerkleTree> finalize(pmt::ModeType nodeType, std::shared_ptr<util::thread_pool_light> wp) {
+                _envelops.clear();
+                pmt::Config pmtConfig;
+                pmtConfig.Mode = nodeType;
+                pmtConfig.RunInParallel = true;
+                return _builder.finalize(pmtConfig, std::move(wp));
+            }
+
+            bool validate(const ValidateHandleType& validateHandle, util::thread_pool_light* wp) const {
+                const auto& leaves = _builder.getLeaves();
+                const int count = (int)_envelops.size();
+                const int numRoutines = std::max(1, std::min(count, wp == nullptr ? 1 : (int)wp->get_thread_count()));
+                std::atomic<bool> ret = true;
+                bthread::CountdownEvent countdown(numRoutines);
+                for (int i = 0; i < numRoutines; i++) {
+                    util::PushTask(wp, [&, start=i] {
+                        for (int j = start; j < count && ret; j += numRoutines) {
+                            if (!validateHandle(_envelops[j]->getSignature(), leaves[j])) {
+                                LOG(ERROR) << "Validate userRequests failed!";
+                                ret = false;
+                            }
+                        }
+                        countdown.signal();
+                    });
+                }
+                countdown.wait();
+                return ret;
+            }
+
+        private:
+            std::vector<const proto::Envelop*> _envelops;
+            pmt::IncrementalMerkleBuilder _builder;
+        };
+
         static std::optional<pmt::Proof> GenerateProof(const pmt::MerkleTree& mt, const proto::Envelop& envelop) {
             EnvelopDataBlock mdb(envelop, nullptr);
             return mt.GenerateProof(mdb);
@@ -126,15 +215,8 @@ namespace util {
                     : rwSet(rwSet), filter(filter) { }
 
             [[nodiscard]] std::optional<pmt::HashString> Digest() const override {
-                // serialize envelop first
-                std::string str;
-                str.reserve(1024);
-                zpp::bits::out out(str);
-                if(failure(out(rwSet, filter))) {
-                    LOG(ERROR) << "Serialize rwSet failed!";
-                    return std::nullopt;
-                }
-                auto digest = util::OpenSSLSHA256::generateDigest(str.data(), str.size());
+                // reuse the digest computed at commit
+                auto digest = rwSet.getDigest(filter);
                 if (digest == std::nullopt) {
                     LOG(ERROR) << "Can not generate digest.";
                     return std::nullopt;
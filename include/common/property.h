@@ -6,6 +6,8 @@
 
 #include "yaml-cpp/yaml.h"
 #include "glog/logging.h"
+#include <bit>
+#include <map>
 #include <mutex>
 
 namespace util {
@@ -207,6 +209,98 @@ namespace util {
         YAML::Node n;
     };
 
+    class DBProperties {
+    public:
+        DBProperties(const DBProperties& rhs) = default;
+
+        DBProperties(DBProperties&& rhs) noexcept : n(rhs.n) { }
+
+        constexpr static const auto BACKEND = "backend";
+        constexpr static const auto BLOCK_CACHE_MB = "block_cache_mb";
+        constexpr static const auto BLOOM_BITS_PER_KEY = "bloom_bits_per_key";
+        constexpr static const auto COLUMN_FAMILIES = "column_families";
+        constexpr static const auto WAL_SYNC = "wal_sync";
+        constexpr static const auto CACHE_CAPACITY = "cache_capacity";
+        constexpr static const auto CACHE_ADMIT_THRESHOLD = "cache_admit_threshold";
+
+    public:
+        // "phmap", "rocksdb" or "leveldb"
+        std::string getBackend() const {
+            try {
+                return n[BACKEND].as<std::string>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find db BACKEND, leave it to phmap.";
+            }
+            return "phmap";
+        }
+
+        size_t getBlockCacheMB() const {
+            try {
+                return n[BLOCK_CACHE_MB].as<size_t>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find db BLOCK_CACHE_MB, leave it to 256.";
+            }
+            return 256;
+        }
+
+        int getBloomBitsPerKey() const {
+            try {
+                return std::max(n[BLOOM_BITS_PER_KEY].as<int>(), 0);
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find db BLOOM_BITS_PER_KEY, leave it to 10.";
+            }
+            return 10;
+        }
+
+        // column family name -> key prefixes, e.g. stock: ["s_"]
+        std::map<std::string, std::vector<std::string>> getColumnFamilies() const {
+            try {
+                return n[COLUMN_FAMILIES].as<std::map<std::string, std::vector<std::string>>>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find db COLUMN_FAMILIES, use the default column family only.";
+            }
+            return {};
+        }
+
+        // when to sync the wal: "always", "group" or "none"
+        std::string getWALSync() const {
+            try {
+                return n[WAL_SYNC].as<std::string>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find db WAL_SYNC, leave it to group.";
+            }
+            return "group";
+        }
+
+        // the number of hot keys cached in front of the backend, 0 to disable
+        size_t getCacheCapacity() const {
+            try {
+                return n[CACHE_CAPACITY].as<size_t>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find db CACHE_CAPACITY, leave it to 0.";
+            }
+            return 0;
+        }
+
+        // a key is cached after it is missed this many times in a block
+        uint32_t getCacheAdmitThreshold() const {
+            try {
+                return std::max(n[CACHE_ADMIT_THRESHOLD].as<uint32_t>(), 1u);
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find db CACHE_ADMIT_THRESHOLD, leave it to 2.";
+            }
+            return 2;
+        }
+
+    protected:
+        friend class Properties;
+
+        explicit DBProperties(const YAML::Node& node) :n(node) { }
+
+    private:
+        YAML::Node n;
+    };
+
     class Properties {
     private:
         static inline std::shared_ptr<Properties> properties;
@@ -214,9 +308,13 @@ namespace util {
     public:
         constexpr static const auto CHAINCODE_PROPERTIES = "chaincode";
         constexpr static const auto NODES_PROPERTIES = "nodes";
+        constexpr static const auto DB_PROPERTIES = "db";
         constexpr static const auto START_BLOCK_NUMBER = "start_at";
         constexpr static const auto DISTRIBUTED_SETTING = "distributed";
         constexpr static const auto REPLICATOR_LOWEST_PORT = "replicator_lowest_port";
+        constexpr static const auto REPLICATOR_RING_BUFFER_SIZE = "replicator_ring_buffer_size";
+        constexpr static const auto REPLICATOR_REASSEMBLY_WINDOW = "replicator_reassembly_window";
+        constexpr static const auto REPLICATOR_ERASURE_CODE = "replicator_erasure_code";
         constexpr static const auto SSH_USERNAME = "ssh_username";
         constexpr static const auto SSH_PASSWORD = "ssh_password";
         constexpr static const auto JVM_PATH = "jvm_path";
@@ -226,6 +324,21 @@ namespace util {
         constexpr static const auto VALIDATE_USER_REQUEST_ON_RECEIVE = "validate_on_receive";
         constexpr static const auto ARIA_WORKER_COUNT = "aria_worker_count";
         constexpr static const auto BCCSP_WORKER_COUNT = "bccsp_worker_count";
+        constexpr static const auto BCCSP_VERIFIED_CACHE_SIZE = "bccsp_verified_cache_size";
+        constexpr static const auto BLOCK_LOG_SEGMENT_MB = "block_log_segment_mb";
+        constexpr static const auto TX_INDEX_CAPACITY = "tx_index_capacity";
+        constexpr static const auto TX_INDEX_BACKEND = "tx_index_backend";
+        constexpr static const auto GBO_VOTE_BATCH_SIZE = "gbo_vote_batch_size";
+        constexpr static const auto GBO_VOTE_BATCH_WINDOW_US = "gbo_vote_batch_window_us";
+        constexpr static const auto EXECUTION_PIPELINE_DEPTH = "execution_pipeline_depth";
+        constexpr static const auto ARIA_ABORT_FALLBACK = "aria_abort_fallback";
+        constexpr static const auto CC_ENGINE = "cc_engine";
+        constexpr static const auto CC_WORKER_COUNT = "cc_worker_count";
+        constexpr static const auto CC_KEY_PARTITION = "cc_key_partition";
+        constexpr static const auto CC_KEY_PARTITION_MAX_IMBALANCE = "cc_key_partition_max_imbalance";
+        constexpr static const auto LOCAL_CONSENSUS_ENGINE = "local_consensus_engine";
+        constexpr static const auto PBFT_PIPELINE_DEPTH = "pbft_pipeline_depth";
+        constexpr static const auto PBFT_VIEW_CHANGE_TIMEOUT_MS = "pbft_view_change_timeout_ms";
 
     public:
         // Load from file, if fileName is null, create an empty property
@@ -259,6 +372,8 @@ namespace util {
 
         NodeProperties getNodeProperties() const { return NodeProperties(_node[NODES_PROPERTIES]); }
 
+        DBProperties getDBProperties() const { return DBProperties(_node[DB_PROPERTIES]); }
+
         YAML::Node getCustomProperties(const std::string& key) {
             if (!_node[key].IsDefined()) {
                 _node[key].reset();
@@ -306,6 +421,41 @@ namespace util {
             return port;
         }
 
+        // the max number of blocks whose fragments are cached by a region receiver, rounded up to a power of 2
+        int getReplicatorRingBufferSize() const {
+            try {
+                return (int)std::bit_ceil((unsigned)std::max(_node[REPLICATOR_RING_BUFFER_SIZE].as<int>(), 1));
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find REPLICATOR_RING_BUFFER_SIZE, leave it to 256.";
+            }
+            return 256;
+        }
+
+        // the number of consecutive blocks of a region that are reassembled concurrently
+        int getReplicatorReassemblyWindow() const {
+            try {
+                return std::max(_node[REPLICATOR_REASSEMBLY_WINDOW].as<int>(), 1);
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find REPLICATOR_REASSEMBLY_WINDOW, leave it to 4.";
+            }
+            return 4;
+        }
+
+        // the erasure code of the replicator, all nodes must use the same one:
+        // "native" (util::ReedSolomonErasureCode, caches the decode matrices) or "go" (util::GoErasureCode)
+        std::string getReplicatorErasureCode() const {
+            try {
+                auto ec = _node[REPLICATOR_ERASURE_CODE].as<std::string>();
+                if (ec == "native" || ec == "go") {
+                    return ec;
+                }
+                LOG(WARNING) << "Unknown REPLICATOR_ERASURE_CODE: " << ec << ", leave it to native.";
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find REPLICATOR_ERASURE_CODE, leave it to native.";
+            }
+            return "native";
+        }
+
         std::tuple<std::string, std::string, bool> getSSHInfo() const {
             try {
                 return { _node[SSH_USERNAME].as<std::string>(),
@@ -357,6 +507,151 @@ namespace util {
 
         int getBCCSPWorkerCount() const;
 
+        // the max number of verified signatures cached by bccsp, 0 to disable the cache
+        size_t getBCCSPVerifiedCacheSize() const {
+            try {
+                return _node[BCCSP_VERIFIED_CACHE_SIZE].as<size_t>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find BCCSP_VERIFIED_CACHE_SIZE, leave it to 65536.";
+            }
+            return 65536;
+        }
+
+        // the segment size of the block log, 0 (default) to keep the blocks in memory only.
+        // The log serves the pruned blocks, it is not replayed on restart (the log of the last run is kept aside).
+        int getBlockLogSegmentMB() const {
+            try {
+                return _node[BLOCK_LOG_SEGMENT_MB].as<int>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find BLOCK_LOG_SEGMENT_MB, leave it to 0 (disabled).";
+            }
+            return 0;
+        }
+
+        // the max number of transactions indexed in memory, 0 to disable the index
+        size_t getTxIndexCapacity() const {
+            try {
+                return _node[TX_INDEX_CAPACITY].as<size_t>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find TX_INDEX_CAPACITY, leave it to 1048576.";
+            }
+            return 1 << 20;
+        }
+
+        // the persisted tier of the tx index: "none", "rocksdb" or "leveldb"
+        std::string getTxIndexBackend() const {
+            try {
+                return _node[TX_INDEX_BACKEND].as<std::string>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find TX_INDEX_BACKEND, leave it to none.";
+            }
+            return "none";
+        }
+
+        // the max number of global block order votes in a raft entry, 1 to disable batching
+        int getGBOVoteBatchSize() const {
+            try {
+                return _node[GBO_VOTE_BATCH_SIZE].as<int>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find GBO_VOTE_BATCH_SIZE, leave it to 32.";
+            }
+            return 32;
+        }
+
+        // how long the first vote of a raft entry waits for the others
+        int getGBOVoteBatchWindowUs() const {
+            try {
+                return _node[GBO_VOTE_BATCH_WINDOW_US].as<int>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find GBO_VOTE_BATCH_WINDOW_US, leave it to 200.";
+            }
+            return 200;
+        }
+
+        // how to re-execute the aborted transactions of a batch: "none", "serial" or "reserve"
+        std::string getAriaAbortFallback() const {
+            try {
+                return _node[ARIA_ABORT_FALLBACK].as<std::string>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find ARIA_ABORT_FALLBACK, leave it to none.";
+            }
+            return "none";
+        }
+
+        // the cc engine registered in peer::cc::CCEngineRegistry, e.g. "aria", "serial" or "dag"
+        std::string getCCEngine() const {
+            try {
+                return _node[CC_ENGINE].as<std::string>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find CC_ENGINE, leave it to aria.";
+            }
+            return "aria";
+        }
+
+        // the worker count of a cc engine, e.g. cc_worker_count: { dag: 16 }, fallback to ARIA_WORKER_COUNT
+        int getCCWorkerCount(const std::string& engine) const;
+
+        // assign the txns to the cc workers by the key hint of the chaincode args, instead of round-robin
+        bool getCCKeyPartition() const {
+            try {
+                return _node[CC_KEY_PARTITION].as<bool>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find CC_KEY_PARTITION, leave it to false.";
+            }
+            return false;
+        }
+
+        // the max load of a cc worker / the average load, the hot keys are split to keep it
+        double getCCKeyPartitionMaxImbalance() const {
+            try {
+                return std::max(_node[CC_KEY_PARTITION_MAX_IMBALANCE].as<double>(), 1.0);
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find CC_KEY_PARTITION_MAX_IMBALANCE, leave it to 1.25.";
+            }
+            return 1.25;
+        }
+
+        // the max number of blocks in the execution pipeline, 1 for executing blocks one by one
+        int getExecutionPipelineDepth() const {
+            try {
+                return std::max(_node[EXECUTION_PIPELINE_DEPTH].as<int>(), 1);
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find EXECUTION_PIPELINE_DEPTH, leave it to 3.";
+            }
+            return 3;
+        }
+
+        // the engine of the local consensus: "bft-smart" (the jvm instance, default) or "native" (util::pbft::PBFTReplica).
+        // The native engine is opt-in, it has no state transfer for a replica lagging more than KEEP_DELIVERED proposals.
+        std::string getLocalConsensusEngine() const {
+            try {
+                return _node[LOCAL_CONSENSUS_ENGINE].as<std::string>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find LOCAL_CONSENSUS_ENGINE, leave it to bft-smart.";
+            }
+            return "bft-smart";
+        }
+
+        // the max number of blocks in flight of the native local consensus, 1 for proposing blocks one by one
+        int getPBFTPipelineDepth() const {
+            try {
+                return std::max(_node[PBFT_PIPELINE_DEPTH].as<int>(), 1);
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find PBFT_PIPELINE_DEPTH, leave it to 8.";
+            }
+            return 8;
+        }
+
+        // a replica of the native local consensus starts a view change if it does not hear from the leader in time
+        int getPBFTViewChangeTimeoutMs() const {
+            try {
+                return _node[PBFT_VIEW_CHANGE_TIMEOUT_MS].as<int>();
+            } catch (const YAML::Exception &e) {
+                LOG(INFO) << "Can not find PBFT_VIEW_CHANGE_TIMEOUT_MS, leave it to 2000.";
+            }
+            return 2000;
+        }
+
         // validate user request immediately, instead of validate them during consensus
         bool validateOnReceive() const {
             bool dist = false;
@@ -0,0 +1,318 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "common/erasure_code.h"
+#include "common/gf256.h"
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace util {
+    // The inverted decode matrices keyed by the indexes of the fragments used for decoding.
+    // The receiver usually gets the same subset of fragments for every block (the same nodes
+    // are slow), so the matrix is inverted once and shared by all codes of the same shard count.
+    class DecodeMatrixCache {
+    public:
+        using MatrixType = std::shared_ptr<const std::vector<uint8_t>>;
+
+        struct Statistics {
+            uint64_t hitCount = 0;
+            uint64_t missCount = 0;
+            uint64_t size = 0;
+
+            [[nodiscard]] double hitRate() const {
+                return hitCount + missCount == 0 ? 0 : (double)hitCount / (double)(hitCount + missCount);
+            }
+        };
+
+        // the cache is cleared when it is full, the erasure patterns are usually stable
+        explicit DecodeMatrixCache(size_t capacity = 1024) : _capacity(capacity) {
+            CHECK(_capacity > 0);
+        }
+
+        // Thread safe, return nullptr if the matrix is not cached
+        MatrixType get(const std::string& key) const {
+            std::shared_lock lock(mutex);
+            auto it = _matrices.find(key);
+            if (it == _matrices.end()) {
+                missCount.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            hitCount.fetch_add(1, std::memory_order_relaxed);
+            return it->second;
+        }
+
+        // Thread safe
+        void put(std::string key, MatrixType matrix) {
+            std::unique_lock lock(mutex);
+            if (_matrices.size() >= _capacity) {
+                _matrices.clear();
+            }
+            _matrices.insert_or_assign(std::move(key), std::move(matrix));
+        }
+
+        [[nodiscard]] Statistics getStatistics() const {
+            Statistics s;
+            s.hitCount = hitCount.load(std::memory_order_relaxed);
+            s.missCount = missCount.load(std::memory_order_relaxed);
+            std::shared_lock lock(mutex);
+            s.size = _matrices.size();
+            return s;
+        }
+
+    private:
+        const size_t _capacity;
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, MatrixType> _matrices;
+        mutable std::atomic<uint64_t> hitCount = 0;
+        mutable std::atomic<uint64_t> missCount = 0;
+    };
+
+    // Systematic Reed-Solomon code over GF(2^8), the parity rows form a Cauchy matrix,
+    // so any dataNum of the dataNum + parityNum fragments restore the data.
+    // The layout is the same as GoErasureCode: the data is split into dataNum fragments
+    // of ceil(len / dataNum) bytes (zero padded), followed by the parity fragments.
+    class ReedSolomonErasureCode : public ErasureCode {
+    public:
+        ReedSolomonErasureCode(int dataNum, int parityNum) : ReedSolomonErasureCode(dataNum, parityNum, nullptr) { }
+
+        // the decode matrices are cached in decodeMatrixCache if it is not nullptr
+        ReedSolomonErasureCode(int dataNum, int parityNum, std::shared_ptr<DecodeMatrixCache> decodeMatrixCache)
+                : ErasureCode(dataNum, parityNum), _decodeMatrixCache(std::move(decodeMatrixCache)) {
+            CHECK(dataNum > 0 && parityNum >= 0 && dataNum + parityNum <= 256) << "Invalid shard count.";
+            parityMatrix.resize(parityNum * dataNum);
+            for (int p = 0; p < parityNum; p++) {
+                for (int j = 0; j < dataNum; j++) {
+                    parityMatrix[p * dataNum + j] = gf256::Inv((uint8_t)((dataNum + p) ^ j));
+                }
+            }
+        }
+
+        ReedSolomonErasureCode(const ReedSolomonErasureCode&) = delete;
+
+        ~ReedSolomonErasureCode() override = default;
+
+        [[nodiscard]] int getFragmentLen(int dataLen) const { return (dataLen + _dataNum - 1) / _dataNum; }
+
+        [[nodiscard]] const auto& getDecodeMatrixCache() const { return _decodeMatrixCache; }
+
+        // Thread safe, the fragments are written to buffer[i * fragmentLen], without any other copy
+        std::optional<std::pair<int, int>> encodeWithBuffer(std::string_view data, char* buffer, int size) const override {
+            if (data.empty()) {
+                return std::nullopt;
+            }
+            const auto fragmentLen = getFragmentLen((int)data.size());
+            const auto shardCount = _dataNum + _parityNum;
+            if (size < fragmentLen * shardCount) {
+                return std::nullopt;
+            }
+            std::memcpy(buffer, data.data(), data.size());
+            std::memset(buffer + data.size(), 0, fragmentLen * _dataNum - data.size());
+            std::vector<const uint8_t*> inputs(_dataNum);
+            for (int i = 0; i < _dataNum; i++) {
+                inputs[i] = reinterpret_cast<const uint8_t*>(buffer + i * fragmentLen);
+            }
+            std::vector<uint8_t*> outputs(_parityNum);
+            for (int p = 0; p < _parityNum; p++) {
+                outputs[p] = reinterpret_cast<uint8_t*>(buffer + (_dataNum + p) * fragmentLen);
+            }
+            if (_parityNum > 0) {
+                gf256::MulMatrix(parityMatrix.data(), inputs, outputs, fragmentLen);
+            }
+            return std::make_pair(shardCount, fragmentLen);
+        }
+
+        // Thread safe, fragmentList[i] is the i-th fragment or empty if it is lost,
+        // the data fragments are copied to buffer and the lost ones are restored in place.
+        bool decodeWithBuffer(const std::vector<std::string_view>& fragmentList, int dataLen, char* buffer, int size) const override {
+            if ((int)fragmentList.size() != _dataNum + _parityNum || size < dataLen || dataLen <= 0) {
+                return false;
+            }
+            // the first dataNum received fragments are used for decoding
+            size_t fragmentLen = 0;
+            std::vector<int> received;
+            received.reserve(_dataNum);
+            for (int i = 0; i < (int)fragmentList.size() && (int)received.size() < _dataNum; i++) {
+                if (fragmentList[i].empty()) {
+                    continue;
+                }
+                if (fragmentLen == 0) {
+                    fragmentLen = fragmentList[i].size();
+                } else if (fragmentLen != fragmentList[i].size()) {
+                    return false;
+                }
+                received.push_back(i);
+            }
+            if ((int)received.size() < _dataNum || (size_t)dataLen > fragmentLen * _dataNum) {
+                return false;
+            }
+            std::vector<int> lost;
+            for (int j = 0; j < _dataNum && (size_t)j * fragmentLen < (size_t)dataLen; j++) {
+                const auto len = std::min(fragmentLen, dataLen - j * fragmentLen);
+                if (fragmentList[j].empty()) {
+                    lost.push_back(j);
+                } else {
+                    std::memcpy(buffer + j * fragmentLen, fragmentList[j].data(), len);
+                }
+            }
+            if (lost.empty()) {
+                return true;
+            }
+            auto inverse = getInverseMatrix(received);
+            if (inverse == nullptr) {
+                return false;
+            }
+            std::vector<const uint8_t*> inputs(_dataNum);
+            for (int r = 0; r < _dataNum; r++) {
+                inputs[r] = reinterpret_cast<const uint8_t*>(fragmentList[received[r]].data());
+            }
+            // restore in place, except the last fragment that is longer than the remaining data
+            std::vector<uint8_t> decodeMatrix;
+            std::vector<uint8_t*> outputs;
+            std::string tail;
+            for (auto j: lost) {
+                decodeMatrix.insert(decodeMatrix.end(), inverse->begin() + j * _dataNum, inverse->begin() + (j + 1) * _dataNum);
+                if ((j + 1) * fragmentLen <= (size_t)dataLen) {
+                    outputs.push_back(reinterpret_cast<uint8_t*>(buffer + j * fragmentLen));
+                } else {
+                    tail.resize(fragmentLen);
+                    outputs.push_back(reinterpret_cast<uint8_t*>(tail.data()));
+                }
+            }
+            gf256::MulMatrix(decodeMatrix.data(), inputs, outputs, fragmentLen);
+            if (!tail.empty()) {
+                const auto j = lost.back();
+                std::memcpy(buffer + j * fragmentLen, tail.data(), dataLen - j * fragmentLen);
+            }
+            return true;
+        }
+
+        [[nodiscard]] std::unique_ptr<EncodeResult> encode(std::string_view data) const override {
+            auto storage = std::make_unique<RSEncodeResult>(this, _dataNum + _parityNum);
+            if (storage->encode(data)) {
+                return storage;
+            }
+            return nullptr;
+        }
+
+        [[nodiscard]] std::unique_ptr<DecodeResult> decode(const std::vector<std::string_view>& fragmentList, int dataLen) const override {
+            auto storage = std::make_unique<RSDecodeResult>(this, dataLen);
+            if (storage->decode(fragmentList)) {
+                return storage;
+            }
+            return nullptr;
+        }
+
+    protected:
+        class RSEncodeResult : public EncodeResult {
+        public:
+            RSEncodeResult(const ReedSolomonErasureCode* ec, int size) : EncodeResult(size), _ec(ec) { }
+
+            bool encode(std::string_view data) override {
+                DCHECK(_buffer == nullptr);  // only call encode once for each instance
+                if (data.empty()) {
+                    return false;
+                }
+                const auto bufferSize = _ec->getFragmentLen((int)data.size()) * size();
+                _buffer = std::make_unique<char[]>(bufferSize);
+                auto ret = _ec->encodeWithBuffer(data, _buffer.get(), bufferSize);
+                if (!ret) {
+                    return false;
+                }
+                _fragmentLen = ret->second;
+                return true;
+            }
+
+            // WARNING: return a string_view, be careful
+            [[nodiscard]] std::optional<std::string_view> get(int index) const override {
+                if (_buffer == nullptr || index < 0 || index >= size()) {
+                    return std::nullopt;
+                }
+                return std::string_view(_buffer.get() + index * _fragmentLen, _fragmentLen);
+            }
+
+            [[nodiscard]] std::optional<std::vector<std::string_view>> getAll() const override {
+                if (_buffer == nullptr) {
+                    return std::nullopt;
+                }
+                std::vector<std::string_view> fragmentList;
+                fragmentList.reserve(size());
+                for (int i = 0; i < size(); i++) {
+                    fragmentList.emplace_back(_buffer.get() + i * _fragmentLen, _fragmentLen);
+                }
+                return fragmentList;
+            }
+
+        private:
+            const ReedSolomonErasureCode* _ec;
+            std::unique_ptr<char[]> _buffer;
+            int _fragmentLen = 0;
+        };
+
+        class RSDecodeResult : public DecodeResult {
+        public:
+            RSDecodeResult(const ReedSolomonErasureCode* ec, int dataLen) : _ec(ec), _dataLen(dataLen) { }
+
+            bool decode(const std::vector<std::string_view>& fragmentList) override {
+                if (_dataLen <= 0) {
+                    return false;
+                }
+                _data = std::make_unique<char[]>(_dataLen);
+                return _ec->decodeWithBuffer(fragmentList, _dataLen, _data.get(), _dataLen);
+            }
+
+            // WARNING: return a string_view, be careful
+            [[nodiscard]] std::optional<std::string_view> getData() const override {
+                if (_data == nullptr) {
+                    return std::nullopt;
+                }
+                return std::string_view(_data.get(), _dataLen);
+            }
+
+        private:
+            const ReedSolomonErasureCode* _ec;
+            const int _dataLen;
+            std::unique_ptr<char[]> _data;
+        };
+
+        // the inverse of the rows of the received fragments in the encoding matrix [I; parityMatrix]
+        [[nodiscard]] DecodeMatrixCache::MatrixType getInverseMatrix(const std::vector<int>& received) const {
+            std::string key;
+            if (_decodeMatrixCache != nullptr) {
+                key.assign(received.size(), 0);
+                for (int r = 0; r < (int)received.size(); r++) {
+                    key[r] = (char)received[r];
+                }
+                if (auto cached = _decodeMatrixCache->get(key); cached != nullptr) {
+                    return cached;
+                }
+            }
+            std::vector<uint8_t> matrix(_dataNum * _dataNum, 0), inverse;
+            for (int r = 0; r < _dataNum; r++) {
+                if (received[r] < _dataNum) {
+                    matrix[r * _dataNum + received[r]] = 1;
+                } else {
+                    std::memcpy(&matrix[r * _dataNum], &parityMatrix[(received[r] - _dataNum) * _dataNum], _dataNum);
+                }
+            }
+            if (!gf256::InvertMatrix(std::move(matrix), inverse, _dataNum)) {
+                return nullptr;
+            }
+            auto ret = std::make_shared<const std::vector<uint8_t>>(std::move(inverse));
+            if (_decodeMatrixCache != nullptr) {
+                _decodeMatrixCache->put(std::move(key), ret);
+            }
+            return ret;
+        }
+
+    private:
+        // parityNum x dataNum, row-major
+        std::vector<uint8_t> parityMatrix;
+        std::shared_ptr<DecodeMatrixCache> _decodeMatrixCache;
+    };
+}
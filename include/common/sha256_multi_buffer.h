@@ -0,0 +1,330 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__SHA__)
+#include <immintrin.h>
+#endif
+
+// SHA-256 of many independent messages per call, used for the merkle tree leaves and interior nodes.
+// The kernel is selected at compile time (the release build uses -march=native):
+// AVX-512 16 lanes > SHA-NI single buffer > AVX2 8 lanes > scalar.
+// The messages of a group are hashed in lock step, the lanes of the shorter messages are masked.
+namespace util::sha256 {
+    using Digest = std::array<uint8_t, 32>;
+
+    constexpr uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    constexpr uint32_t IV[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    inline uint32_t LoadBE32(const uint8_t* p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    }
+
+    inline void StoreBE32(uint8_t* p, uint32_t x) {
+        p[0] = (uint8_t)(x >> 24);
+        p[1] = (uint8_t)(x >> 16);
+        p[2] = (uint8_t)(x >> 8);
+        p[3] = (uint8_t)x;
+    }
+
+    inline uint32_t Rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    inline void CompressScalar(uint32_t state[8], const uint8_t* block) {
+        uint32_t w[64];
+        for (int t = 0; t < 16; t++) {
+            w[t] = LoadBE32(block + t * 4);
+        }
+        for (int t = 16; t < 64; t++) {
+            const auto s0 = Rotr(w[t - 15], 7) ^ Rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            const auto s1 = Rotr(w[t - 2], 17) ^ Rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+        auto a = state[0], b = state[1], c = state[2], d = state[3];
+        auto e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0; t < 64; t++) {
+            const auto t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[t] + w[t];
+            const auto t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+#if defined(__SHA__) && defined(__SSE4_1__)
+    // the state is kept as ABEF / CDGH, the layout used by sha256rnds2
+    inline void CompressSHANI(uint32_t state[8], const uint8_t* block) {
+#if defined(__AVX__)
+        // sha256rnds2 has no VEX form, clear the upper halves to avoid the SSE/AVX transition penalty
+        _mm256_zeroupper();
+#endif
+        const auto mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        auto tmp = _mm_loadu_si128((const __m128i*)&state[0]);     // DCBA
+        auto state1 = _mm_loadu_si128((const __m128i*)&state[4]);  // HGFE
+        tmp = _mm_shuffle_epi32(tmp, 0xB1);                         // CDAB
+        state1 = _mm_shuffle_epi32(state1, 0x1B);                   // EFGH
+        auto state0 = _mm_alignr_epi8(tmp, state1, 8);              // ABEF
+        state1 = _mm_blend_epi16(state1, tmp, 0xF0);                // CDGH
+        const auto abef = state0, cdgh = state1;
+
+        __m128i msg[4];
+        for (int i = 0; i < 4; i++) {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(block + i * 16)), mask);
+        }
+        for (int i = 0; i < 16; i++) {
+            auto& m = msg[i & 3];
+            if (i >= 4) {
+                // m = sigma1(w[t-2]) + w[t-7] + sigma0(w[t-15]) + w[t-16]
+                m = _mm_sha256msg1_epu32(m, msg[(i + 1) & 3]);
+                m = _mm_add_epi32(m, _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+                m = _mm_sha256msg2_epu32(m, msg[(i + 3) & 3]);
+            }
+            auto wk = _mm_add_epi32(m, _mm_loadu_si128((const __m128i*)&K[i * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            wk = _mm_shuffle_epi32(wk, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+        tmp = _mm_shuffle_epi32(state0, 0x1B);                      // FEBA
+        state1 = _mm_shuffle_epi32(state1, 0xB1);                   // DCHG
+        state0 = _mm_blend_epi16(tmp, state1, 0xF0);                // DCBA
+        state1 = _mm_alignr_epi8(state1, tmp, 8);                   // HGFE
+        _mm_storeu_si128((__m128i*)&state[0], state0);
+        _mm_storeu_si128((__m128i*)&state[4], state1);
+    }
+#endif
+
+    // the single buffer kernel is faster than the EVP dispatch only with the sha extensions
+#if defined(__SHA__) && defined(__SSE4_1__)
+    constexpr bool HAS_SHA_NI = true;
+#else
+    constexpr bool HAS_SHA_NI = false;
+#endif
+
+    inline void Compress(uint32_t state[8], const uint8_t* block) {
+#if defined(__SHA__) && defined(__SSE4_1__)
+        CompressSHANI(state, block);
+#else
+        CompressScalar(state, block);
+#endif
+    }
+
+#if defined(__AVX512F__)
+    struct Lanes {
+        using V = __m512i;
+        constexpr static int N = 16;
+        static V Load(const uint32_t* p) { return _mm512_loadu_si512((const void*)p); }
+        static void Store(uint32_t* p, V x) { _mm512_storeu_si512((void*)p, x); }
+        static V Set1(uint32_t x) { return _mm512_set1_epi32((int)x); }
+        static V Add(V a, V b) { return _mm512_add_epi32(a, b); }
+        static V Xor3(V a, V b, V c) { return _mm512_ternarylogic_epi32(a, b, c, 0x96); }
+        static V Ch(V e, V f, V g) { return _mm512_ternarylogic_epi32(e, f, g, 0xCA); }
+        static V Maj(V a, V b, V c) { return _mm512_ternarylogic_epi32(a, b, c, 0xE8); }
+        // the maskz forms avoid the undefined source operand of the unmasked intrinsics
+        template<int n> static V Rotr(V x) { return _mm512_maskz_ror_epi32((__mmask16)0xFFFF, x, n); }
+        template<int n> static V Shr(V x) { return _mm512_maskz_srli_epi32((__mmask16)0xFFFF, x, n); }
+    };
+#elif defined(__AVX2__) && !defined(__SHA__)
+    struct Lanes {
+        using V = __m256i;
+        constexpr static int N = 8;
+        static V Load(const uint32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+        static void Store(uint32_t* p, V x) { _mm256_storeu_si256((__m256i*)p, x); }
+        static V Set1(uint32_t x) { return _mm256_set1_epi32((int)x); }
+        static V Add(V a, V b) { return _mm256_add_epi32(a, b); }
+        static V Xor3(V a, V b, V c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+        static V Ch(V e, V f, V g) { return _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g)); }
+        static V Maj(V a, V b, V c) { return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))); }
+        template<int n> static V Rotr(V x) { return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n)); }
+        template<int n> static V Shr(V x) { return _mm256_srli_epi32(x, n); }
+    };
+#else
+    // the single buffer kernel is used
+    struct Lanes {
+        constexpr static int N = 1;
+    };
+#endif
+
+    // the number of messages hashed together
+    constexpr int LANE_COUNT = Lanes::N;
+
+    // state[i][lane] += compress(w[t][lane]), w is the big-endian words of the blocks
+    template<class L>
+    inline void CompressLanes(uint32_t state[8][L::N], const uint32_t w[16][L::N]) {
+        using V = typename L::V;
+        V s[8], m[16];
+        for (int i = 0; i < 8; i++) {
+            s[i] = L::Load(state[i]);
+        }
+        for (int t = 0; t < 16; t++) {
+            m[t] = L::Load(w[t]);
+        }
+        auto a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        for (int t = 0; t < 64; t++) {
+            if (t >= 16) {
+                const auto& w15 = m[(t - 15) & 15];
+                const auto& w2 = m[(t - 2) & 15];
+                const auto s0 = L::Xor3(L::template Rotr<7>(w15), L::template Rotr<18>(w15), L::template Shr<3>(w15));
+                const auto s1 = L::Xor3(L::template Rotr<17>(w2), L::template Rotr<19>(w2), L::template Shr<10>(w2));
+                m[t & 15] = L::Add(L::Add(m[t & 15], s0), L::Add(m[(t - 7) & 15], s1));
+            }
+            const auto S1 = L::Xor3(L::template Rotr<6>(e), L::template Rotr<11>(e), L::template Rotr<25>(e));
+            const auto t1 = L::Add(L::Add(h, S1), L::Add(L::Ch(e, f, g), L::Add(L::Set1(K[t]), m[t & 15])));
+            const auto S0 = L::Xor3(L::template Rotr<2>(a), L::template Rotr<13>(a), L::template Rotr<22>(a));
+            const auto t2 = L::Add(S0, L::Maj(a, b, c));
+            h = g; g = f; f = e; e = L::Add(d, t1);
+            d = c; c = b; b = a; a = L::Add(t1, t2);
+        }
+        const V r[8] = {a, b, c, d, e, f, g, h};
+        for (int i = 0; i < 8; i++) {
+            L::Store(state[i], L::Add(s[i], r[i]));
+        }
+    }
+
+    // The padded blocks of a message, the full blocks are read in place
+    class PaddedMessage {
+    public:
+        PaddedMessage() = default;
+
+        explicit PaddedMessage(std::string_view msg) { reset(msg); }
+
+        void reset(std::string_view msg) {
+            _data = reinterpret_cast<const uint8_t*>(msg.data());
+            _fullBlocks = msg.size() / 64;
+            const auto rest = msg.size() % 64;
+            std::memset(_tail, 0, sizeof(_tail));
+            std::memcpy(_tail, _data + _fullBlocks * 64, rest);
+            _tail[rest] = 0x80;
+            _tailBlocks = rest + 9 <= 64 ? 1 : 2;
+            const uint64_t bits = (uint64_t)msg.size() * 8;
+            for (int i = 0; i < 8; i++) {
+                _tail[_tailBlocks * 64 - 1 - i] = (uint8_t)(bits >> (8 * i));
+            }
+        }
+
+        [[nodiscard]] size_t blockCount() const { return _fullBlocks + _tailBlocks; }
+
+        [[nodiscard]] const uint8_t* block(size_t i) const {
+            return i < _fullBlocks ? _data + i * 64 : _tail + (i - _fullBlocks) * 64;
+        }
+
+        static size_t BlockCount(size_t len) { return len / 64 + (len % 64 + 9 <= 64 ? 1 : 2); }
+
+    private:
+        const uint8_t* _data = nullptr;
+        size_t _fullBlocks = 0;
+        size_t _tailBlocks = 0;
+        uint8_t _tail[128]{};
+    };
+
+    inline void Hash(std::string_view msg, Digest& digest) {
+        uint32_t state[8];
+        std::memcpy(state, IV, sizeof(IV));
+        PaddedMessage padded(msg);
+        for (size_t i = 0; i < padded.blockCount(); i++) {
+            Compress(state, padded.block(i));
+        }
+        for (int i = 0; i < 8; i++) {
+            StoreBE32(digest.data() + i * 4, state[i]);
+        }
+    }
+
+    // digests[i] = sha256(messages[i]), the messages are grouped by length to fill the lanes
+    inline void HashMany(const std::string_view* messages, Digest* digests, size_t count) {
+        if constexpr (LANE_COUNT == 1) {
+            for (size_t i = 0; i < count; i++) {
+                Hash(messages[i], digests[i]);
+            }
+        } else {
+            constexpr int N = LANE_COUNT;
+            std::vector<uint32_t> order(count);
+            std::iota(order.begin(), order.end(), 0);
+            bool sameLength = std::all_of(messages, messages + count, [&](const auto& m) { return m.size() == messages[0].size(); });
+            if (!sameLength) {
+                std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+                    return messages[lhs].size() < messages[rhs].size();
+                });
+            }
+            PaddedMessage padded[N];
+            alignas(64) uint32_t state[8][N];
+            alignas(64) uint32_t next[8][N];
+            alignas(64) uint32_t w[16][N];
+            size_t i = 0;
+            for (; i + N <= count; i += N) {
+                size_t maxBlocks = 0;
+                for (int l = 0; l < N; l++) {
+                    padded[l].reset(messages[order[i + l]]);
+                    maxBlocks = std::max(maxBlocks, padded[l].blockCount());
+                    for (int j = 0; j < 8; j++) {
+                        state[j][l] = IV[j];
+                    }
+                }
+                for (size_t b = 0; b < maxBlocks; b++) {
+                    for (int l = 0; l < N; l++) {
+                        // a finished lane hashes its last block again, the result is dropped
+                        const auto* block = padded[l].block(std::min(b, padded[l].blockCount() - 1));
+                        for (int t = 0; t < 16; t++) {
+                            w[t][l] = LoadBE32(block + t * 4);
+                        }
+                    }
+                    std::memcpy(next, state, sizeof(state));
+                    CompressLanes<Lanes>(next, w);
+                    for (int l = 0; l < N; l++) {
+                        if (b < padded[l].blockCount()) {
+                            for (int j = 0; j < 8; j++) {
+                                state[j][l] = next[j][l];
+                            }
+                        }
+                    }
+                }
+                for (int l = 0; l < N; l++) {
+                    auto& digest = digests[order[i + l]];
+                    for (int j = 0; j < 8; j++) {
+                        StoreBE32(digest.data() + j * 4, state[j][l]);
+                    }
+                }
+            }
+            for (; i < count; i++) {
+                Hash(messages[order[i]], digests[order[i]]);
+            }
+        }
+    }
+
+    // parents[i] = sha256(children[2i] || children[2i+1]), one level of a merkle tree
+    inline void HashNodes(const Digest* children, Digest* parents, size_t parentCount) {
+        static_assert(sizeof(Digest) == 32, "Digest must be packed");
+        constexpr size_t BATCH = 256;
+        std::string_view messages[BATCH];
+        for (size_t i = 0; i < parentCount; i += BATCH) {
+            const auto n = std::min(BATCH, parentCount - i);
+            for (size_t j = 0; j < n; j++) {
+                messages[j] = std::string_view(reinterpret_cast<const char*>(children[(i + j) * 2].data()), 64);
+            }
+            HashMany(messages, parents + i, n);
+        }
+    }
+}
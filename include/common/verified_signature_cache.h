@@ -0,0 +1,104 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "common/crypto.h"
+#include "common/lru.h"
+#include "common/phmap.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+
+namespace util {
+    // VerifiedSignatureCache remembers the signatures that are verified successfully, so that a signature
+    // checked on receive is not checked again when the block is validated (or when it is relayed).
+    // An entry is indexed by sha256(public key || signature || message), it can not be forged without
+    // a collision. Only the valid signatures are cached, thread safe.
+    class VerifiedSignatureCache {
+    public:
+        using Fingerprint = OpenSSLSHA256::digestType;
+
+        // a rough estimation of the memory used by an entry (the lru list node and the index node)
+        constexpr static size_t BYTES_PER_ENTRY = 160;
+
+        constexpr static size_t DEFAULT_CAPACITY = 1 << 16;
+
+        struct Statistics {
+            uint64_t hitCount;
+            uint64_t missCount;
+            size_t size;
+
+            [[nodiscard]] double hitRate() const {
+                auto total = hitCount + missCount;
+                return total == 0 ? 0 : (double)hitCount / (double)total;
+            }
+        };
+
+        // capacity is the max number of cached signatures, the footprint is about capacity * BYTES_PER_ENTRY
+        explicit VerifiedSignatureCache(size_t capacity) : _capacity(capacity) {
+            auto shardCapacity = std::max<size_t>(capacity / SHARD_COUNT, 1);
+            for (auto& it: _shards) {
+                it.init(shardCapacity, std::max<size_t>(shardCapacity / 16, 1));
+            }
+        }
+
+        VerifiedSignatureCache(const VerifiedSignatureCache&) = delete;
+
+        static Fingerprint GetFingerprint(std::string_view publicKey, const OpenSSLED25519::digestType& signature,
+                                          const void *d, size_t cnt) {
+            thread_local std::string buffer;
+            buffer.clear();
+            buffer.append(publicKey);
+            buffer.append(reinterpret_cast<const char*>(signature.data()), signature.size());
+            buffer.append(reinterpret_cast<const char*>(d), cnt);
+            auto ret = OpenSSLSHA256::generateDigest(buffer.data(), buffer.size());
+            CHECK(ret != std::nullopt) << "generate fingerprint failed";
+            return *ret;
+        }
+
+        // return true if the signature was verified before, refresh the entry on hit
+        bool contains(const Fingerprint& fingerprint) {
+            bool value;
+            if (shard(fingerprint).tryGetCopy(fingerprint, value)) {
+                _hitCount.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            _missCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // record a valid signature, the least recently used entries are evicted when the shard is full
+        void insert(const Fingerprint& fingerprint) {
+            shard(fingerprint).insert(fingerprint, true);
+        }
+
+        [[nodiscard]] size_t capacity() const { return _capacity; }
+
+        [[nodiscard]] Statistics getStatistics() const {
+            Statistics statistics{};
+            statistics.hitCount = _hitCount.load(std::memory_order_relaxed);
+            statistics.missCount = _missCount.load(std::memory_order_relaxed);
+            for (const auto& it: _shards) {
+                statistics.size += it.size();
+            }
+            return statistics;
+        }
+
+    protected:
+        // the shards reduce the contention of the lru lock
+        constexpr static int SHARD_COUNT = 16;
+
+        inline LRUCache<Fingerprint, bool, std::mutex>& shard(const Fingerprint& fingerprint) {
+            // std::hash of the fingerprint uses the leading bytes, use the last byte to select the shard
+            return _shards[fingerprint.back() % SHARD_COUNT];
+        }
+
+    private:
+        const size_t _capacity;
+        std::array<LRUCache<Fingerprint, bool, std::mutex>, SHARD_COUNT> _shards;
+        std::atomic<uint64_t> _hitCount = 0;
+        std::atomic<uint64_t> _missCount = 0;
+    };
+}
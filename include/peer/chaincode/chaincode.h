@@ -25,6 +25,9 @@ namespace peer::chaincode {
             return orm->reset(reads_, writes_);
         }
 
+        // The rw sets are allocated from the arena, nullptr to disable
+        inline void setArena(util::Arena* arena) { orm->setArena(arena); }
+
     protected:
         // use orm to write to db
         std::unique_ptr<ORM> orm;
@@ -24,20 +24,49 @@ namespace peer::chaincode {
 
         [[nodiscard]] inline bool get(std::string&& key, std::string_view* valueSV) {
             DCHECK(!keyAlreadyExistInWrites(key));  // read stale
+            // reuse the buffer if the value is copied into the arena
             std::string value;
-            auto ret = db->get(key, &value);
+            auto* valuePtr = arena == nullptr ? &value : &valueBuffer;
+            auto ret = db->get(key, valuePtr);
             // empty value is marked deleted
-            if (!ret || value.empty()) {
+            if (!ret || valuePtr->empty()) {
+                return false;
+            }
+            auto readKV = newKV(std::move(key), std::move(*valuePtr));
+            *valueSV = readKV->getValueSV();
+            reads.push_back(std::move(readKV));
+            return true;
+        }
+
+        // Avoid constructing strings when the arena is set, the key may be a reused buffer
+        [[nodiscard]] inline bool getSV(std::string_view key, std::string_view* valueSV) {
+            if (arena == nullptr) {
+                return get(std::string(key), valueSV);
+            }
+            DCHECK(!keyAlreadyExistInWrites(key));  // read stale
+            keyBuffer.assign(key);
+            auto ret = db->get(keyBuffer, &valueBuffer);
+            // empty value is marked deleted
+            if (!ret || valueBuffer.empty()) {
                 return false;
             }
             std::unique_ptr<proto::KV> readKV(new proto::KV());
-            readKV->setKey(std::move(key));
-            readKV->setValue(std::move(value));
+            readKV->setKeyValue(key, valueBuffer, *arena);
             *valueSV = readKV->getValueSV();
             reads.push_back(std::move(readKV));
             return true;
         }
 
+        inline void putSV(std::string_view key, std::string_view value) {
+            if (arena == nullptr) {
+                return put(std::string(key), std::string(value));
+            }
+            DCHECK(!keyAlreadyExistInWrites(key));  // update twice
+            std::unique_ptr<proto::KV> writeKV(new proto::KV());
+            writeKV->setKeyValue(key, value, *arena);
+            writes.push_back(std::move(writeKV));
+        }
+
         inline void put(const std::string& key, const std::string& value) {
             put(std::string(key), std::string(value));
         }
@@ -52,10 +81,7 @@ namespace peer::chaincode {
 
         inline void put(std::string&& key, std::string&& value) {
             DCHECK(!keyAlreadyExistInWrites(key));  // update twice
-            std::unique_ptr<proto::KV> writeKV(new proto::KV());
-            writeKV->setKey(std::move(key));
-            writeKV->setValue(std::move(value));
-            writes.push_back(std::move(writeKV));
+            writes.push_back(newKV(std::move(key), std::move(value)));
         }
 
         inline void del(const std::string& key) {
@@ -64,11 +90,13 @@ namespace peer::chaincode {
 
         inline void del(std::string&& key) {
             DCHECK(!keyAlreadyExistInWrites(key));  // update twice
-            std::unique_ptr<proto::KV> writeKV(new proto::KV());
-            writeKV->setKey(std::move(key));
-            writes.push_back(std::move(writeKV));
+            writes.push_back(newKV(std::move(key), {}));
         }
 
+        // The keys and values are copied into the arena (instead of owned by each kv) if it is set,
+        // the caller must keep the arena alive as long as the rw sets, nullptr to disable.
+        inline void setArena(util::Arena* arena_) { arena = arena_; }
+
         // set the return string
         inline void setResult(auto&& result_) { result = std::forward<decltype(result_)>(result_); }
 
@@ -95,7 +123,18 @@ namespace peer::chaincode {
     protected:
         explicit ORM(std::shared_ptr<const db::DBConnection> db) : db(std::move(db)) { }
 
-        [[nodiscard]] inline bool keyAlreadyExistInWrites(const std::string& key) const {
+        inline std::unique_ptr<proto::KV> newKV(std::string&& key, std::string&& value) {
+            std::unique_ptr<proto::KV> kv(new proto::KV());
+            if (arena == nullptr) {
+                kv->setKey(std::move(key));
+                kv->setValue(std::move(value));
+            } else {
+                kv->setKeyValue(key, value, *arena);
+            }
+            return kv;
+        }
+
+        [[nodiscard]] inline bool keyAlreadyExistInWrites(std::string_view key) const {
             if (writes.size() > 100) {
                 return false;   // skip when rw set is too big
             }
@@ -112,5 +151,9 @@ namespace peer::chaincode {
         proto::KVList reads;
         proto::KVList writes;
         std::string result;
+        util::Arena* arena = nullptr;
+        // reused when the arena is set
+        std::string keyBuffer;
+        std::string valueBuffer;
     };
 }
\ No newline at end of file
@@ -51,5 +51,8 @@ namespace peer::chaincode {
 
     private:
         client::tpcc::TPCCHelper helper;
+        // reused between calls, the orm copies them when the arena is set
+        std::string keyBuffer;
+        std::string valueBuffer;
     };
 }
\ No newline at end of file
@@ -0,0 +1,140 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "peer/concurrency_control/key_hint_partitioner.h"
+#include "peer/db/db_interface.h"
+#include "common/property.h"
+#include "proto/transaction.h"
+
+#include "glog/logging.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace peer::cc {
+    // The runtime interface of a cc engine. It costs one virtual call per batch,
+    // the engine still runs its own coordinator (CRTP) inside.
+    class CCEngine {
+    public:
+        using TxnListType = std::vector<std::unique_ptr<proto::Transaction>>;
+
+        virtual ~CCEngine() = default;
+
+        [[nodiscard]] virtual const std::string& getName() const = 0;
+
+        // NOT thread safe, take the transactions and move them back after execution
+        virtual bool processTxnList(TxnListType& txnList) = 0;
+
+        virtual bool processValidatedRequests(std::vector<std::unique_ptr<proto::Envelop>>& requests,
+                                              std::vector<std::unique_ptr<proto::TxReadWriteSet>>& retRWSets,
+                                              std::vector<std::byte>& retResults) = 0;
+    };
+
+    template<class CoordinatorType>
+    class CCEngineAdapter : public CCEngine {
+    public:
+        CCEngineAdapter(std::string name, std::unique_ptr<CoordinatorType> cc, std::shared_ptr<db::DBConnection> dbc)
+                : _name(std::move(name)), _cc(std::move(cc)), _dbc(std::move(dbc)) { }
+
+        [[nodiscard]] const std::string& getName() const override { return _name; }
+
+        bool processTxnList(TxnListType& txnList) override {
+            auto ret = _cc->processTxnList(txnList);
+            _dbc->onBlockCommitted();
+            return ret;
+        }
+
+        bool processValidatedRequests(std::vector<std::unique_ptr<proto::Envelop>>& requests,
+                                      std::vector<std::unique_ptr<proto::TxReadWriteSet>>& retRWSets,
+                                      std::vector<std::byte>& retResults) override {
+            auto ret = _cc->processValidatedRequests(requests, retRWSets, retResults);
+            _dbc->onBlockCommitted();
+            return ret;
+        }
+
+        // for the engine specific settings and statistics
+        [[nodiscard]] CoordinatorType* getCoordinator() const { return _cc.get(); }
+
+    private:
+        const std::string _name;
+        std::unique_ptr<CoordinatorType> _cc;
+        // all workers are idle after a batch, the block boundary of the db
+        std::shared_ptr<db::DBConnection> _dbc;
+    };
+
+    // The engines are selected by name at runtime, the built-in ones are
+    // "aria", "aria_wb", "serial", "crdt" and "dag".
+    class CCEngineRegistry {
+    public:
+        // properties may be nullptr, in which case the engine uses its default settings
+        using Factory = std::function<std::unique_ptr<CCEngine>(const std::shared_ptr<db::DBConnection>& dbc,
+                                                                int workerCount,
+                                                                const util::Properties* properties)>;
+
+        // The registry with the built-in engines
+        static CCEngineRegistry& Instance();
+
+        // NOT thread safe, replace the engine with the same name
+        void registerEngine(const std::string& name, Factory factory) {
+            _factories[name] = std::move(factory);
+        }
+
+        // configure: apply the engine specific properties after the coordinator is created,
+        // the key partitioner (if enabled) is set before configure
+        template<class CoordinatorType>
+        void registerCoordinator(const std::string& name,
+                                 std::function<void(CoordinatorType&, const util::Properties&)> configure = nullptr) {
+            registerEngine(name, [name, configure=std::move(configure)](const auto& dbc, int workerCount, const auto* properties)
+                    -> std::unique_ptr<CCEngine> {
+                auto cc = CoordinatorType::NewCoordinator(dbc, workerCount);
+                if (cc == nullptr) {
+                    return nullptr;
+                }
+                if (properties != nullptr && properties->getCCKeyPartition()) {
+                    cc->setPartitioner(KeyHintPartitioner::NewDefaultPartitioner(properties->getCCKeyPartitionMaxImbalance()));
+                }
+                if (configure && properties != nullptr) {
+                    configure(*cc, *properties);
+                }
+                return std::make_unique<CCEngineAdapter<CoordinatorType>>(name, std::move(cc), dbc);
+            });
+        }
+
+        // return nullptr if the engine is not registered or can not be created
+        [[nodiscard]] std::unique_ptr<CCEngine> newEngine(const std::string& name,
+                                                          const std::shared_ptr<db::DBConnection>& dbc,
+                                                          int workerCount,
+                                                          const util::Properties* properties = nullptr) const {
+            auto it = _factories.find(name);
+            if (it == _factories.end()) {
+                LOG(ERROR) << "Unknown cc engine: " << name;
+                return nullptr;
+            }
+            if (workerCount <= 0) {
+                LOG(ERROR) << "Invalid worker count of cc engine " << name << ": " << workerCount;
+                return nullptr;
+            }
+            return it->second(dbc, workerCount, properties);
+        }
+
+        [[nodiscard]] std::vector<std::string> getEngineNames() const {
+            std::vector<std::string> names;
+            names.reserve(_factories.size());
+            for (const auto& it: _factories) {
+                names.push_back(it.first);
+            }
+            return names;
+        }
+
+    protected:
+        CCEngineRegistry() = default;
+
+    private:
+        std::map<std::string, Factory> _factories;
+    };
+}
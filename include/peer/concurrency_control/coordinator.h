@@ -5,6 +5,7 @@
 #pragma once
 
 #include "peer/concurrency_control/worker_fsm.h"
+#include "peer/concurrency_control/key_hint_partitioner.h"
 #include "peer/db/db_interface.h"
 #include "bthread/countdown_event.h"
 #include "proto/transaction.h"
@@ -60,24 +61,32 @@ namespace peer::cc {
             return true;
         }
 
+        // NOT thread safe, must be called before processing any batch.
+        // Group the txns by key hint instead of round-robin, nullptr to disable.
+        void setPartitioner(std::shared_ptr<KeyHintPartitioner> p) { partitioner = std::move(p); }
+
+        [[nodiscard]] const std::shared_ptr<KeyHintPartitioner>& getPartitioner() const { return partitioner; }
+
         // NOT thread safe, processTxnList will take the transactions and move them back after execution
         bool processTxnList(std::vector<std::unique_ptr<proto::Transaction>>& txnList) {
-            const auto totalWorkerCount = (int)workerList.size();
+            assignTxnList(txnList);
             // prepare txn function
             auto afterStart = [&](const auto& worker, auto& fsm) {
                 auto& fsmTxnList = fsm.getMutableTxnList();
                 fsmTxnList.clear();
-                auto id = worker.getId();
-                for (int i = id; i < (int)txnList.size(); i += totalWorkerCount) {
+                for (auto i: assignment[worker.getId()]) {
+                    txnList[i]->setBatchIndex(i);
                     fsmTxnList.push_back(std::move(txnList[i]));
                 }
             };
-            // move back
+            // move back, the rw sets are hashed by the workers in parallel
             auto afterCommit = [&](const auto& worker, auto& fsm) {
                 auto& fsmTxnList = fsm.getMutableTxnList();
-                auto id = worker.getId();
-                for (int i = id, j = 0; i < (int)txnList.size(); i += totalWorkerCount) {
-                    txnList[i] = std::move(fsmTxnList[j++]);
+                int j = 0;
+                for (auto i: assignment[worker.getId()]) {
+                    auto& txn = fsmTxnList[j++];
+                    txn->updateExecutionResultDigest();
+                    txnList[i] = std::move(txn);
                 }
             };
             return static_cast<Derived*>(this)->processSync(afterStart, afterCommit);
@@ -89,6 +98,10 @@ namespace peer::cc {
             retResults.resize(requests.size());
             retRWSets.resize(requests.size());
             const auto totalWorkerCount = (int)workerList.size();
+            if (partitioner != nullptr) {
+                // the partitioner needs the args of all txns before assigning them
+                return processValidatedRequestsPartitioned(requests, retRWSets, retResults);
+            }
             // prepare txn function
             auto afterStart = [&](const auto& worker, auto& fsm) {
                 auto& fsmTxnList = fsm.getMutableTxnList();
@@ -97,6 +110,7 @@ namespace peer::cc {
                 for (int i = worker.getId(); i < (int)requests.size(); i += totalWorkerCount) {
                     auto txn = proto::Transaction::NewTransactionFromEnvelop(std::move(requests[i]));
                     CHECK(txn != nullptr) << "Can not get exn from envelop!";
+                    txn->setBatchIndex(i);
                     fsmTxnList.push_back(std::move(txn));   // txn may be nullptr
                 }
             };
@@ -125,6 +139,52 @@ namespace peer::cc {
     protected:
         Coordinator() = default;
 
+        // assignment[w] is the ordered txn indexes of worker w
+        void assignTxnList(const std::vector<std::unique_ptr<proto::Transaction>>& txnList) {
+            const auto totalWorkerCount = (int)workerList.size();
+            assignment.resize(totalWorkerCount);
+            if (partitioner != nullptr) {
+                partitioner->partition(txnList, assignment);
+                return;
+            }
+            for (int id = 0; id < totalWorkerCount; id++) {
+                assignment[id].clear();
+                for (int i = id; i < (int)txnList.size(); i += totalWorkerCount) {
+                    assignment[id].push_back(i);
+                }
+            }
+        }
+
+        // Decode (and destroy) the txns in parallel, execute them with processTxnList
+        bool processValidatedRequestsPartitioned(std::vector<std::unique_ptr<proto::Envelop>>& requests,
+                                                 std::vector<std::unique_ptr<proto::TxReadWriteSet>>& retRWSets,
+                                                 std::vector<std::byte>& retResults) {
+            const auto totalWorkerCount = (int)workerList.size();
+            std::vector<std::unique_ptr<proto::Transaction>> txnList(requests.size());
+            auto ret = processParallel(InvokerCommand::CUSTOM, ReceiverState::FINISH_CUSTOM, [&](const auto& worker, auto&) {
+                for (int i = worker.getId(); i < (int)requests.size(); i += totalWorkerCount) {
+                    txnList[i] = proto::Transaction::NewTransactionFromEnvelop(std::move(requests[i]));
+                    CHECK(txnList[i] != nullptr) << "Can not get exn from envelop!";
+                }
+            });
+            if (!ret) {
+                LOG(ERROR) << "decode txnList failed!";
+                return false;
+            }
+            if (!processTxnList(txnList)) {
+                return false;
+            }
+            return processParallel(InvokerCommand::CUSTOM, ReceiverState::FINISH_CUSTOM, [&](const auto& worker, auto&) {
+                for (int i = worker.getId(); i < (int)requests.size(); i += totalWorkerCount) {
+                    auto& txn = txnList[i];
+                    retResults[i] = static_cast<std::byte>(txn->getExecutionResult() == proto::Transaction::ExecutionResult::COMMIT);
+                    auto destroyed = proto::Transaction::DestroyTransaction(std::move(txn));
+                    requests[i] = std::move(destroyed.first);
+                    retRWSets[i] = std::move(destroyed.second);
+                }
+            });
+        }
+
         // InvokerCommand: worker fsm input
         // ReceiverState: worker fsm output
         // Block until all worker finish
@@ -158,5 +218,7 @@ namespace peer::cc {
         std::vector<std::shared_ptr<WorkerFSMType>> fsmList;
         // countdown: for method processParallel
         bthread::CountdownEvent countdown;
+        std::shared_ptr<KeyHintPartitioner> partitioner;
+        std::vector<std::vector<uint32_t>> assignment;
     };
 }
\ No newline at end of file
@@ -13,7 +13,6 @@ namespace peer::cc::crdt {
     public:
         bool init(const std::shared_ptr<peer::db::DBConnection>& dbc) {
             auto dbShim = std::make_shared<peer::crdt::chaincode::DBShim>(dbc);
-            auto table = std::make_shared<ReserveTable>();
             for (auto& it: this->fsmList) {
                 it->setDBShim(dbShim);
             }
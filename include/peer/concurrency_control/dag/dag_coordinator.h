@@ -0,0 +1,124 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "peer/concurrency_control/coordinator.h"
+#include "peer/concurrency_control/dag/dag_worker_fsm.h"
+#include "common/timer.h"
+
+#include <algorithm>
+
+namespace peer::cc::dag {
+    // Simulate all transactions in parallel, build a conflict graph from the rw sets,
+    // then execute the graph on a work-stealing scheduler: the independent txns are committed
+    // in parallel and the conflicting ones in batch order, so no txn is aborted by conflicts.
+    class DAGCoordinator : public Coordinator<DAGWorkerFSM, DAGCoordinator> {
+    public:
+        // Counters of all processed batches
+        struct Statistics {
+            uint64_t totalTxnCount = 0;
+            uint64_t totalEdgeCount = 0;
+            // re-executed after the predecessors are committed
+            uint64_t reExecutedCount = 0;
+            // deferred and re-executed serially before their successors
+            uint64_t serialCount = 0;
+            uint64_t totalBatchCount = 0;
+            double totalTimeSec = 0;
+
+            [[nodiscard]] double throughput() const {
+                return totalTimeSec == 0 ? 0 : (double)totalTxnCount / totalTimeSec;
+            }
+        };
+
+        bool init(const std::shared_ptr<peer::db::DBConnection>& dbc) {
+            graph = std::make_shared<DependencyGraph>((int)this->fsmList.size());
+            for (int i = 0; i < (int)this->fsmList.size(); i++) {
+                auto& fsm = this->fsmList[i];
+                fsm->setDB(dbc);
+                fsm->setDependencyGraph(graph);
+                fsm->setWorkerId(i);
+            }
+            return true;
+        }
+
+        // NOT thread safe
+        [[nodiscard]] const Statistics& getStatistics() const { return statistics; }
+
+        bool processSync(const auto& afterStart, const auto& afterCommit) {
+            util::Timer timer;
+            auto ret = processParallel(InvokerCommand::START, ReceiverState::READY, afterStart);
+            if (!ret) {
+                LOG(ERROR) << "init txnList failed!";
+                return false;
+            }
+            ret = processParallel(InvokerCommand::EXEC, ReceiverState::FINISH_EXEC, nullptr);
+            if (!ret) {
+                LOG(ERROR) << "exec txnList failed!";
+                return false;
+            }
+            // index the txn by batch index
+            size_t txnCount = 0;
+            for (const auto& fsm: this->fsmList) {
+                txnCount += fsm->getMutableTxnList().size();
+            }
+            std::vector<proto::Transaction*> txnList(txnCount);
+            for (const auto& fsm: this->fsmList) {
+                for (const auto& txn: fsm->getMutableTxnList()) {
+                    DCHECK(txn->getBatchIndex() < txnCount);
+                    txnList[txn->getBatchIndex()] = txn.get();
+                }
+            }
+            graph->build(txnList);
+            while (true) {
+                ret = processParallel(InvokerCommand::COMMIT, ReceiverState::FINISH_COMMIT, nullptr);
+                if (!ret) {
+                    LOG(ERROR) << "commit txnList failed!";
+                    return false;
+                }
+                auto deferred = graph->getDeferred();
+                if (deferred.empty()) {
+                    break;
+                }
+                processDeferredSerially(deferred);
+                graph->finishDeferred();
+            }
+            // move back
+            ret = processParallel(InvokerCommand::CUSTOM, ReceiverState::FINISH_CUSTOM, afterCommit);
+            if (!ret) {
+                LOG(ERROR) << "finish txnList failed!";
+                return false;
+            }
+            statistics.totalTxnCount += txnCount;
+            statistics.totalEdgeCount += graph->getEdgeCount();
+            for (const auto& fsm: this->fsmList) {
+                statistics.reExecutedCount += fsm->popReExecutedCount();
+            }
+            statistics.totalBatchCount += 1;
+            statistics.totalTimeSec += timer.end();
+            return true;
+        }
+
+        friend class Coordinator;
+
+    protected:
+        DAGCoordinator() = default;
+
+        // The txns touched a key out of their simulated rw sets, all workers are idle,
+        // and all txns not ordered after them are committed. Their successors are still blocked.
+        // The serial order is deterministic: the committed txns, then these txns in batch order.
+        void processDeferredSerially(const std::vector<proto::Transaction*>& deferred) {
+            auto& fsm = this->fsmList.front();
+            for (auto* txn: deferred) {
+                DCHECK(txn->getExecutionResult() == proto::Transaction::ExecutionResult::ABORT);
+                fsm->executeAndCommitSerially(txn);
+                statistics.serialCount++;
+            }
+        }
+
+    private:
+        Statistics statistics;
+        std::shared_ptr<DependencyGraph> graph;
+    };
+}
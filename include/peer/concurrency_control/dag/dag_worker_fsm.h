@@ -0,0 +1,84 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "peer/concurrency_control/deterministic/chaincode_worker_fsm.h"
+#include "peer/concurrency_control/dag/dependency_graph.h"
+
+namespace peer::cc::dag {
+    class DAGWorkerFSM : public CCWorkerFSM {
+    public:
+        ReceiverState OnCreate() override {
+            pthread_setname_np(pthread_self(), "dag_worker");
+            return peer::cc::ReceiverState::READY;
+        }
+
+        // Simulate the transactions against the snapshot of the last batch
+        ReceiverState OnExecuteTransaction() override {
+            DCHECK(getDB() != nullptr && graph != nullptr);
+            renewArena();
+            for (auto& txn: txnList()) {
+                auto ret = invokeChaincode(txn.get());
+                txn->setExecutionResult(ret == 0 ? ResultType::COMMIT : ResultType::ABORT_NO_RETRY);
+            }
+            return peer::cc::ReceiverState::FINISH_EXEC;
+        }
+
+        // Execute the graph with the other workers, the txns are stolen from each other
+        ReceiverState OnCommitTransaction() override {
+            graph->run(workerId, [this](proto::Transaction* txn, bool stale) {
+                return commitTransaction(txn, stale);
+            });
+            return peer::cc::ReceiverState::FINISH_COMMIT;
+        }
+
+        void setDependencyGraph(std::shared_ptr<DependencyGraph> graph_) { graph = std::move(graph_); }
+
+        void setWorkerId(int workerId_) { workerId = workerId_; }
+
+        // the number of re-executed txns since the last call
+        [[nodiscard]] uint64_t popReExecutedCount() { return std::exchange(reExecutedCount, 0); }
+
+    protected:
+        // Return false if the txn is deferred.
+        // A stale txn is re-executed against the latest db state, all its predecessors are committed.
+        // If it touches a key out of the simulated rw sets, it may conflict with a txn not ordered with it,
+        // so it is marked ABORT and deferred, the coordinator re-executes it serially before its successors.
+        bool commitTransaction(proto::Transaction* txn, bool stale) {
+            if (stale) {
+                // keep the simulated rw sets for checking
+                auto reads = std::move(txn->getReads());
+                auto writes = std::move(txn->getWrites());
+                auto ret = invokeChaincode(txn);
+                reExecutedCount++;
+                if (!CoveredBy(txn->getReads(), reads, writes) || !CoveredBy(txn->getWrites(), writes, {})) {
+                    txn->setExecutionResult(ResultType::ABORT);
+                    return false;
+                }
+                txn->setExecutionResult(ret == 0 ? ResultType::COMMIT : ResultType::ABORT_NO_RETRY);
+            }
+            if (txn->getExecutionResult() != ResultType::COMMIT || txn->getWrites().empty()) {
+                return true;
+            }
+            // the successors read the writes immediately, so the writes are not group committed
+            saveWritesToDB(txn);
+            return true;
+        }
+
+        static bool CoveredBy(const proto::KVList& kvList, const proto::KVList& lhs, const proto::KVList& rhs) {
+            auto contains = [](const proto::KVList& list, std::string_view key) {
+                return std::any_of(list.begin(), list.end(), [&](const auto& kv) { return kv->getKeySV() == key; });
+            };
+            return std::all_of(kvList.begin(), kvList.end(), [&](const auto& kv) {
+                return contains(lhs, kv->getKeySV()) || contains(rhs, kv->getKeySV());
+            });
+        }
+
+    private:
+        int workerId = 0;
+        uint64_t reExecutedCount = 0;
+        std::shared_ptr<DependencyGraph> graph;
+    };
+}
@@ -0,0 +1,232 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "proto/transaction.h"
+#include "common/phmap.h"
+
+#include "riften/deque.hpp"
+#include "glog/logging.h"
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace peer::cc::dag {
+    // The conflict graph of a batch, built from the simulated rw sets.
+    // For each key, a txn depends on the last earlier writer (raw / waw),
+    // and a writer depends on the readers after the last earlier writer (war).
+    // The edges always go from a smaller batch index to a larger one, so the graph is acyclic,
+    // and any topological order is equivalent to the batch order.
+    // A deferred txn blocks its successors until it is finished by finishDeferred, after the graph drains.
+    class DependencyGraph {
+    public:
+        using index_type = uint32_t;
+
+        explicit DependencyGraph(int workerCount) {
+            CHECK(workerCount > 0);
+            deques.reserve(workerCount);
+            for (int i = 0; i < workerCount; i++) {
+                deques.push_back(std::make_unique<riften::Deque<index_type>>());
+            }
+        }
+
+        ~DependencyGraph() = default;
+
+        DependencyGraph(const DependencyGraph &) = delete;
+
+        DependencyGraph(DependencyGraph &&) = delete;
+
+        // NOT thread safe, txnList[i] is the txn whose batch index is i,
+        // the rw sets must not be modified until run returns.
+        void build(const std::vector<proto::Transaction*>& txnList) {
+            resize(txnList.size());
+            keyStates.clear();
+            edgeCount = 0;
+            for (index_type i = 0; i < (index_type)txnList.size(); i++) {
+                auto& node = nodes[i];
+                node.txn = txnList[i];
+                DCHECK(node.txn->getBatchIndex() == i);
+                for (const auto& kv: node.txn->getReads()) {
+                    auto& state = keyStates[kv->getKeySV()];
+                    if (state.lastWriter != NONE) {
+                        addEdge(state.lastWriter, i, true);
+                    }
+                    state.readers.push_back(i);
+                }
+                for (const auto& kv: node.txn->getWrites()) {
+                    auto& state = keyStates[kv->getKeySV()];
+                    if (state.lastWriter != NONE) {
+                        addEdge(state.lastWriter, i, false);
+                    }
+                    for (auto reader: state.readers) {
+                        if (reader != i) {
+                            addEdge(reader, i, false);
+                        }
+                    }
+                    state.readers.clear();
+                    state.lastWriter = i;
+                }
+            }
+            // the roots are distributed before the workers start
+            size_t rootCount = 0;
+            for (index_type i = 0; i < (index_type)txnList.size(); i++) {
+                if (nodes[i].inDegree.load(std::memory_order_relaxed) == 0) {
+                    deques[rootCount++ % deques.size()]->emplace(i);
+                }
+            }
+            nodeCount = txnList.size();
+            active.store(rootCount, std::memory_order_release);
+        }
+
+        // Thread safe, each worker calls it with its own id,
+        // return after all txns are finished or deferred, and the rest are blocked by the deferred ones.
+        // bool execute(proto::Transaction* txn, bool stale): stale is true if the txn has a raw predecessor,
+        // whether the predecessor wrote or not (an earlier writer of the same key may have),
+        // return false to defer the txn, its successors are not released.
+        template<class Func>
+        void run(int workerId, Func&& execute) {
+            auto& own = *deques[workerId];
+            // no txn becomes ready once there is no ready or running txn
+            while (active.load(std::memory_order_acquire) > 0) {
+                auto idx = own.pop();
+                if (!idx) {
+                    idx = steal(workerId);
+                }
+                if (!idx) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                auto& node = nodes[*idx];
+                if (!execute(node.txn, node.stale.load(std::memory_order_acquire))) {
+                    node.state = NodeState::DEFERRED;
+                    active.fetch_sub(1, std::memory_order_acq_rel);
+                    continue;
+                }
+                node.state = NodeState::FINISHED;
+                for (const auto& [succ, raw]: node.successors) {
+                    if (raw) {
+                        nodes[succ].stale.store(true, std::memory_order_release);
+                    }
+                    if (nodes[succ].inDegree.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        active.fetch_add(1, std::memory_order_acq_rel);
+                        own.emplace(succ);
+                    }
+                }
+                active.fetch_sub(1, std::memory_order_acq_rel);
+            }
+        }
+
+        // NOT thread safe, call it after run returns in all workers.
+        // Return the deferred txns in batch order.
+        [[nodiscard]] std::vector<proto::Transaction*> getDeferred() const {
+            std::vector<proto::Transaction*> deferred;
+            for (index_type i = 0; i < (index_type)nodeCount; i++) {
+                if (nodes[i].state == NodeState::DEFERRED) {
+                    deferred.push_back(nodes[i].txn);
+                }
+            }
+            return deferred;
+        }
+
+        // NOT thread safe, the deferred txns are executed and committed, release their successors.
+        // The blocked txns were simulated before the deferred txns committed, they are all marked stale.
+        void finishDeferred() {
+            for (index_type i = 0; i < (index_type)nodeCount; i++) {
+                if (nodes[i].state == NodeState::PENDING) {
+                    nodes[i].stale.store(true, std::memory_order_relaxed);
+                }
+            }
+            size_t rootCount = 0;
+            for (index_type i = 0; i < (index_type)nodeCount; i++) {
+                auto& node = nodes[i];
+                if (node.state != NodeState::DEFERRED) {
+                    continue;
+                }
+                node.state = NodeState::FINISHED;
+                for (const auto& it: node.successors) {
+                    if (nodes[it.first].inDegree.fetch_sub(1, std::memory_order_relaxed) == 1) {
+                        deques[rootCount++ % deques.size()]->emplace(it.first);
+                    }
+                }
+            }
+            active.store(rootCount, std::memory_order_release);
+        }
+
+        [[nodiscard]] size_t getEdgeCount() const { return edgeCount; }
+
+    protected:
+        constexpr static index_type NONE = std::numeric_limits<index_type>::max();
+
+        enum class NodeState : uint8_t {
+            PENDING,
+            FINISHED,
+            DEFERRED,
+        };
+
+        struct Node {
+            proto::Transaction* txn = nullptr;
+            std::atomic<uint32_t> inDegree = 0;
+            std::atomic<bool> stale = false;
+            // written by the worker executing the txn, read after all workers return
+            NodeState state = NodeState::PENDING;
+            // (successor, is raw), without duplicated successors
+            std::vector<std::pair<index_type, bool>> successors;
+        };
+
+        struct KeyState {
+            index_type lastWriter = NONE;
+            // the readers after the last writer
+            std::vector<index_type> readers;
+        };
+
+        void resize(size_t size) {
+            if (size > capacity) {
+                capacity = std::max(size, capacity * 2);
+                nodes = std::make_unique<Node[]>(capacity);
+            }
+            for (size_t i = 0; i < size; i++) {
+                nodes[i].inDegree.store(0, std::memory_order_relaxed);
+                nodes[i].stale.store(false, std::memory_order_relaxed);
+                nodes[i].state = NodeState::PENDING;
+                nodes[i].successors.clear();
+            }
+        }
+
+        inline void addEdge(index_type from, index_type to, bool raw) {
+            auto& successors = nodes[from].successors;
+            // skip the duplicated edge from the same predecessor (e.g., two keys in common)
+            if (!successors.empty() && successors.back().first == to) {
+                successors.back().second |= raw;
+                return;
+            }
+            successors.emplace_back(to, raw);
+            nodes[to].inDegree.fetch_add(1, std::memory_order_relaxed);
+            edgeCount++;
+        }
+
+        std::optional<index_type> steal(int workerId) {
+            for (size_t i = 1; i < deques.size(); i++) {
+                auto idx = deques[(workerId + i) % deques.size()]->steal();
+                if (idx) {
+                    return idx;
+                }
+            }
+            return std::nullopt;
+        }
+
+    private:
+        std::unique_ptr<Node[]> nodes;
+        size_t capacity = 0;
+        size_t nodeCount = 0;
+        size_t edgeCount = 0;
+        // the ready or running txns
+        std::atomic<size_t> active = 0;
+        util::MyFlatHashMap<std::string_view, KeyState> keyStates;
+        std::vector<std::unique_ptr<riften::Deque<index_type>>> deques;
+    };
+}
@@ -26,6 +26,7 @@ namespace peer::cc {
                 auto orm = peer::chaincode::ORM::NewORMFromDBInterface(db);
                 auto ret = peer::chaincode::NewChaincodeByName(ccNameSV, std::move(orm));
                 CHECK(ret != nullptr) << "chaincode name not exist!";
+                ret->setArena(arena.get());
                 auto& rawPointer = *ret;
                 ccList[ccNameSV] = std::move(ret);
                 return &rawPointer;
@@ -34,7 +35,67 @@ namespace peer::cc {
             }
         }
 
+        // Invoke the chaincode and move the rw sets into the txn, return the chaincode ret code
+        inline int invokeChaincode(proto::Transaction* txn) {
+            auto& userRequest = txn->getUserRequest();
+            auto* chaincode = createOrGetChaincode(userRequest.getCCNameSV());
+            auto ret = chaincode->InvokeChaincode(userRequest.getFuncNameSV(), userRequest.getArgs());
+            // get the rwSets out of the orm
+            txn->setRetValue(chaincode->reset(txn->getReads(), txn->getWrites()));
+            txn->setArena(arena);
+            return ret;
+        }
+
+        // Called before executing a batch. The rw sets of a batch are allocated from the same arena,
+        // and the arena is released after all of them are destroyed (e.g., the block is freed).
+        inline void renewArena() {
+            if (arena != nullptr && arena.use_count() == 1) {
+                arena->reset();     // no rw set refers to it
+                return;
+            }
+            arena = std::make_shared<util::Arena>();
+            for (auto& it: ccList) {
+                it.second->setArena(arena.get());
+            }
+        }
+
+        // Write the write set of a committed txn into the db
+        inline bool saveWritesToDB(const proto::Transaction* txn) {
+            auto saveToDBFunc = [&](auto* batch) {
+                for (const auto& kv: txn->getWrites()) {
+                    auto& keySV = kv->getKeySV();
+                    auto& valueSV = kv->getValueSV();
+                    if (valueSV.empty()) {
+                        batch->Delete({keySV.data(), keySV.size()});
+                    } else {
+                        batch->Put({keySV.data(), keySV.size()}, {valueSV.data(), valueSV.size()});
+                    }
+                }
+                return true;
+            };
+            if (!getDB()->syncWriteBatch(saveToDBFunc)) {
+                LOG(ERROR) << "CCWorkerFSM can not write to db!";
+                return false;
+            }
+            return true;
+        }
+
     public:
+        // Re-execute an aborted transaction against the latest db state and commit it immediately,
+        // the caller must ensure that all workers are idle.
+        void executeAndCommitSerially(proto::Transaction* txn) {
+            auto ret = invokeChaincode(txn);
+            if (ret != 0) {
+                txn->setExecutionResult(ResultType::ABORT_NO_RETRY);
+                return;
+            }
+            txn->setExecutionResult(ResultType::COMMIT);
+            if (txn->getWrites().empty()) {
+                return;
+            }
+            saveWritesToDB(txn);
+        }
+
         inline void setDB(std::shared_ptr<db::DBConnection> db_) { db = std::move(db_); }
 
         [[nodiscard]] inline db::DBConnection* getDB() const { return db.get(); }
@@ -51,5 +112,6 @@ namespace peer::cc {
         TxnListType _txnList;
         util::MyFlatHashMap<std::string, std::unique_ptr<peer::chaincode::Chaincode>> ccList;
         std::shared_ptr<db::DBConnection> db;
+        std::shared_ptr<util::Arena> arena = std::make_shared<util::Arena>();
     };
 }
\ No newline at end of file
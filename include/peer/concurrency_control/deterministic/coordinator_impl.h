@@ -6,13 +6,59 @@
 
 #include "peer/concurrency_control/coordinator.h"
 #include "peer/concurrency_control/deterministic/worker_fsm_impl.h"
+#include "common/timer.h"
+
+#include <algorithm>
 
 namespace peer::cc {
     class CoordinatorImpl : public Coordinator<WorkerFSMImpl, CoordinatorImpl> {
     public:
+        // How to deal with the transactions aborted (ResultType::ABORT) by the reserve table
+        enum class AbortFallback {
+            NONE = 0,           // return them to the client
+            SERIAL = 1,         // re-execute them one by one in batch order
+            RESERVE_ROUND = 2,  // re-execute them in another reservation round
+        };
+
+        static AbortFallback ParseAbortFallback(std::string_view name) {
+            if (name == "serial") {
+                return AbortFallback::SERIAL;
+            }
+            if (name == "reserve") {
+                return AbortFallback::RESERVE_ROUND;
+            }
+            LOG_IF(WARNING, name != "none") << "Unknown abort fallback: " << name << ", fallback to none.";
+            return AbortFallback::NONE;
+        }
+
+        // Counters of all processed batches
+        struct Statistics {
+            uint64_t totalTxnCount = 0;
+            // aborted after the first reservation round
+            uint64_t firstRoundAbortCount = 0;
+            // aborted after the fallback phase
+            uint64_t finalAbortCount = 0;
+            uint64_t totalBatchCount = 0;
+            double totalTimeSec = 0;
+
+            [[nodiscard]] double firstRoundAbortRate() const {
+                return totalTxnCount == 0 ? 0 : (double)firstRoundAbortCount / (double)totalTxnCount;
+            }
+
+            [[nodiscard]] double finalAbortRate() const {
+                return totalTxnCount == 0 ? 0 : (double)finalAbortCount / (double)totalTxnCount;
+            }
+
+            // committed transactions per second
+            [[nodiscard]] double throughput() const {
+                return totalTimeSec == 0 ? 0 : (double)(totalTxnCount - finalAbortCount) / totalTimeSec;
+            }
+        };
+
         bool init(const std::shared_ptr<peer::db::DBConnection>& dbc) {
             auto table = std::make_shared<ReserveTable>();
             this->reserveTable = table;
+            this->db = dbc;
             for (auto& it: this->fsmList) {
                 it->setDB(dbc);
                 it->setReserveTable(table);
@@ -20,7 +66,16 @@ namespace peer::cc {
             return true;
         }
 
+        // NOT thread safe, must be called before processing any batch
+        void setAbortFallback(AbortFallback fallback) { abortFallback = fallback; }
+
+        [[nodiscard]] AbortFallback getAbortFallback() const { return abortFallback; }
+
+        // NOT thread safe
+        [[nodiscard]] const Statistics& getStatistics() const { return statistics; }
+
         bool processSync(const auto& afterStart, const auto& afterCommit) {
+            util::Timer timer;
             reserveTable->reset();
             // prepare txn function
             auto ret = processParallel(InvokerCommand::START, ReceiverState::READY, afterStart);
@@ -33,11 +88,50 @@ namespace peer::cc {
                 LOG(ERROR) << "exec txnList failed!";
                 return false;
             }
-            ret = processParallel(InvokerCommand::COMMIT, ReceiverState::FINISH_COMMIT, afterCommit);
+            // count the txn before they are moved back
+            std::atomic<uint64_t> txnCount = 0, abortCount = 0;
+            auto countAndAfterCommit = [&](const auto& worker, auto& fsm) {
+                for (const auto& txn: fsm.getMutableTxnList()) {
+                    if (txn->getExecutionResult() == proto::Transaction::ExecutionResult::ABORT) {
+                        abortCount.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                txnCount.fetch_add(fsm.getMutableTxnList().size(), std::memory_order_relaxed);
+                afterCommit(worker, fsm);
+            };
+            if (abortFallback == AbortFallback::NONE) {
+                ret = processCommitInGroup(countAndAfterCommit);
+                if (!ret) {
+                    LOG(ERROR) << "commit txnList failed!";
+                    return false;
+                }
+                statistics.firstRoundAbortCount += abortCount;
+                updateStatistics(timer.end(), txnCount, abortCount);
+                return true;
+            }
+            // keep the txn in fsm until the fallback phase is finished
+            ret = processCommitInGroup(nullptr);
             if (!ret) {
                 LOG(ERROR) << "commit txnList failed!";
                 return false;
             }
+            statistics.firstRoundAbortCount += countAbortedTxn();
+            if (abortFallback == AbortFallback::SERIAL) {
+                processAbortedSerially();
+            } else {
+                ret = processAbortedInReserveRound();
+                if (!ret) {
+                    LOG(ERROR) << "fallback txnList failed!";
+                    return false;
+                }
+            }
+            // move back
+            ret = processParallel(InvokerCommand::CUSTOM, ReceiverState::FINISH_CUSTOM, countAndAfterCommit);
+            if (!ret) {
+                LOG(ERROR) << "finish txnList failed!";
+                return false;
+            }
+            updateStatistics(timer.end(), txnCount, abortCount);
             return true;
         }
 
@@ -46,7 +140,97 @@ namespace peer::cc {
     protected:
         CoordinatorImpl() = default;
 
+        // The writes of all workers are merged into one group commit (if the db supports it),
+        // the group is finished before the next phase reads the db.
+        bool processCommitInGroup(const auto& afterCommit) {
+            db->beginGroupCommit();
+            auto ret = processParallel(InvokerCommand::COMMIT, ReceiverState::FINISH_COMMIT, afterCommit);
+            if (!db->endGroupCommit()) {
+                LOG(ERROR) << "group commit failed!";
+                return false;
+            }
+            return ret;
+        }
+
+        [[nodiscard]] uint64_t countAbortedTxn() const {
+            uint64_t count = 0;
+            for (const auto& fsm: this->fsmList) {
+                for (const auto& txn: fsm->getMutableTxnList()) {
+                    if (txn->getExecutionResult() == proto::Transaction::ExecutionResult::ABORT) {
+                        count++;
+                    }
+                }
+            }
+            return count;
+        }
+
+        void updateStatistics(double timeSec, uint64_t txnCount, uint64_t finalAbortCount) {
+            statistics.finalAbortCount += finalAbortCount;
+            statistics.totalTxnCount += txnCount;
+            statistics.totalBatchCount += 1;
+            statistics.totalTimeSec += timeSec;
+        }
+
+        // All replicas commit the same first-round transactions and re-execute
+        // the same aborted transactions in the same (batch) order, so the result is deterministic.
+        void processAbortedSerially() {
+            std::vector<proto::Transaction*> abortedList;
+            for (const auto& fsm: this->fsmList) {
+                for (const auto& txn: fsm->getMutableTxnList()) {
+                    if (txn->getExecutionResult() == proto::Transaction::ExecutionResult::ABORT) {
+                        abortedList.push_back(txn.get());
+                    }
+                }
+            }
+            std::sort(abortedList.begin(), abortedList.end(), [](const auto* lhs, const auto* rhs) {
+                return lhs->getBatchIndex() < rhs->getBatchIndex();
+            });
+            // all workers are idle, use the chaincode of the first one
+            auto& fsm = this->fsmList.front();
+            for (auto* txn: abortedList) {
+                fsm->executeAndCommitSerially(txn);
+            }
+        }
+
+        // Only the aborted transactions take part in the second round, the transactions that
+        // are still aborted (conflict with a smaller batch index) remain ResultType::ABORT.
+        bool processAbortedInReserveRound() {
+            // the index of the aborted txn in the fsm txn list
+            std::vector<std::vector<int>> abortedIdxList(this->fsmList.size());
+            std::vector<TxnListType> originTxnList(this->fsmList.size());
+            for (int i = 0; i < (int)this->fsmList.size(); i++) {
+                auto& txnList = this->fsmList[i]->getMutableTxnList();
+                TxnListType abortedList;
+                for (int j = 0; j < (int)txnList.size(); j++) {
+                    if (txnList[j]->getExecutionResult() == proto::Transaction::ExecutionResult::ABORT) {
+                        abortedIdxList[i].push_back(j);
+                        abortedList.push_back(std::move(txnList[j]));
+                    }
+                }
+                originTxnList[i] = std::move(txnList);
+                txnList = std::move(abortedList);
+            }
+            reserveTable->reset();
+            auto ret = processParallel(InvokerCommand::EXEC, ReceiverState::FINISH_EXEC, nullptr);
+            if (ret) {
+                ret = processCommitInGroup(nullptr);
+            }
+            // restore the txn list
+            for (int i = 0; i < (int)this->fsmList.size(); i++) {
+                auto& txnList = this->fsmList[i]->getMutableTxnList();
+                for (int j = 0; j < (int)abortedIdxList[i].size(); j++) {
+                    originTxnList[i][abortedIdxList[i][j]] = std::move(txnList[j]);
+                }
+                txnList = std::move(originTxnList[i]);
+            }
+            return ret;
+        }
+
     private:
+        using TxnListType = WorkerFSMImpl::TxnListType;
+        AbortFallback abortFallback = AbortFallback::NONE;
+        Statistics statistics;
         std::shared_ptr<ReserveTable> reserveTable{};
+        std::shared_ptr<peer::db::DBConnection> db;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,187 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "common/phmap.h"
+
+#include "glog/logging.h"
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+namespace peer::cc {
+
+    // A lock-free reservation table of the deterministic cc.
+    // The key is a string_view, the value is the dense index of a transaction in the current batch.
+    // 1. The keys must NOT be freed before the next reset.
+    // 2. reset bumps the epoch, the slots tagged with an old epoch are treated as empty.
+    // 3. Slots are never removed in an epoch, so a lookup stops at the first empty slot.
+    // 4. The array is pre-sized, when a probe sequence is exhausted, the key goes to a locked
+    //    overflow map, and the array is enlarged on the next reset.
+    class ReservationArray {
+    public:
+        using index_type = uint32_t;
+
+        constexpr static index_type NOT_FOUND = std::numeric_limits<index_type>::max();
+
+        explicit ReservationArray(size_t capacity = 1 << 16) { resize(capacity); }
+
+        ~ReservationArray() = default;
+
+        ReservationArray(const ReservationArray &) = delete;
+
+        ReservationArray(ReservationArray &&) = delete;
+
+        // NOT thread safe, no one can access the array during reset
+        void reset() {
+            auto used = _size.load(std::memory_order_relaxed) + _overflow.size();
+            if (used * 2 > _capacity) {     // keep the load factor below 0.5
+                resize(std::bit_ceil(used * 2));
+                return;
+            }
+            _size.store(0, std::memory_order_relaxed);
+            _overflow.clear();
+            _overflowed.store(false, std::memory_order_relaxed);
+            if (++_epoch > MAX_EPOCH) {     // epoch wrap around, clear the tags
+                for (size_t i = 0; i < _capacity; i++) {
+                    _slots[i].header.store(0, std::memory_order_relaxed);
+                }
+                _epoch = 1;
+            }
+        }
+
+        // Thread safe, keep the min index of the key
+        inline void reserveMin(std::string_view key, index_type index) {
+            update(key, index, [](index_type lhs, index_type rhs) { return lhs < rhs; });
+        }
+
+        // Thread safe, keep the max index of the key
+        inline void reserveMax(std::string_view key, index_type index) {
+            update(key, index, [](index_type lhs, index_type rhs) { return lhs > rhs; });
+        }
+
+        // Return NOT_FOUND if the key is not reserved in the current epoch
+        [[nodiscard]] index_type find(std::string_view key) const {
+            const auto hash = Hash(key);
+            const auto tag = MakeTag(_epoch, hash);
+            auto pos = hash & _mask;
+            for (size_t probe = 0; probe < _capacity; probe++, pos = (pos + 1) & _mask) {
+                auto& slot = _slots[pos];
+                auto header = slot.header.load(std::memory_order_acquire);
+                if ((header >> 32) != _epoch) {
+                    return findInOverflow(key);     // reach an empty slot
+                }
+                header = WaitReady(slot, header);
+                if (header == (tag | READY) && slot.key == key) {
+                    return slot.index.load(std::memory_order_relaxed);
+                }
+            }
+            return findInOverflow(key);
+        }
+
+        [[nodiscard]] size_t capacity() const { return _capacity; }
+
+    protected:
+        struct Slot {
+            // epoch (32 bits) | hash (31 bits) | ready (1 bit)
+            std::atomic<uint64_t> header = 0;
+            std::atomic<index_type> index = NOT_FOUND;
+            // written before the ready bit is set
+            std::string_view key;
+        };
+
+        constexpr static uint64_t READY = 1;
+
+        constexpr static uint64_t MAX_EPOCH = std::numeric_limits<uint32_t>::max();
+
+        static inline uint64_t Hash(std::string_view key) { return std::hash<std::string_view>()(key); }
+
+        static inline uint64_t MakeTag(uint64_t epoch, uint64_t hash) {
+            return (epoch << 32) | ((hash & 0x7fffffff) << 1);
+        }
+
+        // Wait until the claimer publishes the key
+        static inline uint64_t WaitReady(const Slot& slot, uint64_t header) {
+            while ((header & READY) == 0) {
+                header = slot.header.load(std::memory_order_acquire);
+            }
+            return header;
+        }
+
+        void resize(size_t capacity) {
+            _capacity = std::bit_ceil(std::max<size_t>(capacity, 16));
+            _mask = _capacity - 1;
+            _slots = std::make_unique<Slot[]>(_capacity);
+            _epoch = 1;
+            _size.store(0, std::memory_order_relaxed);
+            _overflow.clear();
+            _overflowed.store(false, std::memory_order_relaxed);
+            DLOG(INFO) << "Resize reservation array to " << _capacity;
+        }
+
+        template<class Compare>
+        void update(std::string_view key, index_type index, Compare&& cmp) {
+            const auto hash = Hash(key);
+            const auto tag = MakeTag(_epoch, hash);
+            auto pos = hash & _mask;
+            for (size_t probe = 0; probe < _capacity; probe++, pos = (pos + 1) & _mask) {
+                auto& slot = _slots[pos];
+                auto header = slot.header.load(std::memory_order_acquire);
+                if ((header >> 32) != _epoch) {
+                    // try to claim the empty slot, header is updated if failed
+                    if (slot.header.compare_exchange_strong(header, tag, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                        slot.key = key;
+                        slot.index.store(index, std::memory_order_relaxed);
+                        slot.header.store(tag | READY, std::memory_order_release);
+                        _size.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+                header = WaitReady(slot, header);
+                if (header != (tag | READY) || slot.key != key) {
+                    continue;   // hash collision
+                }
+                // compare and swap the index
+                auto current = slot.index.load(std::memory_order_relaxed);
+                while (cmp(index, current) && !slot.index.compare_exchange_weak(current, index, std::memory_order_relaxed)) { }
+                return;
+            }
+            // the array is full
+            std::unique_lock lock(_overflowMutex);
+            auto [it, inserted] = _overflow.try_emplace(key, index);
+            if (!inserted && cmp(index, it->second)) {
+                it->second = index;
+            }
+            _overflowed.store(true, std::memory_order_release);
+        }
+
+        index_type findInOverflow(std::string_view key) const {
+            if (!_overflowed.load(std::memory_order_acquire)) {
+                return NOT_FOUND;
+            }
+            std::unique_lock lock(_overflowMutex);
+            auto it = _overflow.find(key);
+            if (it == _overflow.end()) {
+                return NOT_FOUND;
+            }
+            return it->second;
+        }
+
+    private:
+        uint64_t _epoch = 1;
+        size_t _capacity = 0;
+        size_t _mask = 0;
+        std::unique_ptr<Slot[]> _slots;
+        // the number of claimed slots in this epoch
+        std::atomic<size_t> _size = 0;
+        // for overflow keys
+        std::atomic<bool> _overflowed = false;
+        mutable std::mutex _overflowMutex;
+        util::MyFlatHashMap<std::string_view, index_type> _overflow;
+    };
+}
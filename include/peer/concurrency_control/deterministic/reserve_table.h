@@ -4,29 +4,31 @@
 
 #pragma once
 
+#include "peer/concurrency_control/deterministic/reservation_array.h"
 #include "proto/transaction.h"
 #include "common/phmap.h"
 
 namespace peer::cc {
 
+    class Dependency {
+    public:
+        bool waw = false;
+        bool war = false;
+        bool raw = false;
+    };
+
     // The reserve map of a specific table (or sharded table)
-    // key have string view type, must NOT be free before ReserveTable is destroyed
-    class ReserveTable {
+    // The priority of a txn is its tid, key have string view type, must NOT be free before ReserveTable is destroyed
+    // Deprecated: the mutex-sharded implementation, kept for comparison
+    class ShardedReserveTable {
     public:
-        class Dependency {
-        public:
-            bool waw = false;
-            bool war = false;
-            bool raw = false;
-        };
+        ShardedReserveTable() = default;
 
-        ReserveTable() = default;
+        virtual ~ShardedReserveTable() = default;
 
-        virtual ~ReserveTable() = default;
+        ShardedReserveTable(const ShardedReserveTable &) = delete;
 
-        ReserveTable(const ReserveTable &) = delete;
-
-        ReserveTable(ReserveTable &&) = delete;
+        ShardedReserveTable(ShardedReserveTable &&) = delete;
 
         void reset() {
             readTable.clear();
@@ -106,5 +108,65 @@ namespace peer::cc {
         TableType readTable;
         TableType writeTable;
     };
-}
 
+    // The reserve map of a specific table (or sharded table)
+    // The priority of a txn is its index in the batch (smaller is higher),
+    // key have string view type, must NOT be free before the next reset
+    class ReserveTable {
+    public:
+        using index_type = ReservationArray::index_type;
+
+        explicit ReserveTable(size_t capacity = 1 << 16) : readTable(capacity), writeTable(capacity) { }
+
+        virtual ~ReserveTable() = default;
+
+        ReserveTable(const ReserveTable &) = delete;
+
+        ReserveTable(ReserveTable &&) = delete;
+
+        // NOT thread safe, O(1) unless the table is enlarged
+        void reset() {
+            readTable.reset();
+            writeTable.reset();
+        }
+
+        void reserveRWSets(const proto::KVList &reads, const proto::KVList &writes, index_type txnIndex) {
+            for (const auto &read: reads) {
+                readTable.reserveMin(read->getKeySV(), txnIndex);
+            }
+            for (const auto &write: writes) {
+                writeTable.reserveMin(write->getKeySV(), txnIndex);
+            }
+        }
+
+        [[nodiscard]] Dependency analysisDependent(const proto::KVList &reads,
+                                                   const proto::KVList &writes,
+                                                   index_type txnIndex) const {
+            // NOT_FOUND is the max index, so it never introduces a dependency
+            Dependency dependency;
+            for (const auto &write: writes) {
+                if (writeTable.find(write->getKeySV()) < txnIndex) {  // waw dependency
+                    dependency.waw = true;
+                    break;
+                }
+            }
+            for (const auto &write: writes) {
+                if (readTable.find(write->getKeySV()) < txnIndex) {  // war dependency
+                    dependency.war = true;
+                    break;
+                }
+            }
+            for (const auto &read: reads) {
+                if (writeTable.find(read->getKeySV()) < txnIndex) {  // raw dependency
+                    dependency.raw = true;
+                    break;
+                }
+            }
+            return dependency;
+        }
+
+    private:
+        ReservationArray readTable;
+        ReservationArray writeTable;
+    };
+}
@@ -17,14 +17,9 @@ namespace peer::cc {
 
         ReceiverState OnExecuteTransaction() override {
             DCHECK(getDB() != nullptr && reserveTable != nullptr);
+            renewArena();
             for (auto& txn: txnList()) {
-                // find the chaincode using ccList
-                auto ccNameSV = txn->getUserRequest().getCCNameSV();
-                auto* chaincode = createOrGetChaincode(ccNameSV);
-                auto& userRequest = txn->getUserRequest();
-                auto ret = chaincode->InvokeChaincode(userRequest.getFuncNameSV(), userRequest.getArgs());
-                // get the rwSets out of the orm
-                txn->setRetValue(chaincode->reset(txn->getReads(), txn->getWrites()));
+                auto ret = invokeChaincode(txn.get());
                 // 1. transaction internal error, abort it without adding reserve table
                 if (ret != 0) {
                     txn->setExecutionResult(ResultType::ABORT_NO_RETRY);
@@ -36,7 +31,7 @@ namespace peer::cc {
                     continue;
                 }
                 // 2. reserve rw set
-                reserveTable->reserveRWSets(txn->getReads(), txn->getWrites(), txn->getTransactionIdPtr());
+                reserveTable->reserveRWSets(txn->getReads(), txn->getWrites(), txn->getBatchIndex());
             }
             // DLOG(INFO) << "Finished execution, id: " << id;
             return peer::cc::ReceiverState::FINISH_EXEC;
@@ -56,7 +51,7 @@ namespace peer::cc {
                         continue;
                     }
                     // 2. analyse dependency
-                    auto dep = reserveTable->analysisDependent(txn->getReads(), txn->getWrites(), txn->getTransactionId());
+                    auto dep = reserveTable->analysisDependent(txn->getReads(), txn->getWrites(), txn->getBatchIndex());
                     if (dep.waw) { // waw, abort the txn.
                         txn->setExecutionResult(ResultType::ABORT);
                         continue;
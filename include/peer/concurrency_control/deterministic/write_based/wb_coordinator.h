@@ -13,6 +13,7 @@ namespace peer::cc {
         bool init(const std::shared_ptr<peer::db::DBConnection>& dbc) {
             auto table = std::make_shared<WBReserveTable>();
             this->reserveTable = table;
+            this->db = dbc;
             for (auto& it: this->fsmList) {
                 it->setDB(dbc);
                 it->setReserveTable(table);
@@ -38,8 +39,13 @@ namespace peer::cc {
                 LOG(ERROR) << "first commit failed!";
                 return false;
             }
-            // Second commit
+            // Second commit, the writes of all workers are merged into one group commit
+            db->beginGroupCommit();
             ret = processParallel(InvokerCommand::COMMIT, ReceiverState::FINISH_COMMIT, afterCommit);
+            if (!db->endGroupCommit()) {
+                LOG(ERROR) << "group commit failed!";
+                return false;
+            }
             if (!ret) {
                 LOG(ERROR) << "second commit failed!";
                 return false;
@@ -54,5 +60,6 @@ namespace peer::cc {
 
     private:
         std::shared_ptr<WBReserveTable> reserveTable;
+        std::shared_ptr<peer::db::DBConnection> db;
     };
 }
\ No newline at end of file
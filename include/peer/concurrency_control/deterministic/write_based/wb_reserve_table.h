@@ -4,14 +4,18 @@
 
 #pragma once
 
+#include "peer/concurrency_control/deterministic/reservation_array.h"
 #include "proto/transaction.h"
-#include "common/phmap.h"
 
 namespace peer::cc {
 
+    // The priority of a txn is its index in the batch (smaller is higher),
+    // key have string view type, must NOT be free before the next reset
     class WBReserveTable {
     public:
-        WBReserveTable() = default;
+        using index_type = ReservationArray::index_type;
+
+        explicit WBReserveTable(size_t capacity = 1 << 16) : rsTable(capacity), cmtTable(capacity) { }
 
         virtual ~WBReserveTable() = default;
 
@@ -20,72 +24,45 @@ namespace peer::cc {
         WBReserveTable(WBReserveTable &&) = delete;
 
         void reset() {
-            rsTable.clear();
-            cmtTable.clear();
+            rsTable.reset();
+            cmtTable.reset();
         }
 
-        void reserveWrites(const proto::KVList &writes, std::shared_ptr<const proto::tid_type> transactionID) {
+        void reserveWrites(const proto::KVList &writes, index_type txnIndex) {
             for (const auto &write: writes) {
-                // Skip if the tid in the map is smaller than the current one
-                auto exist = [&](TableType::value_type &value) {
-                    auto ret = proto::CompareTID(*value.second, *transactionID);
-                    // DLOG_IF(INFO, ret != 0) << "same tid invoke twice!";
-                    if (ret <= 0) {
-                        return;
-                    }
-                    value.second = transactionID;
-                };
-                rsTable.try_emplace_l(write->getKeySV(), exist, transactionID);
+                // Skip if the index in the table is smaller than the current one
+                rsTable.reserveMin(write->getKeySV(), txnIndex);
             }
         }
 
-        [[nodiscard]] bool detectRAW(const proto::KVList &reads, const proto::tid_type &transactionID) const {
-            bool raw = false;
+        [[nodiscard]] bool detectRAW(const proto::KVList &reads, index_type txnIndex) const {
             for (const auto &read: reads) {
-                rsTable.if_contains_unsafe(read->getKeySV(), [&](const TableType::value_type &v) {
-                    if (proto::CompareTID(*v.second, transactionID) < 0) {  // raw dependency
-                        raw = true;
-                    }
-                });
-                if (raw) {
-                    break;
+                if (rsTable.find(read->getKeySV()) < txnIndex) {  // raw dependency
+                    return true;
                 }
             }
-            return raw;
+            return false;
         }
 
-        void mvccReserveWrites(const proto::KVList &writes, std::shared_ptr<const proto::tid_type> transactionID) {
+        void mvccReserveWrites(const proto::KVList &writes, index_type txnIndex) {
             for (const auto &write: writes) {
-                // Skip if the tid in the map is smaller than the current one
-                auto exist = [&](TableType::value_type &value) {
-                    auto ret = proto::CompareTID(*value.second, *transactionID);
-                    // DLOG_IF(INFO, ret != 0) << "same tid invoke twice!";
-                    if (ret >= 0) { // overwrite existing key
-                        return;
-                    }
-                    value.second = transactionID;
-                };
-                cmtTable.try_emplace_l(write->getKeySV(), exist, transactionID);
+                // overwrite the existing key if the index in the table is smaller
+                cmtTable.reserveMax(write->getKeySV(), txnIndex);
             }
         }
 
         void updateDB(const proto::KVList &writes,
-                      const proto::tid_type &transactionID,
+                      index_type txnIndex,
                       const std::function<void(std::string_view, std::string_view)>& callback) const {
             for (const auto &write: writes) {
-                rsTable.if_contains_unsafe(write->getKeySV(), [&](const TableType::value_type &v) {
-                    if (proto::CompareTID(*v.second, transactionID) == 0) {
-                        callback(write->getKeySV(), write->getValueSV());
-                    }
-                });
+                if (rsTable.find(write->getKeySV()) == txnIndex) {
+                    callback(write->getKeySV(), write->getValueSV());
+                }
             }
         }
 
     private:
-        using TableType = util::MyFlatHashMap<std::string_view, std::shared_ptr<const proto::tid_type>, std::mutex>;
-
-        TableType rsTable;
-        TableType cmtTable;
+        ReservationArray rsTable;
+        ReservationArray cmtTable;
     };
 }
-
@@ -17,14 +17,9 @@ namespace peer::cc {
 
         ReceiverState OnExecuteTransaction() override {
             DCHECK(getDB() != nullptr && reserveTable != nullptr);
+            renewArena();
             for (auto& txn: txnList()) {
-                // find the chaincode using ccList
-                auto ccNameSV = txn->getUserRequest().getCCNameSV();
-                auto* chaincode = createOrGetChaincode(ccNameSV);
-                auto& userRequest = txn->getUserRequest();
-                auto ret = chaincode->InvokeChaincode(userRequest.getFuncNameSV(), userRequest.getArgs());
-                // get the rwSets out of the orm
-                txn->setRetValue(chaincode->reset(txn->getReads(), txn->getWrites()));
+                auto ret = invokeChaincode(txn.get());
                 // 1. transaction internal error, abort it without adding reserve table
                 if (ret != 0) {
                     txn->setExecutionResult(ResultType::ABORT_NO_RETRY);
@@ -35,7 +30,7 @@ namespace peer::cc {
                     continue;
                 }
                 // 2. reserve rw set
-                reserveTable->reserveWrites(txn->getWrites(), txn->getTransactionIdPtr());
+                reserveTable->reserveWrites(txn->getWrites(), txn->getBatchIndex());
             }
             return peer::cc::ReceiverState::FINISH_EXEC;
         }
@@ -67,13 +62,13 @@ namespace peer::cc {
                     continue;
                 }
                 // 2. analyse raw
-                auto raw = reserveTable->detectRAW(txn->getReads(), txn->getTransactionId());
+                auto raw = reserveTable->detectRAW(txn->getReads(), txn->getBatchIndex());
                 if (raw) {  // raw, abort the txn
                     txn->setExecutionResult(ResultType::ABORT);
                     continue;
                 }
                 // 3. reserve mvcc writes
-                reserveTable->mvccReserveWrites(txn->getWrites(), txn->getTransactionIdPtr());
+                reserveTable->mvccReserveWrites(txn->getWrites(), txn->getBatchIndex());
                 txn->setExecutionResult(ResultType::COMMIT);
             }
             return peer::cc::ReceiverState::FINISH_COMMIT;
@@ -95,7 +90,7 @@ namespace peer::cc {
                     if (result == ResultType::ABORT_NO_RETRY || result == ResultType::ABORT) {
                         continue;
                     }
-                    reserveTable->updateDB(txn->getWrites(), txn->getTransactionId(), updateDBCallback);
+                    reserveTable->updateDB(txn->getWrites(), txn->getBatchIndex(), updateDBCallback);
                 }
                 return true;
             };
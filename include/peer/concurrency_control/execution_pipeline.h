@@ -0,0 +1,182 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "proto/block.h"
+#include "proto/transaction.h"
+#include "common/concurrent_queue.h"
+#include "common/proof_generator.h"
+#include "common/thread_pool_light.h"
+#include "bthread/countdown_event.h"
+
+#include "glog/logging.h"
+
+namespace peer::cc {
+    // ExecutionPipeline overlaps the processing of consecutive blocks:
+    //   DECODE   (block N+2): deserialize the envelops into transactions in parallel
+    //   EXECUTE  (block N+1): execute and commit the transactions using the coordinator
+    //   FINALIZE (block N):   move the rw sets back to the block, build the merkle tree of the rw sets
+    //                         from the digests computed at commit, and notify the caller
+    // Each stage handles the blocks one by one in the added order, and the EXECUTE stage
+    // of a block does not start until the previous block is committed, so the db state is
+    // exactly the same as executing the blocks serially.
+    template<class CoordinatorType>
+    class ExecutionPipeline {
+    public:
+        using TxnListType = std::vector<std::unique_ptr<proto::Transaction>>;
+        // invoked in the added order after a block is executed (and committed)
+        using CommitCallback = std::function<void(int regionId, std::shared_ptr<proto::Block> block, bool success)>;
+
+        // cc: the coordinator must outlive the pipeline
+        // maxBlocksInFlight: the number of blocks that can be processed in the pipeline concurrently
+        // decodeWorkerCount: the number of threads for decoding, 0 for decoding in the caller thread
+        static std::unique_ptr<ExecutionPipeline> NewExecutionPipeline(CoordinatorType* cc,
+                                                                       int maxBlocksInFlight,
+                                                                       int decodeWorkerCount) {
+            if (cc == nullptr || maxBlocksInFlight <= 0) {
+                LOG(ERROR) << "Invalid pipeline parameter!";
+                return nullptr;
+            }
+            std::unique_ptr<ExecutionPipeline> pipeline(new ExecutionPipeline(maxBlocksInFlight));
+            pipeline->_cc = cc;
+            if (decodeWorkerCount > 0) {
+                pipeline->_decodeThreadPool = std::make_unique<util::thread_pool_light>(decodeWorkerCount, "txn_decoder");
+            }
+            pipeline->_executeThread = std::make_unique<std::thread>(&ExecutionPipeline::executeLoop, pipeline.get());
+            pipeline->_finalizeThread = std::make_unique<std::thread>(&ExecutionPipeline::finalizeLoop, pipeline.get());
+            return pipeline;
+        }
+
+        ~ExecutionPipeline() {
+            // the nullptr is passed through all stages
+            _executeQueue.enqueue(nullptr);
+            if (_executeThread) {
+                _executeThread->join();
+            }
+            if (_finalizeThread) {
+                _finalizeThread->join();
+            }
+        }
+
+        ExecutionPipeline(const ExecutionPipeline&) = delete;
+
+        ExecutionPipeline(ExecutionPipeline&&) = delete;
+
+        void setCommitCallback(CommitCallback callback) { _commitCallback = std::move(callback); }
+
+        // NOT thread safe, the blocks must be added in the final execution order.
+        // Block until there is a free slot in the pipeline, then decode the block.
+        // Return false if the block is not enqueued, the commit callback will not be invoked for it.
+        bool addBlock(int regionId, std::shared_ptr<proto::Block> block) {
+            if (block == nullptr) {
+                return false;
+            }
+            util::wait_for_sema(_freeSlots);
+            auto ctx = std::make_unique<BlockContext>();
+            ctx->regionId = regionId;
+            ctx->block = std::move(block);
+            decodeTransactions(ctx->block->body.userRequests, ctx->txnList);
+            if (!_executeQueue.enqueue(std::move(ctx))) {
+                LOG(ERROR) << "Can not enqueue block, regionId: " << regionId;
+                _freeSlots.signal();
+                return false;
+            }
+            return true;
+        }
+
+    protected:
+        explicit ExecutionPipeline(int maxBlocksInFlight) : _freeSlots(maxBlocksInFlight) { }
+
+        struct BlockContext {
+            int regionId = -1;
+            bool success = false;
+            std::shared_ptr<proto::Block> block;
+            TxnListType txnList;
+        };
+
+        void decodeTransactions(std::vector<std::unique_ptr<proto::Envelop>>& requests, TxnListType& txnList) const {
+            txnList.resize(requests.size());
+            auto decode = [&](int start, int end) {
+                for (int i = start; i < end; i++) {
+                    txnList[i] = proto::Transaction::NewTransactionFromEnvelop(std::move(requests[i]));
+                    CHECK(txnList[i] != nullptr) << "Can not get exn from envelop!";
+                }
+            };
+            if (_decodeThreadPool == nullptr || requests.size() < _decodeThreadPool->get_thread_count()) {
+                decode(0, (int)requests.size());
+                return;
+            }
+            const auto blockCount = (int)_decodeThreadPool->get_thread_count();
+            const auto blockSize = (int)requests.size() / blockCount;
+            bthread::CountdownEvent countdown(blockCount);
+            for (int i = 0; i < blockCount; i++) {
+                auto start = i * blockSize;
+                auto end = (i == blockCount - 1) ? (int)requests.size() : start + blockSize;
+                _decodeThreadPool->push_task([&, start, end] {
+                    decode(start, end);
+                    countdown.signal();
+                });
+            }
+            countdown.wait();
+        }
+
+        void executeLoop() {
+            pthread_setname_np(pthread_self(), "pipeline_exec");
+            while (true) {
+                std::unique_ptr<BlockContext> ctx;
+                _executeQueue.wait_dequeue(ctx);
+                if (ctx == nullptr) {
+                    _finalizeQueue.enqueue(nullptr);
+                    return;
+                }
+                ctx->success = _cc->processTxnList(ctx->txnList);
+                _finalizeQueue.enqueue(std::move(ctx));
+            }
+        }
+
+        void finalizeLoop() {
+            pthread_setname_np(pthread_self(), "pipeline_final");
+            while (true) {
+                std::unique_ptr<BlockContext> ctx;
+                _finalizeQueue.wait_dequeue(ctx);
+                if (ctx == nullptr) {
+                    return;
+                }
+                auto& requests = ctx->block->body.userRequests;
+                auto& retRWSets = ctx->block->executeResult.txReadWriteSet;
+                auto& retResults = ctx->block->executeResult.transactionFilter;
+                retRWSets.resize(requests.size());
+                retResults.resize(requests.size());
+                for (int i = 0; i < (int)requests.size(); i++) {
+                    auto& txn = ctx->txnList[i];
+                    // the same filter as the digest of the rw set
+                    retResults[i] = txn->getTransactionFilter();
+                    auto ret = proto::Transaction::DestroyTransaction(std::move(txn));
+                    requests[i] = std::move(ret.first);
+                    retRWSets[i] = std::move(ret.second);
+                }
+                if (ctx->success && !retRWSets.empty()) {
+                    // built once per block, the proof queries never rebuild it
+                    ctx->block->executeResult.merkleTree = util::ExecResultMTGenerator::GenerateMerkleTree(retRWSets, retResults);
+                }
+                if (_commitCallback) {
+                    _commitCallback(ctx->regionId, std::move(ctx->block), ctx->success);
+                }
+                _freeSlots.signal();
+            }
+        }
+
+    private:
+        CoordinatorType* _cc = nullptr;
+        CommitCallback _commitCallback;
+        moodycamel::LightweightSemaphore _freeSlots;
+        std::unique_ptr<util::thread_pool_light> _decodeThreadPool;
+        // single producer and single consumer, the order is preserved
+        util::BlockingConcurrentQueue<std::unique_ptr<BlockContext>> _executeQueue;
+        util::BlockingConcurrentQueue<std::unique_ptr<BlockContext>> _finalizeQueue;
+        std::unique_ptr<std::thread> _executeThread;
+        std::unique_ptr<std::thread> _finalizeThread;
+    };
+}
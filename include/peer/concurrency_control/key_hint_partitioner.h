@@ -0,0 +1,154 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "proto/transaction.h"
+#include "common/phmap.h"
+
+#include "glog/logging.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace peer::cc {
+    // Assign the txns of a batch to the workers by a key hint taken from the chaincode args,
+    // the txns with the same hint go to the same worker, so that they do not contend on the
+    // same db shard (and reservation slot) from different workers.
+    // The assignment only changes which worker executes a txn, the batch index is not changed,
+    // so the result of a deterministic cc is the same as the round-robin assignment.
+    class KeyHintPartitioner {
+    public:
+        // Return false if the txn has no hint (e.g., can not parse the args)
+        using HintExtractor = std::function<bool(std::string_view funcName, std::string_view args, uint64_t* hint)>;
+
+        struct Statistics {
+            uint64_t totalTxnCount = 0;
+            uint64_t hintedTxnCount = 0;
+            uint64_t groupCount = 0;
+            // the groups that are larger than the capacity of a worker
+            uint64_t splitGroupCount = 0;
+            // sum of max worker load / avg worker load of each batch
+            double totalImbalance = 0;
+            uint64_t totalBatchCount = 0;
+
+            [[nodiscard]] double avgImbalance() const {
+                return totalBatchCount == 0 ? 0 : totalImbalance / (double)totalBatchCount;
+            }
+        };
+
+        // maxImbalance: the max load of a worker / the average load, >= 1
+        explicit KeyHintPartitioner(double maxImbalance = 1.25) : _maxImbalance(std::max(maxImbalance, 1.0)) { }
+
+        // With the extractors of the built-in chaincodes (ycsb, small bank and tpcc)
+        static std::unique_ptr<KeyHintPartitioner> NewDefaultPartitioner(double maxImbalance = 1.25);
+
+        // NOT thread safe, the partition key of a chaincode
+        void registerExtractor(const std::string& ccName, HintExtractor extractor) {
+            _extractors[ccName] = std::move(extractor);
+        }
+
+        // NOT thread safe, assignment[w] is the (ordered) txn indexes of worker w
+        void partition(const std::vector<std::unique_ptr<proto::Transaction>>& txnList,
+                       std::vector<std::vector<uint32_t>>& assignment) {
+            const auto workerCount = (int)assignment.size();
+            DCHECK(workerCount > 0);
+            for (auto& it: assignment) {
+                it.clear();
+            }
+            // 1. group by hint, the txns without hint are assigned at last
+            _groupOf.clear();
+            _groups.clear();
+            std::vector<uint32_t> noHint;
+            for (uint32_t i = 0; i < (uint32_t)txnList.size(); i++) {
+                uint64_t hint;
+                if (!getHint(*txnList[i], &hint)) {
+                    noHint.push_back(i);
+                    continue;
+                }
+                auto [it, inserted] = _groupOf.try_emplace(hint, (uint32_t)_groups.size());
+                if (inserted) {
+                    _groups.emplace_back();
+                }
+                _groups[it->second].push_back(i);
+            }
+            // 2. the largest group first, assign each one to the least loaded worker
+            const auto capacity = (size_t)std::ceil((double)txnList.size() / workerCount * _maxImbalance);
+            std::vector<uint32_t> order(_groups.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+                return _groups[lhs].size() > _groups[rhs].size();
+            });
+            // (load, worker id), the worker id breaks ties so the assignment is deterministic
+            using LoadType = std::pair<size_t, int>;
+            std::priority_queue<LoadType, std::vector<LoadType>, std::greater<>> loads;
+            for (int i = 0; i < workerCount; i++) {
+                loads.emplace(0, i);
+            }
+            auto assign = [&](const uint32_t* begin, size_t count) {
+                auto [load, worker] = loads.top();
+                loads.pop();
+                assignment[worker].insert(assignment[worker].end(), begin, begin + count);
+                loads.emplace(load + count, worker);
+            };
+            for (auto groupId: order) {
+                const auto& group = _groups[groupId];
+                if (group.size() <= capacity) {
+                    assign(group.data(), group.size());
+                    continue;
+                }
+                // a hot key, spread it over multiple workers to keep the balance
+                _statistics.splitGroupCount++;
+                for (size_t pos = 0; pos < group.size(); pos += capacity) {
+                    assign(group.data() + pos, std::min(capacity, group.size() - pos));
+                }
+            }
+            for (auto i: noHint) {
+                assign(&i, 1);
+            }
+            // 3. keep the batch order in each worker
+            size_t maxLoad = 0;
+            for (auto& it: assignment) {
+                std::sort(it.begin(), it.end());
+                maxLoad = std::max(maxLoad, it.size());
+            }
+            _statistics.totalTxnCount += txnList.size();
+            _statistics.hintedTxnCount += txnList.size() - noHint.size();
+            _statistics.groupCount += _groups.size();
+            _statistics.totalBatchCount++;
+            if (!txnList.empty()) {
+                _statistics.totalImbalance += (double)maxLoad * workerCount / (double)txnList.size();
+            }
+        }
+
+        [[nodiscard]] const Statistics& getStatistics() const { return _statistics; }
+
+    protected:
+        bool getHint(const proto::Transaction& txn, uint64_t* hint) const {
+            const auto& request = txn.getUserRequest();
+            auto it = _extractors.find(request.getCCNameSV());
+            if (it == _extractors.end()) {
+                return false;
+            }
+            if (!it->second(request.getFuncNameSV(), request.getArgs(), hint)) {
+                return false;
+            }
+            // the hints of different chaincodes never conflict
+            *hint ^= std::hash<std::string_view>()(request.getCCNameSV()) * 0x9e3779b97f4a7c15ULL;
+            return true;
+        }
+
+    private:
+        const double _maxImbalance;
+        util::MyFlatHashMap<std::string, HintExtractor> _extractors;
+        // reused between batches
+        util::MyFlatHashMap<uint64_t, uint32_t> _groupOf;
+        std::vector<std::vector<uint32_t>> _groups;
+        Statistics _statistics;
+    };
+}
@@ -51,7 +51,28 @@ namespace peer::cc::serial {
                 fsmTxnList.push_back(std::move(txn));   // txn may be nullptr
             }
             // 2 exec txn
-            for (auto& txn: fsmTxnList) {
+            processTxnList(fsmTxnList);
+            // 3 finish exec txn
+            for (int i = 0; i < (int)requests.size(); i += 1) {
+                auto& txn = fsmTxnList[i];
+                retResults[i] = static_cast<std::byte>(false);
+                if (txn == nullptr) {
+                    retRWSets[i] = std::make_unique<proto::TxReadWriteSet>();
+                    continue;
+                }
+                if (txn->getExecutionResult() == proto::Transaction::ExecutionResult::COMMIT) {
+                    retResults[i] = static_cast<std::byte>(true);
+                }
+                auto ret = proto::Transaction::DestroyTransaction(std::move(txn));
+                requests[i] = std::move(ret.first);
+                retRWSets[i] = std::move(ret.second);
+            }
+            return true;
+        }
+
+        // Hide Coordinator::processTxnList, the transactions are executed one by one in the caller thread
+        bool processTxnList(TxnListType& txnList) {
+            for (auto& txn: txnList) {
                 // find the chaincode using ccList
                 auto ccNameSV = txn->getUserRequest().getCCNameSV();
                 auto* chaincode = createOrGetChaincode(ccNameSV);
@@ -87,20 +108,8 @@ namespace peer::cc::serial {
                     LOG(ERROR) << "WorkerFSMImpl can not write to db!";
                 }
             }
-            // 3 finish exec txn
-            for (int i = 0; i < (int)requests.size(); i += 1) {
-                auto& txn = fsmTxnList[i];
-                retResults[i] = static_cast<std::byte>(false);
-                if (txn == nullptr) {
-                    retRWSets[i] = std::make_unique<proto::TxReadWriteSet>();
-                    continue;
-                }
-                if (txn->getExecutionResult() == proto::Transaction::ExecutionResult::COMMIT) {
-                    retResults[i] = static_cast<std::byte>(true);
-                }
-                auto ret = proto::Transaction::DestroyTransaction(std::move(txn));
-                requests[i] = std::move(ret.first);
-                retRWSets[i] = std::move(ret.second);
+            for (auto& txn: txnList) {
+                txn->updateExecutionResultDigest();
             }
             return true;
         }
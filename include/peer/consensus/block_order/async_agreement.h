@@ -10,8 +10,29 @@
 #include "common/thread_pool_light.h"
 #include "common/bccsp.h"
 #include "proto/block_order.h"
+#include <condition_variable>
 
 namespace peer::consensus {
+    // log the votes of a raft entry that can not be applied, delete itself after Run
+    class VoteApplyClosure : public braft::Closure {
+    public:
+        explicit VoteApplyClosure(std::vector<proto::BlockOrder> orders) : _orders(std::move(orders)) { }
+
+        void Run() override {
+            if (!status().ok()) {
+                for (const auto& bo: _orders) {
+                    LOG(ERROR) << "Can not apply vote, chainId: " << bo.chainId << ", blockId: " << bo.blockId
+                               << ", voteChainId: " << bo.voteChainId << ", voteBlockId: " << bo.voteBlockId
+                               << ", " << status().error_cstr();
+                }
+            }
+            delete this;
+        }
+
+    private:
+        std::vector<proto::BlockOrder> _orders;
+    };
+
     // The cluster orders the blocks locally(with bft) and then broadcasts to other clusters(with raft)
     // Meanwhile, the cluster receives the ordering results of other clusters(with raft)
     // Generate a final block order based on the aggregation of all results
@@ -46,6 +67,14 @@ namespace peer::consensus {
         }
 
         virtual ~AsyncAgreement() {
+            if (_voteFlusher != nullptr) {
+                {
+                    std::unique_lock lock(_voteMutex);
+                    _stopFlusher = true;
+                }
+                _voteCV.notify_all();
+                _voteFlusher->join();
+            }
             if (_localConfig != nullptr) {
                 util::DefaultRpcServer::Stop(_localConfig->port);
             }
@@ -84,7 +113,24 @@ namespace peer::consensus {
         }
 
     public:
-        // the instance MUST BE the leader of local group
+        // Coalesce the votes into one raft entry, an entry is applied when it has maxBatchSize votes,
+        // or windowUs after its first vote. Call it once before voting, maxBatchSize <= 1 disables batching.
+        void setVoteBatching(int maxBatchSize, int windowUs) {
+            CHECK(_voteFlusher == nullptr) << "Vote batching is already set!";
+            if (maxBatchSize <= 1) {
+                return;
+            }
+            {   // the leader may be voting already
+                std::unique_lock lock(_voteMutex);
+                _maxBatchSize = maxBatchSize;
+                _batchWindow = std::chrono::microseconds(std::max(windowUs, 0));
+            }
+            _voteFlusher = std::make_unique<std::thread>(&AsyncAgreement::voteFlusherLoop, this);
+        }
+
+        // The instance MUST BE the leader of local group.
+        // With vote batching, return true once the vote is queued, unless the batch is applied and fails.
+        // A batch that can not be applied is retried by the flusher, each vote is logged if it is dropped.
         bool onLeaderVotingNewBlock(const proto::BlockOrder& bo) {
             // TODO: use local BFT consensus to consensus the bo
             //  BFT(bo) -> true
@@ -92,9 +138,28 @@ namespace peer::consensus {
             if (!bo.serializeToString(&sb.serializedBlockOrder)) {
                 return false;
             }
-            std::string buffer;
-            sb.serializeToString(&buffer);
-            return apply(buffer);
+            // the entries are applied in the voting order
+            std::unique_lock lock(_voteMutex);
+            if (_maxBatchSize <= 1) {
+                std::string buffer;
+                sb.serializeToString(&buffer);
+                if (!apply(buffer, {bo})) {
+                    LogVotes({bo}, "Can not apply vote");
+                    return false;
+                }
+                return true;
+            }
+            _pendingVotes.push_back(std::move(sb));
+            _pendingOrders.push_back(bo);
+            if ((int)_pendingVotes.size() >= _maxBatchSize) {
+                return applyPendingVotes();
+            }
+            if (_pendingVotes.size() == 1) {
+                // start the window
+                _windowDeadline = std::chrono::steady_clock::now() + _batchWindow;
+                _voteCV.notify_one();
+            }
+            return true;
         }
 
     public:
@@ -109,17 +174,90 @@ namespace peer::consensus {
         }
 
     protected:
-        // thread safe, called by leader
-        bool apply(std::string& content) {
+        void voteFlusherLoop() {
+            pthread_setname_np(pthread_self(), "vote_flusher");
+            std::unique_lock lock(_voteMutex);
+            while (!_stopFlusher) {
+                if (_pendingVotes.empty()) {
+                    _voteCV.wait(lock);
+                    continue;
+                }
+                if (std::chrono::steady_clock::now() < _windowDeadline) {
+                    _voteCV.wait_until(lock, _windowDeadline);
+                    continue;
+                }
+                applyPendingVotes();
+            }
+        }
+
+        // hold _voteMutex, the votes are kept for a retry if they can not be applied
+        bool applyPendingVotes() {
+            std::string buffer;
+            if (_pendingVotes.size() == 1) {
+                // the same entry as a single vote
+                _pendingVotes.front().serializeToString(&buffer);
+            } else {
+                ::proto::SignedBlockOrderBatch batch;
+                batch.orders = std::move(_pendingVotes);
+                batch.serializeToString(&buffer);
+                _pendingVotes = std::move(batch.orders);
+            }
+            if (!apply(buffer, _pendingOrders)) {
+                if (++_applyRetries > MAX_APPLY_RETRIES) {
+                    LogVotes(_pendingOrders, "Drop vote after retries");
+                    _applyRetries = 0;
+                    _pendingVotes.clear();
+                    _pendingOrders.clear();
+                    return false;
+                }
+                LogVotes(_pendingOrders, "Can not apply vote, retry");
+                _windowDeadline = std::chrono::steady_clock::now() + std::max(_batchWindow, APPLY_RETRY_INTERVAL);
+                _voteCV.notify_one();
+                return false;
+            }
+            _applyRetries = 0;
+            _pendingVotes.clear();
+            _pendingOrders.clear();
+            return true;
+        }
+
+        // thread safe, called by leader, return false if the local node is not the leader anymore.
+        // The entry may still fail in raft, then the votes are logged by the closure.
+        bool apply(std::string& content, std::vector<proto::BlockOrder> orders) {
             auto* leader = _multiRaft->find_node(_localPeerId);
+            if (leader == nullptr || !leader->is_leader()) {
+                return false;
+            }
             butil::IOBuf data;
             data.append(content);
-            auto done = new util::raft::NullOptionClosure;
             braft::Task task;
             task.data = &data;
-            task.done = done;
+            task.done = new VoteApplyClosure(std::move(orders));
             leader->apply(task);
             return true;
         }
+
+        static void LogVotes(const std::vector<proto::BlockOrder>& orders, const char* reason) {
+            for (const auto& bo: orders) {
+                LOG(ERROR) << reason << ", chainId: " << bo.chainId << ", blockId: " << bo.blockId
+                           << ", voteChainId: " << bo.voteChainId << ", voteBlockId: " << bo.voteBlockId;
+            }
+        }
+
+    private:
+        constexpr static int MAX_APPLY_RETRIES = 10;
+        constexpr static std::chrono::microseconds APPLY_RETRY_INTERVAL{100 * 1000};
+
+        int _maxBatchSize = 1;
+        std::chrono::microseconds _batchWindow{};
+        std::mutex _voteMutex;
+        std::condition_variable _voteCV;
+        std::vector<::proto::SignedBlockOrder> _pendingVotes;
+        // the decoded _pendingVotes, for logging
+        std::vector<proto::BlockOrder> _pendingOrders;
+        int _applyRetries = 0;
+        std::chrono::steady_clock::time_point _windowDeadline;
+        bool _stopFlusher = false;
+        std::unique_ptr<std::thread> _voteFlusher;
     };
 }
\ No newline at end of file
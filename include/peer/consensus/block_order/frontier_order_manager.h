@@ -0,0 +1,358 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace peer::consensus::v2 {
+    // FrontierOrderManager delivers the blocks in exactly the same order as InterChainOrderManager,
+    // with less work per decision:
+    // 1. The frontier is the next undelivered block of each group. If a frontier block is less than all
+    //    the others (mustLessThan), it is also the least one in lexicographic order of (watermarks, blockId, groupId).
+    //    So the only candidate is the lexicographic minimum, it is delivered once it is verified against the others.
+    // 2. The watermarks of a frontier block never decrease. If a vote does not change the candidate,
+    //    the candidate is still the lexicographic minimum, only the changed blocks are verified again.
+    // 3. The watermarks of a group are rows of a flat matrix in a ring buffer. A delivered row is
+    //    recycled as soon as all the groups have voted for it (a later vote can not change anything).
+    class FrontierOrderManager {
+    public:
+        static constexpr int INVALID_WATERMARK = -1;
+        static constexpr int ESTIMATE_UNKNOWN = std::numeric_limits<int>::min();
+
+        void setGroupCount(int count) {
+            std::unique_lock guard(mutex);
+            chains = std::vector<Chain>(count);
+            for (int i = 0; i < count; i++) {
+                chains[i].init(count, i);
+            }
+            invalidGroups.clear();
+            isInvalid = std::vector<bool>(count, false);
+            unverified = std::vector<uint8_t>(count, 0);
+            estimates = std::vector<int>(count, INVALID_WATERMARK);
+            changed.clear();
+            changed.reserve(count);
+            candidate = -1;
+        }
+
+        // the callback is invoked with the group id and the block id of the delivered block
+        void setDeliverCallback(auto&& cb) { deliverCallback = std::forward<decltype(cb)>(cb); }
+
+        void pushDecision(int groupId, int blockId, int voteGroupId, int voteGroupWatermark) {
+            if (chains.size() == 1) {
+                return deliverCallback(groupId, blockId); // there is only a single group
+            }
+            if (voteGroupId == groupId) {
+                LOG_IF(WARNING, voteGroupWatermark != blockId) << "voteGroupWatermark is not equal to blockId!";
+                return;    // we will learn voteGroupWatermark from other groups later
+            }
+            std::unique_lock guard(mutex);
+            auto& chain = chains[groupId];
+            if (blockId < chain.low) {
+                return;     // all the groups have voted for this block
+            }
+            chain.ensure(blockId);
+            if (!chain.setWatermark(blockId, voteGroupId, voteGroupWatermark)) {
+                return; // Need to remove duplicates
+            }
+            if (blockId < chain.head) {
+                chain.retire();
+            } else if (blockId == chain.head) {
+                changed.push_back(groupId);
+            }
+            // update chain height
+            chains[voteGroupId].height = std::max(chains[voteGroupId].height, voteGroupWatermark);
+            chain.height = std::max(chain.height, blockId);
+            // voteGroupId cannot vote watermark smaller than voteGroupWatermark after this!
+            updateEstimate(voteGroupId, voteGroupWatermark);
+            popBlocks();
+        }
+
+        void invalidateChain(int groupId) {
+            std::unique_lock guard(mutex);
+            if (isInvalid[groupId]) {
+                return; // already invalidated
+            }
+            const auto height = chains[groupId].height;
+            LOG(WARNING) << "Invalidate chain of group: " << groupId << ", height: " << height;
+            isInvalid[groupId] = true;
+            invalidGroups.push_back(groupId);
+            for (auto& it: chains) {
+                CHECK(it.watermarks(it.head)[groupId] <= height);
+                it.setReal(it.head, groupId);
+            }
+            candidate = -1;
+            popBlocks();  // maybe there are new elements that can pop
+        }
+
+    protected:
+        // the watermark matrix of the blocks of a group, row b is block b, column i is the vote of group i
+        class Chain {
+        public:
+            static constexpr int INITIAL_CAPACITY = 64;
+
+            void init(int groupCount_, int groupId_) {
+                groupCount = groupCount_;
+                groupId = groupId_;
+                resize(INITIAL_CAPACITY);
+                ensure(0);
+            }
+
+            // create the rows until blockId
+            void ensure(int blockId) {
+                if (blockId <= high) {
+                    return;
+                }
+                if (blockId - low + 1 > capacity) {
+                    auto newCapacity = capacity;
+                    while (blockId - low + 1 > newCapacity) {
+                        newCapacity <<= 1;
+                    }
+                    resize(newCapacity);
+                }
+                for (int b = high + 1; b <= blockId; b++) {
+                    auto* w = watermarks(b);
+                    std::fill(w, w + groupCount, INVALID_WATERMARK);
+                    auto* r = real(b);
+                    std::fill(r, r + groupCount, 0);
+                    realCount[slot(b)] = 0;
+                    // this is known by default
+                    w[groupId] = b;
+                    setReal(b, groupId);
+                }
+                high = blockId;
+            }
+
+            bool setWatermark(int blockId, int i, int value) {
+                if (real(blockId)[i]) {
+                    // this may fail due to multiple call of invalidate signal (which does not matter correctness)
+                    return false;
+                }
+                auto& w = watermarks(blockId)[i];
+                CHECK(w <= value);  // ensure compare fairness
+                w = value;
+                setReal(blockId, i);
+                return true;
+            }
+
+            void setReal(int blockId, int i) {
+                auto& r = real(blockId)[i];
+                if (!r) {
+                    r = 1;
+                    realCount[slot(blockId)]++;
+                }
+            }
+
+            // recycle the delivered rows that all the groups voted for
+            void retire() {
+                while (low < head && realCount[slot(low)] == groupCount) {
+                    low++;
+                }
+            }
+
+            inline int32_t* watermarks(int blockId) { return _watermarks.data() + (size_t)slot(blockId) * groupCount; }
+
+            inline uint8_t* real(int blockId) { return _real.data() + (size_t)slot(blockId) * groupCount; }
+
+            int groupId = -1;
+            int groupCount = 0;
+            // the rows of [low, high] are stored, [low, head) are delivered
+            int low = 0;
+            int head = 0;
+            int high = -1;
+            int height = -1;
+
+        protected:
+            [[nodiscard]] inline int slot(int blockId) const { return blockId & (capacity - 1); }
+
+            void resize(int newCapacity) {
+                std::vector<int32_t> w((size_t)newCapacity * groupCount);
+                std::vector<uint8_t> r((size_t)newCapacity * groupCount);
+                std::vector<int> c(newCapacity);
+                for (int b = low; b <= high; b++) {
+                    auto from = (size_t)slot(b) * groupCount;
+                    auto to = (size_t)(b & (newCapacity - 1)) * groupCount;
+                    std::copy_n(_watermarks.data() + from, groupCount, w.data() + to);
+                    std::copy_n(_real.data() + from, groupCount, r.data() + to);
+                    c[b & (newCapacity - 1)] = realCount[slot(b)];
+                }
+                _watermarks = std::move(w);
+                _real = std::move(r);
+                realCount = std::move(c);
+                capacity = newCapacity;
+            }
+
+        private:
+            int capacity = 0;
+            std::vector<int32_t> _watermarks;
+            std::vector<uint8_t> _real;
+            std::vector<int> realCount;
+        };
+
+        // the same order as InterChainOrderManager::Cell::mustLessThan, between the frontier blocks
+        bool mustLessThan(int lhs, int rhs) {
+            if (lhs == rhs) {
+                return true;    // we do not compare the same entry
+            }
+            auto& l = chains[lhs];
+            auto& r = chains[rhs];
+            const auto* lw = l.watermarks(l.head);
+            const auto* lr = l.real(l.head);
+            const auto* rw = r.watermarks(r.head);
+            const auto* rr = r.real(r.head);
+            for (int i = 0; i < (int)chains.size(); i++) {
+                if (!lr[i]) {
+                    return false;
+                }
+                if (lw[i] < rw[i]) {
+                    return true;
+                }
+                if (!rr[i] || lw[i] != rw[i]) {
+                    return false;
+                }
+            }
+            if (l.head != r.head) {
+                return l.head < r.head;
+            }
+            return lhs < rhs;
+        }
+
+        // the lexicographic order of (watermarks, blockId, groupId), between the frontier blocks
+        bool lexLessThan(int lhs, int rhs) {
+            auto& l = chains[lhs];
+            auto& r = chains[rhs];
+            const auto* lw = l.watermarks(l.head);
+            const auto* rw = r.watermarks(r.head);
+            for (int i = 0; i < (int)chains.size(); i++) {
+                if (lw[i] != rw[i]) {
+                    return lw[i] < rw[i];
+                }
+            }
+            if (l.head != r.head) {
+                return l.head < r.head;
+            }
+            return lhs < rhs;
+        }
+
+        void verify(int groupId) {
+            auto result = !mustLessThan(candidate, groupId);
+            unverifiedCount += (int)result - (int)unverified[groupId];
+            unverified[groupId] = result;
+        }
+
+        // return the group of the global minimum, -1 if not exist
+        int globalMinimum() {
+            if (candidate != -1 && std::find(changed.begin(), changed.end(), candidate) == changed.end()) {
+                // the candidate is still the lexicographic minimum
+                for (auto it: changed) {
+                    verify(it);
+                }
+            } else {
+                candidate = 0;
+                for (int i = 1; i < (int)chains.size(); i++) {
+                    if (lexLessThan(i, candidate)) {
+                        candidate = i;
+                    }
+                }
+                std::fill(unverified.begin(), unverified.end(), 0);
+                unverifiedCount = 0;
+                for (int i = 0; i < (int)chains.size(); i++) {
+                    verify(i);
+                }
+            }
+            changed.clear();
+            return unverifiedCount == 0 ? candidate : -1;
+        }
+
+        void updateEstimate(int groupId, int watermark) {
+            if (estimates[groupId] == watermark) {
+                return;     // nothing to update
+            }
+            for (auto& it: chains) {
+                auto* r = it.real(it.head);
+                if (r[groupId]) {
+                    continue;
+                }
+                CHECK(it.groupId != groupId) << "local group watermark must be pre-set";
+                auto& w = it.watermarks(it.head)[groupId];
+                CHECK(w <= watermark) << "watermarks:" << w;
+                if (w != watermark) {
+                    w = watermark;
+                    changed.push_back(it.groupId);
+                }
+            }
+            estimates[groupId] = watermark;
+        }
+
+        // move the frontier of the group to the next block, the estimates are inherited
+        void exchange(int groupId) {
+            auto& chain = chains[groupId];
+            const auto prev = chain.head;
+            const auto next = prev + 1;
+            chain.ensure(next);
+            // take the rows after ensure, it may reallocate the matrix
+            const auto* prevW = chain.watermarks(prev);
+            auto* nextW = chain.watermarks(next);
+            const auto* nextR = chain.real(next);
+            for (int i = 0; i < (int)chains.size(); i++) {
+                if (nextR[i]) {
+                    CHECK(prevW[i] <= nextW[i]);
+                    continue;
+                }
+                nextW[i] = prevW[i];
+                if (nextW[i] != estimates[i]) {
+                    estimates[i] = ESTIMATE_UNKNOWN;
+                }
+            }
+            // set bits of invalidated group
+            for (auto it: invalidGroups) {
+                nextW[it] = prevW[it];
+                chain.setReal(next, it);
+            }
+            chain.head = next;
+            chain.retire();
+        }
+
+        void popBlocks() {
+            for (auto groupId = globalMinimum(); groupId != -1; groupId = globalMinimum()) {
+                deliverCallback(groupId, chains[groupId].head);
+                exchange(groupId);
+                candidate = -1;
+            }
+        }
+
+    private:
+        std::mutex mutex;   // for chains
+
+        std::vector<Chain> chains;
+
+        std::vector<bool> isInvalid;
+
+        std::vector<int> invalidGroups;
+
+        // the lexicographic minimum of the frontier, -1 if it must be found again
+        int candidate = -1;
+
+        // unverified[i] is set if the candidate is not less than the frontier block of group i
+        std::vector<uint8_t> unverified;
+
+        int unverifiedCount = 0;
+
+        // if estimates[i] is not ESTIMATE_UNKNOWN, it is the watermark of group i in all the frontier blocks
+        // that have not received the vote of group i
+        std::vector<int> estimates;
+
+        // the frontier blocks changed since the last verification
+        std::vector<int> changed;
+
+        std::function<void(int groupId, int blockId)> deliverCallback;  // execute block in order
+    };
+}
@@ -4,6 +4,7 @@
 
 #include "peer/consensus/block_order/async_agreement.h"
 #include "peer/consensus/block_order/block_order.h"
+#include "peer/consensus/block_order/frontier_order_manager.h"
 #include "peer/consensus/block_order/interchain_order_manager.h"
 #include "peer/storage/mr_block_storage.h"
 
@@ -30,33 +31,68 @@ namespace peer::consensus::v2 {
         }
 
         [[nodiscard]] bool validateSignatureOfBlockOrder(const proto::SignedBlockOrder& sb) const {
-            if (sb.signatures.empty()) {    // optimize
+            return validateSignatureOfBlockOrders({&sb});
+        }
+
+        // The signatures of all the orders (e.g., the votes in a raft entry) are verified in one batch,
+        // the indexes of the orders with an invalid signature are appended to invalid.
+        [[nodiscard]] bool validateSignatureOfBlockOrders(const std::vector<const proto::SignedBlockOrder*>& orders,
+                                                          std::vector<int>* invalid = nullptr) const {
+            size_t signatureCount = 0;
+            for (const auto& sb: orders) {
+                signatureCount += sb->signatures.size();
+            }
+            if (signatureCount == 0) {    // optimize
                 // DLOG(WARNING) << "Sigs are empty in validateSignatureOfBlockOrder!";
                 return true;
             }
-            bool success = true;
-            auto numRoutines = (int)_threadPool->get_thread_count();
-            bthread::CountdownEvent countdown(numRoutines);
-            for (auto i = 0; i < numRoutines; i++) {
-                _threadPool->push_emergency_task([&, start=i] {
-                    auto& payload = sb.serializedBlockOrder;
-                    for (int j = start; j < (int)sb.signatures.size(); j += numRoutines) {
-                        auto& signature = sb.signatures[j];
-                        const auto key = _bccsp->GetKey(signature.ski);
-                        if (key == nullptr) {
-                            LOG(WARNING) << "Can not load key, ski: " << signature.ski;
-                            success = false;
-                            break;
-                        }
-                        if (!key->Verify(signature.digest, payload.data(), payload.size())) {
-                            success = false;
-                            break;
-                        }
+            // all the signatures of an order are over the same payload, hash it once
+            std::vector<util::OpenSSLSHA256::digestType> digests;
+            digests.reserve(orders.size());
+            std::vector<util::VerifyRawRequest> requests;
+            requests.reserve(signatureCount);
+            // the index of the order of each request
+            std::vector<int> owners;
+            owners.reserve(signatureCount);
+            std::vector<bool> rejected(orders.size(), false);
+            for (int i = 0; i < (int)orders.size(); i++) {
+                const auto& sb = orders[i];
+                if (sb->signatures.empty()) {
+                    continue;
+                }
+                const auto& payload = sb->serializedBlockOrder;
+                auto digest = util::OpenSSLSHA256::generateDigest(payload.data(), payload.size());
+                if (digest == std::nullopt) {
+                    rejected[i] = true;
+                    continue;
+                }
+                const auto& d = digests.emplace_back(*digest);
+                for (const auto& signature: sb->signatures) {
+                    auto key = _bccsp->GetKey(signature.ski);
+                    if (key == nullptr) {
+                        LOG(WARNING) << "Can not load key, ski: " << signature.ski;
+                        rejected[i] = true;
+                        continue;
                     }
-                    countdown.signal();
-                });
+                    requests.push_back({std::move(key), &signature.digest, d.data(), d.size()});
+                    owners.push_back(i);
+                }
+            }
+            std::vector<int> invalidRequests;
+            util::BCCSP::VerifyRawBatch(requests, &invalidRequests, _threadPool.get());
+            for (auto i: invalidRequests) {
+                rejected[owners[i]] = true;
+            }
+            bool success = true;
+            for (int i = 0; i < (int)orders.size(); i++) {
+                if (!rejected[i]) {
+                    continue;
+                }
+                success = false;
+                if (invalid != nullptr) {
+                    invalid->push_back(i);
+                }
             }
-            countdown.wait();
             return success;
         }
 
@@ -94,36 +130,32 @@ namespace peer::consensus::v2 {
             // concurrent access
             setOnValidateCallback([this](const std::string& decision)->bool {
                 if (_validator != nullptr) {
-                    proto::SignedBlockOrder sb{};
-                    if (!sb.deserializeFromString(decision)) {
-                        return false;
-                    }
-                    proto::BlockOrder bo{};
-                    if (!bo.deserializeFromString(sb.serializedBlockOrder)) {
+                    // An entry contains one vote or a batch of votes, a committed entry is applied as a whole,
+                    // so an entry with any invalid vote is rejected here, before it is committed.
+                    std::vector<proto::SignedBlockOrder> orders;
+                    std::vector<proto::BlockOrder> blockOrders;
+                    if (!DecodeEntry(decision, orders, blockOrders)) {
                         return false;
                     }
-                    if (bo.voteChainId == -1) {
-                        return true;    // this is a view-change message
-                    }
-                    if (!_increaseBlockVoteCallback(bo.chainId, bo.blockId, bo.voteChainId)) {
-                        return false;   // add count
-                    }
-                    if (_getBlockVoteCountCallback(bo.chainId, bo.blockId)) {    // received f+1 votes
-                        return true;
-                    }
-                    if (!_validator->validateSignatureOfBlockOrder(sb)) {
+                    if (!validateSignatures(orders, blockOrders)) {
                         return false;   // signature checksum error
                     }
-                    for (int i=0; i<20; i++) {
-                        if (_validator->waitUntilReceiveValidBlock(bo, 10)) { // received actual block
-                            return true;
+                    std::vector<proto::BlockOrder> waitList;
+                    for (const auto& bo: blockOrders) {
+                        if (bo.voteChainId == -1) {
+                            continue;    // this is a view-change message
+                        }
+                        if (!_increaseBlockVoteCallback(bo.chainId, bo.blockId, bo.voteChainId)) {
+                            return false;   // add count
                         }
                         if (_getBlockVoteCountCallback(bo.chainId, bo.blockId)) {    // received f+1 votes
-                            return true;
+                            continue;
                         }
+                        waitList.push_back(bo);
+                    }
+                    if (!waitUntilReceiveValidBlocks(waitList)) {
+                        return false;
                     }
-                    LOG(ERROR) << "I can not receive block after 20 tries: " << bo.chainId << ", " << bo.blockId;
-                    return false;
                 }
                 return true;
             });
@@ -136,17 +168,17 @@ namespace peer::consensus::v2 {
         // initialized by BlockOrder::NewBlockOrder
         void init(int groupCount, std::unique_ptr<LocalDistributor> ld) override {
             RaftCallback::init(groupCount, std::move(ld));
-            auto om = std::make_unique<v2::InterChainOrderManager>();
+            auto om = std::make_unique<v2::FrontierOrderManager>();
             om->setGroupCount(groupCount);
-            om->setDeliverCallback([this](const v2::InterChainOrderManager::Cell* c) {
+            om->setDeliverCallback([this](int groupId, int blockId) {
                 // use to test if all nodes runs in the same order
                 // static int idx = 0;
                 // static auto gid = std::this_thread::get_id();
-                // LOG(INFO) << "Node " << gid << " execute " << idx ++ << " " << c->groupId << " " << c->blockId;
+                // LOG(INFO) << "Node " << gid << " execute " << idx ++ << " " << groupId << " " << blockId;
 
                 // return the final decision to caller
-                if (!onExecuteBlock(c->groupId, c->blockId)) {
-                    LOG(ERROR) << "Execute block failed, bid: " << c->blockId;
+                if (!onExecuteBlock(groupId, blockId)) {
+                    LOG(ERROR) << "Execute block failed, bid: " << blockId;
                 }
             });
             _orderManager = std::move(om);
@@ -163,20 +195,84 @@ namespace peer::consensus::v2 {
         void setGetBlockVoteCountCallback(auto&& cb) { _getBlockVoteCountCallback = std::forward<decltype(cb)>(cb); }
 
     protected:
-        bool applyRawBlockOrder(const std::string& decision) {
-            proto::SignedBlockOrder sb;
-            if (!sb.deserializeFromString(decision)) {
+        // the blocks of all the votes in an entry share one wait budget, the blocks keep arriving in the
+        // background, so the votes are waited concurrently and an entry waits at most WAIT_BLOCK_BUDGET_MS
+        constexpr static int WAIT_BLOCK_BUDGET_MS = 200;
+
+        bool waitUntilReceiveValidBlocks(const std::vector<proto::BlockOrder>& waitList) {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(WAIT_BLOCK_BUDGET_MS);
+            for (const auto& bo: waitList) {
+                while (true) {
+                    if (_validator->waitUntilReceiveValidBlock(bo, 10)) { // received actual block
+                        break;
+                    }
+                    if (_getBlockVoteCountCallback(bo.chainId, bo.blockId)) {    // received f+1 votes
+                        break;
+                    }
+                    if (std::chrono::steady_clock::now() >= deadline) {
+                        LOG(ERROR) << "I can not receive block in " << WAIT_BLOCK_BUDGET_MS << "ms: " << bo.chainId << ", " << bo.blockId;
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // an entry contains one vote or a batch of votes, return false if the entry is malformed
+        static bool DecodeEntry(const std::string& decision,
+                                std::vector<proto::SignedBlockOrder>& orders,
+                                std::vector<proto::BlockOrder>& blockOrders) {
+            if (!proto::SignedBlockOrderBatch::DeserializeEntry(decision, orders)) {
                 return false;
             }
-            proto::BlockOrder bo{};
-            if (!bo.deserializeFromString(sb.serializedBlockOrder)) {
+            blockOrders.resize(orders.size());
+            for (int i = 0; i < (int)orders.size(); i++) {
+                if (!blockOrders[i].deserializeFromString(orders[i].serializedBlockOrder)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // the signatures of the votes are verified one by one in a batch, each invalid vote is logged
+        bool validateSignatures(const std::vector<proto::SignedBlockOrder>& orders,
+                                const std::vector<proto::BlockOrder>& blockOrders) const {
+            std::vector<const proto::SignedBlockOrder*> signedList;
+            signedList.reserve(orders.size());
+            for (const auto& sb: orders) {
+                signedList.push_back(&sb);
+            }
+            std::vector<int> invalid;
+            if (_validator->validateSignatureOfBlockOrders(signedList, &invalid)) {
+                return true;
+            }
+            for (auto i: invalid) {
+                const auto& bo = blockOrders[i];
+                LOG(ERROR) << "Reject an entry with an invalid vote, chainId: " << bo.chainId << ", blockId: " << bo.blockId
+                           << ", voteChainId: " << bo.voteChainId << ", voteBlockId: " << bo.voteBlockId;
+            }
+            return false;
+        }
+
+        // the entry is committed, all its votes are applied, the state machine must not depend on the local state
+        bool applyRawBlockOrder(const std::string& decision) {
+            std::vector<proto::SignedBlockOrder> orders;
+            std::vector<proto::BlockOrder> blockOrders;
+            if (!DecodeEntry(decision, orders, blockOrders)) {
                 return false;
             }
+            for (const auto& bo: blockOrders) {
+                applyBlockOrder(bo);
+            }
+            return true;
+        }
+
+        void applyBlockOrder(const proto::BlockOrder& bo) {
             if (bo.voteChainId == -1) {   // this is an error message
                 CHECK(bo.blockId == -1 && bo.voteBlockId == -1);
                 // the group is down, invalid all the block
                 _orderManager->invalidateChain(bo.chainId);
-                return true;
+                return;
             }
             // if is leader, increase local vc
             if (_increaseVCCallback) {
@@ -184,11 +280,10 @@ namespace peer::consensus::v2 {
             }
             // LOG(INFO)  << "DEBUG  " << bo.chainId << ", " << bo.blockId << ", " << bo.voteChainId << ", " <<bo.voteBlockId;
             _orderManager->pushDecision(bo.chainId, bo.blockId,  bo.voteChainId, bo.voteBlockId);
-            return true;
         }
 
     private:
-        std::unique_ptr<v2::InterChainOrderManager> _orderManager;
+        std::unique_ptr<v2::FrontierOrderManager> _orderManager;
         std::unique_ptr<RaftLogValidator> _validator;
         std::function<bool(int chainId, int blockId)> _increaseVCCallback;
         std::function<bool(int chainId, int blockId, int voteChainId)> _increaseBlockVoteCallback;
@@ -333,6 +428,13 @@ namespace peer::consensus::v2 {
             return raftAgreement->onLeaderVotingNewBlock(bo);
         }
 
+        // coalesce the votes of this leader into fewer raft entries, see AsyncAgreement::setVoteBatching
+        void setVoteBatching(int maxBatchSize, int windowUs) {
+            if (raftAgreement != nullptr && isRaftLeader) {
+                raftAgreement->setVoteBatching(maxBatchSize, windowUs);
+            }
+        }
+
         [[nodiscard]] bool isLeader() const override { return isRaftLeader; }
 
         // wait until the node become the leader of the raft group
@@ -9,6 +9,7 @@
 #include "common/bccsp.h"
 #include "common/thread_pool_light.h"
 #include "common/concurrent_queue.h"
+#include "common/proof_generator.h"
 
 #include "proto/block.h"
 #include "bthread/countdown_event.h"
@@ -61,8 +62,10 @@ namespace peer::consensus::v2 {
         void sendStopSignal() { _running = false; }
 
         // If the user request has been verified before (pessimistic verification),
-        // there is no need to re-verify here, otherwise the user signature needs to be verified
-        bool pushUnorderedBlock(std::vector<std::unique_ptr<proto::Envelop>> batch);
+        // there is no need to re-verify here, otherwise the user signature needs to be verified.
+        // The builder holds the leaves of the batch, it is fed by the request replicator as the requests arrive.
+        bool pushUnorderedBlock(std::vector<std::unique_ptr<proto::Envelop>> batch,
+                                std::unique_ptr<util::UserRequestMTGenerator::Builder> builder);
 
     protected:
         [[nodiscard]] std::unique_ptr<::proto::Block::SignaturePair> OnSignProposal(const ::util::NodeConfigPtr& localNode, const std::string& message) override;
@@ -101,6 +101,9 @@ namespace peer::consensus::v2 {
             return true;
         }
 
+        // the state machine driven by the local consensus engine
+        [[nodiscard]] std::shared_ptr<LocalConsensus> getStateMachine() const { return _replicator; }
+
     protected:
         LocalConsensusController(std::unique_ptr<LocalConsensus> replicator,
                             std::shared_ptr<peer::MRBlockStorage> storage,
@@ -73,6 +73,21 @@ namespace peer::consensus {
             return true;
         }
 
+        // The pipelined engine verifies a header before the former one is delivered,
+        // it is valid if it follows the delivered block or the last verified header.
+        [[nodiscard]] bool isVerifiedBlockHeaderValid(const proto::Block::Header& header) {
+            if (_verifiedHeader != nullptr) {
+                auto exceptPreviousHash = CalculatePreviousHash(*_verifiedHeader);
+                if (exceptPreviousHash != std::nullopt && *exceptPreviousHash == header.previousHash &&
+                    _verifiedHeader->number + 1 == header.number) {
+                    return true;
+                }
+            }
+            return isDeliveredBlockHeaderValid(header);
+        }
+
+        void setHeaderVerified(std::unique_ptr<proto::Block::Header> header) { _verifiedHeader = std::move(header); }
+
         // leader
         void setBlockProposed(auto&& block) { _proposedLastBlock = std::forward<decltype(block)>(block); }
 
@@ -99,5 +114,6 @@ namespace peer::consensus {
 
         std::shared_ptr<::proto::Block> _deliveredBlock;
         std::shared_ptr<::proto::Block> _proposedLastBlock;
+        std::unique_ptr<::proto::Block::Header> _verifiedHeader;
     };
 }
\ No newline at end of file
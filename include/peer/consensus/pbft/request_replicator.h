@@ -6,12 +6,15 @@
 
 #include "common/zeromq.h"
 #include "common/timer.h"
+#include "common/proof_generator.h"
 #include "proto/user_request.h"
 
 namespace peer::consensus::v2 {
     // RequestReplicator is used to collect requests from local users.
     // When the request is greater than the threshold or times out,
     // the callback function is called on the request collection.
+    // The requests are appended to a merkle tree builder as they arrive,
+    // the builder is passed to the callback together with the requests.
     class RequestReplicator {
     public:
         struct Config {
@@ -97,6 +100,7 @@ namespace peer::consensus::v2 {
 
             while(true) {
                 auto unorderedRequests = std::vector<std::unique_ptr<proto::Envelop>>(_batchConfig.maxBatchSize);
+                auto builder = std::make_unique<util::UserRequestMTGenerator::Builder>();
                 std::string serializedRequests;
                 serializedRequests.reserve(_batchConfig.maxBatchSize * 512);
                 auto timer = util::Timer();
@@ -111,6 +115,7 @@ namespace peer::consensus::v2 {
                                                                              timeLeftUs);
                     for (int i = 0; i < (int)ret; i++) {
                         unorderedRequests[currentBatchSize + i]->serializeToString(&serializedRequests, (int)serializedRequests.size());
+                        builder->append(*unorderedRequests[currentBatchSize + i]);
                     }
                     currentBatchSize += (int)ret;
                     if (currentBatchSize == 0) {   // We can not pass empty batch to replicator
@@ -127,7 +132,7 @@ namespace peer::consensus::v2 {
                 }
                 unorderedRequests.resize(currentBatchSize);
                 DLOG(INFO) << "Leader batch a block, size: " << currentBatchSize;
-                if (_batchCallback && !_batchCallback(std::move(unorderedRequests))) {
+                if (_batchCallback && !_batchCallback(std::move(unorderedRequests), std::move(builder))) {
                     LOG(WARNING) << "Batch call back return false!";
                     continue;
                 }
@@ -143,6 +148,7 @@ namespace peer::consensus::v2 {
 
             auto currentBatchSize = 0;
             auto unorderedRequests = std::vector<std::unique_ptr<proto::Envelop>>(_batchConfig.maxBatchSize);
+            auto builder = std::make_unique<util::UserRequestMTGenerator::Builder>();
 
             auto batchingFunc = [&]() -> bool {
                 if (currentBatchSize == 0) {
@@ -150,12 +156,13 @@ namespace peer::consensus::v2 {
                 }
                 unorderedRequests.resize(currentBatchSize);
                 DLOG(INFO) << "Follower batch a block, size: " << currentBatchSize;
-                if (_batchCallback && !_batchCallback(std::move(unorderedRequests))) {
+                if (_batchCallback && !_batchCallback(std::move(unorderedRequests), std::move(builder))) {
                     LOG(WARNING) << "Batch call back return false!";
                     return false;
                 }
                 currentBatchSize = 0;   // reset
                 unorderedRequests = std::vector<std::unique_ptr<proto::Envelop>>(_batchConfig.maxBatchSize);
+                builder = std::make_unique<util::UserRequestMTGenerator::Builder>();
                 return true;
             };
 
@@ -176,6 +183,7 @@ namespace peer::consensus::v2 {
                         LOG(WARNING) << "Deserialize user request failed.";
                         return true;
                     }
+                    builder->append(*envelop);
                     unorderedRequests[currentBatchSize] = std::move(envelop);
                     currentBatchSize += 1;
                 }
@@ -201,6 +209,7 @@ namespace peer::consensus::v2 {
         // send to follower as a server
         std::shared_ptr<util::ZMQInstance> _sendToPeer;
 
-        std::function<bool(std::vector<std::unique_ptr<proto::Envelop>> unorderedRequests)> _batchCallback;
+        std::function<bool(std::vector<std::unique_ptr<proto::Envelop>> unorderedRequests,
+                           std::unique_ptr<util::UserRequestMTGenerator::Builder> builder)> _batchCallback;
     };
 }
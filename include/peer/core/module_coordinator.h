@@ -10,6 +10,10 @@
 #include "common/async_serial_executor.h"
 #include "peer/db/db_interface.h"
 
+namespace proto {
+    class Block;
+}
+
 namespace util {
     class Properties;
     struct NodeConfig;
@@ -22,13 +26,9 @@ namespace peer {
         class BlockOrderInterface;
     }
     namespace cc {
-        class CoordinatorImpl;
-        namespace crdt {
-            class CRDTCoordinator;
-        }
-        namespace serial {
-            class SerialCoordinator;
-        }
+        template<class CoordinatorType>
+        class ExecutionPipeline;
+        class CCEngine;
     }
 }
 
@@ -38,13 +38,6 @@ namespace peer::core {
 
     class ModuleCoordinator {
     public:
-        // Uncomment this line to enable CRDT chaincode
-        // using ChaincodeType = peer::cc::crdt::CRDTCoordinator;
-        // Uncomment this line to enable traditional chaincode
-        using ChaincodeType = peer::cc::CoordinatorImpl;
-        // Uncomment this line to enable serial exec chaincode
-        // using ChaincodeType = peer::cc::serial::SerialCoordinator;
-
         static std::unique_ptr<ModuleCoordinator> NewModuleCoordinator(const std::shared_ptr<util::Properties>& properties);
 
         bool initChaincodeData(const std::string& ccName);
@@ -72,6 +65,8 @@ namespace peer::core {
 
         bool onConsensusBlockOrder(int regionId, int blockId);
 
+        void onBlockCommitted(int regionId, std::shared_ptr<proto::Block> block, bool success);
+
     private:
         // for subscriber
         int _subscriberId = -1;
@@ -87,9 +82,13 @@ namespace peer::core {
         std::shared_ptr<util::NodeConfig> _localNode;
         // for concurrency control
         std::shared_ptr<peer::db::DBConnection> _db;
-        std::unique_ptr<ChaincodeType> _cc;
-        util::AsyncSerialExecutor _serialExecutor;
+        // the engine is selected by CC_ENGINE
+        std::unique_ptr<peer::cc::CCEngine> _cc;
         // for user rpc
         std::shared_ptr<::peer::BlockLRUCache> _userRPCNotifier;
+        // destroyed in reverse order: the executor stops adding blocks, then the pipeline
+        // joins its threads, which call onBlockCommitted, before _userRPCNotifier and _cc are released
+        std::unique_ptr<peer::cc::ExecutionPipeline<peer::cc::CCEngine>> _pipeline;
+        util::AsyncSerialExecutor _serialExecutor;
     };
 }
\ No newline at end of file
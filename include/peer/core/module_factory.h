@@ -11,6 +11,9 @@
 namespace util {
     class BCCSP;
     class thread_pool_light;
+    namespace pbft {
+        class PBFTReplica;
+    }
 }
 
 namespace peer {
@@ -18,6 +21,7 @@ namespace peer {
         namespace v2 {
             class LocalConsensusController;
             class SinglePBFTController;
+            class LocalDistributor;
             class BlockOrder;
         }
         namespace rb {
@@ -48,8 +52,17 @@ namespace peer {
 namespace peer::core {
     struct BFTController {
         ~BFTController();
+
+        // start the local consensus engine, either pbftController (BFT-SMaRt) or replica (native)
+        void startInstance();
+
+        void waitUntilReady();
+
         std::unique_ptr<consensus::v2::LocalConsensusController> consensusController;
         std::unique_ptr<consensus::v2::SinglePBFTController> pbftController;
+        std::unique_ptr<util::pbft::PBFTReplica> replica;
+        // broadcast the messages between the replicas
+        std::unique_ptr<consensus::v2::LocalDistributor> replicaTransport;
     };
 
     class ModuleFactory {
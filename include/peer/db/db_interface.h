@@ -4,15 +4,257 @@
 
 #pragma once
 
+#include "peer/db/write_batch.h"
+#include "peer/db/hot_key_cache.h"
 #include "peer/db/leveldb_connection.h"
 #include "peer/db/phmap_connection.h"
 #include "peer/db/rocksdb_connection.h"
+#include "peer/db/mvcc_connection.h"
 
 namespace peer::db {
-    using DBConnection = PHMapConnection;
+    struct DBConfig {
+        // "phmap", "rocksdb" or "leveldb"
+        std::string backend = "phmap";
+        // only for rocksdb
+        RocksdbConfig rocksdb;
+        // cache the hot keys in front of the backend, 0 to disable
+        size_t cacheCapacity = 0;
+        uint32_t cacheAdmitThreshold = 2;
+    };
+
+    // The storage backend is selected at runtime, all backends share the same write batch.
+    class DBConnection {
+    public:
+        using WriteBatch = db::WriteBatch;
+
+        virtual ~DBConnection() = default;
+
+        // return nullptr if the backend is unknown or the db can not be opened
+        static std::unique_ptr<DBConnection> NewConnection(const std::string& dbName, const DBConfig& config);
+
+        // create an in-memory hashmap db
+        static std::unique_ptr<DBConnection> NewConnection(const std::string& dbName) {
+            return NewConnection(dbName, DBConfig{});
+        }
+
+        [[nodiscard]] virtual const std::string& getDBName() const = 0;
+
+        // The data survives a restart
+        [[nodiscard]] virtual bool isPersistent() const = 0;
+
+        virtual bool syncWriteBatch(const std::function<bool(WriteBatch* batch)>& callback) = 0;
+
+        virtual bool syncPut(std::string_view key, std::string_view value) = 0;
+
+        virtual bool asyncPut(std::string_view key, std::string_view value) = 0;
+
+        // It is not an error if "key" did not exist in the database.
+        virtual bool syncDelete(std::string_view key) = 0;
+
+        virtual bool asyncDelete(std::string_view key) = 0;
+
+        virtual bool get(std::string_view key, std::string* value) const = 0;
+
+        // The syncWriteBatch between begin and end may be merged and written (synced) once at the end,
+        // the batches are not visible until endGroupCommit. Must be called when there is no in-flight write.
+        virtual void beginGroupCommit() { }
+
+        virtual bool endGroupCommit() { return true; }
+
+        // Called after all txns of a block are committed, when there is no in-flight read or write.
+        virtual void onBlockCommitted() { }
+    };
+
+    template<class Backend>
+    class DBConnectionAdapter : public DBConnection {
+    public:
+        explicit DBConnectionAdapter(std::unique_ptr<Backend> backend) : _backend(std::move(backend)) { }
+
+        [[nodiscard]] const std::string& getDBName() const override { return _backend->getDBName(); }
+
+        [[nodiscard]] bool isPersistent() const override {
+            return !std::is_same_v<Backend, PHMapConnection>;
+        }
+
+        bool syncWriteBatch(const std::function<bool(WriteBatch* batch)>& callback) override {
+            if constexpr (std::is_same_v<typename Backend::WriteBatch, WriteBatch>) {
+                return _backend->syncWriteBatch(callback);
+            } else {    // convert to the native batch
+                return _backend->syncWriteBatch([&](typename Backend::WriteBatch* nativeBatch) {
+                    WriteBatch batch;
+                    if (!callback(&batch)) {
+                        return false;
+                    }
+                    for (const auto& it: batch.writes) {
+                        nativeBatch->Put(it.first, it.second);
+                    }
+                    for (const auto& it: batch.deletes) {
+                        nativeBatch->Delete(it);
+                    }
+                    return true;
+                });
+            }
+        }
+
+        bool syncPut(std::string_view key, std::string_view value) override {
+            if constexpr (std::is_same_v<Backend, PHMapConnection>) {
+                return _backend->syncPut(std::string(key), std::string(value));
+            } else {
+                return _backend->syncPut(key, value);
+            }
+        }
+
+        bool asyncPut(std::string_view key, std::string_view value) override {
+            if constexpr (std::is_same_v<Backend, PHMapConnection>) {
+                return _backend->asyncPut(std::string(key), std::string(value));
+            } else {
+                return _backend->asyncPut(key, value);
+            }
+        }
+
+        bool syncDelete(std::string_view key) override {
+            if constexpr (std::is_same_v<Backend, PHMapConnection>) {
+                return _backend->syncDelete(std::string(key));
+            } else {
+                return _backend->syncDelete(key);
+            }
+        }
+
+        bool asyncDelete(std::string_view key) override {
+            if constexpr (std::is_same_v<Backend, PHMapConnection>) {
+                return _backend->asyncDelete(std::string(key));
+            } else {
+                return _backend->asyncDelete(key);
+            }
+        }
+
+        bool get(std::string_view key, std::string* value) const override { return _backend->get(key, value); }
+
+        void beginGroupCommit() override {
+            if constexpr (std::is_same_v<Backend, RocksdbConnection>) {
+                _backend->beginGroupCommit();
+            }
+        }
+
+        bool endGroupCommit() override {
+            if constexpr (std::is_same_v<Backend, RocksdbConnection>) {
+                return _backend->endGroupCommit();
+            }
+            return true;
+        }
+
+        [[nodiscard]] Backend* getBackend() const { return _backend.get(); }
+
+    private:
+        std::unique_ptr<Backend> _backend;
+    };
+
+    // The hot keys are read from the cache without any lock, the writes invalidate the cached keys,
+    // and the cache is refreshed with the committed values at each block boundary.
+    class CachedDBConnection : public DBConnection {
+    public:
+        CachedDBConnection(std::unique_ptr<DBConnection> backend, HotKeyCache::Config config)
+                : _backend(std::move(backend)), _cache(config) { }
+
+        [[nodiscard]] const std::string& getDBName() const override { return _backend->getDBName(); }
+
+        [[nodiscard]] bool isPersistent() const override { return _backend->isPersistent(); }
+
+        bool syncWriteBatch(const std::function<bool(WriteBatch* batch)>& callback) override {
+            return _backend->syncWriteBatch([&](WriteBatch* batch) {
+                if (!callback(batch)) {
+                    return false;
+                }
+                for (const auto& it: batch->writes) {
+                    _cache.invalidate(it.first);
+                }
+                for (const auto& it: batch->deletes) {
+                    _cache.invalidate(it);
+                }
+                return true;
+            });
+        }
+
+        bool syncPut(std::string_view key, std::string_view value) override {
+            _cache.invalidate(key);
+            return _backend->syncPut(key, value);
+        }
+
+        bool asyncPut(std::string_view key, std::string_view value) override {
+            _cache.invalidate(key);
+            return _backend->asyncPut(key, value);
+        }
+
+        bool syncDelete(std::string_view key) override {
+            _cache.invalidate(key);
+            return _backend->syncDelete(key);
+        }
+
+        bool asyncDelete(std::string_view key) override {
+            _cache.invalidate(key);
+            return _backend->asyncDelete(key);
+        }
+
+        bool get(std::string_view key, std::string* value) const override {
+            return _cache.get(key, value, [&](std::string* v) { return _backend->get(key, v); });
+        }
+
+        void beginGroupCommit() override { _backend->beginGroupCommit(); }
+
+        bool endGroupCommit() override { return _backend->endGroupCommit(); }
+
+        void onBlockCommitted() override {
+            _backend->onBlockCommitted();
+            _cache.refresh([&](std::string_view key, std::string* value) { return _backend->get(key, value); });
+            auto s = _cache.getStatistics();
+            LOG_IF(INFO, s.refreshCount % LOG_INTERVAL == 0) << "Hot key cache of " << getDBName()
+                    << ", size: " << s.size << ", hit rate: " << s.hitRate()
+                    << ", hit latency (ns): " << s.avgHitLatencyNs << ", miss latency (ns): " << s.avgMissLatencyNs
+                    << ", invalidated: " << s.invalidateCount;
+        }
+
+        [[nodiscard]] HotKeyCache::Statistics getCacheStatistics() const { return _cache.getStatistics(); }
+
+    protected:
+        // print the cache statistics every LOG_INTERVAL blocks
+        constexpr static uint64_t LOG_INTERVAL = 1000;
+
+    private:
+        std::unique_ptr<DBConnection> _backend;
+        // get is const for the callers, but it updates the counters and admission candidates
+        mutable HotKeyCache _cache;
+    };
+
+    inline std::unique_ptr<DBConnection> DBConnection::NewConnection(const std::string& dbName, const DBConfig& config) {
+        auto adapt = [&](auto backend) -> std::unique_ptr<DBConnection> {
+            if (backend == nullptr) {
+                return nullptr;
+            }
+            using Backend = typename decltype(backend)::element_type;
+            auto dbc = std::make_unique<DBConnectionAdapter<Backend>>(std::move(backend));
+            if (config.cacheCapacity == 0) {
+                return dbc;
+            }
+            HotKeyCache::Config cacheConfig;
+            cacheConfig.capacity = config.cacheCapacity;
+            cacheConfig.admitThreshold = config.cacheAdmitThreshold;
+            return std::make_unique<CachedDBConnection>(std::move(dbc), cacheConfig);
+        };
+        if (config.backend == "phmap") {
+            return adapt(PHMapConnection::NewConnection(dbName));
+        }
+        if (config.backend == "rocksdb") {
+            return adapt(RocksdbConnection::NewConnection(dbName, config.rocksdb));
+        }
+        if (config.backend == "leveldb") {
+            return adapt(LeveldbConnection::NewConnection(dbName));
+        }
+        LOG(ERROR) << "Unknown db backend: " << config.backend;
+        return nullptr;
+    }
 
     template<class T>
-    concept db_like = requires(T t,
+    concept db_like = requires(T& t,
             DBConnection::WriteBatch b,
             const std::function<bool(DBConnection::WriteBatch*)>& callback,
             std::string* getValue) {
@@ -24,6 +266,7 @@ namespace peer::db {
         t.get("key", getValue);
     };
     static_assert(db_like<DBConnection>);
-
-    inline bool IsDBHashMap() { return std::is_same<DBConnection, PHMapConnection>::value; }
-}
\ No newline at end of file
+    static_assert(db_like<PHMapConnection>);
+    static_assert(db_like<MVCCConnection>);
+    static_assert(db_like<RocksdbConnection>);
+}
@@ -0,0 +1,274 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "common/phmap.h"
+
+#include "glog/logging.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace peer::db {
+    // A read-through cache of the hottest keys, rebuilt at each block boundary.
+    // Between two refreshes the table is immutable, the workers read it without any lock,
+    // a write only clears the valid flag of the entry, the value is reloaded at the next refresh.
+    class HotKeyCache {
+    public:
+        struct Config {
+            // max number of cached keys
+            size_t capacity = 1024;
+            // a missed key is cached if it is missed at least admitThreshold times in a block
+            uint32_t admitThreshold = 2;
+        };
+
+        struct Statistics {
+            uint64_t hitCount = 0;
+            uint64_t missCount = 0;
+            uint64_t invalidateCount = 0;
+            uint64_t refreshCount = 0;
+            // the cached keys after the last refresh
+            uint64_t size = 0;
+            // sampled latency of get, including the backend read of a miss
+            double avgHitLatencyNs = 0;
+            double avgMissLatencyNs = 0;
+
+            [[nodiscard]] double hitRate() const {
+                return hitCount + missCount == 0 ? 0 : (double)hitCount / (double)(hitCount + missCount);
+            }
+        };
+
+        explicit HotKeyCache(Config config) : _config(config) {
+            CHECK(_config.capacity > 0);
+            _table = std::make_unique<Table>(0);
+        }
+
+        // Thread safe, return true and copy the value if the key is cached and valid.
+        // (bool found) load(std::string* value) is called for a miss.
+        template<class Func>
+        bool get(std::string_view key, std::string* value, Func&& load) {
+            auto& local = LocalState();
+            const bool sampled = (local.opCount++ % SAMPLE_INTERVAL) == 0;
+            std::chrono::steady_clock::time_point start;
+            if (sampled) {
+                start = std::chrono::steady_clock::now();
+            }
+            auto* slot = _table->find(key);
+            if (slot != nullptr && slot->valid.load(std::memory_order_acquire)) {
+                *value = slot->value;
+                if (sampled) {
+                    // the sampled hits are the popularity of the entry
+                    slot->sampledHits.fetch_add(1, std::memory_order_relaxed);
+                    addLatency(hitLatency, start);
+                }
+                stripe(hitCount).fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            auto found = load(value);
+            if (slot == nullptr) {
+                recordMiss(key);
+            }
+            if (sampled) {
+                addLatency(missLatency, start);
+            }
+            stripe(missCount).fetch_add(1, std::memory_order_relaxed);
+            return found;
+        }
+
+        // Thread safe, must be called before the key is written to the backend
+        void invalidate(std::string_view key) {
+            auto* slot = _table->find(key);
+            if (slot != nullptr && slot->valid.exchange(false, std::memory_order_acq_rel)) {
+                stripe(invalidateCount).fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // NOT thread safe, must be called when there is no in-flight read or write.
+        // Keep the most popular keys of the last block, (bool found) load(key, std::string* value)
+        // reads the committed value of an invalidated or newly admitted key.
+        template<class Func>
+        void refresh(Func&& load) {
+            struct Candidate {
+                uint64_t score;
+                std::string key;
+                std::string value;
+                bool loaded;
+            };
+            std::vector<Candidate> candidates;
+            _table->forEach([&](Slot& slot) {
+                auto valid = slot.valid.load(std::memory_order_relaxed);
+                candidates.push_back({slot.sampledHits.load(std::memory_order_relaxed) * SAMPLE_INTERVAL,
+                                      std::move(slot.key), valid ? std::move(slot.value) : std::string(), valid});
+            });
+            _missed.for_each_m([&](auto& it) {
+                if (it.second >= _config.admitThreshold) {
+                    candidates.push_back({it.second, it.first, {}, false});
+                }
+            });
+            _missed.clear();
+            std::stable_sort(candidates.begin(), candidates.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.score > rhs.score;
+            });
+            auto table = std::make_unique<Table>(std::min(candidates.size(), _config.capacity));
+            for (auto& it: candidates) {
+                if (table->size() == _config.capacity) {
+                    break;
+                }
+                if (!it.loaded && !load(it.key, &it.value)) {
+                    continue;   // deleted
+                }
+                table->insert(std::move(it.key), std::move(it.value));
+            }
+            _table = std::move(table);
+            _refreshCount++;
+        }
+
+        // Thread safe with get and invalidate, the counters are approximate if there are in-flight reads
+        [[nodiscard]] Statistics getStatistics() const {
+            Statistics s;
+            s.hitCount = sum(hitCount);
+            s.missCount = sum(missCount);
+            s.invalidateCount = sum(invalidateCount);
+            s.refreshCount = _refreshCount;
+            s.size = _table->size();
+            s.avgHitLatencyNs = hitLatency.average();
+            s.avgMissLatencyNs = missLatency.average();
+            return s;
+        }
+
+    protected:
+        constexpr static uint64_t SAMPLE_INTERVAL = 64;
+        constexpr static size_t STRIPE_COUNT = 16;
+
+        struct Slot {
+            uint64_t hash = 0;
+            bool used = false;
+            std::string key;
+            std::string value;
+            std::atomic<bool> valid = false;
+            std::atomic<uint64_t> sampledHits = 0;
+        };
+
+        // open addressing with linear probing, at most half full
+        class Table {
+        public:
+            explicit Table(size_t capacity) {
+                _mask = std::bit_ceil(std::max<size_t>(capacity * 2, 2)) - 1;
+                _slots = std::make_unique<Slot[]>(_mask + 1);
+            }
+
+            void insert(std::string key, std::string value) {
+                auto hash = std::hash<std::string_view>()(key);
+                for (auto i = hash & _mask; ; i = (i + 1) & _mask) {
+                    auto& slot = _slots[i];
+                    if (!slot.used) {
+                        slot.hash = hash;
+                        slot.used = true;
+                        slot.key = std::move(key);
+                        slot.value = std::move(value);
+                        slot.valid.store(true, std::memory_order_relaxed);
+                        _size++;
+                        return;
+                    }
+                }
+            }
+
+            Slot* find(std::string_view key) const {
+                auto hash = std::hash<std::string_view>()(key);
+                for (auto i = hash & _mask; ; i = (i + 1) & _mask) {
+                    auto& slot = _slots[i];
+                    if (!slot.used) {
+                        return nullptr;
+                    }
+                    if (slot.hash == hash && slot.key == key) {
+                        return &slot;
+                    }
+                }
+            }
+
+            void forEach(auto&& func) {
+                for (size_t i = 0; i <= _mask; i++) {
+                    if (_slots[i].used) {
+                        func(_slots[i]);
+                    }
+                }
+            }
+
+            [[nodiscard]] size_t size() const { return _size; }
+
+        private:
+            size_t _mask;
+            size_t _size = 0;
+            std::unique_ptr<Slot[]> _slots;
+        };
+
+        struct alignas(64) PaddedCounter {
+            std::atomic<uint64_t> value = 0;
+        };
+
+        using StripedCounter = std::array<PaddedCounter, STRIPE_COUNT>;
+
+        struct LatencyCounter {
+            StripedCounter totalNs;
+            StripedCounter count;
+
+            [[nodiscard]] double average() const {
+                auto c = sum(count);
+                return c == 0 ? 0 : (double)sum(totalNs) / (double)c;
+            }
+        };
+
+        struct ThreadState {
+            size_t stripeId;
+            uint64_t opCount = 0;
+        };
+
+        static ThreadState& LocalState() {
+            static std::atomic<size_t> nextStripeId = 0;
+            static thread_local ThreadState state{nextStripeId.fetch_add(1, std::memory_order_relaxed) % STRIPE_COUNT};
+            return state;
+        }
+
+        static std::atomic<uint64_t>& stripe(StripedCounter& counter) {
+            return counter[LocalState().stripeId].value;
+        }
+
+        static uint64_t sum(const StripedCounter& counter) {
+            uint64_t total = 0;
+            for (const auto& it: counter) {
+                total += it.value.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+        static void addLatency(LatencyCounter& counter, std::chrono::steady_clock::time_point start) {
+            auto span = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            stripe(counter.totalNs).fetch_add(span, std::memory_order_relaxed);
+            stripe(counter.count).fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void recordMiss(std::string_view key) {
+            _missed.try_emplace_l(std::string(key), [](auto& it) { it.second++; }, 1);
+        }
+
+    private:
+        const Config _config;
+        std::unique_ptr<Table> _table;
+        // the missed keys of the current block, the admission candidates
+        util::MyFlatHashMap<std::string, uint32_t, std::mutex, 6> _missed;
+        StripedCounter hitCount;
+        StripedCounter missCount;
+        StripedCounter invalidateCount;
+        LatencyCounter hitLatency;
+        LatencyCounter missLatency;
+        uint64_t _refreshCount = 0;
+    };
+}
@@ -0,0 +1,280 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "peer/db/write_batch.h"
+#include "common/phmap.h"
+
+#include "glog/logging.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+
+namespace peer::db {
+    // A multi-version in-memory store, each version is tagged with a block number.
+    // 1. Writes are tagged with the current write version (setWriteVersion), the writes of the
+    //    same version overwrite each other.
+    // 2. A snapshot of version v sees the latest writes whose version <= v, the value is returned
+    //    as a string_view without copying, and it is valid until the snapshot is destroyed.
+    // 3. garbageCollect removes the versions that are not visible to any active snapshot,
+    //    a snapshot older than the watermark of the last gc can not be taken anymore.
+    // If a snapshot may see the overwritten value of the same version, the value is kept until gc,
+    // the later reads of the snapshot see the new value.
+    // It is not registered as a DBConnection backend: no engine pins a snapshot or advances the
+    // write version yet, all of them read the latest writes of the block being executed.
+    class MVCCConnection {
+    public:
+        using WriteBatch = db::WriteBatch;
+
+        using version_type = uint64_t;
+
+        class Snapshot {
+        public:
+            ~Snapshot() { _db->releaseVersion(_version); }
+
+            Snapshot(const Snapshot&) = delete;
+
+            Snapshot(Snapshot&&) = delete;
+
+            [[nodiscard]] version_type getVersion() const { return _version; }
+
+            // Zero copy, the value is valid until the snapshot is destroyed
+            bool get(std::string_view key, std::string_view* value) const {
+                return _db->getVersion(key, _version, value);
+            }
+
+            bool get(std::string_view key, std::string* value) const {
+                std::string_view valueSV;
+                if (!_db->getVersion(key, _version, &valueSV)) {
+                    return false;
+                }
+                value->assign(valueSV);
+                return true;
+            }
+
+        protected:
+            friend class MVCCConnection;
+
+            Snapshot(const MVCCConnection* db, version_type version) : _db(db), _version(version) { }
+
+        private:
+            const MVCCConnection* _db;
+            const version_type _version;
+        };
+
+        static std::unique_ptr<MVCCConnection> NewConnection(const std::string& dbName) {
+            auto db = std::unique_ptr<MVCCConnection>(new MVCCConnection);
+            db->_dbName = dbName;
+            return db;
+        }
+
+        [[nodiscard]] const std::string& getDBName() const { return _dbName; }
+
+        // NOT thread safe with writes, the version must be monotonically increasing
+        void setWriteVersion(version_type version) {
+            DCHECK(version >= _writeVersion) << "the write version must not decrease";
+            _writeVersion = version;
+        }
+
+        [[nodiscard]] version_type getWriteVersion() const { return _writeVersion; }
+
+        // Pin the version, the snapshot must be destroyed before the db.
+        // Return nullptr if the version is older than the watermark of the last gc, it may be collected.
+        [[nodiscard]] std::unique_ptr<Snapshot> getSnapshot(version_type version) const {
+            std::unique_lock lock(_snapshotMutex);
+            if (version < _gcWatermark) {
+                LOG(WARNING) << "The snapshot version is collected: " << version << ", watermark: " << _gcWatermark;
+                return nullptr;
+            }
+            _activeVersions.insert(version);
+            _maxActiveVersion.store((int64_t)*_activeVersions.rbegin(), std::memory_order_release);
+            return std::unique_ptr<Snapshot>(new Snapshot(this, version));
+        }
+
+        bool syncWriteBatch(const std::function<bool(WriteBatch* batch)>& callback) {
+            WriteBatch batch;
+            if (!callback(&batch)) {
+                return false;
+            }
+            for (auto& it: batch.writes) {
+                putVersion(it.first, std::make_unique<std::string>(std::move(it.second)), _writeVersion);
+            }
+            for (auto& it: batch.deletes) {
+                putVersion(it, nullptr, _writeVersion);
+            }
+            return true;
+        }
+
+        bool syncPut(std::string_view key, std::string_view value) {
+            putVersion(key, std::make_unique<std::string>(value), _writeVersion);
+            return true;
+        }
+
+        inline bool asyncPut(std::string_view key, std::string_view value) {
+            return syncPut(key, value);
+        }
+
+        // Read the latest version, the value is copied
+        bool get(std::string_view key, std::string* value) const {
+            bool found = false;
+            _table.if_contains(key, [&](const TableType::value_type& v) {
+                const auto& latest = v.second.back();
+                if (latest.value != nullptr) {
+                    *value = *latest.value;
+                    found = true;
+                }
+            });
+            return found;
+        }
+
+        // It is not an error if "key" did not exist in the database.
+        bool syncDelete(std::string_view key) {
+            putVersion(key, nullptr, _writeVersion);
+            return true;
+        }
+
+        inline bool asyncDelete(std::string_view key) {
+            return syncDelete(key);
+        }
+
+        // Remove the versions older than the oldest active snapshot, return the number of removed versions.
+        // Can be called concurrently with reads and writes.
+        size_t garbageCollect() {
+            std::unique_lock lock(_gcMutex);
+            auto watermark = advanceWatermark();
+            size_t removed = 0;
+            std::vector<std::string> emptyKeys;
+            // the table is locked per shard during the traversal
+            _table.for_each_m([&](TableType::value_type& v) {
+                auto& versions = v.second;
+                // keep the newest version <= watermark (with its overwritten values) and all newer versions
+                auto it = std::upper_bound(versions.begin(), versions.end(), watermark, [](version_type lhs, const Version& rhs) {
+                    return lhs < rhs.version;
+                });
+                if (it != versions.begin()) {
+                    it = std::lower_bound(versions.begin(), it, (it - 1)->version, [](const Version& lhs, version_type rhs) {
+                        return lhs.version < rhs;
+                    });
+                    removed += it - versions.begin();
+                    versions.erase(versions.begin(), it);
+                }
+                if (versions.size() == 1 && versions.front().value == nullptr && versions.front().version <= watermark) {
+                    emptyKeys.push_back(v.first);
+                }
+            });
+            for (const auto& key: emptyKeys) {
+                // the key may be updated after the traversal
+                removed += _table.erase_if(key, [&](TableType::value_type& v) {
+                    auto& versions = v.second;
+                    return versions.size() == 1 && versions.front().value == nullptr && versions.front().version <= watermark;
+                });
+            }
+            return removed;
+        }
+
+    protected:
+        MVCCConnection() = default;
+
+        struct Version {
+            version_type version;
+            // nullptr for deleted, the string is never moved until it is removed
+            std::unique_ptr<std::string> value;
+        };
+
+        // ordered by version, never empty,
+        // a version has more than one entry if it is overwritten while a snapshot may see it (the last one wins)
+        using VersionList = std::vector<Version>;
+
+        // 2^6 shards, each one is guarded by a mutex
+        using TableType = util::MyFlatHashMap<std::string, VersionList, std::mutex, 6>;
+
+        void putVersion(std::string_view key, std::unique_ptr<std::string> value, version_type version) {
+            auto exist = [&](TableType::value_type& v) {
+                auto& versions = v.second;
+                // a snapshot that reads the key is taken before the shard is locked, so it is observed
+                const auto visible = (int64_t)version <= _maxActiveVersion.load(std::memory_order_acquire);
+                if (versions.back().version == version && !visible) {   // overwrite the same version
+                    versions.back().value = std::move(value);
+                    return;
+                }
+                if (versions.back().version <= version) {
+                    versions.push_back({version, std::move(value)});
+                    return;
+                }
+                // should not happen, keep the list ordered anyway
+                LOG(WARNING) << "Write to an old version: " << version;
+                auto it = std::upper_bound(versions.begin(), versions.end(), version, [](version_type lhs, const Version& rhs) {
+                    return lhs < rhs.version;
+                });
+                versions.insert(it, {version, std::move(value)});
+            };
+            if (_table.modify_if(key, exist)) {
+                return;
+            }
+            VersionList versions;
+            versions.push_back({version, std::move(value)});
+            // insert the new key, or update it if it is inserted concurrently (versions is not consumed)
+            _table.try_emplace_l(std::string(key), [&](TableType::value_type& v) {
+                value = std::move(versions.front().value);
+                exist(v);
+            }, std::move(versions));
+        }
+
+        bool getVersion(std::string_view key, version_type version, std::string_view* value) const {
+            bool found = false;
+            _table.if_contains(key, [&](const TableType::value_type& v) {
+                const auto& versions = v.second;
+                // the newest version <= version
+                auto it = std::upper_bound(versions.begin(), versions.end(), version, [](version_type lhs, const Version& rhs) {
+                    return lhs < rhs.version;
+                });
+                if (it == versions.begin()) {
+                    return;     // created after the snapshot
+                }
+                --it;
+                if (it->value != nullptr) {
+                    *value = *it->value;
+                    found = true;
+                }
+            });
+            return found;
+        }
+
+        void releaseVersion(version_type version) const {
+            std::unique_lock lock(_snapshotMutex);
+            auto it = _activeVersions.find(version);
+            DCHECK(it != _activeVersions.end());
+            _activeVersions.erase(it);
+            _maxActiveVersion.store(_activeVersions.empty() ? -1 : (int64_t)*_activeVersions.rbegin(), std::memory_order_release);
+        }
+
+        // the oldest version that may be read, the snapshots older than it are rejected from now on
+        version_type advanceWatermark() {
+            std::unique_lock lock(_snapshotMutex);
+            auto watermark = _writeVersion.load();
+            if (!_activeVersions.empty()) {
+                watermark = std::min(*_activeVersions.begin(), watermark);
+            }
+            _gcWatermark = std::max(_gcWatermark, watermark);
+            return _gcWatermark;
+        }
+
+    private:
+        std::string _dbName;
+        std::atomic<version_type> _writeVersion = 0;
+        TableType _table;
+        // serialize the gc
+        std::mutex _gcMutex;
+        mutable std::mutex _snapshotMutex;
+        mutable std::multiset<version_type> _activeVersions;
+        // the max version of the active snapshots, -1 if there is none, updated with _activeVersions
+        mutable std::atomic<int64_t> _maxActiveVersion = -1;
+        // the watermark of the last gc, guarded by _snapshotMutex
+        version_type _gcWatermark = 0;
+    };
+}
@@ -4,23 +4,13 @@
 
 #pragma once
 
+#include "peer/db/write_batch.h"
 #include "common/phmap.h"
 
 namespace peer::db {
     class PHMapConnection {
     public:
-        struct WriteBatch {
-            void Put(std::string key, std::string value) {
-                writes.emplace_back(std::move(key), std::move(value));
-            }
-
-            void Delete(std::string key) {
-                deletes.push_back(std::move(key));
-            }
-
-            std::vector<std::pair<std::string, std::string>> writes;
-            std::vector<std::string> deletes;
-        };
+        using WriteBatch = db::WriteBatch;
 
         static std::unique_ptr<PHMapConnection> NewConnection(const std::string& dbName) {
             auto db = std::unique_ptr<PHMapConnection>(new PHMapConnection);
@@ -4,93 +4,243 @@
 
 #pragma once
 
+#include "peer/db/write_batch.h"
+
 #include "rocksdb/db.h"
+#include "rocksdb/cache.h"
+#include "rocksdb/filter_policy.h"
+#include "rocksdb/table.h"
+#include "rocksdb/write_batch.h"
 
 #include "glog/logging.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 
 namespace peer::db {
+    struct RocksdbConfig {
+        // When the write-ahead log is fsync-ed
+        enum class WALSync {
+            ALWAYS = 0,     // every sync write, the writes in a group are NOT merged
+            GROUP = 1,      // once per group commit (and every sync write out of a group)
+            NONE = 2,       // never, leave it to the os
+        };
+
+        static WALSync ParseWALSync(std::string_view name) {
+            if (name == "always") {
+                return WALSync::ALWAYS;
+            }
+            if (name == "none") {
+                return WALSync::NONE;
+            }
+            LOG_IF(WARNING, name != "group") << "Unknown wal sync policy: " << name << ", fallback to group.";
+            return WALSync::GROUP;
+        }
+
+        // the lru block cache shared by all column families
+        size_t blockCacheMB = 256;
+        // 0 to disable the bloom filter
+        int bloomBitsPerKey = 10;
+        // column family name -> key prefixes (e.g. the table prefixes of a chaincode),
+        // a key is routed by its longest matching prefix, the rest go to the default column family
+        std::map<std::string, std::vector<std::string>> columnFamilies;
+        WALSync walSync = WALSync::GROUP;
+    };
+
     class RocksdbConnection {
     public:
-        using WriteBatch = rocksdb::WriteBatch;
+        using WriteBatch = db::WriteBatch;
 
         RocksdbConnection(const RocksdbConnection&) = delete;
 
         RocksdbConnection(RocksdbConnection&&) = delete;
 
-        virtual ~RocksdbConnection() = default;
+        virtual ~RocksdbConnection() {
+            if (db == nullptr) {
+                return;
+            }
+            for (auto* handle: handles) {
+                db->DestroyColumnFamilyHandle(handle);
+            }
+            auto status = db->Close();
+            LOG_IF(WARNING, !status.ok()) << "Close database failed: " << status.ToString();
+        }
 
         // create a new db connection
-        static std::unique_ptr<RocksdbConnection> NewConnection(const std::string& dbName) {
+        static std::unique_ptr<RocksdbConnection> NewConnection(const std::string& dbName, const RocksdbConfig& config = {}) {
             rocksdb::Options options;
             options.create_if_missing = true;
+            options.create_missing_column_families = true;
+            options.IncreaseParallelism((int)std::max(std::thread::hardware_concurrency(), 2u));
+            // the wal and the memtable are written by different threads
+            options.enable_pipelined_write = true;
+            rocksdb::BlockBasedTableOptions tableOptions;
+            tableOptions.block_cache = rocksdb::NewLRUCache(config.blockCacheMB << 20);
+            if (config.bloomBitsPerKey > 0) {
+                tableOptions.filter_policy.reset(rocksdb::NewBloomFilterPolicy(config.bloomBitsPerKey, false));
+            }
+            options.table_factory.reset(rocksdb::NewBlockBasedTableFactory(tableOptions));
+            // all existing column families must be opened
+            std::set<std::string> cfNames{rocksdb::kDefaultColumnFamilyName};
+            std::vector<std::string> existCFNames;
+            if (rocksdb::DB::ListColumnFamilies(options, dbName, &existCFNames).ok()) {
+                cfNames.insert(existCFNames.begin(), existCFNames.end());
+            }
+            for (const auto& it: config.columnFamilies) {
+                cfNames.insert(it.first);
+            }
+            std::vector<rocksdb::ColumnFamilyDescriptor> descriptors;
+            for (const auto& it: cfNames) {
+                descriptors.emplace_back(it, rocksdb::ColumnFamilyOptions(options));
+            }
+            std::unique_ptr<RocksdbConnection> dbc(new RocksdbConnection(config.walSync));
             rocksdb::DB* db;
-            rocksdb::Status status = rocksdb::DB::Open(options, dbName, &db);
+            rocksdb::Status status = rocksdb::DB::Open(rocksdb::DBOptions(options), dbName, descriptors, &dbc->handles, &db);
             if (!status.ok()) {
-                LOG(WARNING) << "Can not open database: " << dbName;
+                LOG(WARNING) << "Can not open database: " << dbName << ", " << status.ToString();
                 return nullptr;
             }
-            std::unique_ptr<RocksdbConnection> dbc(new RocksdbConnection());
             dbc->dbName = dbName;
             dbc->db.reset(db);
+            for (auto* handle: dbc->handles) {
+                if (handle->GetName() == rocksdb::kDefaultColumnFamilyName) {
+                    dbc->defaultHandle = handle;
+                    continue;
+                }
+                auto it = config.columnFamilies.find(handle->GetName());
+                if (it == config.columnFamilies.end()) {
+                    continue;   // created by an old config, it is not routed
+                }
+                for (const auto& prefix: it->second) {
+                    dbc->routes.emplace_back(prefix, handle);
+                }
+            }
+            CHECK(dbc->defaultHandle != nullptr);
+            std::sort(dbc->routes.begin(), dbc->routes.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.first.size() > rhs.first.size();
+            });
             return dbc;
         }
 
         [[nodiscard]] const std::string& getDBName() const { return dbName; }
 
         bool asyncPut(std::string_view key, std::string_view value) {
-            auto status = db->Put(asyncWrite,
-                                  rocksdb::Slice{key.data(), key.size()},
-                                  rocksdb::Slice{value.data(), value.size()});
+            auto status = db->Put(asyncWrite, route(key), toSlice(key), toSlice(value));
             return status.ok();
         }
 
         bool syncPut(std::string_view key, std::string_view value) {
-            auto status = db->Put(syncWrite,
-                                  rocksdb::Slice{key.data(), key.size()},
-                                  rocksdb::Slice{value.data(), value.size()});
+            auto status = db->Put(syncWrite, route(key), toSlice(key), toSlice(value));
             return status.ok();
         }
 
         // It is not an error if "key" did not exist in the database.
         bool asyncDelete(std::string_view key) {
-            auto status = db->Delete(asyncWrite, rocksdb::Slice{key.data(), key.size()});
+            auto status = db->Delete(asyncWrite, route(key), toSlice(key));
             return status.ok();
         }
 
         // It is not an error if "key" did not exist in the database.
         bool syncDelete(std::string_view key) {
-            auto status = db->Delete(syncWrite, rocksdb::Slice{key.data(), key.size()});
+            auto status = db->Delete(syncWrite, route(key), toSlice(key));
             return status.ok();
         }
 
         // batch.Put(key, value);
         // batch.Delete(key);
-        bool syncWriteBatch(const std::function<bool(rocksdb::WriteBatch* batch)>& callback) {
-            rocksdb::WriteBatch batch;
+        // Thread safe, the batch is merged into the group if a group commit is in progress.
+        bool syncWriteBatch(const std::function<bool(WriteBatch* batch)>& callback) {
+            WriteBatch batch;
             if (!callback(&batch)) {
                 return false;
             }
-            auto status = db->Write(syncWrite, &batch);
+            if (grouping.load(std::memory_order_acquire)) {
+                std::unique_lock lock(groupMutex);
+                appendTo(&groupBatch, batch);
+                return true;
+            }
+            rocksdb::WriteBatch rocksBatch;
+            appendTo(&rocksBatch, batch);
+            auto status = db->Write(syncWrite, &rocksBatch);
+            return status.ok();
+        }
+
+        // NOT thread safe with syncWriteBatch, the batches in a group must not overlap
+        // (which is guaranteed by the cc), since the order of them is undefined.
+        void beginGroupCommit() {
+            if (walSync == RocksdbConfig::WALSync::ALWAYS) {
+                return;
+            }
+            grouping.store(true, std::memory_order_release);
+        }
+
+        // Write the merged batch with a single (synced) write
+        bool endGroupCommit() {
+            if (!grouping.load(std::memory_order_acquire)) {
+                return true;
+            }
+            grouping.store(false, std::memory_order_release);
+            std::unique_lock lock(groupMutex);
+            if (groupBatch.Count() == 0) {
+                return true;
+            }
+            auto status = db->Write(syncWrite, &groupBatch);
+            groupBatch.Clear();
+            LOG_IF(ERROR, !status.ok()) << "Group commit failed: " << status.ToString();
             return status.ok();
         }
 
         bool get(std::string_view key, std::string* value) const {
-            rocksdb::Status status = db->Get(rocksdb::ReadOptions(), rocksdb::Slice{key.data(), key.size()}, value);
+            rocksdb::Status status = db->Get(rocksdb::ReadOptions(), route(key), toSlice(key), value);
             return status.ok();
         }
 
     protected:
-        RocksdbConnection() {
-            syncWrite.sync = true;
-            asyncWrite.sync= false;
+        explicit RocksdbConnection(RocksdbConfig::WALSync walSync_) : walSync(walSync_) {
+            syncWrite.sync = walSync != RocksdbConfig::WALSync::NONE;
+            asyncWrite.sync = false;
+        }
+
+        static inline rocksdb::Slice toSlice(std::string_view sv) { return {sv.data(), sv.size()}; }
+
+        [[nodiscard]] rocksdb::ColumnFamilyHandle* route(std::string_view key) const {
+            for (const auto& it: routes) {
+                if (key.starts_with(it.first)) {
+                    return it.second;
+                }
+            }
+            return defaultHandle;
+        }
+
+        void appendTo(rocksdb::WriteBatch* rocksBatch, const WriteBatch& batch) const {
+            for (const auto& it: batch.writes) {
+                rocksBatch->Put(route(it.first), it.first, it.second);
+            }
+            for (const auto& it: batch.deletes) {
+                rocksBatch->Delete(route(it), it);
+            }
         }
 
     private:
+        const RocksdbConfig::WALSync walSync;
         rocksdb::WriteOptions syncWrite;
         rocksdb::WriteOptions asyncWrite;
         std::string dbName;
         std::unique_ptr<rocksdb::DB> db;
+        // owned, destroyed before the db is closed
+        std::vector<rocksdb::ColumnFamilyHandle*> handles;
+        rocksdb::ColumnFamilyHandle* defaultHandle = nullptr;
+        // ordered by the length of the prefix (desc)
+        std::vector<std::pair<std::string, rocksdb::ColumnFamilyHandle*>> routes;
+        // group commit
+        std::atomic<bool> grouping = false;
+        std::mutex groupMutex;
+        rocksdb::WriteBatch groupBatch;
     };
 
-}
\ No newline at end of file
+}
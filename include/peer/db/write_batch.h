@@ -0,0 +1,24 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace peer::db {
+    // The backend independent write batch, the writes are applied before the deletes
+    struct WriteBatch {
+        void Put(std::string key, std::string value) {
+            writes.emplace_back(std::move(key), std::move(value));
+        }
+
+        void Delete(std::string key) {
+            deletes.push_back(std::move(key));
+        }
+
+        std::vector<std::pair<std::string, std::string>> writes;
+        std::vector<std::string> deletes;
+    };
+}
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "common/erasure_code.h"
+#include "common/reed_solomon_erasure_code.h"
 #include "common/parallel_merkle_tree.h"
 #include "common/thread_pool_light.h"
 #include "common/matrix_2d.h"
@@ -130,9 +131,12 @@ namespace peer {
         // wpForMTAndEC_ is used to:
         // 1. generate merkle tree parallel in serialize phase.
         // 2. encode and decode parallel in both phase.
+        // The erasure code is selected with the last param, e.g. std::type_identity<util::ReedSolomonErasureCode>(),
+        // if it supports a DecodeMatrixCache, the cache is shared by all instances with the same shard count.
         template<class ErasureCodeType=util::GoErasureCode>
         requires std::is_base_of<util::ErasureCode, ErasureCodeType>::value
-        BlockFragmentGenerator(const std::vector<Config>& cfgList, util::thread_pool_light* wpForMTAndEC_)
+        BlockFragmentGenerator(const std::vector<Config>& cfgList, util::thread_pool_light* wpForMTAndEC_,
+                               std::type_identity<ErasureCodeType> = {})
                 : wpForMTAndEC(wpForMTAndEC_) {
             CHECK(wpForMTAndEC != nullptr) << "Thread pool unset, can not start bfg";
             int max_x = 0, max_y = 0;
@@ -147,6 +151,7 @@ namespace peer {
             }
             ecMap.reset(max_x + 1, max_y + 1);
             semaMap.reset(max_x + 1, max_y + 1);
+            decodeMatrixCacheMap.reset(max_x + 1, max_y + 1);
 
             for (const auto& cfg: cfgList) {
                 auto x = cfg.dataShardCnt;
@@ -168,7 +173,15 @@ namespace peer {
                     queue = std::make_unique<ECListType>(totalInstanceCount);
                 }
                 for (int i=0; i<totalInstanceCount; i++) {
-                    queue->push(std::make_unique<ErasureCodeType>(cfg.dataShardCnt, cfg.parityShardCnt));
+                    if constexpr (std::is_constructible_v<ErasureCodeType, int, int, std::shared_ptr<util::DecodeMatrixCache>>) {
+                        auto& cache = decodeMatrixCacheMap(x, y);
+                        if (cache == nullptr) {
+                            cache = std::make_shared<util::DecodeMatrixCache>();
+                        }
+                        queue->push(std::make_unique<ErasureCodeType>(cfg.dataShardCnt, cfg.parityShardCnt, cache));
+                    } else {
+                        queue->push(std::make_unique<ErasureCodeType>(cfg.dataShardCnt, cfg.parityShardCnt));
+                    }
                 }
                 ecMap(x, y) = std::move(queue);
                 auto& sema = semaMap(x, y);
@@ -184,6 +197,19 @@ namespace peer {
         // Or there may be a deadlock!
         [[nodiscard]] std::shared_ptr<Context> getEmptyContext(const Config& cfg);
 
+        // The decode matrix cache statistics of the contexts with the same shard count as cfg,
+        // return nullopt if the erasure code does not use a cache.
+        [[nodiscard]] std::optional<util::DecodeMatrixCache::Statistics> getDecodeMatrixCacheStatistics(const Config& cfg) const {
+            if (cfg.dataShardCnt >= decodeMatrixCacheMap.x() || cfg.parityShardCnt >= decodeMatrixCacheMap.y()) {
+                return std::nullopt;
+            }
+            const auto& cache = decodeMatrixCacheMap(cfg.dataShardCnt, cfg.parityShardCnt);
+            if (cache == nullptr) {
+                return std::nullopt;
+            }
+            return cache->getStatistics();
+        }
+
     protected:
         bool freeContext(std::unique_ptr<Context> context);
 
@@ -191,6 +217,7 @@ namespace peer {
         using ECListType = rigtorp::MPMCQueue<std::unique_ptr<util::ErasureCode>>;
         util::Matrix2D<std::unique_ptr<ECListType>> ecMap;
         util::Matrix2D<moodycamel::LightweightSemaphore> semaMap;
+        util::Matrix2D<std::shared_ptr<util::DecodeMatrixCache>> decodeMatrixCacheMap;
         util::thread_pool_light* wpForMTAndEC;
     };
 }
\ No newline at end of file
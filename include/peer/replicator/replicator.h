@@ -7,6 +7,7 @@
 #include "peer/replicator/v2/block_sender.h"
 #include "peer/replicator/v2/mr_block_receiver.h"
 #include "common/zmq_port_util.h"
+#include "common/reed_solomon_erasure_code.h"
 
 namespace peer {
     // Replicator has fragment sending and receiving instances,
@@ -46,6 +47,15 @@ namespace peer {
             _blockSenderThreadPool = std::move(threadPool);
         }
 
+        // optional, the receiver reassembles reassemblyWindow consecutive blocks of a region concurrently
+        void setReassemblyConfig(int ringBufferCapacity, int reassemblyWindow) {
+            _ringBufferCapacity = ringBufferCapacity;
+            _reassemblyWindow = reassemblyWindow;
+        }
+
+        // optional, use util::ReedSolomonErasureCode (default) or util::GoErasureCode for the fragments
+        void setNativeErasureCode(bool nativeErasureCode) { _nativeErasureCode = nativeErasureCode; }
+
         // _zmqPortsConfig = util::ZMQPortUtil::InitPortsConfig(portOffset, regionNodesCount, samePort);
         void setPortUtilMap(std::shared_ptr<std::unordered_map<int, util::ZMQPortUtilList>> zmqPortsConfig) {
             _zmqPortsConfig = std::move(zmqPortsConfig);
@@ -149,11 +159,16 @@ namespace peer {
                     _localNodeConfig,
                     frServerPorts,   // we do not use this one yet, anything is ok
                     rfrServerPorts,   // these port are used to receive from crossRegionSender (as server)
-                    localBroadcastConfigs); // the ports are used to receive from mockLocalSender (as client)
+                    localBroadcastConfigs, // the ports are used to receive from mockLocalSender (as client)
+                    _ringBufferCapacity);
             if (receiver == nullptr) {
                 LOG(ERROR) << "create receiver failed";
                 return false;
             }
+            if (!receiver->setReassemblyWindow(_reassemblyWindow)) {
+                LOG(ERROR) << "set reassembly window failed";
+                return false;
+            }
             receiver->setBCCSPWithThreadPool(_bccsp, _bfgAndBCCSPThreadPool);
             receiver->setStorage(_localStorage);
             receiver->setBFGWithConfig(_bfg, _localFragmentCfg.first);
@@ -173,7 +188,8 @@ namespace peer {
 
             std::vector<peer::BlockFragmentGenerator::Config> bfgConfigList;
             for (auto& it: _localFragmentCfg.first) { // for receivers
-                it.second.concurrency = regionNodesCount[it.first];
+                // each block in the reassembly window holds its own contexts
+                it.second.concurrency = regionNodesCount[it.first] * _reassemblyWindow;
                 bfgConfigList.push_back(it.second);
             }
 
@@ -181,7 +197,12 @@ namespace peer {
                 LOG(ERROR) << "bccsp thread pool is not set";
                 return false;
             }
-            _bfg = std::make_shared<peer::BlockFragmentGenerator>(bfgConfigList, _bfgAndBCCSPThreadPool.get());
+            if (_nativeErasureCode) {
+                _bfg = std::make_shared<peer::BlockFragmentGenerator>(bfgConfigList, _bfgAndBCCSPThreadPool.get(),
+                                                                      std::type_identity<util::ReedSolomonErasureCode>());
+            } else {
+                _bfg = std::make_shared<peer::BlockFragmentGenerator>(bfgConfigList, _bfgAndBCCSPThreadPool.get());
+            }
             return true;
         }
 
@@ -215,5 +236,8 @@ namespace peer {
         std::shared_ptr<util::thread_pool_light> _blockSenderThreadPool;
         // block receiver
         std::unique_ptr<v2::MRBlockReceiver> _receiver;
+        int _ringBufferCapacity = v2::BlockReceiver::DEFAULT_RING_BUFFER_CAPACITY;
+        int _reassemblyWindow = 1;
+        bool _nativeErasureCode = true;
     };
 }
\ No newline at end of file
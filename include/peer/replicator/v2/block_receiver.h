@@ -10,7 +10,9 @@
 #include "common/concurrent_queue.h"
 #include "proto/fragment.h"
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <utility>
 
@@ -107,9 +109,14 @@ namespace peer::v2 {
     protected:
         constexpr static const auto DEQUEUE_TIMEOUT_US = 1000*100;     // 100 ms
 
-        template<class T, int cap, int mask=cap-1>
+        template<class T>
         class Buffer {
         public:
+            // cap must be a power of 2
+            explicit Buffer(int cap_) : cap(cap_), mask(cap_-1), data(std::make_unique<moodycamel::BlockingConcurrentQueue<T>[]>(cap_)) {
+                CHECK(cap_ > 0 && (cap_ & (cap_-1)) == 0) << "Ring buffer capacity must be a power of 2!";
+            }
+
             // call by producer
             bool push(proto::BlockNumber blockNumber, T&& element) {
                 if (blockNumber >= low+cap) {
@@ -144,13 +151,20 @@ namespace peer::v2 {
             // call by consumer
             [[nodiscard]] proto::BlockNumber nextBlock() const { return low; }
 
+            [[nodiscard]] int capacity() const { return (int)cap; }
+
         private:
             // actual block number, the lowest data that are valid
             volatile proto::BlockNumber low = 0;
-            std::array<moodycamel::BlockingConcurrentQueue<T>, cap> data;
+            const proto::BlockNumber cap;
+            const proto::BlockNumber mask;
+            std::unique_ptr<moodycamel::BlockingConcurrentQueue<T>[]> data;
         };
 
     public:
+        // the fragments of at most DEFAULT_RING_BUFFER_CAPACITY blocks are cached
+        constexpr static const auto DEFAULT_RING_BUFFER_CAPACITY = 256;
+
         using ConfigPtr = std::shared_ptr<util::ZMQInstanceConfig>;
 
         struct BufferBlock {
@@ -165,7 +179,10 @@ namespace peer::v2 {
             _tearDownSignal = true;
             _remoteFragmentReceiver.reset();
             _localFragmentReceiverList.clear();
-            if (_thread) { _thread->join(); }
+            _turnCv.notify_all();
+            for (auto& it: _workerList) {
+                it.join();
+            }
         }
 
         // Each BlockReceiver instance listening on different rfrConfig and frConfig port
@@ -178,10 +195,16 @@ namespace peer::v2 {
                 const std::vector<ConfigPtr>& lfrConfigList,
                 // one FragmentRepeater (as local region server, broadcast remote fragments)
                 int frPort,
-                int localId) {
+                int localId,
+                // the max number of blocks whose fragments are cached, must be a power of 2
+                int ringBufferCapacity = DEFAULT_RING_BUFFER_CAPACITY) {
             if (lfrConfigList.empty() || std::min(rfrPort, frPort) <= 0 || rfrPort == frPort) {
                 return nullptr;
             }
+            if (ringBufferCapacity <= 0 || (ringBufferCapacity & (ringBufferCapacity - 1)) != 0) {
+                LOG(ERROR) << "Ring buffer capacity must be a power of 2, got: " << ringBufferCapacity;
+                return nullptr;
+            }
             // ensure the nodes are from the same group
             auto& n0 = lfrConfigList[0];
             for (int i=1; i<(int)lfrConfigList.size(); i++) {
@@ -198,7 +221,7 @@ namespace peer::v2 {
                     return nullptr;
                 }
             }
-            std::unique_ptr<BlockReceiver> blockReceiver(new BlockReceiver());
+            std::unique_ptr<BlockReceiver> blockReceiver(new BlockReceiver(ringBufferCapacity));
             // set up _localFragmentReceiverList
             for (const auto& it: lfrConfigList) {
                 if (it->nodeConfig->nodeId == localId) {
@@ -225,8 +248,9 @@ namespace peer::v2 {
             auto rfr = std::make_unique<RemoteFragmentReceiver>();
             rfr->setOnReceived([cfg = std::move(localNodeConfig), ptr = blockReceiver.get()](auto n, auto b) {
                 // repeat the block
-                // TODO: OMIT ADDITIONAL COPY
-                ptr->_fragmentRepeater->send(b->data.to_string());
+                if (!RelayFragment(*ptr->_fragmentRepeater, b->data)) {
+                    LOG(WARNING) << "Failed to repeat the fragment of block: " << n;
+                }
                 // add to ring buffer
                 // DLOG(INFO) << "Receive a block from remote broadcast, block number: " << n;
                 if (!ptr->_ringBuf.push(n, {std::move(b), cfg})) {
@@ -251,6 +275,14 @@ namespace peer::v2 {
             return blockReceiver;
         }
 
+        // Broadcast a remote fragment in the local region without copying it,
+        // zmq_msg_copy shares the refcounted buffer, which is still owned by the ring buffer.
+        static bool RelayFragment(FragmentRepeater& repeater, zmq::message_t& data) {
+            zmq::message_t relay;
+            relay.copy(data);
+            return repeater.send(std::move(relay));
+        }
+
         // call by mr_block_receiver
         void setBFG(std::shared_ptr<peer::BlockFragmentGenerator> bfg) { _bfg = std::move(bfg); }
 
@@ -258,6 +290,19 @@ namespace peer::v2 {
 
         void setValidateFunc(ValidateFunc func) { _validateCallback = std::move(func); }
 
+        // The number of consecutive blocks that are reassembled concurrently in the active mode,
+        // the caller must ensure the bfg config has enough concurrency. Call before activeStart.
+        bool setReassemblyWindow(int window) {
+            if (window < 1 || window > _ringBuf.capacity() || !_workerList.empty()) {
+                LOG(ERROR) << "Invalid reassembly window: " << window;
+                return false;
+            }
+            _reassemblyWindow = window;
+            return true;
+        }
+
+        [[nodiscard]] int getReassemblyWindow() const { return _reassemblyWindow; }
+
         // passive object version
         bool passiveStart(proto::BlockNumber startAt) {
             if (!_fragmentRepeater || !_remoteFragmentReceiver || !_bfg) {
@@ -272,7 +317,9 @@ namespace peer::v2 {
             if (!passiveStart(startAt)) {
                 return false;
             }
-            _thread = std::make_unique<std::thread>(run, this);
+            for (int i = 0; i < _reassemblyWindow; i++) {
+                _workerList.emplace_back(run, this, startAt + i);
+            }
             return true;
         }
 
@@ -296,28 +343,49 @@ namespace peer::v2 {
         }
 
     protected:
-        BlockReceiver() = default;
+        explicit BlockReceiver(int ringBufferCapacity) : _ringBuf(ringBufferCapacity) { }
 
-        static void* run(void* ptr) {
+        // Each worker reassembles block startAt, startAt+window, startAt+2*window, ...
+        // the fragments of the blocks in the window are validated and decoded concurrently,
+        // the blocks are validated by _validateCallback and delivered in order.
+        static void run(BlockReceiver* receiver, proto::BlockNumber startAt) {
             pthread_setname_np(pthread_self(), "blk_receiver");
-            auto* receiver = static_cast<BlockReceiver*>(ptr);
             auto& buf =  receiver->_ringBuf;
-            auto nextBlockNumber = buf.nextBlock();
+            auto nextBlockNumber = startAt;
             LOG(INFO) << "SingleRegionBlockReceiver active get start from block: " << nextBlockNumber;
             while(!receiver->_tearDownSignal) {
-                auto ret = receiver->passiveGet(nextBlockNumber);
+                auto ret = receiver->genBlockFromQueue<true>(nextBlockNumber);
                 if (ret == nullptr) {
                     continue;
                 }
+                // it is the turn of nextBlockNumber until the ring buffer moves forward
                 if (!receiver->_activeBlockResultQueue.enqueue(std::move(ret))) {
                     CHECK(false) << "Queue max size achieve!";
                 }
-                nextBlockNumber++;
+                {
+                    std::unique_lock lock(receiver->_turnMutex);
+                    buf.clearBelow(nextBlockNumber+1);
+                }
+                receiver->_turnCv.notify_all();
+                nextBlockNumber += receiver->_reassemblyWindow;
             }
-            return nullptr;
         }
 
-        // access by only a consumer
+        // wait until all blocks before number are delivered, return false if the receiver is shutdown
+        bool waitForTurn(proto::BlockNumber number) {
+            std::unique_lock lock(_turnMutex);
+            while (_ringBuf.nextBlock() != number) {
+                if (_tearDownSignal) {
+                    return false;
+                }
+                _turnCv.wait_for(lock, std::chrono::microseconds(DEQUEUE_TIMEOUT_US));
+            }
+            return true;
+        }
+
+        // access by only a consumer for each block number,
+        // if ordered, the block is validated after all blocks before it are delivered
+        template<bool ordered=false>
         std::unique_ptr<std::string> genBlockFromQueue(proto::BlockNumber number) {
             struct BlockRegenerateOptions {
                 uint32_t currentShardCnt = 0;
@@ -373,6 +441,11 @@ namespace peer::v2 {
                         LOG(WARNING) << "Regenerate shard failed.";
                         continue;
                     }
+                    if constexpr (ordered) {
+                        if (!waitForTurn(number)) {
+                            return nullptr;
+                        }
+                    }
                     // 2. validate the block integrity (if needed)
                     if (_validateCallback != nullptr) {
                         // validate failed, received block is generated by byzantine nodes
@@ -390,8 +463,12 @@ namespace peer::v2 {
         }
 
     private:
-        // For active object, tid and message queue
-        std::unique_ptr<std::thread> _thread;
+        // For active object, the reassembly workers and message queue
+        std::vector<std::thread> _workerList;
+        int _reassemblyWindow = 1;
+        // the worker of the next block is notified when the ring buffer moves forward
+        std::mutex _turnMutex;
+        std::condition_variable _turnCv;
         // TODO: consider limit the size of the queue
         util::BlockingConcurrentQueue<std::unique_ptr<std::string>> _activeBlockResultQueue;
         // signal to alert if the system is shutdown
@@ -400,7 +477,7 @@ namespace peer::v2 {
         BlockFragmentGenerator::Config _localFragmentConfig;
         std::shared_ptr<BlockFragmentGenerator> _bfg;
         // Cache the received fragments
-        Buffer<BufferBlock, 256> _ringBuf;
+        Buffer<BufferBlock> _ringBuf;
         // Check the block signature and other things
         ValidateFunc _validateCallback;
         // one RemoteFragmentReceiver (as server)
@@ -280,7 +280,12 @@ namespace peer::v2 {
                 if (block == nullptr) {
                     continue;   // unexpected wakeup
                 }
-                CHECK(block->haveSerializedMessage());
+                if (!block->haveSerializedMessage()) {
+                    // a pruned block is read from the block log without copy, and it is not shared
+                    std::string raw;
+                    CHECK(block->serializeToString(&raw).valid);
+                    block->setSerializedMessage(std::move(raw));
+                }
                 bthread::CountdownEvent countdown((int)_senderMap.size());
                 bool allSuccess = true;
                 for (auto& it: _senderMap) {
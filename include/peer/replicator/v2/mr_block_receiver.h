@@ -166,7 +166,9 @@ namespace peer::v2 {
                 // For the same node id, each [region] has a different port number
                 // The port number is used to connect to other local servers
                 // Each master region has a set of local ports
-                const std::unordered_map<int, std::vector<BlockReceiver::ConfigPtr>>& regionConfig) {
+                const std::unordered_map<int, std::vector<BlockReceiver::ConfigPtr>>& regionConfig,
+                // the ring buffer capacity of each BlockReceiver
+                int ringBufferCapacity = BlockReceiver::DEFAULT_RING_BUFFER_CAPACITY) {
             // Create new instance
             std::unique_ptr<MRBlockReceiver> br(new MRBlockReceiver());
             br->localRegionId = localNodeConfig->groupId;
@@ -195,7 +197,8 @@ namespace peer::v2 {
                                                                      rfrServerPorts.at(it.first),
                                                                      rds->nodesConfig,
                                                                      frServerPorts.at(it.first),
-                                                                     localNodeConfig->nodeId);
+                                                                     localNodeConfig->nodeId,
+                                                                     ringBufferCapacity);
                 if (rds->blockReceiver == nullptr) {
                     LOG(ERROR) << "Create SingleRegionBlockReceiver failed!";
                     return nullptr;
@@ -239,6 +242,16 @@ namespace peer::v2 {
 
         std::shared_ptr<BlockFragmentGenerator> getBFG() { return bfg; }
 
+        // set the reassembly window of all regions, call before checkAndStartService
+        bool setReassemblyWindow(int window) {
+            for (auto& it: regions) {
+                if (!it.second->blockReceiver->setReassemblyWindow(window)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
     protected:
         MRBlockReceiver() = default;
 
@@ -0,0 +1,122 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "proto/block.h"
+#include "common/concurrent_queue.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+
+namespace peer {
+    // BlockLog is a durable, append-only log of the serialized blocks, one directory per region:
+    //   <path>/<regionId>/<segmentId>.seg: the records, a record is a RecordHeader followed by the block
+    //   <path>/<regionId>/index: a memory-mapped IndexEntry array, indexed by the block number
+    // The blocks are written by a background thread in batches, each batch is synced once before the
+    // index is updated, so an index entry always points to a durable record. The segments are mapped,
+    // a block is read without copy (a block read from a shared log keeps the log alive). On open, the records of the last segment are verified by checksum,
+    // the torn tail is dropped and the index entries are repaired from the valid records.
+    class BlockLog : public std::enable_shared_from_this<BlockLog> {
+    public:
+        struct Config {
+            // the segments are preallocated, a record larger than segmentSize has its own segment
+            size_t segmentSize = 64 << 20;
+            // fdatasync the segments after each batch
+            bool sync = true;
+            // max number of blocks written in a batch
+            int maxBatchSize = 64;
+        };
+
+        struct RecordHeader {
+            uint32_t magic;
+            uint32_t size;
+            uint64_t blockNumber;
+            uint32_t checksum;          // crc32c of the payload
+            uint32_t headerChecksum;    // crc32c of the fields above
+        };
+
+        struct IndexEntry {
+            uint64_t offset;
+            uint32_t segmentId;
+            uint32_t size;              // 0 if the block is not written, published last
+        };
+
+        constexpr static uint32_t RECORD_MAGIC = 0x4d424c47;
+
+        static std::unique_ptr<BlockLog> NewBlockLog(const std::string& path, int regionCount, const Config& config);
+
+        static std::unique_ptr<BlockLog> NewBlockLog(const std::string& path, int regionCount) {
+            return NewBlockLog(path, regionCount, Config{});
+        }
+
+        ~BlockLog();
+
+        BlockLog(const BlockLog &) = delete;
+
+        // thread safe, the raw block is written in the background, raw must not be modified afterward
+        void append(int regionId, proto::BlockNumber blockNumber, std::shared_ptr<const std::string> raw);
+
+        // thread safe, the block is serialized in the background, it must not be modified afterward
+        void append(int regionId, std::shared_ptr<const proto::Block> block);
+
+        // thread safe, nullopt if the block is not written (or corrupted),
+        // the view points into the mapped segment and is valid until the log is destroyed
+        [[nodiscard]] std::optional<std::string_view> read(int regionId, proto::BlockNumber blockNumber) const;
+
+        // thread safe, deserialize a block from the log, nullptr if not exist.
+        // If the log is owned by a shared_ptr, the block refers to the mapped segment and holds the log,
+        // otherwise the record is copied into the serialized message of the block.
+        [[nodiscard]] std::shared_ptr<proto::Block> readBlock(int regionId, proto::BlockNumber blockNumber) const;
+
+        // block until all the blocks appended before are written
+        void flush();
+
+        // thread safe, the max block number that is indexed, -1 if the region is empty
+        [[nodiscard]] int64_t getMaxBlockNumber(int regionId) const;
+
+        [[nodiscard]] int regionCount() const { return (int)_regions.size(); }
+
+    protected:
+        struct Segment;
+
+        struct Region;
+
+        struct Item {
+            int regionId = -1;
+            proto::BlockNumber blockNumber = 0;
+            std::shared_ptr<const std::string> raw;
+            std::shared_ptr<const proto::Block> block;
+            // set if the item is a flush marker
+            std::shared_ptr<std::promise<void>> flushed;
+            // stop the writer after the batch
+            bool stop = false;
+        };
+
+        BlockLog(std::string path, const Config& config);
+
+        bool openRegion(int regionId);
+
+        void run();
+
+        void writeBatch(Item* items, size_t count);
+
+        bool rollSegment(Region& region, size_t recordSize);
+
+        static bool ReserveIndex(Region& region, proto::BlockNumber blockNumber);
+
+        // apply the pending index entries, msync the index synchronously if durable is set
+        void publishIndex(Region& region, bool durable);
+
+    private:
+        const std::string _path;
+        const Config _config;
+        std::vector<std::unique_ptr<Region>> _regions;
+        util::BlockingConcurrentQueue<Item> _queue;
+        std::unique_ptr<std::thread> _writer;
+    };
+}
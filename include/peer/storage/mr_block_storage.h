@@ -5,6 +5,8 @@
 #pragma once
 
 #include "proto/block.h"
+#include "peer/storage/block_log.h"
+#include "peer/storage/tx_index.h"
 #include "bthread/butex.h"
 #include "common/phmap.h"
 #include "common/lru.h"
@@ -41,6 +43,17 @@ namespace peer {
 
             [[nodiscard]] auto regionCount() const { return newBlockFutexList.size(); }
 
+            // persist the inserted blocks to the log, the in-memory blocks become a cache of the log,
+            // must be set before any block is inserted
+            void setBlockLog(std::shared_ptr<BlockLog> log) { blockLog = std::move(log); }
+
+            [[nodiscard]] const std::shared_ptr<BlockLog>& getBlockLog() const { return blockLog; }
+
+            // index the transactions of the inserted blocks, must be set before any block is inserted
+            void setTxIndex(std::shared_ptr<TxIndex> index) { txIndex = std::move(index); }
+
+            [[nodiscard]] const std::shared_ptr<TxIndex>& getTxIndex() const { return txIndex; }
+
             // thread safe, return -1 if not exist
             [[nodiscard]] int getMaxStoredBlockNumber(int regionId) const {
                 return newBlockFutexList[regionId]->load(std::memory_order_acquire);
@@ -110,6 +123,13 @@ namespace peer {
                     }
                 }
                 auto blockId = block->header.number;
+                if (blockLog != nullptr) {
+                    static_cast<Derived*>(this)->appendToBlockLog(regionId, block);
+                }
+                if (txIndex != nullptr) {
+                    // the transactions are found as soon as the block is visible
+                    txIndex->insertBlock(regionId, *block);
+                }
                 if (!static_cast<Derived*>(this)->tryEmplaceBlock(regionId, blockId, std::move(block))) {
                     LOG(WARNING) << "Insert block failed: " << blockId;
                 }
@@ -123,6 +143,10 @@ namespace peer {
                 static_cast<Derived*>(this)->pruneWithMaxBlockId(regionId, blockId);
             }
 
+        protected:
+            std::shared_ptr<BlockLog> blockLog;
+            std::shared_ptr<TxIndex> txIndex;
+
         private:
             // change when block updated
             std::vector<butil::atomic<int>*> newBlockFutexList;
@@ -144,10 +168,25 @@ namespace peer {
         std::shared_ptr<proto::Block> getBlock(int regionId, proto::BlockNumber blockId) {
             std::shared_ptr<proto::Block> block = nullptr;
             blockStorage[regionId].if_contains(blockId, [&block](const RegionStorage::value_type &v) { block = v.second; });
+            if (block == nullptr && blockLog != nullptr && (int)blockId <= getMaxStoredBlockNumber(regionId)) {
+                // the block is pruned from memory
+                block = blockLog->readBlock(regionId, blockId);
+            }
             DCHECK(block != nullptr) << "Block must not be empty, impl error!";
             return block;
         }
 
+        // the block is modified in place after it is inserted (the user requests are moved out),
+        // log the message it is deserialized from instead
+        void appendToBlockLog(int regionId, const std::shared_ptr<proto::Block>& block) {
+            auto raw = block->getSerializedMessage();
+            if (raw == nullptr || raw->empty()) {
+                LOG(WARNING) << "Block has no serialized message, skip logging it: " << block->header.number;
+                return;
+            }
+            blockLog->append(regionId, block->header.number, std::move(raw));
+        }
+
         bool tryEmplaceBlock(int regionId, proto::BlockNumber blockId, auto&& block) {
             blockStorage[regionId].try_emplace(blockId, std::forward<decltype(block)>(block));
             return true;
@@ -181,12 +220,25 @@ namespace peer {
     protected:
         std::shared_ptr<proto::Block> getBlock(int regionId, proto::BlockNumber blockId) {
             std::shared_ptr<proto::Block> block = nullptr;
-            if (!blockStorage[regionId].tryGetCopy(blockId, block)) {
+            if (blockStorage[regionId].tryGetCopy(blockId, block)) {
+                return block;
+            }
+            if (blockLog == nullptr || (int)blockId > getMaxStoredBlockNumber(regionId)) {
                 return nullptr;
             }
+            // the block is evicted, load it from the log and cache it again
+            block = blockLog->readBlock(regionId, blockId);
+            if (block != nullptr) {
+                blockStorage[regionId].insert(blockId, block);
+            }
             return block;
         }
 
+        // the blocks are final after execution, serialize them in the log writer
+        void appendToBlockLog(int regionId, const std::shared_ptr<proto::Block>& block) {
+            blockLog->append(regionId, block);
+        }
+
         bool tryEmplaceBlock(int regionId, proto::BlockNumber blockId, auto&& block) {
             blockStorage[regionId].insert(blockId, std::forward<decltype(block)>(block));
             return true;
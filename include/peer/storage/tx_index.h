@@ -0,0 +1,136 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "proto/block.h"
+#include "peer/db/db_interface.h"
+#include "gtl/phmap.hpp"
+#include <array>
+#include <mutex>
+#include <optional>
+
+namespace peer {
+    // TxIndex maps a transaction id (the digest of the user request signature) to the block
+    // and the position in the block that contains it, so that a proof query does not scan the blocks.
+    // The in-memory tier keeps (at least) the latest capacity / 2 transactions of all the regions,
+    // an optional persisted tier keeps all of them. Thread safe.
+    class TxIndex {
+    public:
+        struct Location {
+            int32_t regionId;
+            uint32_t position;
+            proto::BlockNumber blockNumber;
+        };
+
+        constexpr static size_t DEFAULT_CAPACITY = 1 << 20;
+
+        // capacity: the max number of transactions in memory
+        // db: the persisted tier, nullptr to keep the index in memory only
+        explicit TxIndex(size_t capacity, std::shared_ptr<db::DBConnection> db = nullptr)
+                : _db(std::move(db)) {
+            _generationCapacity = std::max<size_t>(capacity / SHARD_COUNT / 2, 1);
+            for (auto& it: _shards) {
+                it.current.reserve(_generationCapacity);
+            }
+        }
+
+        TxIndex(const TxIndex&) = delete;
+
+        // index all the user requests of a block, call it before the block is visible to the queries
+        void insertBlock(int regionId, const proto::Block& block) {
+            const auto& requests = block.body.userRequests;
+            for (int i = 0; i < (int)requests.size(); i++) {
+                const auto& digest = requests[i]->getSignature().digest;
+                Location location{regionId, (uint32_t)i, block.header.number};
+                auto key = Key(digest);
+                auto& shard = _shards[key % SHARD_COUNT];
+                std::unique_lock lock(shard.mutex);
+                if (shard.current.size() >= _generationCapacity) {
+                    // drop the oldest generation
+                    shard.previous = std::move(shard.current);
+                    shard.current.clear();
+                    shard.current.reserve(_generationCapacity);
+                }
+                shard.current[key] = location;
+            }
+            if (_db == nullptr) {
+                return;
+            }
+            auto ret = _db->syncWriteBatch([&](db::DBConnection::WriteBatch* batch) {
+                for (int i = 0; i < (int)requests.size(); i++) {
+                    const auto& digest = requests[i]->getSignature().digest;
+                    Location location{regionId, (uint32_t)i, block.header.number};
+                    batch->Put(std::string(reinterpret_cast<const char*>(digest.data()), digest.size()),
+                               std::string(reinterpret_cast<const char*>(&location), sizeof(Location)));
+                }
+                return true;
+            });
+            if (!ret) {
+                LOG(WARNING) << "Persist tx index failed, region: " << regionId << ", block: " << block.header.number;
+            }
+        }
+
+        // The in-memory tier is indexed by a 64-bit fingerprint of the txId,
+        // the caller must check the digest of the request at the location.
+        [[nodiscard]] std::optional<Location> find(std::string_view txId) const {
+            if (txId.size() != DIGEST_SIZE) {
+                return std::nullopt;
+            }
+            auto key = Key(txId);
+            const auto& shard = _shards[key % SHARD_COUNT];
+            {
+                std::unique_lock lock(shard.mutex);
+                auto it = shard.current.find(key);
+                if (it != shard.current.end()) {
+                    return it->second;
+                }
+                it = shard.previous.find(key);
+                if (it != shard.previous.end()) {
+                    return it->second;
+                }
+            }
+            std::string value;
+            if (_db == nullptr || !_db->get(txId, &value) || value.size() != sizeof(Location)) {
+                return std::nullopt;
+            }
+            Location location{};
+            std::memcpy(&location, value.data(), sizeof(Location));
+            return location;
+        }
+
+        // the number of transactions in memory
+        [[nodiscard]] size_t size() const {
+            size_t size = 0;
+            for (const auto& it: _shards) {
+                std::unique_lock lock(it.mutex);
+                size += it.current.size() + it.previous.size();
+            }
+            return size;
+        }
+
+    protected:
+        constexpr static int SHARD_COUNT = 16;
+
+        constexpr static size_t DIGEST_SIZE = std::tuple_size_v<proto::DigestString>;
+
+        // the digest is a signature, its bytes are already uniformly distributed
+        static uint64_t Key(const auto& digest) {
+            uint64_t lhs, rhs;
+            std::memcpy(&lhs, digest.data(), sizeof(uint64_t));
+            std::memcpy(&rhs, digest.data() + DIGEST_SIZE / 2, sizeof(uint64_t));
+            return lhs ^ rhs;
+        }
+
+    private:
+        struct Shard {
+            mutable std::mutex mutex;
+            gtl::flat_hash_map<uint64_t, Location> current;
+            gtl::flat_hash_map<uint64_t, Location> previous;
+        };
+        size_t _generationCapacity;
+        std::array<Shard, SHARD_COUNT> _shards;
+        std::shared_ptr<db::DBConnection> _db;
+    };
+}
@@ -8,6 +8,10 @@
 #include "proto/user_request.h"
 #include "zpp_bits.h"
 
+namespace pmt {
+    class MerkleTree;
+}
+
 namespace proto {
     using HashString = util::OpenSSLSHA256::digestType;
 
@@ -79,6 +83,18 @@ namespace proto {
                 }
                 return nullptr;
             }
+
+            // return the envelop at position if its digest matches, nullptr otherwise
+            [[nodiscard]] Envelop* getEnvelop(int position, const auto& digest) const {
+                if (position < 0 || position >= (int)userRequests.size()) {
+                    return nullptr;
+                }
+                auto& envelop = userRequests[position];
+                if (proto::CompareDigest(envelop->getSignature().digest, digest) != 0) {
+                    return nullptr;
+                }
+                return envelop.get();
+            }
         };
 
         class ExecuteResult {
@@ -86,6 +102,8 @@ namespace proto {
             std::vector<std::unique_ptr<TxReadWriteSet>> txReadWriteSet;
             // check if a transaction is valid
             std::vector<std::byte> transactionFilter;
+            // not serialized, the merkle tree of the rw sets built when the block is committed
+            std::shared_ptr<pmt::MerkleTree> merkleTree;
 
         public:
             friend zpp::bits::access;
@@ -105,6 +123,19 @@ namespace proto {
                 }
                 return false;
             }
+
+            // the rw sets are in the order of the user requests, check the one at position only
+            [[nodiscard]] bool getRWSet(int position, const auto& digest, TxReadWriteSet*& rwSet, std::byte& valid) const {
+                if (position < 0 || position >= (int)txReadWriteSet.size() || position >= (int)transactionFilter.size()) {
+                    return false;
+                }
+                if (proto::CompareDigest(txReadWriteSet[position]->getRequestDigest(), digest) != 0) {
+                    return false;
+                }
+                rwSet = txReadWriteSet[position].get();
+                valid = transactionFilter[position];
+                return true;
+            }
         };
 
         // std::string: the metadata to be signed (may leave empty)
@@ -157,11 +188,17 @@ namespace proto {
         }
 
         PosList deserializeFromString(int pos = 0) {
-            PosList posList;
             if (this->storage == nullptr) {
-                return posList;
+                return {};
             }
-            auto in = zpp::bits::in(*(this->storage));
+            return deserializeFromView(*this->storage, pos);
+        }
+
+        // Deserialize without copying the buffer, the fields may refer to it, so it must outlive the block.
+        // The block does not have a serialized message afterward.
+        PosList deserializeFromView(std::string_view raw, int pos = 0) {
+            PosList posList;
+            auto in = zpp::bits::in(raw);
             in.reset(pos);
             posList.headerPos = in.position();
             if(failure(in(this->header))) {
@@ -69,4 +69,38 @@ namespace proto {
             return true;
         }
     };
-}
\ No newline at end of file
+
+    // The votes coalesced into one raft entry. A batch entry starts with BATCH_MAGIC,
+    // which is never the size prefix of a single SignedBlockOrder, so the single-vote entries are still decoded.
+    struct SignedBlockOrderBatch {
+        constexpr static uint32_t BATCH_MAGIC = 0xffffffff;
+
+        std::vector<SignedBlockOrder> orders;
+
+        bool serializeToString(std::string* buf, int pos = 0) const {
+            zpp::bits::out out(*buf);
+            out.reset(pos);
+            if(failure(out(BATCH_MAGIC, orders))) {
+                return false;
+            }
+            return true;
+        }
+
+        // decode a raft entry, it contains either a single order or a batch of orders
+        static bool DeserializeEntry(const std::string& buf, std::vector<SignedBlockOrder>& orders) {
+            uint32_t magic = 0;
+            if (buf.size() >= sizeof(magic)) {
+                std::memcpy(&magic, buf.data(), sizeof(magic));
+            }
+            if (magic != BATCH_MAGIC) {
+                orders.resize(1);
+                return orders[0].deserializeFromString(buf);
+            }
+            auto in = zpp::bits::in(buf);
+            if(failure(in(magic, orders))) {
+                return false;
+            }
+            return true;
+        }
+    };
+}
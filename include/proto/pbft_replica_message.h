@@ -0,0 +1,160 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "zpp_bits.h"
+#include "proto/block.h"
+
+namespace proto {
+    // The messages exchanged by util::pbft::PBFTReplica. On the wire, a message is followed by
+    // the signature of the sender on the serialized message (a DigestString).
+    struct PBFTMessage {
+        enum Type : int32_t {
+            PRE_PREPARE = 0,
+            PREPARE = 1,
+            COMMIT = 2,
+            VIEW_CHANGE = 3,
+            NEW_VIEW = 4,
+            HEARTBEAT = 5,
+        };
+
+        int32_t type;
+        int32_t view;
+        // HEARTBEAT: the last delivered sequence of the sender
+        int64_t sequence;
+        int32_t sender;
+        // the digest of the proposal
+        HashString digest{};
+        // PRE_PREPARE: the proposal, VIEW_CHANGE: a PBFTViewChange, NEW_VIEW: a PBFTNewView
+        std::string payload;
+        // PRE_PREPARE, PREPARE: the signature of the sender on the proposal
+        std::vector<Block::SignaturePair> signatures;
+        // PRE_PREPARE, PREPARE: the signature of the sender on PBFTVote{view, sequence, digest}
+        DigestString voteSignature{};
+
+        friend zpp::bits::access;
+
+        constexpr static auto serialize(auto &archive, PBFTMessage &m) {
+            return archive(m.type, m.view, m.sequence, m.sender, m.digest, m.payload, m.signatures, m.voteSignature);
+        }
+
+        bool serializeToString(std::string* buf, int pos = 0) const {
+            zpp::bits::out out(*buf);
+            out.reset(pos);
+            if(failure(out(*this))) {
+                return false;
+            }
+            return true;
+        }
+
+        bool deserializeFromString(std::string_view buf, int pos = 0) {
+            auto in = zpp::bits::in(buf);
+            in.reset(pos);
+            if(failure(in(*this))) {
+                return false;
+            }
+            return true;
+        }
+    };
+
+    // The bytes signed by a replica when it prepares a proposal. The signatures on the proposal are
+    // delivered to the state machine, they do not bind the view and the sequence of the vote.
+    struct PBFTVote {
+        int32_t view;
+        int64_t sequence;
+        HashString digest{};
+
+        friend zpp::bits::access;
+
+        constexpr static auto serialize(auto &archive, PBFTVote &v) {
+            return archive(v.view, v.sequence, v.digest);
+        }
+
+        bool serializeToString(std::string* buf, int pos = 0) const {
+            zpp::bits::out out(*buf);
+            out.reset(pos);
+            if(failure(out(*this))) {
+                return false;
+            }
+            return true;
+        }
+    };
+
+    // A proposal prepared in a view, with the signatures of a quorum
+    struct PBFTCertificate {
+        int32_t view;
+        int64_t sequence;
+        std::string proposal;
+        std::vector<Block::SignaturePair> signatures;
+        // voteSignatures[i] is the signature of the signer of signatures[i] on PBFTVote{view, sequence, digest}
+        std::vector<DigestString> voteSignatures;
+
+        friend zpp::bits::access;
+
+        constexpr static auto serialize(auto &archive, PBFTCertificate &c) {
+            return archive(c.view, c.sequence, c.proposal, c.signatures, c.voteSignatures);
+        }
+    };
+
+    struct PBFTViewChange {
+        // the last delivered sequence of the sender
+        int64_t delivered;
+        // the prepared proposals of the sender, in sequence
+        std::vector<PBFTCertificate> certificates;
+
+        friend zpp::bits::access;
+
+        constexpr static auto serialize(auto &archive, PBFTViewChange &v) {
+            return archive(v.delivered, v.certificates);
+        }
+
+        bool serializeToString(std::string* buf, int pos = 0) const {
+            zpp::bits::out out(*buf);
+            out.reset(pos);
+            if(failure(out(*this))) {
+                return false;
+            }
+            return true;
+        }
+
+        bool deserializeFromString(std::string_view buf, int pos = 0) {
+            auto in = zpp::bits::in(buf);
+            in.reset(pos);
+            if(failure(in(*this))) {
+                return false;
+            }
+            return true;
+        }
+    };
+
+    struct PBFTNewView {
+        // the signed VIEW_CHANGE messages of a quorum
+        std::vector<std::string> viewChanges;
+
+        friend zpp::bits::access;
+
+        constexpr static auto serialize(auto &archive, PBFTNewView &n) {
+            return archive(n.viewChanges);
+        }
+
+        bool serializeToString(std::string* buf, int pos = 0) const {
+            zpp::bits::out out(*buf);
+            out.reset(pos);
+            if(failure(out(*this))) {
+                return false;
+            }
+            return true;
+        }
+
+        bool deserializeFromString(std::string_view buf, int pos = 0) {
+            auto in = zpp::bits::in(buf);
+            in.reset(pos);
+            if(failure(in(*this))) {
+                return false;
+            }
+            return true;
+        }
+    };
+}
@@ -5,7 +5,9 @@
 #pragma once
 
 #include "common/crypto.h"
+#include "common/arena.h"
 #include "zpp_bits.h"
+#include <cstring>
 
 namespace proto {
     using DigestString = util::OpenSSLED25519::digestType;
@@ -38,6 +40,14 @@ namespace proto {
             _valueSV = _value;
         }
 
+        // Copy the key and value into the arena, the arena must outlive the KV
+        void setKeyValue(std::string_view key, std::string_view value, util::Arena& arena) {
+            _key.clear();
+            _value.clear();
+            _keySV = arena.copy(key);
+            _valueSV = arena.copy(value);
+        }
+
         [[nodiscard]] const std::string_view &getKeySV() const {
             return _keySV;
         }
@@ -62,6 +72,49 @@ namespace proto {
 
     using KVList = std::vector<std::unique_ptr<KV>>;
 
+    namespace inner {
+        // Collect the small pieces of a message into a buffer, to save the calls of update
+        template<class Update>
+        class BufferedDigestWriter {
+        public:
+            explicit BufferedDigestWriter(Update& update) : _update(update) { }
+
+            void append(const void *d, size_t cnt) {
+                if (_size + cnt > sizeof(_buffer)) {
+                    flush();
+                }
+                if (cnt >= sizeof(_buffer)) {
+                    _update(d, cnt);
+                    return;
+                }
+                std::memcpy(_buffer + _size, d, cnt);
+                _size += cnt;
+            }
+
+            template<class T>
+            requires std::is_trivially_copyable_v<T>
+            void appendValue(const T& value) { append(&value, sizeof(T)); }
+
+            // with a 4-byte length prefix
+            void appendSized(std::string_view sv) {
+                appendValue((uint32_t)sv.size());
+                append(sv.data(), sv.size());
+            }
+
+            void flush() {
+                if (_size != 0) {
+                    _update(_buffer, _size);
+                    _size = 0;
+                }
+            }
+
+        private:
+            Update& _update;
+            size_t _size = 0;
+            char _buffer[256];
+        };
+    }
+
     class TxReadWriteSet {
     public:
         explicit TxReadWriteSet(DigestString requestDigest)
@@ -100,6 +153,43 @@ namespace proto {
 
         [[nodiscard]] int32_t getRetCode() const { return _retCode; }
 
+        // Keep the arena that the kv in reads and writes are allocated from alive
+        void setArena(std::shared_ptr<util::Arena> arena) { _arena = std::move(arena); }
+
+        // The leaf of the execution result merkle tree, the sha256 of the rw set and its filter.
+        // The fields are streamed into the hash with their length prefixes, the rw set is not serialized.
+        [[nodiscard]] std::optional<util::OpenSSLSHA256::digestType> computeDigest(std::byte filter) const {
+            return util::OpenSSLSHA256::generateDigestStreamed([&](auto&& update) {
+                inner::BufferedDigestWriter writer(update);
+                writer.append(_requestDigest.data(), _requestDigest.size());
+                writer.appendSized(_retValueSV);
+                writer.appendValue(_retCode);
+                for (const auto* list: {&_reads, &_writes}) {
+                    writer.appendValue((uint32_t)list->size());
+                    for (const auto& kv: *list) {
+                        writer.appendSized(kv->getKeySV());
+                        writer.appendSized(kv->getValueSV());
+                    }
+                }
+                writer.appendValue(filter);
+                writer.flush();
+            });
+        }
+
+        // Called by the cc engine after the txn is committed, the rw set must not be modified afterward
+        void updateDigest(std::byte filter) {
+            _digest = computeDigest(filter);
+            _digestFilter = filter;
+        }
+
+        // Return the digest computed at commit if the filter is the same, otherwise compute it
+        [[nodiscard]] std::optional<util::OpenSSLSHA256::digestType> getDigest(std::byte filter) const {
+            if (_digest != std::nullopt && _digestFilter == filter) {
+                return _digest;
+            }
+            return computeDigest(filter);
+        }
+
     public:
         friend zpp::bits::access;
 
@@ -108,6 +198,8 @@ namespace proto {
         }
 
     private:
+        // destroyed after the kv lists
+        std::shared_ptr<util::Arena> _arena;
         // requestDigest(tid) represents the corresponding user request
         DigestString _requestDigest;
         std::string _retValue;
@@ -115,5 +207,8 @@ namespace proto {
         int32_t _retCode;
         KVList _reads;
         KVList _writes;
+        // not serialized, cached by updateDigest
+        std::optional<util::OpenSSLSHA256::digestType> _digest;
+        std::byte _digestFilter{};
     };
 }
\ No newline at end of file
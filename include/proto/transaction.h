@@ -33,15 +33,14 @@ namespace proto {
         static std::unique_ptr<Transaction> NewTransactionFromEnvelop(std::unique_ptr<Envelop> envelop) {
             std::unique_ptr<Transaction> txn(new Transaction());
             txn->_envelop = std::move(envelop);
-            txn->_userRequest = std::make_unique<UserRequest>();
             zpp::bits::in in(txn->_envelop->getPayload());
-            if (failure(in(*txn->_userRequest))) {
+            if (failure(in(txn->_userRequest))) {
                 LOG(WARNING) << "Deserialize user request failed!";
                 return nullptr;
             }
             txn->_executionResult = std::make_unique<TxReadWriteSet>();
             txn->_executionResult->setRequestDigest(txn->_envelop->getSignature().digest);
-            txn->tid = std::make_shared<tid_type>(txn->_envelop->getSignature().digest);
+            txn->tid = txn->_envelop->getSignature().digest;
             return txn;
         }
 
@@ -56,15 +55,13 @@ namespace proto {
         Transaction(Transaction&&) = delete;
 
         // Set the txn id through NewTransactionFromEnvelop
-        [[nodiscard]] const tid_type& getTransactionId() const {
-            DCHECK(tid != nullptr);
-            return *tid;
-        }
+        [[nodiscard]] const tid_type& getTransactionId() const { return tid; }
 
-        [[nodiscard]] std::shared_ptr<const tid_type> getTransactionIdPtr() const {
-            DCHECK(tid != nullptr);
-            return tid;
-        }
+        // The dense position of the txn in the current batch, set by the coordinator.
+        // Used as the priority of the txn in the reserve table (smaller is higher).
+        void setBatchIndex(uint32_t batchIndex) { _batchIndex = batchIndex; }
+
+        [[nodiscard]] uint32_t getBatchIndex() const { return _batchIndex; }
 
         [[nodiscard]] const KVList& getReads() const { return _executionResult->getReads(); }
 
@@ -74,7 +71,7 @@ namespace proto {
 
         [[nodiscard]] KVList& getWrites() { return _executionResult->getWrites(); }
 
-        [[nodiscard]] const UserRequest& getUserRequest() const { return *_userRequest; }
+        [[nodiscard]] const UserRequest& getUserRequest() const { return _userRequest; }
 
         void setExecutionResult(ExecutionResult er) { _executionResult->setRetCode((int32_t) er); }
 
@@ -84,17 +81,31 @@ namespace proto {
 
         void setRetValue(std::string &&retValue) { _executionResult->setRetValue(std::move(retValue)); }
 
+        // The rw sets are allocated from the arena
+        void setArena(std::shared_ptr<util::Arena> arena) { _executionResult->setArena(std::move(arena)); }
+
         [[nodiscard]] const std::string_view &getRetValueSV() const { return _executionResult->getRetValueSV(); }
 
+        // The filter of the txn in ExecuteResult::transactionFilter
+        [[nodiscard]] std::byte getTransactionFilter() const {
+            return static_cast<std::byte>(getExecutionResult() == ExecutionResult::COMMIT);
+        }
+
+        // Hash the rw set after the txn is committed, it is the leaf of the execution result merkle tree
+        void updateExecutionResultDigest() { _executionResult->updateDigest(getTransactionFilter()); }
+
     protected:
         Transaction() = default;
 
     private:
-        std::shared_ptr<tid_type> tid;
+        // stored inline to save the allocations of each transaction
+        tid_type tid{};
+        uint32_t _batchIndex = 0;
         // Each transaction must contain an envelope
         // Contains the user's raw transaction (serialized and un-serialized)
         std::unique_ptr<Envelop> _envelop;
-        std::unique_ptr<UserRequest> _userRequest;
+        // the string views point to the payload of the envelope
+        UserRequest _userRequest;
         std::unique_ptr<TxReadWriteSet> _executionResult;
     };
 }
\ No newline at end of file
@@ -31,6 +31,7 @@ namespace tests {
             auto envelopList = CreateMockEnvelop(count, range);
             for(int i=0; i<count; i++) {
                 auto txn = proto::Transaction::NewTransactionFromEnvelop(std::move(envelopList[i]));
+                txn->setBatchIndex(i);
                 txnList->push_back(std::move(txn));
             }
         }
@@ -0,0 +1,135 @@
+//
+// Created by user on 23-10-17.
+//
+
+#pragma once
+
+#include "client/core/db.h"
+#include "client/core/status.h"
+#include "client/core/workload.h"
+#include "client/ycsb/core_workload.h"
+#include "client/small_bank/small_bank_workload.h"
+#include "peer/chaincode/chaincode.h"
+#include "peer/db/db_interface.h"
+#include "proto/block.h"
+#include "common/timer.h"
+
+#include "glog/logging.h"
+
+namespace tests {
+    // Capture the requests generated by a client workload as envelops,
+    // so that the same trace can be replayed on different cc engines.
+    class EnvelopRecorder : public client::core::DB {
+    public:
+        void stop() override { }
+
+        client::core::Status sendInvokeRequest(const std::string& ccName, const std::string& funcName, const std::string& args) override {
+            proto::UserRequest request;
+            request.setCCName(std::string(ccName));
+            request.setFuncName(std::string(funcName));
+            request.setArgs(std::string(args));
+            request.setNonce(nonce);
+            std::string requestRaw;
+            zpp::bits::out out(requestRaw);
+            CHECK(!failure(out(request)));
+            auto envelop = std::make_unique<proto::Envelop>();
+            envelop->setPayload(std::move(requestRaw));
+            // the tid is ordered by nonce (big endian)
+            proto::SignatureString signature;
+            for (int i = 0; i < (int)sizeof(nonce); i++) {
+                signature.digest[i] = static_cast<uint8_t>(nonce >> (8 * (sizeof(nonce) - 1 - i)));
+            }
+            envelop->setSignature(std::move(signature));
+            envelopList.push_back(std::move(envelop));
+            return client::core::Status(client::core::Status::State::OK, util::Timer::time_now_ms(), std::to_string(nonce++));
+        }
+
+        std::vector<std::unique_ptr<proto::Envelop>> envelopList;
+
+    private:
+        uint64_t nonce = 0;
+    };
+
+    class WorkloadTraceUtils {
+    public:
+        using BlockTrace = std::vector<std::vector<std::unique_ptr<proto::Envelop>>>;
+
+        // Generate blockCount blocks, each block contains blockSize requests
+        static BlockTrace GenerateBlockTrace(client::core::Workload& workload, int blockCount, int blockSize) {
+            workload.setMeasurements(std::make_shared<client::core::Measurements>());
+            EnvelopRecorder recorder;
+            BlockTrace trace(blockCount);
+            for (auto& block: trace) {
+                recorder.envelopList.clear();
+                recorder.envelopList.reserve(blockSize);
+                while ((int)recorder.envelopList.size() < blockSize) {
+                    workload.doTransaction(&recorder);
+                }
+                block = std::move(recorder.envelopList);
+            }
+            return trace;
+        }
+
+        // The ycsb properties must be set before calling this function
+        static BlockTrace GenerateYCSBTrace(int blockCount, int blockSize) {
+            client::ycsb::CoreWorkload workload;
+            workload.init(*util::Properties::GetProperties());
+            return GenerateBlockTrace(workload, blockCount, blockSize);
+        }
+
+        // The small bank properties must be set before calling this function
+        static BlockTrace GenerateSmallBankTrace(int blockCount, int blockSize) {
+            client::small_bank::SmallBankWorkload workload;
+            workload.init(*util::Properties::GetProperties());
+            return GenerateBlockTrace(workload, blockCount, blockSize);
+        }
+
+        static std::vector<std::unique_ptr<proto::Envelop>> CopyEnvelops(const std::vector<std::unique_ptr<proto::Envelop>>& envelops) {
+            std::vector<std::unique_ptr<proto::Envelop>> ret;
+            ret.reserve(envelops.size());
+            for (const auto& it: envelops) {
+                auto envelop = std::make_unique<proto::Envelop>();
+                envelop->setPayload(std::string(it->getPayload()));
+                envelop->setSignature(it->getSignature());
+                ret.push_back(std::move(envelop));
+            }
+            return ret;
+        }
+
+        // Wrap the trace into blocks, the block number start at 0
+        static std::vector<std::shared_ptr<proto::Block>> CopyToBlocks(const BlockTrace& trace) {
+            std::vector<std::shared_ptr<proto::Block>> blocks;
+            blocks.reserve(trace.size());
+            for (int i = 0; i < (int)trace.size(); i++) {
+                auto block = std::make_shared<proto::Block>();
+                block->header.number = i;
+                block->body.userRequests = CopyEnvelops(trace[i]);
+                blocks.push_back(std::move(block));
+            }
+            return blocks;
+        }
+
+        // Create a db connection and load the initial data of the chaincode
+        static std::shared_ptr<peer::db::DBConnection> InitDB(const std::string& ccName, const std::string& dbName="traceDB") {
+            std::shared_ptr<peer::db::DBConnection> dbc = peer::db::DBConnection::NewConnection(dbName);
+            CHECK(dbc != nullptr) << "create db failed!";
+            LoadDB(ccName, dbc);
+            return dbc;
+        }
+
+        // Load the initial data of the chaincode into an existing db
+        static void LoadDB(const std::string& ccName, const std::shared_ptr<peer::db::DBConnection>& dbc) {
+            auto orm = peer::chaincode::ORM::NewORMFromDBInterface(dbc);
+            auto cc = peer::chaincode::NewChaincodeByName(ccName, std::move(orm));
+            CHECK(cc != nullptr && cc->InitDatabase() == 0) << "init chaincode failed!";
+            proto::KVList reads, writes;
+            cc->reset(reads, writes);
+            CHECK(dbc->syncWriteBatch([&](auto* batch) -> bool {
+                for (const auto& it: writes) {
+                    batch->Put({it->getKeySV().data(), it->getKeySV().size()}, {it->getValueSV().data(), it->getValueSV().size()});
+                }
+                return true;
+            }));
+        }
+    };
+}
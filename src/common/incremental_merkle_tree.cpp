@@ -0,0 +1,98 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "common/incremental_merkle_tree.h"
+#include "common/sha256_multi_buffer.h"
+#include "glog/logging.h"
+
+namespace pmt {
+
+    void IncrementalMerkleBuilder::flush() {
+        if (!_pending.empty()) {
+            auto& leaves = _levels[0];
+            const auto start = leaves.size();
+            leaves.resize(start + _pending.size());
+            util::sha256::HashMany(_pending.data(), leaves.data() + start, _pending.size());
+            _pending.clear();
+        }
+        hashCompletePairs();
+    }
+
+    void IncrementalMerkleBuilder::hashCompletePairs() {
+        for (int i = 0; _levels[i].size() >= 2; i++) {
+            if (i + 1 == (int)_levels.size()) {
+                _levels.emplace_back();
+            }
+            auto& children = _levels[i];
+            auto& parents = _levels[i + 1];
+            const int hashed = (int)parents.size();
+            const int parentCount = (int)(children.size() >> 1);
+            if (parentCount == hashed) {
+                return;     // the upper levels are up-to-date
+            }
+            parents.resize(parentCount);
+            MerkleTree::HashLevel(children.data() + 2 * hashed, parents.data() + hashed, parentCount - hashed, nullptr, 1);
+        }
+    }
+
+    std::unique_ptr<MerkleTree> IncrementalMerkleBuilder::finalize(const Config &c, std::shared_ptr<util::thread_pool_light> wpPtr) {
+        flush();
+        auto levels = std::move(_levels);
+        reset();
+        const int numLeaves = (int)levels[0].size();
+        if (numLeaves <= 1) {
+            LOG(ERROR) << "the number of data blocks must be greater than 1";
+            return nullptr;
+        }
+        auto mt = std::unique_ptr<MerkleTree>(new MerkleTree(c));
+        mt->wp = std::move(wpPtr);
+        if (mt->wp != nullptr && mt->config.NumRoutines == 0) {
+            mt->config.NumRoutines = (int)mt->wp->get_thread_count();
+        }
+        auto* wp = mt->config.RunInParallel ? mt->wp.get() : nullptr;
+        const int numRoutines = mt->config.RunInParallel ? mt->config.NumRoutines : 1;
+        mt->Depth = MerkleTree::calTreeDepth(numLeaves);
+        mt->Leaves = levels[0];
+        // the nodes on the right edge are not hashed yet
+        levels.resize(std::max(levels.size(), (size_t)mt->Depth));
+        for (int i = 0; i < (int)mt->Depth; i++) {
+            int prevLen = (int)levels[i].size();
+            MerkleTree::fixOdd(levels[i], prevLen);
+            if (i + 1 == (int)mt->Depth) {
+                break;
+            }
+            auto& parents = levels[i + 1];
+            const int hashed = (int)parents.size();
+            parents.resize(prevLen >> 1);
+            MerkleTree::HashLevel(levels[i].data() + 2 * hashed, parents.data() + hashed, (prevLen >> 1) - hashed, wp, numRoutines);
+        }
+        // the upper levels are computed eagerly when the leaves count is a power of 2
+        levels.resize(mt->Depth);
+        mt->Root = Config::HashFunc(levels.back()[0], levels.back()[1]);
+
+        if (mt->config.Mode == ModeType::ModeProofGen) {
+            for (auto& it: levels) {
+                mt->proofGenBufList.push_back(std::make_unique<std::vector<HashString>>(std::move(it)));
+            }
+        } else if (mt->config.Mode == ModeType::ModeTreeBuild || mt->config.Mode == ModeType::ModeProofGenAndTreeBuild) {
+            for (auto i = 0; i < numLeaves; i++) {
+                mt->leafMap[std::string(mt->Leaves[i].begin(), mt->Leaves[i].end())] = i;
+            }
+            mt->tree = std::move(levels);
+            if (mt->config.Mode == ModeType::ModeTreeBuild) {
+                return mt;
+            }
+        } else {
+            LOG(ERROR) << "invalid configuration mode";
+            return nullptr;
+        }
+        // proofs point into the final buffers
+        mt->initProofs();
+        for (int i = 0; i < (int)mt->Depth; i++) {
+            const auto& buf = mt->config.Mode == ModeType::ModeProofGen ? *mt->proofGenBufList[i] : mt->tree[i];
+            mt->updateProofs(buf, (int)buf.size(), i);
+        }
+        return mt;
+    }
+}
@@ -3,18 +3,19 @@
 //
 
 #include "common/parallel_merkle_tree.h"
+#include "common/sha256_multi_buffer.h"
 #include "bthread/countdown_event.h"
 #include "glog/logging.h"
 #include <bitset>
+#include <cstring>
 
 namespace pmt {
 
     HashString Config::HashFunc(const HashString &h1, const HashString &h2) {
-        util::OpenSSLSHA256 hash;
-        if (!hash.update(h1.data(), h1.size()) || !hash.update(h2.data(), h2.size())) {
-            CHECK(false) << "Can not update digest.";
-        }
-        auto digest = hash.final();
+        std::array<uint8_t, sizeof(HashString) * 2> buffer;
+        std::memcpy(buffer.data(), h1.data(), h1.size());
+        std::memcpy(buffer.data() + h1.size(), h2.data(), h2.size());
+        auto digest = util::OpenSSLSHA256::generateDigest(buffer.data(), buffer.size());
         if (digest == std::nullopt) {
             CHECK(false) << "Can not generate digest.";
         }
@@ -107,11 +108,10 @@ namespace pmt {
         this->updateProofs(*buf, numLeaves, 0);
 
         for (auto step = 1; step < int(Depth); step++) {
-            proofGenBufList.push_back(std::make_unique<std::vector<HashString>>(*buf));
+            auto* prev = buf;
+            proofGenBufList.push_back(std::make_unique<std::vector<HashString>>(prevLen >> 1));
             buf = proofGenBufList.back().get();  // must re-create buf, copy-on-write
-            for (auto idx = 0; idx < prevLen; idx += 2) {
-                (*buf)[idx >> 1] = Config::HashFunc((*buf)[idx], (*buf)[idx + 1]);
-            }
+            MerkleTree::HashLevel(prev->data(), buf->data(), prevLen >> 1, nullptr, 1);
             prevLen >>= 1;
             pmt::MerkleTree::fixOdd(*buf, prevLen);
             this->updateProofs(*buf, prevLen, step);
@@ -196,28 +196,37 @@ namespace pmt {
         proofGenBufList.push_back(std::make_unique<std::vector<HashString>>(prevLen >> 1));
         std::vector<HashString>* buf2 = proofGenBufList.back().get();
         for (auto step = 1; step < int(Depth); step++) {
-            auto numRoutines = MerkleTree::calculateNumRoutine(config.NumRoutines, prevLen);
-            bthread::CountdownEvent countdown(numRoutines);
-            for (auto i = 0; i < numRoutines; i++) {
-                util::PushEmergencyTask(wp.get(), [&, start=i << 1] {
-                    for (auto j = start; j < prevLen; j += (numRoutines << 1)) {
-                        (*buf2)[j >> 1] = Config::HashFunc((*buf1)[j], (*buf1)[j + 1]);
-                    }
-                    countdown.signal();
-                });
-            }
+            MerkleTree::HashLevel(buf1->data(), buf2->data(), prevLen >> 1, wp.get(), config.NumRoutines);
             buf1 = buf2;
             proofGenBufList.push_back(std::make_unique<std::vector<HashString>>(prevLen >> 1));
             buf2 = proofGenBufList.back().get();
             prevLen >>= 1;
-            countdown.wait();
-            // do not modify buf1 until all workers finished.
             pmt::MerkleTree::fixOdd(*buf1, prevLen);
             this->updateProofsParallel(*buf1, prevLen, step);
         }
         Root = Config::HashFunc((*buf1)[0], (*buf1)[1]);
     }
 
+    void MerkleTree::HashLevel(const HashString* children, HashString* parents, int parentCount,
+                               util::thread_pool_light* wp, int numRoutines) {
+        numRoutines = MerkleTree::calculateNumRoutine(numRoutines, parentCount << 1);
+        if (numRoutines == 1) {
+            util::sha256::HashNodes(children, parents, parentCount);
+            return;
+        }
+        const int chunkSize = (parentCount + numRoutines - 1) / numRoutines;
+        bthread::CountdownEvent countdown(numRoutines);
+        for (auto i = 0; i < numRoutines; i++) {
+            const int start = std::min(i * chunkSize, parentCount);
+            const int end = std::min(start + chunkSize, parentCount);
+            util::PushEmergencyTask(wp, [&, start=start, end=end] {
+                util::sha256::HashNodes(children + 2 * start, parents + start, end - start);
+                countdown.signal();
+            });
+        }
+        countdown.wait();
+    }
+
     void MerkleTree::updateProofsParallel(const std::vector<HashString> &buf, int bufLen, int step) {
         auto batch = 1 << step;
 
@@ -251,23 +260,9 @@ namespace pmt {
         for (uint32_t i = 0; i < Depth - 1; i++) {
             this->tree[i + 1] = std::vector<HashString>(prevLen >> 1);
             if (config.RunInParallel) {
-                auto numRoutines = MerkleTree::calculateNumRoutine(config.NumRoutines, prevLen);
-                bthread::CountdownEvent countdown(numRoutines);
-                for (auto j = 0; j < numRoutines; j++) {
-                    // ----in the original version, numRoutines==config::NumRoutines----
-                    util::PushEmergencyTask(wp.get(), [this, start=j << 1, prevLen=prevLen, numRoutines=numRoutines, depth=i, &countdown] {
-                        for (auto k = start; k < prevLen; k += (numRoutines << 1)) {
-                            this->tree[depth + 1][k >> 1] = Config::HashFunc(this->tree[depth][k], this->tree[depth][k + 1]);
-                        }
-                        countdown.signal();
-                    });
-                    // -----------------------------------------------------------------
-                }
-                countdown.wait();
+                MerkleTree::HashLevel(tree[i].data(), tree[i + 1].data(), prevLen >> 1, wp.get(), config.NumRoutines);
             } else {
-                for (auto j = 0; j < prevLen; j += 2) {
-                    this->tree[i + 1][j >> 1] = Config::HashFunc(tree[i][j], tree[i][j + 1]);
-                }
+                MerkleTree::HashLevel(tree[i].data(), tree[i + 1].data(), prevLen >> 1, nullptr, 1);
             }
             prevLen = (int) this->tree[i + 1].size();
             pmt::MerkleTree::fixOdd(this->tree[i + 1], prevLen);
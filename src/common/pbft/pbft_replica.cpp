@@ -0,0 +1,1047 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "common/pbft/pbft_replica.h"
+#include "common/crypto.h"
+#include <limits>
+
+namespace util::pbft {
+    std::unique_ptr<PBFTReplica> PBFTReplica::NewPBFTReplica(Config config,
+                                                             std::shared_ptr<util::BCCSP> bccsp,
+                                                             std::shared_ptr<util::thread_pool_light> threadPool,
+                                                             std::shared_ptr<PBFTStateMachine> stateMachine) {
+        if (config.localId < 0 || config.localId >= (int)config.nodes.size()) {
+            LOG(ERROR) << "Local id is out of range: " << config.localId;
+            return nullptr;
+        }
+        for (int i = 0; i < (int)config.nodes.size(); i++) {
+            if (config.nodes[i]->nodeId != i) {
+                LOG(ERROR) << "The nodes must be ordered by node id!";
+                return nullptr;
+            }
+        }
+        config.pipelineDepth = std::max(config.pipelineDepth, 1);
+        config.heartbeatIntervalMs = std::max(config.heartbeatIntervalMs, 1);
+        config.viewChangeTimeoutMs = std::max(config.viewChangeTimeoutMs, config.heartbeatIntervalMs * 2);
+        config.maxBatchSize = std::max(config.maxBatchSize, 1);
+        std::unique_ptr<PBFTReplica> replica(new PBFTReplica(std::move(config), std::move(bccsp),
+                                                             std::move(threadPool), std::move(stateMachine)));
+        for (const auto& it: replica->_config.nodes) {
+            auto key = replica->_bccsp->GetKey(it->ski);
+            if (key == nullptr) {
+                LOG(ERROR) << "Can not load key, ski: " << it->ski;
+                return nullptr;
+            }
+            replica->_skiToId[it->ski] = it->nodeId;
+            replica->_keys.push_back(std::move(key));
+        }
+        if (!replica->_keys[replica->_config.localId]->Private()) {
+            LOG(ERROR) << "Can not load the private key of the local node.";
+            return nullptr;
+        }
+        return replica;
+    }
+
+    PBFTReplica::PBFTReplica(Config config, std::shared_ptr<util::BCCSP> bccsp,
+                             std::shared_ptr<util::thread_pool_light> threadPool,
+                             std::shared_ptr<PBFTStateMachine> stateMachine)
+            : _config(std::move(config)), _f(((int)_config.nodes.size() - 1) / 3), _bccsp(std::move(bccsp)),
+              _threadPool(std::move(threadPool)), _stateMachine(std::move(stateMachine)), _ready(1) {
+        const auto n = _config.nodes.size();
+        _heard = std::vector<bool>(n, false);
+        _peerView = std::vector<int>(n, 0);
+        _peerDelivered = std::vector<int64_t>(n, 0);
+        _peerHeardAt = std::vector<Clock::time_point>(n);
+        _peerViewChange = std::vector<int>(n, 0);
+    }
+
+    PBFTReplica::~PBFTReplica() {
+        stop();
+    }
+
+    void PBFTReplica::start() {
+        if (_running.exchange(true)) {
+            return;
+        }
+        auto now = Clock::now();
+        _leaderHeardAt = now;
+        _heartbeatAt = now - std::chrono::milliseconds(_config.heartbeatIntervalMs);
+        _retransmitAt = now;
+        _appThread = std::make_unique<std::thread>(&PBFTReplica::runApp, this);
+        _proposerThread = std::make_unique<std::thread>(&PBFTReplica::runProposer, this);
+        _eventThread = std::make_unique<std::thread>(&PBFTReplica::run, this);
+    }
+
+    void PBFTReplica::stop() {
+        {
+            std::unique_lock lock(_proposeMutex);
+            if (!_running) {
+                return;
+            }
+            _running = false;
+        }
+        _proposeCV.notify_all();
+        if (_eventThread) {
+            _eventThread->join();
+        }
+        // the proposer may wait for OnRequestProposal
+        if (_proposerThread) {
+            _proposerThread->join();
+        }
+        _appQueue.enqueue(nullptr);
+        if (_appThread) {
+            _appThread->join();
+        }
+    }
+
+    void PBFTReplica::run() {
+        pthread_setname_np(pthread_self(), "pbft_event");
+        if (LeaderOf(0) == _config.localId) {
+            startLeading();
+        }
+        std::vector<Event> events(_config.maxBatchSize);
+        const auto tick = std::chrono::milliseconds(std::max(_config.heartbeatIntervalMs / 4, 1));
+        while (_running) {
+            auto count = _queue.wait_dequeue_bulk_timed(events.begin(), events.size(), tick);
+            handleEvents(events, count);
+            onTimer();
+        }
+    }
+
+    void PBFTReplica::runApp() {
+        pthread_setname_np(pthread_self(), "pbft_app");
+        while (true) {
+            std::function<void()> task;
+            _appQueue.wait_dequeue(task);
+            if (task == nullptr) {
+                break;
+            }
+            task();
+        }
+    }
+
+    void PBFTReplica::runProposer() {
+        pthread_setname_np(pthread_self(), "pbft_propose");
+        const auto& localNode = _config.nodes[_config.localId];
+        while (true) {
+            int view;
+            {
+                std::unique_lock lock(_proposeMutex);
+                _proposeCV.wait(lock, [&] {
+                    return !_running || (_proposeView != -1 && _inFlight < _config.pipelineDepth);
+                });
+                if (!_running) {
+                    break;
+                }
+                view = _proposeView;
+                _inFlight++;
+            }
+            // the sequence is a hint, the event thread assigns the sequence
+            auto proposal = _stateMachine->OnRequestProposal(localNode, (int)getLastDelivered() + 1, {});
+            std::unique_ptr<proto::Block::SignaturePair> signature;
+            if (proposal != std::nullopt) {
+                signature = _stateMachine->OnSignProposal(localNode, *proposal);
+            }
+            if (proposal == std::nullopt || signature == nullptr) {
+                {
+                    std::unique_lock lock(_proposeMutex);
+                    if (_proposeView == view) {
+                        _inFlight--;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            _queue.enqueue(Event{Event::PROPOSED, view, -1, true, std::move(*proposal), std::move(signature)});
+        }
+    }
+
+    bool PBFTReplica::ParseMessage(std::string_view raw, proto::PBFTMessage* message, std::string_view* body, proto::DigestString* signature) {
+        constexpr auto signatureSize = std::tuple_size_v<proto::DigestString>;
+        if (raw.size() < signatureSize) {
+            return false;
+        }
+        *body = raw.substr(0, raw.size() - signatureSize);
+        std::memcpy(signature->data(), raw.data() + body->size(), signatureSize);
+        return message->deserializeFromString(*body);
+    }
+
+    std::string PBFTReplica::send(const proto::PBFTMessage& message) {
+        std::string raw;
+        raw.reserve(message.payload.size() + 256);
+        if (!message.serializeToString(&raw)) {
+            LOG(ERROR) << "Serialize message failed, type: " << message.type;
+            return {};
+        }
+        auto signature = _keys[_config.localId]->SignRaw(raw.data(), raw.size());
+        CHECK(signature != std::nullopt) << "Sign message failed!";
+        raw.append(reinterpret_cast<const char*>(signature->data()), signature->size());
+        if (_broadcast) {
+            _broadcast(raw);
+        }
+        return raw;
+    }
+
+    std::optional<proto::DigestString> PBFTReplica::signVote(int view, int64_t sequence, const proto::HashString& digest) {
+        std::string voteBytes;
+        if (!proto::PBFTVote{view, sequence, digest}.serializeToString(&voteBytes)) {
+            LOG(ERROR) << "Serialize vote failed.";
+            return std::nullopt;
+        }
+        auto signature = _keys[_config.localId]->SignRaw(voteBytes.data(), voteBytes.size());
+        LOG_IF(ERROR, signature == std::nullopt) << "Sign vote failed, sequence: " << sequence;
+        return signature;
+    }
+
+    void PBFTReplica::handleEvents(std::vector<Event>& events, size_t count) {
+        // verify the signatures of the messages in a batch
+        std::vector<proto::PBFTMessage> messages(count);
+        std::vector<proto::DigestString> signatures(count);
+        std::vector<bool> valid(count, false);
+        std::vector<util::VerifyRawRequest> requests;
+        std::vector<int> index;
+        for (int i = 0; i < (int)count; i++) {
+            if (events[i].type != Event::MESSAGE) {
+                continue;
+            }
+            std::string_view body;
+            if (!ParseMessage(events[i].raw, &messages[i], &body, &signatures[i])) {
+                LOG(WARNING) << "Can not parse message.";
+                continue;
+            }
+            const auto sender = messages[i].sender;
+            if (sender < 0 || sender >= (int)_config.nodes.size()) {
+                LOG(WARNING) << "Sender is out of range: " << sender;
+                continue;
+            }
+            requests.push_back({_keys[sender], &signatures[i], body.data(), body.size()});
+            index.push_back(i);
+            valid[i] = true;
+        }
+        if (!requests.empty()) {
+            std::vector<int> invalid;
+            if (!util::BCCSP::VerifyRawBatch(requests, &invalid, _threadPool.get())) {
+                for (auto it: invalid) {
+                    LOG(WARNING) << "Invalid message signature, sender: " << messages[index[it]].sender;
+                    valid[index[it]] = false;
+                }
+            }
+        }
+        for (int i = 0; i < (int)count; i++) {
+            auto& event = events[i];
+            switch (event.type) {
+                case Event::MESSAGE:
+                    if (valid[i]) {
+                        onMessage(messages[i], event.raw);
+                    }
+                    break;
+                case Event::PROPOSED:
+                    onProposed(event);
+                    break;
+                case Event::VERIFIED:
+                    onVerified(event);
+                    break;
+                case Event::DELIVERED:
+                    onDelivered(event.sequence);
+                    break;
+            }
+        }
+    }
+
+    void PBFTReplica::onMessage(const proto::PBFTMessage& message, std::string& raw) {
+        const auto sender = message.sender;
+        if (!_heard[sender]) {
+            _heard[sender] = true;
+            if (!_isReady && std::count(_heard.begin(), _heard.end(), true) >= quorum()) {
+                _isReady = true;
+                _ready.signal();
+            }
+        }
+        if (message.view == _view && sender == LeaderOf(message.view)) {
+            _leaderHeardAt = Clock::now();
+        }
+        switch (message.type) {
+            case proto::PBFTMessage::PRE_PREPARE:
+                return onPrePrepare(message);
+            case proto::PBFTMessage::PREPARE:
+                return onPrepare(message);
+            case proto::PBFTMessage::COMMIT:
+                return onCommit(message);
+            case proto::PBFTMessage::VIEW_CHANGE:
+                return onViewChange(message, raw);
+            case proto::PBFTMessage::NEW_VIEW:
+                return onNewView(message, raw);
+            case proto::PBFTMessage::HEARTBEAT:
+                return onHeartbeat(message);
+            default:
+                LOG(WARNING) << "Unknown message type: " << message.type;
+        }
+    }
+
+    PBFTReplica::Slot& PBFTReplica::getSlot(int64_t sequence, int view) {
+        auto& slot = _slots[sequence];
+        if (slot.view != view) {
+            auto certificate = std::move(slot.certificate);
+            slot = Slot{};
+            slot.view = view;
+            slot.since = Clock::now();
+            slot.certificate = std::move(certificate);
+        }
+        return slot;
+    }
+
+    PBFTReplica::Slot* PBFTReplica::getVotingSlot(int64_t sequence) {
+        if (sequence > _lastScheduled + MAX_PENDING || sequence <= _lastScheduled - KEEP_DELIVERED) {
+            return nullptr;
+        }
+        if (sequence > _lastScheduled) {
+            return &getSlot(sequence);
+        }
+        auto it = _slots.find(sequence);
+        if (it == _slots.end() || it->second.view != _view || !it->second.hasProposal) {
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    void PBFTReplica::onProposed(Event& event) {
+        if (event.view != _view || _inViewChange) {
+            LOG(INFO) << "Drop the proposal of view: " << event.view << ", current view: " << _view;
+            return;
+        }
+        auto digest = util::OpenSSLSHA256::generateDigest(event.raw.data(), event.raw.size());
+        if (digest == std::nullopt) {
+            LOG(ERROR) << "Calculate proposal digest failed.";
+            return;
+        }
+        const auto sequence = _nextSequence++;
+        auto voteSignature = signVote(event.view, sequence, *digest);
+        if (voteSignature == std::nullopt) {
+            return;
+        }
+        auto& slot = getSlot(sequence);
+        slot.hasProposal = true;
+        slot.proposal = event.raw;
+        slot.digest = *digest;
+        slot.proposedLocally = true;
+        // the signature of the leader is its prepare, it is verified with the others
+        slot.prepares.insert_or_assign(_config.localId, Vote{*digest, event.signature->second, *voteSignature, false});
+        proto::PBFTMessage message{proto::PBFTMessage::PRE_PREPARE, event.view, sequence, _config.localId,
+                                   *digest, std::move(event.raw), {std::move(*event.signature)}, *voteSignature};
+        slot.sent.push_back(send(message));
+        tryAccept();
+        tryPrepare(sequence);
+    }
+
+    void PBFTReplica::onPrePrepare(const proto::PBFTMessage& message) {
+        if (_inViewChange && message.view == _installedView) {
+            return onCatchUp(message);
+        }
+        if (message.view != _view || _inViewChange || message.sender != LeaderOf(message.view) ||
+            message.sequence <= _lastScheduled || message.sequence > _lastScheduled + MAX_PENDING) {
+            return;
+        }
+        if (message.signatures.size() != 1 || message.signatures[0].second.ski != _config.nodes[message.sender]->ski) {
+            LOG(WARNING) << "Invalid pre-prepare signature, sender: " << message.sender;
+            return;
+        }
+        auto digest = util::OpenSSLSHA256::generateDigest(message.payload.data(), message.payload.size());
+        if (digest == std::nullopt || *digest != message.digest) {
+            LOG(WARNING) << "Invalid pre-prepare digest, sequence: " << message.sequence;
+            return;
+        }
+        auto& slot = getSlot(message.sequence);
+        if (slot.hasProposal) {
+            LOG_IF(WARNING, slot.digest != message.digest) << "Conflicting pre-prepare, view: " << message.view
+                                                            << ", sequence: " << message.sequence;
+            return;
+        }
+        slot.hasProposal = true;
+        slot.proposal = message.payload;
+        slot.digest = message.digest;
+        slot.prepares.insert_or_assign(message.sender, Vote{message.digest, message.signatures[0].second, message.voteSignature, false});
+        tryAccept();
+        tryPrepare(message.sequence);
+    }
+
+    void PBFTReplica::onPrepare(const proto::PBFTMessage& message) {
+        if (_inViewChange && message.view == _installedView) {
+            return onCatchUp(message);
+        }
+        if (message.view != _view || _inViewChange) {
+            return;
+        }
+        if (message.signatures.size() != 1 || message.signatures[0].second.ski != _config.nodes[message.sender]->ski) {
+            LOG(WARNING) << "Invalid prepare signature, sender: " << message.sender;
+            return;
+        }
+        auto* slot = getVotingSlot(message.sequence);
+        if (slot == nullptr) {
+            return;
+        }
+        slot->prepares.emplace(message.sender, Vote{message.digest, message.signatures[0].second, message.voteSignature, false});
+        tryPrepare(message.sequence);
+    }
+
+    void PBFTReplica::onCommit(const proto::PBFTMessage& message) {
+        if (_inViewChange && message.view == _installedView) {
+            return onCatchUp(message);
+        }
+        if (message.view != _view || _inViewChange) {
+            return;
+        }
+        auto* slot = getVotingSlot(message.sequence);
+        if (slot == nullptr) {
+            return;
+        }
+        slot->commits.emplace(message.sender, message.digest);
+        tryCommit(message.sequence);
+    }
+
+    void PBFTReplica::onHeartbeat(const proto::PBFTMessage& message) {
+        _peerView[message.sender] = message.view;
+        _peerDelivered[message.sender] = message.sequence;
+        _peerHeardAt[message.sender] = Clock::now();
+    }
+
+    void PBFTReplica::tryAccept() {
+        while (true) {
+            auto it = _slots.find(_acceptNext);
+            if (it == _slots.end() || it->second.view != _view || !it->second.hasProposal) {
+                return;
+            }
+            auto& slot = it->second;
+            const auto sequence = _acceptNext++;
+            if (slot.accepted || slot.verifying) {
+                continue;
+            }
+            if (slot.proposedLocally) {
+                slot.accepted = true;   // PRE_PREPARE carries the signature
+                continue;
+            }
+            if (sequence <= _lastScheduled) {
+                // re-proposed in a new view, but it is delivered locally, sign it directly
+                auto signature = _keys[_config.localId]->Sign(slot.proposal.data(), slot.proposal.size());
+                if (signature == std::nullopt) {
+                    LOG(ERROR) << "Sign proposal failed, sequence: " << sequence;
+                    continue;
+                }
+                accept(sequence, slot, proto::SignatureString{_config.nodes[_config.localId]->ski, *signature});
+                continue;
+            }
+            slot.verifying = true;
+            postApp([this, view = slot.view, sequence, proposal = slot.proposal] {
+                const auto& localNode = _config.nodes[_config.localId];
+                auto success = _stateMachine->OnVerifyProposal(localNode, proposal);
+                // always take the signature, otherwise it is left in the signature cache of the state machine
+                auto signature = _stateMachine->OnSignProposal(localNode, proposal);
+                success = success && signature != nullptr;
+                _queue.enqueue(Event{Event::VERIFIED, view, sequence, success, {}, std::move(signature)});
+            });
+        }
+    }
+
+    void PBFTReplica::onVerified(Event& event) {
+        auto it = _slots.find(event.sequence);
+        if (event.view != _view || it == _slots.end() || it->second.view != event.view) {
+            return;
+        }
+        auto& slot = it->second;
+        slot.verifying = false;
+        if (!event.success) {
+            LOG(WARNING) << "Verify proposal failed, view: " << event.view << ", sequence: " << event.sequence;
+            _acceptNext = std::min(_acceptNext, event.sequence);    // retry later
+            return;
+        }
+        accept(event.sequence, slot, event.signature->second);
+    }
+
+    void PBFTReplica::accept(int64_t sequence, Slot& slot, const proto::SignatureString& signature) {
+        auto voteSignature = signVote(slot.view, sequence, slot.digest);
+        if (voteSignature == std::nullopt) {
+            return;
+        }
+        slot.accepted = true;
+        slot.prepares.insert_or_assign(_config.localId, Vote{slot.digest, signature, *voteSignature, false});
+        proto::PBFTMessage message{proto::PBFTMessage::PREPARE, slot.view, sequence, _config.localId,
+                                   slot.digest, {}, {proto::Block::SignaturePair{{}, signature}}, *voteSignature};
+        slot.sent.push_back(send(message));
+        tryPrepare(sequence);
+    }
+
+    void PBFTReplica::tryPrepare(int64_t sequence) {
+        auto it = _slots.find(sequence);
+        if (it == _slots.end()) {
+            return;
+        }
+        auto& slot = it->second;
+        if (!slot.hasProposal || !slot.accepted || slot.prepared || !verifyPrepares(sequence, slot)) {
+            return;
+        }
+        slot.prepared = true;
+        setCertificate(sequence, slot);
+        slot.commits.insert_or_assign(_config.localId, slot.digest);
+        proto::PBFTMessage message{proto::PBFTMessage::COMMIT, slot.view, sequence, _config.localId, slot.digest, {}, {}};
+        slot.sent.push_back(send(message));
+        tryCommit(sequence);
+    }
+
+    bool PBFTReplica::verifyPrepares(int64_t sequence, Slot& slot) {
+        auto countMatched = [&]() {
+            return std::count_if(slot.prepares.begin(), slot.prepares.end(), [&](const auto& v) {
+                return v.second.digest == slot.digest;
+            });
+        };
+        if (countMatched() < quorum()) {
+            return false;
+        }
+        // verify the signatures of the votes lazily, in a batch, the matching votes sign the same vote bytes
+        std::string voteBytes;
+        if (!proto::PBFTVote{slot.view, sequence, slot.digest}.serializeToString(&voteBytes)) {
+            LOG(ERROR) << "Serialize vote failed.";
+            return false;
+        }
+        std::vector<util::VerifyRawRequest> requests;
+        std::vector<int> senders;
+        for (const auto& [sender, vote]: slot.prepares) {
+            if (!vote.verified && vote.digest == slot.digest) {
+                requests.push_back({_keys[sender], &vote.signature.digest, slot.digest.data(), slot.digest.size()});
+                requests.push_back({_keys[sender], &vote.voteSignature, voteBytes.data(), voteBytes.size()});
+                senders.push_back(sender);
+                senders.push_back(sender);
+            }
+        }
+        if (!requests.empty()) {
+            std::vector<int> invalid;
+            util::BCCSP::VerifyRawBatch(requests, &invalid, _threadPool.get());
+            for (auto i: invalid) {
+                LOG(WARNING) << "Invalid prepare signature, sender: " << senders[i] << ", sequence: " << sequence;
+                slot.prepares.erase(senders[i]);
+            }
+            for (auto& [sender, vote]: slot.prepares) {
+                vote.verified = vote.verified || vote.digest == slot.digest;
+            }
+            return countMatched() >= quorum();
+        }
+        return true;
+    }
+
+    void PBFTReplica::setCertificate(int64_t sequence, Slot& slot) {
+        auto certificate = std::make_unique<proto::PBFTCertificate>();
+        certificate->view = slot.view;
+        certificate->sequence = sequence;
+        certificate->proposal = slot.proposal;
+        for (const auto& [sender, vote]: slot.prepares) {
+            if (vote.digest == slot.digest && (int)certificate->signatures.size() < quorum()) {
+                certificate->signatures.emplace_back(std::string{}, vote.signature);
+                certificate->voteSignatures.push_back(vote.voteSignature);
+            }
+        }
+        slot.certificate = std::move(certificate);
+    }
+
+    void PBFTReplica::tryCommit(int64_t sequence) {
+        auto it = _slots.find(sequence);
+        if (it == _slots.end()) {
+            return;
+        }
+        auto& slot = it->second;
+        if (!slot.prepared || slot.committed || CountCommits(slot) < quorum()) {
+            return;
+        }
+        slot.committed = true;
+        tryDeliver();
+    }
+
+    void PBFTReplica::onCatchUp(const proto::PBFTMessage& message) {
+        if (message.sequence <= _lastScheduled || message.sequence > _lastScheduled + MAX_PENDING) {
+            return;
+        }
+        if (message.type != proto::PBFTMessage::COMMIT &&
+            (message.signatures.size() != 1 || message.signatures[0].second.ski != _config.nodes[message.sender]->ski)) {
+            LOG(WARNING) << "Invalid prepare signature, sender: " << message.sender;
+            return;
+        }
+        auto& slot = getSlot(message.sequence, message.view);
+        switch (message.type) {
+            case proto::PBFTMessage::PRE_PREPARE: {
+                if (message.sender != LeaderOf(message.view) || slot.hasProposal) {
+                    return;
+                }
+                auto digest = util::OpenSSLSHA256::generateDigest(message.payload.data(), message.payload.size());
+                if (digest == std::nullopt || *digest != message.digest) {
+                    LOG(WARNING) << "Invalid pre-prepare digest, sequence: " << message.sequence;
+                    return;
+                }
+                slot.hasProposal = true;
+                slot.proposal = message.payload;
+                slot.digest = message.digest;
+                slot.prepares.insert_or_assign(message.sender, Vote{message.digest, message.signatures[0].second, message.voteSignature, false});
+                break;
+            }
+            case proto::PBFTMessage::PREPARE:
+                slot.prepares.emplace(message.sender, Vote{message.digest, message.signatures[0].second, message.voteSignature, false});
+                break;
+            default:
+                slot.commits.emplace(message.sender, message.digest);
+        }
+        // the proposals with a quorum of prepares and commits are committed, no matter the local votes
+        while (true) {
+            auto it = _slots.find(_lastScheduled + 1);
+            if (it == _slots.end() || it->second.view != _installedView || !it->second.hasProposal) {
+                break;
+            }
+            auto& next = it->second;
+            if (CountCommits(next) < quorum() || !verifyPrepares(it->first, next)) {
+                break;
+            }
+            next.prepared = true;
+            next.committed = true;
+            setCertificate(it->first, next);
+            tryDeliver();
+        }
+    }
+
+    void PBFTReplica::tryDeliver() {
+        while (true) {
+            auto it = _slots.find(_lastScheduled + 1);
+            if (it == _slots.end() || it->second.view != _installedView || !it->second.committed) {
+                break;
+            }
+            const auto sequence = ++_lastScheduled;
+            const auto& slot = it->second;
+            postApp([this, sequence, proposal = slot.proposal, signatures = slot.certificate->signatures]() mutable {
+                if (!_stateMachine->OnDeliver(_config.nodes[_config.localId], proposal, std::move(signatures))) {
+                    LOG(ERROR) << "Deliver proposal failed, sequence: " << sequence;
+                }
+                _queue.enqueue(Event{Event::DELIVERED, -1, sequence, true, {}, nullptr});
+            });
+        }
+        // OnLeaderStart is executed after delivering the re-proposed proposals
+        if (_pendingLeaderStart != -1 && _lastScheduled >= _pendingLeaderStart) {
+            startLeading();
+        }
+    }
+
+    void PBFTReplica::onDelivered(int64_t sequence) {
+        _lastDelivered.store(sequence, std::memory_order_release);
+        if (sequence > _backoffUntil) {
+            _viewChangeBackoff = 1;
+        }
+        auto it = _slots.find(sequence);
+        if (it != _slots.end() && it->second.proposedLocally && it->second.view == _view) {
+            {
+                std::unique_lock lock(_proposeMutex);
+                if (_proposeView == _view) {
+                    _inFlight = std::max(_inFlight - 1, 0);
+                }
+            }
+            _proposeCV.notify_all();
+        }
+        _slots.erase(_slots.begin(), _slots.lower_bound(sequence - KEEP_DELIVERED + 1));
+    }
+
+    void PBFTReplica::startLeading() {
+        _pendingLeaderStart = -1;
+        const auto view = _view.load(std::memory_order_relaxed);
+        LOG(INFO) << "Replica " << _config.localId << " starts leading view: " << view << ", next sequence: " << _nextSequence;
+        postApp([this, view, sequence = _nextSequence] {
+            _stateMachine->OnLeaderStart(_config.nodes[_config.localId], (int)sequence);
+            {
+                std::unique_lock lock(_proposeMutex);
+                if (_view.load(std::memory_order_acquire) == view) {
+                    _proposeView = view;
+                    _inFlight = 0;
+                }
+            }
+            _proposeCV.notify_all();
+        });
+    }
+
+    void PBFTReplica::startViewChange(int view) {
+        if (view <= _view) {
+            return;
+        }
+        LOG(WARNING) << "Replica " << _config.localId << " starts view change, view: " << view
+                     << ", last scheduled: " << _lastScheduled;
+        {
+            std::unique_lock lock(_proposeMutex);
+            _view.store(view, std::memory_order_release);
+            _proposeView = -1;
+            _inFlight = 0;
+        }
+        if (_lastScheduled <= _backoffUntil) {
+            // the former view did not make progress
+            _viewChangeBackoff = std::min(_viewChangeBackoff * 2, MAX_VIEW_CHANGE_BACKOFF);
+        }
+        _backoffUntil = std::numeric_limits<int64_t>::max();
+        _inViewChange = true;
+        _viewChangeAt = Clock::now();
+        _pendingLeaderStart = -1;
+        _newView.clear();
+        _newViewSent = false;
+        sendViewChange();
+        _peerViewChange[_config.localId] = view;
+        trySendNewView();
+    }
+
+    void PBFTReplica::sendViewChange() {
+        const auto view = _view.load(std::memory_order_relaxed);
+        proto::PBFTViewChange viewChange;
+        viewChange.delivered = _lastScheduled;
+        for (const auto& [sequence, slot]: _slots) {
+            if (slot.certificate != nullptr && sequence > _lastScheduled - KEEP_DELIVERED) {
+                viewChange.certificates.push_back(*slot.certificate);
+            }
+        }
+        std::string payload;
+        if (!viewChange.serializeToString(&payload)) {
+            LOG(ERROR) << "Serialize view change failed.";
+            return;
+        }
+        proto::PBFTMessage message{proto::PBFTMessage::VIEW_CHANGE, view, _lastScheduled, _config.localId, {}, std::move(payload), {}};
+        _localViewChange = send(message);
+        _viewChanges[view][_config.localId] = _localViewChange;
+    }
+
+    void PBFTReplica::onViewChange(const proto::PBFTMessage& message, std::string& raw) {
+        if (message.view < _view) {
+            return;     // the leader resends NEW_VIEW to the replicas in the former views
+        }
+        if (message.view == _view && !_inViewChange) {
+            // the replica missed NEW_VIEW of the current view
+            if (LeaderOf(_view) == _config.localId && !_newView.empty() && _broadcast) {
+                _broadcast(_newView);
+            }
+            return;
+        }
+        _viewChanges[message.view][message.sender] = std::move(raw);
+        _peerViewChange[message.sender] = std::max(_peerViewChange[message.sender], message.view);
+        // join the view change if f+1 replicas want a higher view, at least one of them is correct
+        std::vector<int> views;
+        for (auto it: _peerViewChange) {
+            if (it > _view) {
+                views.push_back(it);
+            }
+        }
+        if ((int)views.size() >= _f + 1) {
+            std::sort(views.begin(), views.end(), std::greater<>());
+            startViewChange(views[_f]);
+        }
+        trySendNewView();
+    }
+
+    void PBFTReplica::trySendNewView() {
+        if (!_inViewChange || _newViewSent || LeaderOf(_view) != _config.localId) {
+            return;
+        }
+        auto it = _viewChanges.find(_view);
+        if (it == _viewChanges.end() || (int)it->second.size() < quorum()) {
+            return;
+        }
+        proto::PBFTNewView newView;
+        for (const auto& vc: it->second) {
+            newView.viewChanges.push_back(vc.second);
+            if ((int)newView.viewChanges.size() == quorum()) {
+                break;
+            }
+        }
+        std::string payload;
+        if (!newView.serializeToString(&payload)) {
+            LOG(ERROR) << "Serialize new view failed.";
+            return;
+        }
+        _newViewSent = true;
+        proto::PBFTMessage message{proto::PBFTMessage::NEW_VIEW, _view, 0, _config.localId, {}, std::move(payload), {}};
+        auto raw = send(message);
+        onNewView(message, raw);
+    }
+
+    bool PBFTReplica::verifyCertificate(const proto::PBFTCertificate& certificate) {
+        if (certificate.voteSignatures.size() != certificate.signatures.size()) {
+            return false;
+        }
+        auto digest = util::OpenSSLSHA256::generateDigest(certificate.proposal.data(), certificate.proposal.size());
+        if (digest == std::nullopt) {
+            return false;
+        }
+        // the quorum must have signed the view and the sequence of the certificate, not only the proposal
+        std::string voteBytes;
+        if (!proto::PBFTVote{certificate.view, certificate.sequence, *digest}.serializeToString(&voteBytes)) {
+            return false;
+        }
+        std::vector<bool> signers(_config.nodes.size(), false);
+        std::vector<util::VerifyRawRequest> requests;
+        for (int i = 0; i < (int)certificate.signatures.size(); i++) {
+            const auto& it = certificate.signatures[i];
+            auto id = _skiToId.find(it.second.ski);
+            if (id == _skiToId.end() || signers[id->second]) {
+                continue;
+            }
+            signers[id->second] = true;
+            requests.push_back({_keys[id->second], &it.second.digest, digest->data(), digest->size()});
+            requests.push_back({_keys[id->second], &certificate.voteSignatures[i], voteBytes.data(), voteBytes.size()});
+        }
+        if ((int)requests.size() < 2 * quorum()) {
+            return false;
+        }
+        return util::BCCSP::VerifyRawBatch(requests, nullptr, _threadPool.get());
+    }
+
+    bool PBFTReplica::computeNewViewPlan(const std::vector<proto::PBFTViewChange>& viewChanges, NewViewPlan* plan) {
+        std::vector<int64_t> delivered;
+        for (const auto& it: viewChanges) {
+            delivered.push_back(it.delivered);
+        }
+        std::sort(delivered.begin(), delivered.end(), std::greater<>());
+        // at least one correct replica delivered the proposals until target
+        const auto target = delivered[_f];
+        // the candidate certificates of each sequence, in the descending order of the view
+        std::map<int64_t, std::vector<const proto::PBFTCertificate*>> candidates;
+        for (const auto& it: viewChanges) {
+            for (const auto& certificate: it.certificates) {
+                if (certificate.sequence > target - KEEP_DELIVERED && certificate.sequence <= target + MAX_PENDING) {
+                    candidates[certificate.sequence].push_back(&certificate);
+                }
+            }
+        }
+        for (auto& it: candidates) {
+            std::stable_sort(it.second.begin(), it.second.end(), [](const auto* lhs, const auto* rhs) {
+                return lhs->view > rhs->view;
+            });
+        }
+        // the valid certificate of the highest view
+        std::map<int64_t, const proto::PBFTCertificate*> selected;
+        auto select = [&](int64_t sequence) -> const proto::PBFTCertificate* {
+            if (auto it = selected.find(sequence); it != selected.end()) {
+                return it->second;
+            }
+            const proto::PBFTCertificate* result = nullptr;
+            if (auto it = candidates.find(sequence); it != candidates.end()) {
+                for (const auto* certificate: it->second) {
+                    if (verifyCertificate(*certificate)) {
+                        result = certificate;
+                        break;
+                    }
+                    LOG(WARNING) << "Invalid certificate, sequence: " << sequence;
+                }
+            }
+            selected[sequence] = result;
+            return result;
+        };
+        // re-propose the contiguous prepared proposals around target, the lagging replicas
+        // (maybe not in the quorum) catch up with the proposals delivered in the last pipeline
+        const auto lowest = std::max<int64_t>(std::min<int64_t>(delivered.back(), target - _config.pipelineDepth), target - KEEP_DELIVERED + 1);
+        plan->start = target + 1;
+        while (plan->start - 1 > std::max<int64_t>(lowest, 0) && select(plan->start - 1) != nullptr) {
+            plan->start--;
+        }
+        plan->end = target;
+        while (select(plan->end + 1) != nullptr) {
+            plan->end++;
+        }
+        plan->certificates.clear();
+        for (auto i = plan->start; i <= plan->end; i++) {
+            plan->certificates.push_back(select(i));
+        }
+        // the proposals before start are delivered by a correct replica, the lagging replica delivers them directly
+        plan->committed.clear();
+        for (auto i = _lastScheduled + 1; i < plan->start; i++) {
+            const auto* certificate = select(i);
+            if (certificate == nullptr) {
+                plan->committed.clear();
+                break;
+            }
+            plan->committed.push_back(certificate);
+        }
+        return true;
+    }
+
+    void PBFTReplica::onNewView(const proto::PBFTMessage& message, std::string& raw) {
+        if (message.sender != LeaderOf(message.view) || message.view < _view || (message.view == _view && !_inViewChange)) {
+            return;
+        }
+        proto::PBFTNewView newView;
+        if (!newView.deserializeFromString(message.payload) || (int)newView.viewChanges.size() < quorum()) {
+            LOG(WARNING) << "Invalid new view, view: " << message.view;
+            return;
+        }
+        const auto n = newView.viewChanges.size();
+        std::vector<proto::PBFTMessage> messages(n);
+        std::vector<proto::DigestString> signatures(n);
+        std::vector<util::VerifyRawRequest> requests;
+        std::vector<proto::PBFTViewChange> viewChanges(n);
+        std::vector<bool> seen(_config.nodes.size(), false);
+        for (int i = 0; i < (int)n; i++) {
+            std::string_view body;
+            auto& vc = messages[i];
+            if (!ParseMessage(newView.viewChanges[i], &vc, &body, &signatures[i]) || vc.type != proto::PBFTMessage::VIEW_CHANGE ||
+                vc.view != message.view || vc.sender < 0 || vc.sender >= (int)_config.nodes.size() || seen[vc.sender] ||
+                !viewChanges[i].deserializeFromString(vc.payload)) {
+                LOG(WARNING) << "Invalid view change in new view, view: " << message.view;
+                return;
+            }
+            seen[vc.sender] = true;
+            requests.push_back({_keys[vc.sender], &signatures[i], body.data(), body.size()});
+        }
+        if (!util::BCCSP::VerifyRawBatch(requests, nullptr, _threadPool.get())) {
+            LOG(WARNING) << "Invalid view change signature in new view, view: " << message.view;
+            return;
+        }
+        NewViewPlan plan;
+        if (!computeNewViewPlan(viewChanges, &plan)) {
+            return;
+        }
+        LOG(INFO) << "Replica " << _config.localId << " installs view: " << message.view
+                  << ", re-propose: [" << plan.start << ", " << plan.end << "]";
+        LOG_IF(ERROR, plan.start > _lastScheduled + 1 + (int64_t)plan.committed.size())
+                        << "The replica is lagging behind, last scheduled: " << _lastScheduled;
+        {
+            std::unique_lock lock(_proposeMutex);
+            _view.store(message.view, std::memory_order_release);
+            _proposeView = -1;
+            _inFlight = 0;
+        }
+        _installedView = message.view;
+        _inViewChange = false;
+        // keep the backoff until the new view makes progress, re-proposing may take long
+        _backoffUntil = plan.end;
+        _leaderHeardAt = Clock::now();
+        _newView = raw;
+        _viewChanges.erase(_viewChanges.begin(), _viewChanges.upper_bound(message.view));
+        // drop the proposals that are not re-proposed
+        for (auto it = _slots.begin(); it != _slots.end();) {
+            if (it->first > _lastScheduled && (it->first < plan.start || it->first > plan.end)) {
+                it = _slots.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        // deliver the committed proposals that the lagging replica missed
+        for (int64_t i = 0; i < (int64_t)plan.committed.size(); i++) {
+            auto& slot = getSlot(_lastScheduled + 1 + i);
+            const auto& certificate = *plan.committed[i];
+            slot.hasProposal = true;
+            slot.proposal = certificate.proposal;
+            slot.digest = util::OpenSSLSHA256::generateDigest(slot.proposal.data(), slot.proposal.size()).value_or(proto::HashString{});
+            slot.prepared = true;
+            slot.committed = true;
+            slot.certificate = std::make_unique<proto::PBFTCertificate>(certificate);
+        }
+        tryDeliver();
+        const auto leader = LeaderOf(message.view);
+        const auto& localNode = _config.nodes[_config.localId];
+        if (leader != _config.localId) {
+            // before verifying the re-proposed proposals
+            postApp([this, localNode, leaderNode = _config.nodes[leader], sequence = plan.start] {
+                _stateMachine->OnLeaderChange(localNode, leaderNode, (int)sequence);
+            });
+        }
+        for (auto i = plan.start; i <= plan.end; i++) {
+            auto& slot = getSlot(i);
+            const auto& proposal = plan.certificates[i - plan.start]->proposal;
+            slot.hasProposal = true;
+            slot.proposal = proposal;
+            slot.digest = util::OpenSSLSHA256::generateDigest(proposal.data(), proposal.size()).value_or(proto::HashString{});
+        }
+        _acceptNext = plan.start;
+        _nextSequence = plan.end + 1;
+        if (leader == _config.localId) {
+            _pendingLeaderStart = plan.end;
+        }
+        tryAccept();
+        tryDeliver();
+    }
+
+    void PBFTReplica::onTimer() {
+        const auto now = Clock::now();
+        const auto heartbeatInterval = std::chrono::milliseconds(_config.heartbeatIntervalMs);
+        if (now - _heartbeatAt >= heartbeatInterval) {
+            _heartbeatAt = now;
+            proto::PBFTMessage message{proto::PBFTMessage::HEARTBEAT, _view, _lastScheduled, _config.localId, {}, {}, {}};
+            send(message);
+        }
+        // retransmitting too often floods the replicas that are slow to verify the messages
+        const auto retransmitInterval = std::max(heartbeatInterval, std::chrono::milliseconds(_config.viewChangeTimeoutMs / 4));
+        if (now - _retransmitAt >= retransmitInterval) {
+            _retransmitAt = now;
+            retransmit(now);
+            tryAccept();    // retry the failed verifications
+        }
+        if (!_isReady) {
+            return;     // the other replicas may not be started
+        }
+        const auto timeout = std::chrono::milliseconds(_config.viewChangeTimeoutMs);
+        if (_inViewChange) {
+            // the leader of the new view may be faulty too, but a replica does not move to
+            // the next view alone, the timer starts when a quorum is in the view change
+            auto it = _viewChanges.find(_view);
+            if (it == _viewChanges.end() || (int)it->second.size() < quorum()) {
+                _viewChangeAt = now;
+            } else if (now - _viewChangeAt > timeout * _viewChangeBackoff) {
+                startViewChange(_view + 1);
+            }
+            return;
+        }
+        if (LeaderOf(_view) == _config.localId) {
+            return;
+        }
+        bool stalled = now - _leaderHeardAt > timeout * _viewChangeBackoff;
+        for (auto it = _slots.upper_bound(_lastScheduled); !stalled && it != _slots.end(); ++it) {
+            const auto& slot = it->second;
+            // a single faulty replica can not create a stalled slot
+            const bool started = slot.hasProposal || (int)slot.prepares.size() > _f || (int)slot.commits.size() > _f;
+            stalled = slot.view == _view && started && !slot.committed && now - slot.since > timeout * _viewChangeBackoff;
+            if (stalled) {
+                // the slot is delivered by at least one correct replica, the local replica is lagging behind
+                // and catches up with the retransmissions
+                int delivered = 0;
+                for (int i = 0; i < (int)_config.nodes.size(); i++) {
+                    if (i != _config.localId && now - _peerHeardAt[i] <= timeout && _peerDelivered[i] >= it->first) {
+                        delivered++;
+                    }
+                }
+                stalled = delivered <= _f;
+            }
+        }
+        if (stalled) {
+            startViewChange(_view + 1);
+        }
+    }
+
+    void PBFTReplica::retransmit(Clock::time_point now) {
+        const auto timeout = std::chrono::milliseconds(_config.viewChangeTimeoutMs);
+        const auto retransmitInterval = std::max(std::chrono::milliseconds(_config.heartbeatIntervalMs), timeout / 4);
+        if (!_broadcast) {
+            return;
+        }
+        if (_inViewChange) {
+            sendViewChange();   // with the proposals delivered by catching up
+            return;
+        }
+        // the messages of the slots that are not delivered by all the live replicas
+        auto minDelivered = _lastScheduled;
+        bool lagging = false;
+        for (int i = 0; i < (int)_config.nodes.size(); i++) {
+            if (i == _config.localId || now - _peerHeardAt[i] > timeout) {
+                continue;
+            }
+            minDelivered = std::min(minDelivered, _peerDelivered[i]);
+            lagging = lagging || _peerView[i] < _view;
+        }
+        for (auto it = _slots.upper_bound(minDelivered); it != _slots.end(); ++it) {
+            const auto& slot = it->second;
+            if (slot.view != _view || now - slot.since < retransmitInterval) {
+                continue;
+            }
+            for (const auto& raw: slot.sent) {
+                _broadcast(raw);
+            }
+        }
+        // the replicas in the former views install the current view
+        if (lagging && !_newView.empty() && LeaderOf(_view) == _config.localId) {
+            _broadcast(_newView);
+        }
+    }
+}
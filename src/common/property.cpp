@@ -98,6 +98,15 @@ namespace util {
         return workerCount;
     }
 
+    int Properties::getCCWorkerCount(const std::string& engine) const {
+        try {
+            return _node[CC_WORKER_COUNT][engine].as<int>();
+        } catch (const YAML::Exception &e) {
+            LOG(INFO) << "Can not find CC_WORKER_COUNT of " << engine << ", leave it to ARIA_WORKER_COUNT.";
+        }
+        return getAriaWorkerCount();
+    }
+
     int Properties::getBCCSPWorkerCount() const {
         // Use all threads can maximize performance
         auto workerCount = std::max((int)std::thread::hardware_concurrency(), 1);
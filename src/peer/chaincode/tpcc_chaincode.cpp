@@ -721,14 +721,14 @@ namespace peer::chaincode {
 
     template<class Key, class Value>
     bool TPCCChaincode::getValue(std::string_view tablePrefix, const Key &key, Value &value) {
-        std::string keyRaw(tablePrefix);
-        zpp::bits::out outKey(keyRaw);
-        outKey.reset(keyRaw.size());
+        keyBuffer.assign(tablePrefix);
+        zpp::bits::out outKey(keyBuffer);
+        outKey.reset(keyBuffer.size());
         if(failure(outKey(key))) {
             return false;
         }
         std::string_view valueSV;
-        if (!orm->get(std::move(keyRaw), &valueSV)) {
+        if (!orm->getSV(keyBuffer, &valueSV)) {
             return false;
         }
         zpp::bits::in inValue(valueSV);
@@ -740,19 +740,18 @@ namespace peer::chaincode {
 
     template<class Key, class Value>
     bool TPCCChaincode::insertIntoTable(std::string_view tablePrefix, const Key &key, const Value &value) {
-        std::string keyRaw(tablePrefix);
-        zpp::bits::out outKey(keyRaw);
-        outKey.reset(keyRaw.size());
+        keyBuffer.assign(tablePrefix);
+        zpp::bits::out outKey(keyBuffer);
+        outKey.reset(keyBuffer.size());
         if(failure(outKey(key))) {
             return false;
         }
-        std::string valueRaw;
-        valueRaw.reserve(256);
-        zpp::bits::out outValue(valueRaw);
+        valueBuffer.clear();
+        zpp::bits::out outValue(valueBuffer);
         if(failure(outValue(value))) {
             return false;
         }
-        orm->put(std::move(keyRaw), std::move(valueRaw));
+        orm->putSV(keyBuffer, valueBuffer);
         return true;
     }
 }
\ No newline at end of file
@@ -0,0 +1,28 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/concurrency_control/cc_engine.h"
+#include "peer/concurrency_control/deterministic/coordinator_impl.h"
+#include "peer/concurrency_control/deterministic/write_based/wb_coordinator.h"
+#include "peer/concurrency_control/serial/serial_coordinator.h"
+#include "peer/concurrency_control/crdt/crdt_coordinator.h"
+#include "peer/concurrency_control/dag/dag_coordinator.h"
+#include "common/property.h"
+
+namespace peer::cc {
+    CCEngineRegistry& CCEngineRegistry::Instance() {
+        static CCEngineRegistry registry = [] {
+            CCEngineRegistry r;
+            r.registerCoordinator<CoordinatorImpl>("aria", [](CoordinatorImpl& cc, const util::Properties& properties) {
+                cc.setAbortFallback(CoordinatorImpl::ParseAbortFallback(properties.getAriaAbortFallback()));
+            });
+            r.registerCoordinator<WBCoordinator>("aria_wb");
+            r.registerCoordinator<serial::SerialCoordinator>("serial");
+            r.registerCoordinator<crdt::CRDTCoordinator>("crdt");
+            r.registerCoordinator<dag::DAGCoordinator>("dag");
+            return r;
+        }();
+        return registry;
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/concurrency_control/key_hint_partitioner.h"
+#include "client/small_bank/small_bank_helper.h"
+#include "client/tpcc/tpcc_helper.h"
+#include "client/tpcc/tpcc_types.h"
+#include "client/ycsb/ycsb_helper.h"
+#include "zpp_bits.h"
+
+namespace peer::cc {
+    std::unique_ptr<KeyHintPartitioner> KeyHintPartitioner::NewDefaultPartitioner(double maxImbalance) {
+        auto partitioner = std::make_unique<KeyHintPartitioner>(maxImbalance);
+        // the first account, amalgamate also touches the second one
+        partitioner->registerExtractor(client::small_bank::InvokeRequestType::SMALL_BANK, [](std::string_view, std::string_view args, uint64_t* hint) {
+            zpp::bits::in in(args);
+            client::small_bank::AccountIDType acctId;
+            if (failure(in(acctId))) {
+                return false;
+            }
+            *hint = (uint64_t)acctId;
+            return true;
+        });
+        // the row key, all functions start with (table, key)
+        partitioner->registerExtractor(client::ycsb::InvokeRequestType::YCSB, [](std::string_view, std::string_view args, uint64_t* hint) {
+            zpp::bits::in in(args);
+            std::string_view table, key;
+            if (failure(in(table, key))) {
+                return false;
+            }
+            *hint = std::hash<std::string_view>()(key);
+            return true;
+        });
+        // the home warehouse, new order and payment both start with the warehouse id
+        partitioner->registerExtractor(client::tpcc::InvokeRequestType::TPCC, [](std::string_view, std::string_view args, uint64_t* hint) {
+            zpp::bits::in in(args);
+            client::tpcc::Integer warehouseId;
+            if (failure(in(warehouseId))) {
+                return false;
+            }
+            *hint = (uint64_t)warehouseId;
+            return true;
+        });
+        return partitioner;
+    }
+}
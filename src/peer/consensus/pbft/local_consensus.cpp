@@ -12,32 +12,44 @@ namespace peer::consensus::v2 {
             : _config(std::move(config)), _running(false) {
         _blockCache = std::make_unique<PBFTBlockCache>();
         _requestReplicator = std::make_unique<RequestReplicator>(RequestReplicator::Config{_config.timeoutMs, _config.maxBatchSize});
-        _requestReplicator->setBatchCallback([this](auto&& item) {
-            return this->pushUnorderedBlock(std::forward<decltype(item)>(item));
+        _requestReplicator->setBatchCallback([this](auto&& item, auto&& builder) {
+            return this->pushUnorderedBlock(std::forward<decltype(item)>(item), std::forward<decltype(builder)>(builder));
         });
     }
 
-    bool LocalConsensus::pushUnorderedBlock(std::vector<std::unique_ptr<proto::Envelop>> batch) {
+    bool LocalConsensus::pushUnorderedBlock(std::vector<std::unique_ptr<proto::Envelop>> batch,
+                                            std::unique_ptr<util::UserRequestMTGenerator::Builder> builder) {
+        DCHECK(builder != nullptr && builder->size() == (int)batch.size());
         std::shared_ptr<::proto::Block> block(new proto::Block);
         block->body.userRequests = std::move(batch);
         const bool isLeader = _isLeader.load(std::memory_order_acquire);
         auto updateBlockDataHash = [&]() -> bool {
-            util::ValidateHandleType validateHandle = nullptr;
+            util::BatchValidateHandleType validateHandle = nullptr;
             if (!isLeader) {    // follower validate the signatures
-                validateHandle = [this](const auto& signature, const auto& hash)->bool {
-                    const auto key = _bccsp->GetKey(signature.ski);
-                    if (key == nullptr) {
-                        LOG(WARNING) << "Can not load key, ski: " << signature.ski;
+                validateHandle = [this](const auto& envelops, const auto& hashes)->bool {
+                    std::vector<util::VerifyRawRequest> requests;
+                    requests.reserve(envelops.size());
+                    for (int i = 0; i < (int)envelops.size(); i++) {
+                        const auto& signature = envelops[i]->getSignature();
+                        auto key = _bccsp->GetKey(signature.ski);
+                        if (key == nullptr) {
+                            LOG(WARNING) << "Can not load key, ski: " << signature.ski;
+                            return false;
+                        }
+                        requests.push_back({std::move(key), &signature.digest, hashes[i].data(), hashes[i].size()});
+                    }
+                    std::vector<int> invalid;
+                    if (!util::BCCSP::VerifyRawBatch(requests, &invalid, _threadPoolForBCCSP.get())) {
+                        LOG(WARNING) << "Invalid signatures in batch: " << invalid.size() << ", first index: " << invalid.front();
                         return false;
                     }
-                    return key->VerifyRaw(signature.digest, hash.data(), hash.size());
+                    return true;
                 };
             }
-            // generate merkle root
-            auto mt = util::UserRequestMTGenerator::GenerateMerkleTree(block->body.userRequests,
-                                                                       validateHandle,
-                                                                       pmt::ModeType::ModeProofGenAndTreeBuild,
-                                                                       _threadPoolForBCCSP);
+            // generate merkle root, the leaves are already hashed by the request replicator
+            auto mt = builder->buildWithBatchValidation(validateHandle,
+                                                        pmt::ModeType::ModeProofGenAndTreeBuild,
+                                                        _threadPoolForBCCSP);
             if (mt == nullptr) {
                 LOG(WARNING) << "Generate merkle tree failed.";
                 return false;
@@ -71,7 +83,7 @@ namespace peer::consensus::v2 {
             return false;
         }
         DLOG(INFO) << "Verify Block, groupId: " << localNode->groupId << " blk number:" << header.number;
-        if (!_blockCache->isDeliveredBlockHeaderValid(header)) {
+        if (!_blockCache->isVerifiedBlockHeaderValid(header)) {
             return false;
         }
         // create signed message
@@ -101,6 +113,7 @@ namespace peer::consensus::v2 {
         }
         DCHECK(block->header.dataHash == header.dataHash);
         block->header = header;
+        _blockCache->setHeaderVerified(std::make_unique<proto::Block::Header>(header));
         return true;
     }
 
@@ -142,6 +155,7 @@ namespace peer::consensus::v2 {
 
     void LocalConsensus::OnLeaderStart(::util::NodeConfigPtr localNode, int) {
         _blockCache->setBlockProposed(_blockCache->getBlockDelivered());
+        _blockCache->setHeaderVerified(nullptr);
         _signatureCache.reset();
         _isLeader = true;
         auto portInfo = _config.getNodeInfo(localNode->nodeId);
@@ -152,6 +166,7 @@ namespace peer::consensus::v2 {
     void LocalConsensus::OnLeaderChange(::util::NodeConfigPtr, ::util::NodeConfigPtr newLeaderNode, int) {
         _isLeader = false;
         _blockCache->setBlockProposed(nullptr); // clear the state
+        _blockCache->setHeaderVerified(nullptr);
         _signatureCache.reset();
         auto portInfo = _config.getNodeInfo(newLeaderNode->nodeId);
         _requestReplicator->startFollower(portInfo->nodeConfig->priIp, portInfo->port);
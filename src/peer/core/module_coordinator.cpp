@@ -7,9 +7,13 @@
 #include "peer/consensus/pbft/single_pbft_controller.h"
 #include "peer/consensus/block_order/block_order.h"
 #include "peer/storage/mr_block_storage.h"
-#include "peer/concurrency_control/deterministic/coordinator_impl.h"
-#include "peer/concurrency_control/crdt/crdt_coordinator.h"
-#include "peer/concurrency_control/serial/serial_coordinator.h"
+#include "peer/concurrency_control/cc_engine.h"
+#include "peer/chaincode/chaincode.h"
+#include "peer/chaincode/crdt/crdt_chaincode.h"
+#include "peer/concurrency_control/execution_pipeline.h"
+#include "common/property.h"
+
+#include <filesystem>
 
 namespace peer::core {
 
@@ -34,14 +38,34 @@ namespace peer::core {
         if (!exists(dbPath) && !create_directories(dbPath)) {
             return nullptr; // create directory failed
         }
-        mc->_db = peer::db::DBConnection::NewConnection(dbPath);
+        auto dbProperties = properties->getDBProperties();
+        peer::db::DBConfig dbConfig;
+        dbConfig.backend = dbProperties.getBackend();
+        dbConfig.rocksdb.blockCacheMB = dbProperties.getBlockCacheMB();
+        dbConfig.rocksdb.bloomBitsPerKey = dbProperties.getBloomBitsPerKey();
+        dbConfig.rocksdb.columnFamilies = dbProperties.getColumnFamilies();
+        dbConfig.rocksdb.walSync = peer::db::RocksdbConfig::ParseWALSync(dbProperties.getWALSync());
+        dbConfig.cacheCapacity = dbProperties.getCacheCapacity();
+        dbConfig.cacheAdmitThreshold = dbProperties.getCacheAdmitThreshold();
+        mc->_db = peer::db::DBConnection::NewConnection(dbPath, dbConfig);
         if (mc->_db == nullptr) {
             return nullptr;
         }
-        mc->_cc = ChaincodeType::NewCoordinator(mc->_db, properties->getAriaWorkerCount());
+        auto ccEngine = properties->getCCEngine();
+        mc->_cc = peer::cc::CCEngineRegistry::Instance().newEngine(
+                ccEngine, mc->_db, properties->getCCWorkerCount(ccEngine), properties.get());
         if (mc->_cc == nullptr) {
             return nullptr;
         }
+        LOG(INFO) << "Using cc engine: " << mc->_cc->getName();
+        mc->_pipeline = peer::cc::ExecutionPipeline<peer::cc::CCEngine>::NewExecutionPipeline(
+                mc->_cc.get(), properties->getExecutionPipelineDepth(), properties->getCCWorkerCount(ccEngine));
+        if (mc->_pipeline == nullptr) {
+            return nullptr;
+        }
+        mc->_pipeline->setCommitCallback([ptr = mc.get()](int regionId, std::shared_ptr<proto::Block> block, bool success) {
+            ptr->onBlockCommitted(regionId, std::move(block), success);
+        });
         // 1.02 init factory
         mc->_moduleFactory = peer::core::ModuleFactory::NewModuleFactory(properties);
         if (mc->_moduleFactory == nullptr) {
@@ -99,19 +123,23 @@ namespace peer::core {
     bool ModuleCoordinator::onConsensusBlockOrder(int regionId, int blockId) {
         auto realBlock = _contentStorage->waitForBlock(regionId, blockId, 0);
         CHECK(realBlock != nullptr && (int)realBlock->header.number == blockId) << "The block is already deleted!";
+        // the block is executed asynchronously, the result is returned in onBlockCommitted
+        return _pipeline->addBlock(regionId, std::move(realBlock));
+    }
+
+    // called by the execution pipeline in the final block order
+    void ModuleCoordinator::onBlockCommitted(int regionId, std::shared_ptr<proto::Block> block, bool success) {
         // if success, txReadWriteSet and transactionFilter are the return values
-        if (!_cc->processValidatedRequests(realBlock->body.userRequests,
-                                           realBlock->executeResult.txReadWriteSet,
-                                           realBlock->executeResult.transactionFilter)) {
-            return false;
+        if (!success) {
+            LOG(ERROR) << "Can not execute block.";
+            return;
         }
-        // NOTE: do not invoke realBlock->setSerializedMessage, not thread safe!
+        // NOTE: do not invoke block->setSerializedMessage, not thread safe!
         if (_localNode->nodeId == 0) {
-            DLOG(INFO) << "Leader of local group " << _localNode->groupId << " commit a block, chainId: " << regionId  << ", blockId: " << blockId;
+            DLOG(INFO) << "Leader of local group " << _localNode->groupId << " commit a block, chainId: " << regionId  << ", blockId: " << block->header.number;
         }
         // notify user by rpc
-        _userRPCNotifier->insertBlockAndNotify(regionId, std::move(realBlock));
-        return true;
+        _userRPCNotifier->insertBlockAndNotify(regionId, std::move(block));
     }
 
     void ModuleCoordinator::contentLeaderReceiverLoop() {
@@ -138,7 +166,7 @@ namespace peer::core {
             LOG(ERROR) << "Raft config contains error, can not wait until raft is ready!";
         }
         // wait until bft is ready
-        _localContentBFT->pbftController->waitUntilReady();
+        _localContentBFT->waitUntilReady();
     }
 
     bool ModuleCoordinator::startInstance() {
@@ -146,7 +174,7 @@ namespace peer::core {
             LOG(ERROR) << "ReplicatorSender client start failed!";
             return false;
         }
-        _localContentBFT->pbftController->startInstance();
+        _localContentBFT->startInstance();
         return true;
     }
 
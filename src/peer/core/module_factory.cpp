@@ -11,13 +11,73 @@
 #include "peer/consensus/block_order/iss/iss_block_order.h"
 #include "peer/consensus/pbft/local_consensus_controller.h"
 #include "peer/consensus/pbft/single_pbft_controller.h"
+#include "peer/consensus/block_order/local_distributor.h"
+#include "common/pbft/pbft_replica.h"
 #include "peer/replicator/replicator.h"
 #include "peer/replicator/direct/direct_replicator.h"
 #include "peer/replicator/multyway_only/multiway_replicator.h"
 #include "common/yaml_key_storage.h"
 #include "common/property.h"
+#include <chrono>
+#include <filesystem>
 
 namespace peer::core {
+    namespace {
+        // the blocks of a storage are logged to data/<ski>_blocks/<name>
+        std::shared_ptr<::peer::BlockLog> NewBlockLog(const util::Properties& properties, const std::string& name, int regionCount) {
+            auto segmentMB = properties.getBlockLogSegmentMB();
+            if (segmentMB <= 0) {
+                return nullptr;
+            }
+            auto localNode = properties.getNodeProperties().getLocalNodeInfo();
+            auto path = std::filesystem::current_path() / "data" / (localNode->ski + "_blocks") / name;
+            // The chain is not recovered on restart, the storage (and the consensus) restarts from block 0.
+            // Keep the log of the last run aside, so that its blocks are not served as the new ones.
+            std::error_code ec;
+            if (std::filesystem::exists(path, ec)) {
+                auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+                auto archived = path;
+                archived += "." + std::to_string(seconds);
+                std::filesystem::rename(path, archived, ec);
+                if (ec) {
+                    LOG(ERROR) << "Can not archive the last block log, keep the blocks in memory: " << path << ", " << ec.message();
+                    return nullptr;
+                }
+                LOG(INFO) << "The block log of the last run is kept in: " << archived;
+            }
+            ::peer::BlockLog::Config config;
+            config.segmentSize = (size_t)segmentMB << 20;
+            auto log = ::peer::BlockLog::NewBlockLog(path.string(), regionCount, config);
+            if (log == nullptr) {
+                LOG(ERROR) << "Create block log failed, keep the blocks in memory: " << path;
+            }
+            return log;
+        }
+
+        // the persisted tier is stored in data/<ski>_txindex
+        std::shared_ptr<::peer::TxIndex> NewTxIndex(const util::Properties& properties) {
+            auto capacity = properties.getTxIndexCapacity();
+            if (capacity == 0) {
+                return nullptr;
+            }
+            std::shared_ptr<::peer::db::DBConnection> db = nullptr;
+            auto backend = properties.getTxIndexBackend();
+            if (backend != "none") {
+                auto localNode = properties.getNodeProperties().getLocalNodeInfo();
+                auto path = std::filesystem::current_path() / "data" / (localNode->ski + "_txindex");
+                ::peer::db::DBConfig config;
+                config.backend = backend;
+                db = ::peer::db::DBConnection::NewConnection(path.string(), config);
+                if (db == nullptr || !db->isPersistent()) {
+                    LOG(ERROR) << "Open tx index backend failed, keep the index in memory: " << backend;
+                    db = nullptr;
+                }
+            }
+            return std::make_shared<::peer::TxIndex>(capacity, std::move(db));
+        }
+    }
+
     ModuleFactory::~ModuleFactory() = default;
 
     std::unique_ptr<ModuleFactory> ModuleFactory::NewModuleFactory(const std::shared_ptr<util::Properties>& properties) {
@@ -31,7 +91,8 @@ namespace peer::core {
             return { _bccsp, _threadPoolForBCCSP };
         }
         auto node = _properties->getCustomProperties("bccsp");
-        _bccsp = std::make_shared<util::BCCSP>(std::make_unique<util::YAMLKeyStorage>(node));
+        _bccsp = std::make_shared<util::BCCSP>(std::make_unique<util::YAMLKeyStorage>(node),
+                                               _properties->getBCCSPVerifiedCacheSize());
         _threadPoolForBCCSP = std::make_shared<util::thread_pool_light>(_properties->getBCCSPWorkerCount(), "bccsp_tp");
         return { _bccsp, _threadPoolForBCCSP };
     }
@@ -45,6 +106,7 @@ namespace peer::core {
             return nullptr;
         }
         _contentStorage = std::make_shared<peer::MRBlockStorage>(gc);
+        _contentStorage->setBlockLog(NewBlockLog(*_properties, "content", gc));
         return _contentStorage;
     }
 
@@ -76,6 +138,8 @@ namespace peer::core {
             return nullptr;
         }
         replicator->setPortUtilMap(std::move(pum));
+        replicator->setReassemblyConfig(_properties->getReplicatorRingBufferSize(), _properties->getReplicatorReassemblyWindow());
+        replicator->setNativeErasureCode(_properties->getReplicatorErasureCode() == "native");
         if (!replicator->initialize()) {
             LOG(WARNING) << "replicator initialize error!";
             return nullptr;
@@ -94,46 +158,54 @@ namespace peer::core {
     std::unique_ptr<BFTController> ModuleFactory::newReplicatorBFTController(int groupId) {
         auto np = _properties->getNodeProperties();
         auto localNode = np.getLocalNodeInfo();
-        auto [user, pass, success] = _properties->getSSHInfo();
-        if (!success) {
-            LOG(WARNING) << "please check your ssh setting in config file.";
-        }
-        auto runningPath = _properties->getRunningPath();
-        peer::consensus::SSHConfig sshConfig {
-                .ip = localNode->priIp,
-                .port = -1,
-                .userName = user,
-                .password = pass,
-        };
-        auto ic = peer::consensus::BFTInstanceController::NewBFTInstanceController(
-                sshConfig,
-                groupId,
-                localNode->nodeId,
-                runningPath,
-                _properties->getJVMPath());
-        if (!ic) {
-            return nullptr;
-        }
-        // generate host file
         auto portMap = getOrInitZMQPortUtilMap();
         if (!portMap) {
             return nullptr;
         }
-        std::vector<peer::consensus::NodeHostConfig> hostList;
         auto& groupPortMap = portMap->at(localNode->groupId);
         auto localRegionNodes = np.getGroupNodesInfo(localNode->groupId);
         CHECK(localRegionNodes.size() == portMap->at(localNode->groupId).size());
-        for (int i=0; i<(int)localRegionNodes.size(); i++) {
-            auto& node = localRegionNodes[i];
-            hostList.push_back({
-                                       .processId = node->nodeId,
-                                       .ip = node->priIp,
-                                       .serverToServerPort = groupPortMap[i]->getLocalServicePorts(util::PortType::SERVER_TO_SERVER)[i],
-                                       .serverToClientPort = groupPortMap[i]->getLocalServicePorts(util::PortType::CLIENT_TO_SERVER)[i],
-                                       .rpcPort =  groupPortMap[i]->getLocalServicePorts(util::PortType::BFT_RPC)[i],
-                               });
-        }
-        ic->prepareConfigurationFile(hostList);
+        auto engine = _properties->getLocalConsensusEngine();
+        std::unique_ptr<consensus::v2::SinglePBFTController> rc;
+        if (engine == "bft-smart") {
+            auto [user, pass, success] = _properties->getSSHInfo();
+            if (!success) {
+                LOG(WARNING) << "please check your ssh setting in config file.";
+            }
+            auto runningPath = _properties->getRunningPath();
+            peer::consensus::SSHConfig sshConfig {
+                    .ip = localNode->priIp,
+                    .port = -1,
+                    .userName = user,
+                    .password = pass,
+            };
+            auto ic = peer::consensus::BFTInstanceController::NewBFTInstanceController(
+                    sshConfig,
+                    groupId,
+                    localNode->nodeId,
+                    runningPath,
+                    _properties->getJVMPath());
+            if (!ic) {
+                return nullptr;
+            }
+            // generate host file
+            std::vector<peer::consensus::NodeHostConfig> hostList;
+            for (int i=0; i<(int)localRegionNodes.size(); i++) {
+                auto& node = localRegionNodes[i];
+                hostList.push_back({
+                                           .processId = node->nodeId,
+                                           .ip = node->priIp,
+                                           .serverToServerPort = groupPortMap[i]->getLocalServicePorts(util::PortType::SERVER_TO_SERVER)[i],
+                                           .serverToClientPort = groupPortMap[i]->getLocalServicePorts(util::PortType::CLIENT_TO_SERVER)[i],
+                                           .rpcPort =  groupPortMap[i]->getLocalServicePorts(util::PortType::BFT_RPC)[i],
+                                   });
+            }
+            ic->prepareConfigurationFile(hostList);
+            rc = std::make_unique<consensus::v2::SinglePBFTController>(std::move(ic), localNode->groupId, localNode->nodeId, groupId);
+        } else if (engine != "native") {
+            LOG(ERROR) << "Unknown local consensus engine: " << engine;
+            return nullptr;
+        }
         // ----- init LocalPBFTController ----
         auto [bccsp, tp] = this->getOrInitBCCSPAndThreadPool();
         auto cs = getOrInitContentStorage();
@@ -146,16 +218,46 @@ namespace peer::core {
                 localNode->nodeId,
                 groupPortMap.at(localNode->nodeId),
                 bccsp,
-                std::move(tp),
+                tp,
                 std::move(cs),
                 _properties->getBlockBatchTimeoutMs(),
                 _properties->getBlockMaxBatchSize());
         if (!pc || !pc->startRPCService()) {
             return nullptr;
         }
-        auto rc = std::make_unique<consensus::v2::SinglePBFTController>(std::move(ic), localNode->groupId, localNode->nodeId, groupId);
-
-        return std::make_unique<BFTController>(std::move(pc), std::move(rc));
+        auto controller = std::make_unique<BFTController>(std::move(pc), std::move(rc));
+        if (engine != "native") {
+            return controller;
+        }
+        // ----- init the native replica, the ports of BFT-SMaRt are reused ----
+        util::pbft::PBFTReplica::Config config;
+        config.nodes = localRegionNodes;
+        config.localId = localNode->nodeId;
+        config.pipelineDepth = _properties->getPBFTPipelineDepth();
+        config.viewChangeTimeoutMs = _properties->getPBFTViewChangeTimeoutMs();
+        controller->replica = util::pbft::PBFTReplica::NewPBFTReplica(config, std::move(bccsp), std::move(tp),
+                                                                      controller->consensusController->getStateMachine());
+        if (!controller->replica) {
+            return nullptr;
+        }
+        auto [replicaZMQConfigs, ret] = util::ZMQPortUtil::WrapPortWithConfig(
+                localRegionNodes,
+                groupPortMap.at(localNode->nodeId)->getLocalServicePorts(util::PortType::SERVER_TO_SERVER));
+        if (!ret) {
+            LOG(ERROR) << "generate replica zmq config failed!";
+            return nullptr;
+        }
+        controller->replicaTransport = consensus::v2::LocalDistributor::NewLocalDistributor(replicaZMQConfigs, localNode->nodeId);
+        if (!controller->replicaTransport) {
+            return nullptr;
+        }
+        controller->replicaTransport->setDeliverCallback([replica = controller->replica.get()](std::string raw) {
+            replica->onMessage(std::move(raw));
+        });
+        controller->replica->setBroadcastCallback([transport = controller->replicaTransport.get()](std::string raw) {
+            transport->gossip(std::move(raw));
+        });
+        return controller;
     }
 
     std::shared_ptr<std::unordered_map<int, util::ZMQPortUtilList>> ModuleFactory::getOrInitZMQPortUtilMap() {
@@ -201,7 +303,11 @@ namespace peer::core {
         auto [bccsp, tp] = getOrInitBCCSPAndThreadPool();
         auto callback = BlockOrderType::NewRaftCallback(getOrInitContentStorage(), std::move(bccsp), std::move(tp));
         callback->setOnExecuteBlockCallback(std::move(deliverCallback));
-        return BlockOrderType::NewBlockOrder(localReceivers, multiRaftParticipant, multiRaftLeaderPos, localNode, std::move(callback));
+        auto bo = BlockOrderType::NewBlockOrder(localReceivers, multiRaftParticipant, multiRaftLeaderPos, localNode, std::move(callback));
+        if (bo != nullptr) {
+            bo->setVoteBatching(_properties->getGBOVoteBatchSize(), _properties->getGBOVoteBatchWindowUs());
+        }
+        return bo;
     }
 
     bool ModuleFactory::startReplicatorSender() {
@@ -217,6 +323,8 @@ namespace peer::core {
             return nullptr;
         }
         auto storage = std::make_shared<peer::BlockLRUCache>(gc);
+        storage->setBlockLog(NewBlockLog(*_properties, "committed", gc));
+        storage->setTxIndex(NewTxIndex(*_properties));
 
         auto portMap = getOrInitZMQPortUtilMap();
         auto np = _properties->getNodeProperties();
@@ -230,5 +338,29 @@ namespace peer::core {
         return storage;
     }
 
-    BFTController::~BFTController() = default;
+    void BFTController::startInstance() {
+        if (replica != nullptr) {
+            replica->start();
+            return;
+        }
+        pbftController->startInstance();
+    }
+
+    void BFTController::waitUntilReady() {
+        if (replica != nullptr) {
+            replica->waitUntilReady();
+            return;
+        }
+        pbftController->waitUntilReady();
+    }
+
+    BFTController::~BFTController() {
+        if (replica != nullptr) {
+            // the proposer may wait for a block in the state machine
+            consensusController->getStateMachine()->sendStopSignal();
+            replica->stop();
+        }
+        replicaTransport.reset();
+        replica.reset();
+    }
 }
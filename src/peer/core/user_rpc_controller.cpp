@@ -31,6 +31,10 @@ namespace peer::core {
             }
 
             std::shared_ptr<pmt::MerkleTree> getOrGenerateExecResultMT(const proto::Block& block) {
+                // built by the execution pipeline when the block is committed
+                if (block.executeResult.merkleTree != nullptr) {
+                    return block.executeResult.merkleTree;
+                }
                 std::shared_ptr<pmt::MerkleTree> ret = nullptr;
                 if (_executeResultMerkleTree.tryGetCopy(block.header.dataHash, ret)) {
                     return ret;
@@ -150,63 +154,94 @@ namespace peer::core {
                                            ::google::protobuf::Closure *done) {
         brpc::ClosureGuard guard(done);
         response->set_success(false);
+        const auto& txId = request->txid();
+        if (txId.size() != std::tuple_size_v<proto::DigestString>) {
+            LOG(WARNING) << "Invalid txid size: " << txId.size();
+            return;
+        }
         auto regionId = request->chainidhint();
-        auto maxBlockNumber = _impl->_storage->getMaxStoredBlockNumber(regionId);
-        auto minBlockNumber = request->blockidhint();
-        for (auto i=minBlockNumber; i<(int)maxBlockNumber+1; i++) {
-            auto block = _impl->_storage->waitForBlock(regionId, i);
-            if (block == nullptr) {
-                continue;   // block is removed by another process
-            }
-            // found transaction
-            auto envelop = block->body.findEnvelop(request->txid());
-            if (envelop == nullptr) {
-                continue;
-            }
-            response->set_chainid(regionId);
-            response->set_blockid((int)block->header.number);
-            // generate request proof
-            {
-                if (!envelop->serializeToString(response->mutable_envelop())) {
-                    LOG(ERROR) << "Serialize envelop failed!";
-                    return;
-                }
-                auto ret = _impl->getOrGenerateUserRequestMT(*block);
-                auto proof = util::UserRequestMTGenerator::GenerateProof(*ret, *envelop);
-                if (proof == std::nullopt) {
-                    LOG(ERROR) << "GenerateProof failed!";
-                    return;
-                }
-                if (!util::serializeToString(*proof, *response->mutable_envelopproof())) {
-                    LOG(ERROR) << "SerializeProof failed!";
-                    return;
+        std::shared_ptr<proto::Block> block = nullptr;
+        proto::Envelop* envelop = nullptr;
+        proto::TxReadWriteSet* rwSet = nullptr;
+        std::byte valid{};
+        // locate the transaction directly with the index
+        if (const auto& index = _impl->_storage->getTxIndex(); index != nullptr) {
+            auto location = index->find(txId);
+            // the persisted index may be ahead of the storage after a restart
+            if (location != std::nullopt && (int64_t)location->blockNumber <= _impl->_storage->getMaxStoredBlockNumber(location->regionId)) {
+                block = _impl->_storage->waitForBlock(location->regionId, location->blockNumber);
+                if (block != nullptr) {
+                    envelop = block->body.getEnvelop((int)location->position, txId);
+                    if (envelop == nullptr || !block->executeResult.getRWSet((int)location->position, txId, rwSet, valid)) {
+                        block = nullptr;    // a fingerprint collision, scan the blocks instead
+                    } else {
+                        regionId = location->regionId;
+                    }
                 }
             }
-            response->set_success(true);
-            // generate response proof
-            {
-                proto::TxReadWriteSet* rwSet;
-                std::byte valid;
-                if (!block->executeResult.findRWSet(request->txid(), rwSet, valid)) {
-                    LOG(ERROR) << "Corresponding RWSets not found!";
-                    return;
-                }
-                zpp::bits::out out(*response->mutable_rwset());
-                if (failure(out(*rwSet, valid))) {
-                    return;
-                }
-                auto ret = _impl->getOrGenerateExecResultMT(*block);
-                auto proof = util::ExecResultMTGenerator::GenerateProof(*ret, *rwSet, valid);
-                if (proof == std::nullopt) {
-                    LOG(ERROR) << "GenerateProof failed!";
-                    return;
+        }
+        if (block == nullptr) {
+            auto maxBlockNumber = _impl->_storage->getMaxStoredBlockNumber(regionId);
+            auto minBlockNumber = request->blockidhint();
+            for (auto i=minBlockNumber; i<(int)maxBlockNumber+1; i++) {
+                block = _impl->_storage->waitForBlock(regionId, i);
+                if (block == nullptr) {
+                    continue;   // block is removed by another process
                 }
-                if (!util::serializeToString(*proof, *response->mutable_rwsetproof())) {
-                    LOG(ERROR) << "SerializeProof failed!";
-                    return;
+                // found transaction
+                envelop = block->body.findEnvelop(txId);
+                if (envelop != nullptr) {
+                    break;
                 }
+                block = nullptr;
+            }
+            if (block == nullptr) {
+                return;
+            }
+            if (!block->executeResult.findRWSet(txId, rwSet, valid)) {
+                rwSet = nullptr;
+            }
+        }
+        response->set_chainid(regionId);
+        response->set_blockid((int)block->header.number);
+        // generate request proof
+        {
+            if (!envelop->serializeToString(response->mutable_envelop())) {
+                LOG(ERROR) << "Serialize envelop failed!";
+                return;
+            }
+            auto ret = _impl->getOrGenerateUserRequestMT(*block);
+            auto proof = util::UserRequestMTGenerator::GenerateProof(*ret, *envelop);
+            if (proof == std::nullopt) {
+                LOG(ERROR) << "GenerateProof failed!";
+                return;
+            }
+            if (!util::serializeToString(*proof, *response->mutable_envelopproof())) {
+                LOG(ERROR) << "SerializeProof failed!";
+                return;
+            }
+        }
+        response->set_success(true);
+        // generate response proof
+        {
+            if (rwSet == nullptr) {
+                LOG(ERROR) << "Corresponding RWSets not found!";
+                return;
+            }
+            zpp::bits::out out(*response->mutable_rwset());
+            if (failure(out(*rwSet, valid))) {
+                return;
+            }
+            auto ret = _impl->getOrGenerateExecResultMT(*block);
+            auto proof = util::ExecResultMTGenerator::GenerateProof(*ret, *rwSet, valid);
+            if (proof == std::nullopt) {
+                LOG(ERROR) << "GenerateProof failed!";
+                return;
+            }
+            if (!util::serializeToString(*proof, *response->mutable_rwsetproof())) {
+                LOG(ERROR) << "SerializeProof failed!";
+                return;
             }
-            return;
         }
     }
 
@@ -0,0 +1,476 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/storage/block_log.h"
+#include "butil/crc32c.h"
+#include "glog/logging.h"
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace peer {
+    namespace {
+        constexpr size_t INITIAL_INDEX_CAPACITY = 4096;
+
+        constexpr size_t RecordSize(size_t payloadSize) {
+            // keep the record headers aligned
+            return (sizeof(BlockLog::RecordHeader) + payloadSize + 7) & ~(size_t)7;
+        }
+
+        uint32_t HeaderChecksum(const BlockLog::RecordHeader& header) {
+            return butil::crc32c::Value(reinterpret_cast<const char*>(&header), offsetof(BlockLog::RecordHeader, headerChecksum));
+        }
+
+        // the header is valid and the payload matches the checksum
+        bool VerifyRecord(const char* record, size_t maxSize) {
+            if (maxSize < sizeof(BlockLog::RecordHeader)) {
+                return false;
+            }
+            const auto* header = reinterpret_cast<const BlockLog::RecordHeader*>(record);
+            if (header->magic != BlockLog::RECORD_MAGIC || header->headerChecksum != HeaderChecksum(*header)) {
+                return false;
+            }
+            if (header->size > maxSize - sizeof(BlockLog::RecordHeader)) {
+                return false;
+            }
+            return header->checksum == butil::crc32c::Value(record + sizeof(BlockLog::RecordHeader), header->size);
+        }
+    }
+
+    struct BlockLog::Segment {
+        uint32_t id = 0;
+        int fd = -1;
+        char* base = nullptr;
+        size_t capacity = 0;
+
+        ~Segment() {
+            if (base != nullptr) {
+                ::munmap(base, capacity);
+            }
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+
+        // map an opened segment, the segment is read only through the mapping
+        bool map(size_t size) {
+            capacity = size;
+            auto* ptr = ::mmap(nullptr, capacity, PROT_READ, MAP_SHARED, fd, 0);
+            if (ptr == MAP_FAILED) {
+                return false;
+            }
+            base = static_cast<char*>(ptr);
+            return true;
+        }
+    };
+
+    struct BlockLog::Region {
+        struct IndexMap {
+            IndexEntry* entries = nullptr;
+            size_t capacity = 0;
+        };
+
+        std::filesystem::path dir;
+        int indexFd = -1;
+        // the latest mapping of the index file, the former mappings are kept for the concurrent readers
+        std::atomic<IndexMap*> index = nullptr;
+        std::vector<std::unique_ptr<IndexMap>> indexMaps;
+        // the segments are only appended, readers lock it shared
+        mutable std::shared_mutex segmentMutex;
+        std::vector<std::unique_ptr<Segment>> segments;
+        std::atomic<int64_t> maxBlockNumber = -1;
+        // owned by the writer
+        size_t writePos = 0;
+        std::vector<std::pair<proto::BlockNumber, IndexEntry>> pending;
+
+        ~Region() {
+            for (auto& it: indexMaps) {
+                ::munmap(it->entries, it->capacity * sizeof(IndexEntry));
+            }
+            if (indexFd >= 0) {
+                ::close(indexFd);
+            }
+        }
+
+        [[nodiscard]] Segment* getSegment(uint32_t segmentId) const {
+            std::shared_lock lock(segmentMutex);
+            if (segmentId >= segments.size()) {
+                return nullptr;
+            }
+            return segments[segmentId].get();
+        }
+    };
+
+    std::unique_ptr<BlockLog> BlockLog::NewBlockLog(const std::string& path, int regionCount, const Config& config) {
+        if (regionCount <= 0 || config.segmentSize < RecordSize(0) || config.maxBatchSize <= 0) {
+            LOG(ERROR) << "Invalid block log config.";
+            return nullptr;
+        }
+        std::unique_ptr<BlockLog> log(new BlockLog(path, config));
+        for (int i = 0; i < regionCount; i++) {
+            log->_regions.push_back(std::make_unique<Region>());
+            if (!log->openRegion(i)) {
+                LOG(ERROR) << "Open block log failed, region: " << i << ", path: " << path;
+                return nullptr;
+            }
+        }
+        log->_writer = std::make_unique<std::thread>(&BlockLog::run, log.get());
+        return log;
+    }
+
+    BlockLog::BlockLog(std::string path, const Config& config)
+            : _path(std::move(path)), _config(config) { }
+
+    BlockLog::~BlockLog() {
+        if (_writer) {
+            Item item;
+            item.stop = true;
+            _queue.enqueue(std::move(item));
+            _writer->join();
+        }
+    }
+
+    bool BlockLog::openRegion(int regionId) {
+        auto& region = *_regions[regionId];
+        region.dir = std::filesystem::path(_path) / std::to_string(regionId);
+        std::error_code ec;
+        std::filesystem::create_directories(region.dir, ec);
+        if (ec) {
+            LOG(ERROR) << "Create directory failed: " << ec.message();
+            return false;
+        }
+        // load the segments, the ids are continuous from 0
+        std::vector<uint32_t> segmentIds;
+        for (const auto& it: std::filesystem::directory_iterator(region.dir)) {
+            if (it.path().extension() == ".seg") {
+                segmentIds.push_back((uint32_t)std::stoul(it.path().stem().string()));
+            }
+        }
+        std::sort(segmentIds.begin(), segmentIds.end());
+        for (int i = 0; i < (int)segmentIds.size(); i++) {
+            if (segmentIds[i] != (uint32_t)i) {
+                LOG(ERROR) << "Segment is missing: " << i;
+                return false;
+            }
+            auto segment = std::make_unique<Segment>();
+            segment->id = i;
+            segment->fd = ::open((region.dir / (std::to_string(i) + ".seg")).c_str(), O_RDWR);
+            struct stat st{};
+            if (segment->fd < 0 || ::fstat(segment->fd, &st) != 0 || st.st_size == 0 || !segment->map(st.st_size)) {
+                LOG(ERROR) << "Open segment failed: " << i;
+                return false;
+            }
+            region.segments.push_back(std::move(segment));
+        }
+        // load the index
+        region.indexFd = ::open((region.dir / "index").c_str(), O_RDWR | O_CREAT, 0644);
+        struct stat st{};
+        if (region.indexFd < 0 || ::fstat(region.indexFd, &st) != 0) {
+            LOG(ERROR) << "Open index failed.";
+            return false;
+        }
+        if (!ReserveIndex(region, std::max<size_t>(st.st_size / sizeof(IndexEntry), INITIAL_INDEX_CAPACITY) - 1)) {
+            return false;
+        }
+        if (region.segments.empty()) {
+            region.writePos = 0;
+        } else {
+            // the index entries of the last segment may be lost, scan the records to repair them
+            const auto& last = *region.segments.back();
+            size_t offset = 0;
+            while (VerifyRecord(last.base + offset, last.capacity - offset)) {
+                const auto* header = reinterpret_cast<const RecordHeader*>(last.base + offset);
+                region.pending.emplace_back(header->blockNumber, IndexEntry{offset, last.id, header->size});
+                offset += RecordSize(header->size);
+                if (offset >= last.capacity) {
+                    break;
+                }
+            }
+            region.writePos = offset;
+            if (offset < last.capacity && reinterpret_cast<const RecordHeader*>(last.base + offset)->magic != 0) {
+                // a torn record, the stale bytes behind it may look valid, start from a new segment
+                LOG(WARNING) << "Drop the torn tail of segment " << last.id << " at " << offset;
+                region.writePos = last.capacity;
+            }
+            // drop the entries point to nothing
+            auto* map = region.index.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < map->capacity; i++) {
+                auto& entry = map->entries[i];
+                if (entry.size == 0) {
+                    continue;
+                }
+                if (entry.segmentId > last.id || (entry.segmentId == last.id && entry.offset >= offset)) {
+                    entry = IndexEntry{};
+                }
+            }
+        }
+        for (const auto& it: region.pending) {
+            if (!ReserveIndex(region, it.first)) {
+                return false;
+            }
+        }
+        publishIndex(region, true);
+        auto* map = region.index.load(std::memory_order_relaxed);
+        for (auto i = (int64_t)map->capacity - 1; i >= 0; i--) {
+            if (map->entries[i].size != 0) {
+                region.maxBlockNumber.store(i, std::memory_order_release);
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool BlockLog::ReserveIndex(Region& region, proto::BlockNumber blockNumber) {
+        auto* current = region.index.load(std::memory_order_relaxed);
+        if (current != nullptr && blockNumber < current->capacity) {
+            return true;
+        }
+        auto capacity = current == nullptr ? INITIAL_INDEX_CAPACITY : current->capacity;
+        while (capacity <= blockNumber) {
+            capacity <<= 1;
+        }
+        const auto size = capacity * sizeof(IndexEntry);
+        struct stat st{};
+        if (::fstat(region.indexFd, &st) != 0 || ((size_t)st.st_size < size && ::ftruncate(region.indexFd, (off_t)size) != 0)) {
+            LOG(ERROR) << "Resize index failed, capacity: " << capacity;
+            return false;
+        }
+        auto* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, region.indexFd, 0);
+        if (ptr == MAP_FAILED) {
+            LOG(ERROR) << "Map index failed, capacity: " << capacity;
+            return false;
+        }
+        // the mappings share the page cache, the former mapping stays valid for the readers
+        region.indexMaps.push_back(std::make_unique<Region::IndexMap>(Region::IndexMap{static_cast<IndexEntry*>(ptr), capacity}));
+        region.index.store(region.indexMaps.back().get(), std::memory_order_release);
+        return true;
+    }
+
+    void BlockLog::publishIndex(Region& region, bool durable) {
+        auto* map = region.index.load(std::memory_order_relaxed);
+        auto maxBlockNumber = region.maxBlockNumber.load(std::memory_order_relaxed);
+        for (const auto& [blockNumber, entry]: region.pending) {
+            auto& target = map->entries[blockNumber];
+            target.offset = entry.offset;
+            target.segmentId = entry.segmentId;
+            // the size is the last field a reader checks
+            std::atomic_ref(target.size).store(entry.size, std::memory_order_release);
+            maxBlockNumber = std::max(maxBlockNumber, (int64_t)blockNumber);
+        }
+        region.pending.clear();
+        region.maxBlockNumber.store(maxBlockNumber, std::memory_order_release);
+        if (::msync(map->entries, map->capacity * sizeof(IndexEntry), durable ? MS_SYNC : MS_ASYNC) != 0) {
+            LOG(WARNING) << "Sync index failed: " << region.dir;
+        }
+    }
+
+    bool BlockLog::rollSegment(Region& region, size_t recordSize) {
+        if (!region.segments.empty()) {
+            // the index entries of the former segments are never repaired, make them durable
+            if (_config.sync && ::fdatasync(region.segments.back()->fd) != 0) {
+                LOG(WARNING) << "Sync segment failed: " << region.segments.back()->id;
+            }
+            publishIndex(region, true);
+        }
+        auto segment = std::make_unique<Segment>();
+        segment->id = (uint32_t)region.segments.size();
+        const auto capacity = std::max(_config.segmentSize, recordSize);
+        segment->fd = ::open((region.dir / (std::to_string(segment->id) + ".seg")).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (segment->fd < 0 || ::ftruncate(segment->fd, (off_t)capacity) != 0 || !segment->map(capacity)) {
+            LOG(ERROR) << "Create segment failed: " << segment->id;
+            return false;
+        }
+        if (_config.sync) {
+            // persist the directory entry of the new segment
+            auto dirFd = ::open(region.dir.c_str(), O_RDONLY | O_DIRECTORY);
+            if (dirFd >= 0) {
+                ::fsync(dirFd);
+                ::close(dirFd);
+            }
+        }
+        std::unique_lock lock(region.segmentMutex);
+        region.segments.push_back(std::move(segment));
+        region.writePos = 0;
+        return true;
+    }
+
+    void BlockLog::append(int regionId, proto::BlockNumber blockNumber, std::shared_ptr<const std::string> raw) {
+        Item item;
+        item.regionId = regionId;
+        item.blockNumber = blockNumber;
+        item.raw = std::move(raw);
+        _queue.enqueue(std::move(item));
+    }
+
+    void BlockLog::append(int regionId, std::shared_ptr<const proto::Block> block) {
+        Item item;
+        item.regionId = regionId;
+        item.blockNumber = block->header.number;
+        item.block = std::move(block);
+        _queue.enqueue(std::move(item));
+    }
+
+    void BlockLog::flush() {
+        Item item;
+        item.flushed = std::make_shared<std::promise<void>>();
+        auto future = item.flushed->get_future();
+        _queue.enqueue(std::move(item));
+        future.wait();
+    }
+
+    void BlockLog::run() {
+        pthread_setname_np(pthread_self(), "block_log");
+        std::vector<Item> items(_config.maxBatchSize);
+        while (true) {
+            auto count = _queue.wait_dequeue_bulk(items.begin(), items.size());
+            writeBatch(items.data(), count);
+            bool stop = std::any_of(items.begin(), items.begin() + (long)count, [](const Item& it) { return it.stop; });
+            for (size_t i = 0; i < count; i++) {
+                items[i] = Item{};
+            }
+            if (stop) {
+                return;
+            }
+        }
+    }
+
+    void BlockLog::writeBatch(Item* items, size_t count) {
+        std::vector<bool> touched(_regions.size());
+        std::string buffer;
+        for (size_t i = 0; i < count; i++) {
+            auto& item = items[i];
+            if (item.regionId < 0 || item.regionId >= (int)_regions.size()) {
+                if (item.flushed == nullptr && !item.stop) {
+                    LOG(ERROR) << "Invalid region id: " << item.regionId;
+                }
+                continue;
+            }
+            const std::string* raw = item.raw.get();
+            if (raw == nullptr && item.block != nullptr) {
+                buffer.clear();
+                if (!item.block->serializeToString(&buffer).valid) {
+                    LOG(ERROR) << "Serialize block failed: " << item.blockNumber;
+                    continue;
+                }
+                raw = &buffer;
+            }
+            if (raw == nullptr || raw->empty() || raw->size() > std::numeric_limits<uint32_t>::max()) {
+                LOG(ERROR) << "Invalid block: " << item.blockNumber;
+                continue;
+            }
+            auto& region = *_regions[item.regionId];
+            const auto recordSize = RecordSize(raw->size());
+            if (!ReserveIndex(region, item.blockNumber)) {
+                continue;
+            }
+            if (region.segments.empty() || region.writePos + recordSize > region.segments.back()->capacity) {
+                if (!rollSegment(region, recordSize)) {
+                    continue;
+                }
+            }
+            const auto& segment = *region.segments.back();
+            RecordHeader header{};
+            header.magic = RECORD_MAGIC;
+            header.size = (uint32_t)raw->size();
+            header.blockNumber = item.blockNumber;
+            header.checksum = butil::crc32c::Value(raw->data(), raw->size());
+            header.headerChecksum = HeaderChecksum(header);
+            static const char padding[8]{};
+            iovec iov[3] = {
+                    {&header, sizeof(header)},
+                    {const_cast<char*>(raw->data()), raw->size()},
+                    {const_cast<char*>(padding), recordSize - sizeof(header) - raw->size()}};
+            if (::pwritev(segment.fd, iov, 3, (off_t)region.writePos) != (ssize_t)recordSize) {
+                LOG(ERROR) << "Write block failed: " << item.blockNumber;
+                continue;
+            }
+            region.pending.emplace_back(item.blockNumber, IndexEntry{region.writePos, segment.id, header.size});
+            region.writePos += recordSize;
+            touched[item.regionId] = true;
+        }
+        for (int i = 0; i < (int)_regions.size(); i++) {
+            if (!touched[i]) {
+                continue;
+            }
+            auto& region = *_regions[i];
+            // the records must be durable before they are indexed
+            if (_config.sync && ::fdatasync(region.segments.back()->fd) != 0) {
+                LOG(WARNING) << "Sync segment failed: " << region.segments.back()->id;
+            }
+            // the index entries of the active segment are repaired on open, no need to wait
+            publishIndex(region, false);
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (items[i].flushed != nullptr) {
+                items[i].flushed->set_value();
+            }
+        }
+    }
+
+    std::optional<std::string_view> BlockLog::read(int regionId, proto::BlockNumber blockNumber) const {
+        if (regionId < 0 || regionId >= (int)_regions.size()) {
+            return std::nullopt;
+        }
+        const auto& region = *_regions[regionId];
+        auto* map = region.index.load(std::memory_order_acquire);
+        if (blockNumber >= map->capacity) {
+            return std::nullopt;
+        }
+        auto& entry = map->entries[blockNumber];
+        auto size = std::atomic_ref(entry.size).load(std::memory_order_acquire);
+        if (size == 0) {
+            return std::nullopt;
+        }
+        auto* segment = region.getSegment(entry.segmentId);
+        if (segment == nullptr || entry.offset + RecordSize(size) > segment->capacity) {
+            LOG(ERROR) << "Invalid index entry, region: " << regionId << ", block: " << blockNumber;
+            return std::nullopt;
+        }
+        const auto* record = segment->base + entry.offset;
+        const auto* header = reinterpret_cast<const RecordHeader*>(record);
+        if (!VerifyRecord(record, segment->capacity - entry.offset) || header->blockNumber != blockNumber || header->size != size) {
+            LOG(ERROR) << "Block record is corrupted, region: " << regionId << ", block: " << blockNumber;
+            return std::nullopt;
+        }
+        return std::string_view(record + sizeof(RecordHeader), size);
+    }
+
+    std::shared_ptr<proto::Block> BlockLog::readBlock(int regionId, proto::BlockNumber blockNumber) const {
+        auto raw = read(regionId, blockNumber);
+        if (raw == std::nullopt) {
+            return nullptr;
+        }
+        auto owner = weak_from_this().lock();
+        if (owner == nullptr) {
+            // the block owns its serialized message, the fields are views into it
+            auto block = std::make_shared<proto::Block>();
+            if (!block->deserializeFromString(std::string(*raw)).valid) {
+                LOG(ERROR) << "Deserialize block failed, region: " << regionId << ", block: " << blockNumber;
+                return nullptr;
+            }
+            return block;
+        }
+        // the fields are views into the mapped segment, which lives as long as the log
+        struct PinnedBlock {
+            std::shared_ptr<const BlockLog> log;
+            proto::Block block;
+        };
+        auto pinned = std::make_shared<PinnedBlock>();
+        pinned->log = std::move(owner);
+        if (!pinned->block.deserializeFromView(*raw).valid) {
+            LOG(ERROR) << "Deserialize block failed, region: " << regionId << ", block: " << blockNumber;
+            return nullptr;
+        }
+        return {pinned, &pinned->block};
+    }
+
+    int64_t BlockLog::getMaxBlockNumber(int regionId) const {
+        return _regions[regionId]->maxBlockNumber.load(std::memory_order_acquire);
+    }
+}
@@ -43,6 +43,8 @@ public:
         return false;
     }
 
+    [[nodiscard]] bool isDBPersistent() const { return _mc->getDBHandle()->isPersistent(); }
+
     ~PeerInstance() {
         util::MetaRpcServer::Stop();
     }
@@ -92,10 +94,10 @@ int main(int argc, char *argv[]) {
             return -1;
         }
         LOG(INFO) << "Init db for chaincode: " << *ccName << " completed.";
-        if (!peer::db::IsDBHashMap()) {
+        if (peer.isDBPersistent()) {
             return 0;
         }
-        LOG(INFO) << "Using hashmap as db, continue starting peer.";
+        LOG(INFO) << "Using in-memory db, continue starting peer.";
     }
     // startup
     if (!peer.startInstance()) {
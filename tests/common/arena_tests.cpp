@@ -0,0 +1,87 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "common/arena.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+class ArenaTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+    };
+
+    void TearDown() override {
+    };
+
+    struct Counter {
+        explicit Counter(int* c) : count(c) { }
+
+        ~Counter() { (*count)++; }
+
+        int* count;
+        std::string payload = "a payload that does not fit in the small string buffer";
+    };
+};
+
+TEST_F(ArenaTest, TestCopy) {
+    util::Arena arena(64);
+    for (int round=0; round<3; round++) {
+        std::vector<std::string_view> views;
+        for (int i=0; i<10000; i++) {
+            views.push_back(arena.copy("key_" + std::to_string(i)));
+        }
+        for (int i=0; i<10000; i++) {
+            ASSERT_TRUE(views[i] == "key_" + std::to_string(i));
+        }
+        ASSERT_TRUE(arena.copy("").empty());
+        arena.reset();
+        ASSERT_TRUE(arena.bytesUsed() == 0);
+    }
+}
+
+TEST_F(ArenaTest, TestAlignment) {
+    util::Arena arena(64);
+    for (int i=0; i<1000; i++) {
+        arena.allocate(i % 7 + 1, 1);
+        auto* ptr = arena.allocate(8, 64);
+        ASSERT_TRUE(reinterpret_cast<uintptr_t>(ptr) % 64 == 0);
+    }
+    // larger than a chunk
+    auto* ptr = static_cast<char*>(arena.allocate(1024 * 1024, 8));
+    std::memset(ptr, 0, 1024 * 1024);
+}
+
+TEST_F(ArenaTest, TestDestructor) {
+    int count = 0;
+    {
+        util::Arena arena;
+        for (int i=0; i<100; i++) {
+            arena.create<Counter>(&count);
+        }
+        arena.reset();
+        ASSERT_TRUE(count == 100);
+        for (int i=0; i<100; i++) {
+            arena.create<Counter>(&count);
+        }
+    }
+    ASSERT_TRUE(count == 200);
+}
+
+TEST_F(ArenaTest, TestChunkReuse) {
+    util::Arena arena(1024);
+    for (int i=0; i<1000; i++) {
+        arena.allocate(100);
+    }
+    auto allocCount = arena.chunkAllocCount();
+    // the last chunk is kept, so the same pattern needs fewer system allocations
+    for (int round=0; round<10; round++) {
+        arena.reset();
+        for (int i=0; i<1000; i++) {
+            arena.allocate(100);
+        }
+    }
+    LOG(INFO) << "Chunk allocated in the first round: " << allocCount << ", total: " << arena.chunkAllocCount();
+    ASSERT_TRUE(arena.chunkAllocCount() - allocCount <= 10);
+}
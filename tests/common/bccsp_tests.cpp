@@ -7,7 +7,9 @@
 
 #include "common/bccsp.h"
 #include "common/thread_pool_light.h"
+#include "common/timer.h"
 
+#include <thread>
 #include <vector>
 
 class BCCSPTest : public ::testing::Test {
@@ -135,3 +137,295 @@ TEST_F(BCCSPTest, TestGetKeyPrivate) {
     ASSERT_TRUE(*key_3->PrivateBytes() == priHex);
     ASSERT_TRUE(*key_3->PublicBytes() == pubHex);
 }
+
+TEST_F(BCCSPTest, TestVerifyRawBatch) {
+    util::OpenSSLED25519::initCrypto();
+    // disable the verified signature cache, all the signatures are checked
+    util::BCCSP bccsp(std::make_unique<util::DefaultKeyStorage>(), 0);
+    std::vector<util::CstKeyPtr> keys;
+    for (int i = 0; i < 4; i++) {
+        keys.push_back(bccsp.generateED25519Key("test_ski_" + std::to_string(i), true));
+        ASSERT_TRUE(keys.back() != nullptr && keys.back()->BatchPublicKey() != nullptr);
+    }
+    const int count = 1000;
+    std::vector<std::string> data(count);
+    std::vector<util::OpenSSLED25519::digestType> signatures(count);
+    std::vector<util::VerifyRawRequest> requests;
+    for (int i = 0; i < count; i++) {
+        data[i] = "user request " + std::to_string(i);
+        signatures[i] = *keys[i % keys.size()]->SignRaw(data[i].data(), data[i].size());
+        requests.push_back({keys[i % keys.size()], &signatures[i], data[i].data(), data[i].size()});
+    }
+    auto wp = std::make_unique<util::thread_pool_light>(4);
+    ASSERT_TRUE(util::BCCSP::VerifyRawBatch(requests));
+    ASSERT_TRUE(util::BCCSP::VerifyRawBatch(requests, nullptr, wp.get()));
+    // the invalid signatures are located one by one
+    signatures[10][40] ^= 1;
+    requests[500].key = keys[(500 + 1) % keys.size()];
+    requests[999].size--;
+    std::vector<int> invalid;
+    ASSERT_FALSE(util::BCCSP::VerifyRawBatch(requests, &invalid, wp.get()));
+    ASSERT_TRUE((invalid == std::vector<int>{10, 500, 999}));
+
+    // compare with verifying one by one
+    signatures[10][40] ^= 1;
+    requests[500].key = keys[500 % keys.size()];
+    requests[999].size++;
+    util::Timer timer;
+    for (const auto& it: requests) {
+        ASSERT_TRUE(it.key->VerifyRaw(*it.signature, it.data, it.size));
+    }
+    auto span = timer.end();
+    timer.start();
+    ASSERT_TRUE(util::BCCSP::VerifyRawBatch(requests));
+    auto batchSpan = timer.end();
+    LOG(INFO) << "Verify " << count << " signatures one by one costs: " << span << ", in a batch costs: " << batchSpan;
+}
+
+namespace {
+    util::ed25519::detail::Scalar ReduceBytes(const uint8_t* bytes, int size) {
+        uint64_t wide[8] = {};
+        for (int i = 0; i < size; i++) {
+            wide[i / 8] |= (uint64_t)bytes[i] << (8 * (i % 8));
+        }
+        return util::ed25519::detail::ScReduce(wide);
+    }
+
+    void ScalarToBytes(uint8_t out[32], const util::ed25519::detail::Scalar& s) {
+        for (int i = 0; i < 32; i++) {
+            out[i] = (uint8_t)(s[i / 8] >> (8 * (i % 8)));
+        }
+    }
+
+    void Compress(uint8_t out[32], const util::ed25519::detail::Point& p) {
+        using namespace util::ed25519::detail;
+        const auto zi = FeInvert(p.Z);
+        uint8_t xb[32];
+        FeToBytes(xb, FeMul(p.X, zi));
+        FeToBytes(out, FeMul(p.Y, zi));
+        out[31] |= (xb[0] & 1) << 7;
+    }
+
+    // sign with the scalar of the private key, R = [r]B + T, T is the point of order 2
+    util::OpenSSLED25519::digestType SignWithTorsion(const util::Key& key, const std::string& msg, bool withTorsion) {
+        using namespace util::ed25519::detail;
+        uint8_t expanded[64];
+        const auto& seed = *key.PrivateBytes();
+        CHECK(EVP_Digest(seed.data(), seed.size(), expanded, nullptr, EVP_sha512(), nullptr) == 1);
+        expanded[0] &= 248;
+        expanded[31] &= 127;
+        expanded[31] |= 64;
+        const auto a = ReduceBytes(expanded, 32);
+        const auto r = ReduceBytes(expanded + 32, 32);
+        auto point = MultiScalarMul({ToCached(BasePoint())}, {r}, 253);
+        if (withTorsion) {
+            // (x, y) + (0, -1) = (-x, -y)
+            point.X = FeNeg(point.X);
+            point.Y = FeNeg(point.Y);
+        }
+        util::OpenSSLED25519::digestType signature{};
+        Compress(signature.data(), point);
+        uint8_t digest[64];
+        CHECK(Sha512(digest, signature.data(), key.BatchPublicKey()->encoded().data(), msg.data(), msg.size()));
+        ScalarToBytes(signature.data() + 32, ScAdd(r, ScMul(ReduceBytes(digest, 64), a)));
+        return signature;
+    }
+}
+
+// the batch and the single check accept exactly the same signatures
+TEST_F(BCCSPTest, TestVerifyRawBatchSmallOrder) {
+    util::OpenSSLED25519::initCrypto();
+    util::BCCSP bccsp(std::make_unique<util::DefaultKeyStorage>(), 0);
+    auto key = bccsp.generateED25519Key("test_ski_small_order", true);
+    ASSERT_TRUE(key != nullptr && key->BatchPublicKey() != nullptr);
+    const std::string msg = "user request";
+    auto valid = SignWithTorsion(*key, msg, false);
+    ASSERT_TRUE(key->VerifyRaw(valid, msg.data(), msg.size()));
+    util::ed25519::BatchItem item{key->BatchPublicKey(), valid.data(), msg.data(), msg.size()};
+    ASSERT_TRUE(util::ed25519::VerifyBatch(&item, 1));
+    // the cofactored equation holds, the cofactorless one does not
+    auto torsion = SignWithTorsion(*key, msg, true);
+    ASSERT_TRUE(key->VerifyRaw(torsion, msg.data(), msg.size()));
+    item.signature = torsion.data();
+    ASSERT_TRUE(util::ed25519::VerifyBatch(&item, 1));
+    std::vector<util::VerifyRawRequest> requests{{key, &torsion, msg.data(), msg.size()}, {key, &valid, msg.data(), msg.size()}};
+    ASSERT_TRUE(util::BCCSP::VerifyRawBatch(requests));
+    // both of them reject the signature of another message
+    const std::string other = "user request!";
+    ASSERT_FALSE(key->VerifyRaw(torsion, other.data(), other.size()));
+    requests[0].data = other.data();
+    requests[0].size = other.size();
+    std::vector<int> invalid;
+    ASSERT_FALSE(util::BCCSP::VerifyRawBatch(requests, &invalid));
+    ASSERT_TRUE((invalid == std::vector<int>{0}));
+    // a public key of order 2, [S]B == R is accepted by both
+    using namespace util::ed25519::detail;
+    uint8_t smallOrder[32];
+    Compress(smallOrder, Point{FeFromInt(0), FeNeg(FeFromInt(1)), FeFromInt(1), FeFromInt(0)});
+    auto smallOrderKey = util::ed25519::PublicKey::Decode(smallOrder);
+    ASSERT_TRUE(smallOrderKey.has_value());
+    const Scalar r{12345, 0, 0, 0};
+    util::OpenSSLED25519::digestType forged{};
+    Compress(forged.data(), MultiScalarMul({ToCached(BasePoint())}, {r}, 253));
+    ScalarToBytes(forged.data() + 32, r);
+    ASSERT_TRUE(util::ed25519::Verify(*smallOrderKey, forged.data(), msg.data(), msg.size()));
+    item = {&*smallOrderKey, forged.data(), msg.data(), msg.size()};
+    ASSERT_TRUE(util::ed25519::VerifyBatch(&item, 1));
+}
+
+// the speedup of the batch over the single check, with a single thread
+TEST_F(BCCSPTest, BenchmarkVerifyRawBatch) {
+    util::OpenSSLED25519::initCrypto();
+    util::BCCSP bccsp(std::make_unique<util::DefaultKeyStorage>(), 0);
+    std::vector<util::CstKeyPtr> keys;
+    for (int i = 0; i < 16; i++) {
+        keys.push_back(bccsp.generateED25519Key("test_ski_" + std::to_string(i), true));
+    }
+    const int count = 4096;
+    std::vector<std::string> data(count);
+    std::vector<util::OpenSSLED25519::digestType> signatures(count);
+    std::vector<util::ed25519::BatchItem> items(count);
+    for (int i = 0; i < count; i++) {
+        const auto& key = keys[i % keys.size()];
+        data[i] = "user request " + std::to_string(i);
+        signatures[i] = *key->SignRaw(data[i].data(), data[i].size());
+        items[i] = {key->BatchPublicKey(), signatures[i].data(), data[i].data(), data[i].size()};
+    }
+    for (int batchSize: {1, 16, 64, 256, 1024, 4096}) {
+        util::Timer timer;
+        for (const auto& it: items) {
+            ASSERT_TRUE(util::ed25519::Verify(*it.key, it.signature, it.message, it.size));
+        }
+        auto span = timer.end();
+        timer.start();
+        for (int i = 0; i < count; i += batchSize) {
+            ASSERT_TRUE(util::ed25519::VerifyBatch(items.data() + i, batchSize));
+        }
+        auto batchSpan = timer.end();
+        LOG(INFO) << "Batch size: " << batchSize << ", per signature one by one: " << span / count * 1e6
+                  << "us, in a batch: " << batchSpan / count * 1e6 << "us, speedup: " << span / batchSpan;
+    }
+}
+
+TEST_F(BCCSPTest, TestVerifiedSignatureCache) {
+    util::OpenSSLED25519::initCrypto();
+    util::BCCSP bccsp(std::make_unique<util::DefaultKeyStorage>(), 4096);
+    auto key = bccsp.generateED25519Key("test_ski", true);
+    ASSERT_TRUE(key != nullptr && key->GetVerifiedSignatureCache() != nullptr);
+    std::string data = "user request";
+    auto signature = *key->Sign(data.data(), data.size());
+    ASSERT_TRUE(key->Verify(signature, data.data(), data.size()));
+    ASSERT_TRUE(key->Verify(signature, data.data(), data.size()));
+    auto statistics = bccsp.getVerifiedSignatureCacheStatistics();
+    ASSERT_TRUE(statistics.hitCount == 1 && statistics.missCount == 1 && statistics.size == 1);
+    // the invalid signatures are never cached
+    auto tampered = data + "!";
+    ASSERT_FALSE(key->Verify(signature, tampered.data(), tampered.size()));
+    ASSERT_FALSE(key->Verify(signature, tampered.data(), tampered.size()));
+    statistics = bccsp.getVerifiedSignatureCacheStatistics();
+    ASSERT_TRUE(statistics.hitCount == 1 && statistics.missCount == 3 && statistics.size == 1);
+    // the same signature of another key misses
+    auto other = bccsp.generateED25519Key("test_ski_other", true);
+    ASSERT_FALSE(other->Verify(signature, data.data(), data.size()));
+
+    // the signatures verified on receive are skipped by the batch verification
+    const int count = 1000;
+    std::vector<std::string> requestData(count);
+    std::vector<util::OpenSSLED25519::digestType> signatures(count);
+    std::vector<util::VerifyRawRequest> requests;
+    for (int i = 0; i < count; i++) {
+        requestData[i] = "user request " + std::to_string(i);
+        signatures[i] = *key->SignRaw(requestData[i].data(), requestData[i].size());
+        requests.push_back({key, &signatures[i], requestData[i].data(), requestData[i].size()});
+    }
+    for (int i = 0; i < count; i += 2) {
+        ASSERT_TRUE(key->VerifyRaw(signatures[i], requestData[i].data(), requestData[i].size()));
+    }
+    auto before = bccsp.getVerifiedSignatureCacheStatistics();
+    ASSERT_TRUE(util::BCCSP::VerifyRawBatch(requests));
+    auto after = bccsp.getVerifiedSignatureCacheStatistics();
+    ASSERT_TRUE(after.hitCount - before.hitCount == count / 2);
+    signatures[1][40] ^= 1;
+    std::vector<int> invalid;
+    ASSERT_FALSE(util::BCCSP::VerifyRawBatch(requests, &invalid));
+    ASSERT_TRUE((invalid == std::vector<int>{1}));
+    LOG(INFO) << "Verified signature cache hit rate: " << bccsp.getVerifiedSignatureCacheStatistics().hitRate();
+}
+
+TEST_F(BCCSPTest, TestVerifiedSignatureCacheBounded) {
+    util::VerifiedSignatureCache cache(256);
+    util::OpenSSLED25519::digestType signature{};
+    for (int i = 0; i < 10000; i++) {
+        cache.insert(util::VerifiedSignatureCache::GetFingerprint("public key", signature, &i, sizeof(i)));
+    }
+    ASSERT_TRUE(cache.getStatistics().size <= 256 + 256 / 16);
+    // the recently inserted one is not evicted
+    int last = 9999;
+    ASSERT_TRUE(cache.contains(util::VerifiedSignatureCache::GetFingerprint("public key", signature, &last, sizeof(last))));
+}
+
+TEST_F(BCCSPTest, TestKeyDirectoryUpdate) {
+    util::OpenSSLED25519::initCrypto();
+    util::BCCSP bccsp(std::make_unique<util::DefaultKeyStorage>());
+    auto key_1 = bccsp.generateED25519Key("test_ski", false);
+    ASSERT_TRUE(bccsp.GetKey("test_ski") == key_1);
+    // the thread cached snapshot is reloaded after the key is overridden
+    auto key_2 = bccsp.generateED25519Key("test_ski", false);
+    ASSERT_TRUE(key_1 != key_2 && bccsp.GetKey("test_ski") == key_2);
+    // another bccsp does not share the snapshot
+    util::BCCSP other(std::make_unique<util::DefaultKeyStorage>());
+    ASSERT_TRUE(other.GetKey("test_ski") == nullptr);
+    ASSERT_TRUE(bccsp.GetKey("test_ski") == key_2);
+    // load from the storage concurrently, all the threads get the same key
+    auto storage = std::make_unique<util::DefaultKeyStorage>();
+    storage->saveKey("test_ski", *key_2->PrivateBytes(), true, true);
+    util::BCCSP fromStorage(std::move(storage));
+    std::vector<util::CstKeyPtr> loaded(8);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < (int)loaded.size(); i++) {
+        threads.emplace_back([&, i] { loaded[i] = fromStorage.GetKey("test_ski"); });
+    }
+    for (auto& it: threads) {
+        it.join();
+    }
+    for (const auto& it: loaded) {
+        ASSERT_TRUE(it != nullptr && it == loaded[0]);
+    }
+}
+
+TEST_F(BCCSPTest, BenchmarkConcurrentGetKey) {
+    util::OpenSSLED25519::initCrypto();
+    util::BCCSP bccsp(std::make_unique<util::DefaultKeyStorage>(), 0);
+    const int keyCount = 100;
+    for (int i = 0; i < keyCount; i++) {
+        ASSERT_TRUE(bccsp.generateED25519Key("test_ski_" + std::to_string(i), true) != nullptr);
+    }
+    std::string data = "user request";
+    auto signature = *bccsp.GetKey("test_ski_0")->SignRaw(data.data(), data.size());
+    const int threadCount = 32;
+    // verify: look up the key and verify a signature, as the validators do
+    for (auto verify: {false, true}) {
+        const int round = verify ? 200 : 100000;
+        std::vector<std::thread> threads;
+        util::Timer timer;
+        for (int i = 0; i < threadCount; i++) {
+            threads.emplace_back([&, i] {
+                std::string ski;
+                for (int j = 0; j < round; j++) {
+                    ski = "test_ski_" + std::to_string((i + j) % keyCount);
+                    auto key = bccsp.GetKey(ski);
+                    CHECK(key != nullptr);
+                    if (verify) {
+                        CHECK(key->VerifyRaw(signature, data.data(), data.size()) == (ski == "test_ski_0"));
+                    }
+                }
+            });
+        }
+        for (auto& it: threads) {
+            it.join();
+        }
+        auto span = timer.end();
+        LOG(INFO) << "threads: " << threadCount << ", verify: " << verify << ", costs per lookup: "
+                  << span * 1e9 / (threadCount * round) << " ns";
+    }
+}
@@ -9,6 +9,8 @@
 #include "common/timer.h"
 #include "common/thread_pool_light.h"
 
+#include <cstring>
+#include <thread>
 #include <vector>
 
 
@@ -61,6 +63,62 @@ TEST_F(CryptoTest, SingleThreadPerformance) {
     LOG(INFO) << "Total Time spend: " << timer.end();
 }
 
+TEST_F(CryptoTest, TestGenerateDigestFastPath) {
+    util::OpenSSLSHA256::initCrypto();
+    auto hash = util::OpenSSLSHA256();
+    std::string data;
+    for (int i = 0; i < 3000; i++) {
+        data.push_back((char)(random() % 256));
+    }
+    // across the boundary of the fast path and the padding blocks
+    for (auto size: {0, 1, 55, 56, 64, 119, 120, 128, 129, 1024, 3000}) {
+        auto digest = util::OpenSSLSHA256::generateDigest(data.data(), size);
+        ASSERT_TRUE(digest != std::nullopt && *digest == *hash.updateFinal(data.data(), size)) << "size: " << size;
+    }
+    // the thread local contexts are independent
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&] {
+            for (int j = 0; j < 1000; j++) {
+                CHECK(util::OpenSSLSHA256::toString(*util::OpenSSLSHA256::generateDigest(msg, std::strlen(msg))) == kat256);
+                CHECK(util::OpenSSLSHA1::toString(*util::OpenSSLSHA1::generateDigest(msg, std::strlen(msg))) == kat1);
+            }
+        });
+    }
+    for (auto& it: threads) {
+        it.join();
+    }
+}
+
+// compare with allocating an EVP context for each digest
+TEST_F(CryptoTest, BenchmarkGenerateDigest) {
+    util::OpenSSLSHA256::initCrypto();
+    for (auto size: {32, 64, 128, 256, 1024, 4096}) {
+        std::string data(size, 'x');
+        const int round = 200000;
+        util::Timer timer;
+        // chain the digests, so that the hashing is not optimized out
+        for (int i = 0; i < round; i++) {
+            util::OpenSSLSHA256::digestType md;
+            OpenSSL::EVP_MD_CTX_ptr ctx(EVP_MD_CTX_new());
+            CHECK(EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr) == 1 &&
+                  EVP_DigestUpdate(ctx.get(), data.data(), data.size()) == 1 &&
+                  EVP_DigestFinal_ex(ctx.get(), md.data(), nullptr) == 1);
+            data[0] = (char)md[0];
+        }
+        auto span = timer.end();
+        timer.start();
+        for (int i = 0; i < round; i++) {
+            auto md = util::OpenSSLSHA256::generateDigest(data.data(), data.size());
+            CHECK(md != std::nullopt);
+            data[0] = (char)(*md)[0];
+        }
+        auto pooledSpan = timer.end();
+        LOG(INFO) << "size: " << size << ", new context: " << span * 1e9 / round << " ns, pooled: "
+                  << pooledSpan * 1e9 / round << " ns, speedup: " << span / pooledSpan;
+    }
+}
+
 TEST_F(CryptoTest, TestED25519KeyPairGeneration) {
     util::OpenSSLED25519::initCrypto();
     auto ret = util::OpenSSLED25519::generateKeyFiles({}, {}, {});
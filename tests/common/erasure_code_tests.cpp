@@ -3,6 +3,7 @@
 //
 
 #include "common/erasure_code.h"
+#include "common/reed_solomon_erasure_code.h"
 
 #include "gtest/gtest.h"
 #include "lightweightsemaphore.h"
@@ -10,6 +11,7 @@
 #include <vector>
 #include <thread>
 #include <random>
+#include <numeric>
 #include "common/crypto.h"
 
 class ESTest : public ::testing::Test {
@@ -88,6 +90,40 @@ protected:
         }
     }
 
+    // encode and decode with the caller-owned buffers, the first parityNum data fragments are lost
+    static void bufferBenchmark(const std::string& name, util::ErasureCode& ec, int dataNum, int parityNum, int dataLen) {
+        std::string dataEncode;
+        FillDummy(dataEncode, dataLen);
+        const auto bufferSize = (dataLen / dataNum + 1) * (dataNum + parityNum) * 2;
+        std::unique_ptr<char[]> encodeBuffer(new char[bufferSize]);
+        std::unique_ptr<char[]> decodeBuffer(new char[dataLen]);
+        constexpr int round = 20;
+        std::optional<std::pair<int, int>> ret;
+        util::Timer timer;
+        for (int i = 0; i < round; i++) {
+            ret = ec.encodeWithBuffer(dataEncode, encodeBuffer.get(), bufferSize);
+        }
+        auto spanEncode = timer.end();
+        ASSERT_TRUE(ret && ret->first == dataNum + parityNum) << "Encode failed!";
+        std::vector<std::string_view> fragmentList;
+        for (int i = 0; i < ret->first; i++) {
+            if (i < std::min(parityNum, dataNum)) {
+                fragmentList.emplace_back("");
+            } else {
+                fragmentList.emplace_back(encodeBuffer.get() + i * ret->second, ret->second);
+            }
+        }
+        timer.start();
+        for (int i = 0; i < round; i++) {
+            ASSERT_TRUE(ec.decodeWithBuffer(fragmentList, dataLen, decodeBuffer.get(), dataLen)) << "Decode failed!";
+        }
+        auto spanDecode = timer.end();
+        ASSERT_TRUE(std::string_view(decodeBuffer.get(), dataLen) == dataEncode);
+        auto throughput = [&](double span) { return (double)dataLen * round / span / 1024 / 1024; };
+        LOG(INFO) << name << " " << dataNum << "+" << parityNum << ", block size: " << dataLen
+                  << ", encode (MB/s): " << throughput(spanEncode) << ", decode (MB/s): " << throughput(spanDecode);
+    }
+
     static void encodeSizeTest(util::ErasureCode& ec, int m, int n) {
         std::string dataEncode;
         for(int i=0; i<200000; i++) {
@@ -194,6 +230,10 @@ TEST_F(ESTest, ReconstructDataSuccess) {
     util::LibErasureCode ec_c_1(20, 40);
     util::LibErasureCode ec_c_2(20, 40);
     encodeDecodeTest(ec_c_1, ec_c_2);
+    LOG(INFO) << "ReedSolomonErasureCode: ";
+    util::ReedSolomonErasureCode ec_rs_1(20, 40);
+    util::ReedSolomonErasureCode ec_rs_2(20, 40);
+    encodeDecodeTest(ec_rs_1, ec_rs_2);
 }
 
 TEST_F(ESTest, ReconstructDataFailure) {
@@ -205,6 +245,10 @@ TEST_F(ESTest, ReconstructDataFailure) {
     util::LibErasureCode ec_go_1(21, 39);
     util::LibErasureCode ec_go_2(21, 39);
     encodeDecodeTest(ec_go_1, ec_go_2, false);
+    LOG(INFO) << "ReedSolomonErasureCode: ";
+    util::ReedSolomonErasureCode ec_rs_1(21, 39);
+    util::ReedSolomonErasureCode ec_rs_2(21, 39);
+    encodeDecodeTest(ec_rs_1, ec_rs_2, false);
 }
 
 TEST_F(ESTest, SizeTest) {
@@ -241,4 +285,92 @@ TEST_F(ESTest, MultiThreadReconstructData) {
     multiThreadProcessing([&](int tid){
         return esList[tid].get();
     }, m, n, tc);
-}
\ No newline at end of file
+}
+
+TEST_F(ESTest, ReedSolomonRandomLoss) {
+    std::default_random_engine rng(0);
+    for (auto [dataNum, parityNum]: std::vector<std::pair<int, int>>{{1, 0}, {4, 2}, {16, 8}, {85, 170}}) {
+        util::ReedSolomonErasureCode ec(dataNum, parityNum);
+        for (int dataLen: {1, 1023, 4096, 100003}) {
+            std::string dataEncode;
+            FillDummy(dataEncode, dataLen);
+            auto encodeResult = ec.encode(dataEncode);
+            ASSERT_TRUE(encodeResult != nullptr);
+            auto svList = *encodeResult->getAll();
+            std::vector<int> index(svList.size());
+            std::iota(index.begin(), index.end(), 0);
+            for (int i = 0; i < 10; i++) {
+                // lose any parityNum fragments
+                std::shuffle(index.begin(), index.end(), rng);
+                auto fragmentList = svList;
+                for (int j = 0; j < parityNum; j++) {
+                    fragmentList[index[j]] = {};
+                }
+                auto decodeResult = ec.decode(fragmentList, dataLen);
+                ASSERT_TRUE(decodeResult != nullptr && decodeResult->getData() == dataEncode);
+                if (parityNum == 0) {
+                    continue;
+                }
+                // one more fragment is lost
+                fragmentList[index[parityNum]] = {};
+                ASSERT_TRUE(ec.decode(fragmentList, dataLen) == nullptr);
+            }
+        }
+    }
+}
+
+// Compare the backends over the block sizes and shard counts used by the replicator
+// The same erasure pattern reuses the inverted matrix, across the codes that share the cache
+TEST_F(ESTest, DecodeMatrixCache) {
+    const int dataNum = 16, parityNum = 8, dataLen = 100003;
+    auto cache = std::make_shared<util::DecodeMatrixCache>();
+    util::ReedSolomonErasureCode ec_1(dataNum, parityNum, cache), ec_2(dataNum, parityNum, cache);
+    util::ReedSolomonErasureCode ec_uncached(dataNum, parityNum);
+    std::string dataEncode;
+    FillDummy(dataEncode, dataLen);
+    auto encodeResult = ec_1.encode(dataEncode);
+    ASSERT_TRUE(encodeResult != nullptr);
+    auto svList = *encodeResult->getAll();
+    // two stable patterns: lose the first or the last parityNum data fragments
+    for (int i = 0; i < 10; i++) {
+        auto fragmentList = svList;
+        for (int j = 0; j < parityNum; j++) {
+            fragmentList[i % 2 == 0 ? j : dataNum - 1 - j] = {};
+        }
+        auto& ec = i < 5 ? ec_1 : ec_2;
+        auto decodeResult = ec.decode(fragmentList, dataLen);
+        ASSERT_TRUE(decodeResult != nullptr && decodeResult->getData() == dataEncode);
+        decodeResult = ec_uncached.decode(fragmentList, dataLen);
+        ASSERT_TRUE(decodeResult != nullptr && decodeResult->getData() == dataEncode);
+    }
+    // no matrix is needed if all data fragments are received
+    ASSERT_TRUE(ec_2.decode(svList, dataLen) != nullptr);
+    auto s = cache->getStatistics();
+    ASSERT_TRUE(s.size == 2 && s.missCount == 2 && s.hitCount == 8);
+    LOG(INFO) << "Decode matrix cache hit rate: " << s.hitRate();
+    // a steady erasure pattern, compare the decode latency
+    auto fragmentList = svList;
+    for (int j = 0; j < parityNum; j++) {
+        fragmentList[j * 2] = {};
+    }
+    for (auto* ec: {&ec_uncached, &ec_1}) {
+        util::Timer timer;
+        for (int i = 0; i < 1000; i++) {
+            CHECK(ec->decode(fragmentList, dataLen) != nullptr);
+        }
+        LOG(INFO) << (ec->getDecodeMatrixCache() == nullptr ? "Uncached" : "Cached") << " decode latency (us): " << timer.end() * 1000;
+    }
+}
+
+TEST_F(ESTest, BackendBenchmark) {
+    for (auto [dataNum, parityNum]: std::vector<std::pair<int, int>>{{4, 2}, {8, 4}, {16, 8}}) {
+        util::GoErasureCode go(dataNum, parityNum);
+        util::LibErasureCode lib(dataNum, parityNum);
+        util::ReedSolomonErasureCode rs(dataNum, parityNum);
+        for (int dataLen: {4 * 1024, 64 * 1024, 512 * 1024, 2 * 1024 * 1024}) {
+            bufferBenchmark("GoErasureCode", go, dataNum, parityNum, dataLen);
+            bufferBenchmark("LibErasureCode", lib, dataNum, parityNum, dataLen);
+            bufferBenchmark("ReedSolomonErasureCode", rs, dataNum, parityNum, dataLen);
+        }
+    }
+}
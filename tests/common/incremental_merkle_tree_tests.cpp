@@ -0,0 +1,153 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "gtest/gtest.h"
+#include "common/incremental_merkle_tree.h"
+#include "common/sha256_multi_buffer.h"
+#include "common/timer.h"
+
+class IncrementalMerkleTreeTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        util::OpenSSLSHA256::initCrypto();
+    };
+
+    void TearDown() override {
+    };
+
+    class mockDataBlock: public pmt::DataBlock {
+    public:
+        std::string data;
+
+        [[nodiscard]] std::optional<pmt::HashString> Digest() const override {
+            return util::OpenSSLSHA256::generateDigest(data.data(), data.size());
+        }
+    };
+
+    std::shared_ptr<util::thread_pool_light> wp = std::make_shared<util::thread_pool_light>();
+
+    static std::vector<std::unique_ptr<pmt::DataBlock>> genTestDataBlocks(int num, int len=100) {
+        std::vector<std::unique_ptr<pmt::DataBlock>> blocks(num);
+        for (auto i = 0; i < num; i++) {
+            auto block = std::make_unique<mockDataBlock>();
+            block->data.resize(len + random() % 8);
+            for (auto &b: block->data) {
+                b = (char)(random() % 256);
+            }
+            blocks[i] = std::move(block);
+        }
+        return blocks;
+    }
+
+    static std::unique_ptr<pmt::MerkleTree> buildIncremental(const std::vector<std::unique_ptr<pmt::DataBlock>>& blocks,
+                                                             const pmt::Config& config,
+                                                             std::shared_ptr<util::thread_pool_light> wp) {
+        pmt::IncrementalMerkleBuilder builder;
+        for (const auto& it: blocks) {
+            builder.appendPayload(dynamic_cast<mockDataBlock*>(it.get())->data);
+        }
+        return builder.finalize(config, std::move(wp));
+    }
+};
+
+TEST_F(IncrementalMerkleTreeTest, TestHashMany) {
+    for (auto len: {0, 1, 55, 56, 63, 64, 100, 1000}) {
+        std::vector<std::string> data(37);
+        std::vector<std::string_view> messages;
+        for (int i = 0; i < (int)data.size(); i++) {
+            data[i].resize(len + (i % 3) * (len % 2));
+            for (auto &b: data[i]) {
+                b = (char)(random() % 256);
+            }
+            messages.emplace_back(data[i]);
+        }
+        std::vector<util::sha256::Digest> digests(messages.size());
+        util::sha256::HashMany(messages.data(), digests.data(), messages.size());
+        for (int i = 0; i < (int)data.size(); i++) {
+            ASSERT_TRUE(digests[i] == *util::OpenSSLSHA256::generateDigest(data[i].data(), data[i].size())) << "len: " << data[i].size();
+        }
+    }
+    std::vector<util::sha256::Digest> children(300), parents(150);
+    for (auto& it: children) {
+        it = *util::OpenSSLSHA256::generateDigest(&it, sizeof(it));
+    }
+    util::sha256::HashNodes(children.data(), parents.data(), parents.size());
+    for (int i = 0; i < (int)parents.size(); i++) {
+        ASSERT_TRUE(parents[i] == pmt::Config::HashFunc(children[i * 2], children[i * 2 + 1]));
+    }
+}
+
+TEST_F(IncrementalMerkleTreeTest, TestEquivalent) {
+    for (auto mode: {pmt::ModeType::ModeProofGen, pmt::ModeType::ModeTreeBuild, pmt::ModeType::ModeProofGenAndTreeBuild}) {
+        for (auto parallel: {false, true}) {
+            pmt::Config config;
+            config.Mode = mode;
+            config.RunInParallel = parallel;
+            for (int n = 2; n <= 300; n++) {
+                auto blocks = genTestDataBlocks(n);
+                auto expected = pmt::MerkleTree::New(config, blocks, parallel ? wp : nullptr);
+                auto mt = buildIncremental(blocks, config, parallel ? wp : nullptr);
+                ASSERT_TRUE(expected != nullptr && mt != nullptr);
+                ASSERT_TRUE(mt->getRoot() == expected->getRoot()) << "leaves: " << n;
+                ASSERT_TRUE(mt->getProofs().size() == expected->getProofs().size());
+                for (int i = 0; i < (int)mt->getProofs().size(); i++) {
+                    ASSERT_TRUE(mt->getProofs()[i].equal(expected->getProofs()[i])) << "leaves: " << n << ", index: " << i;
+                    ASSERT_TRUE(*mt->Verify(*blocks[i], mt->getProofs()[i]));
+                }
+                if (mode == pmt::ModeType::ModeProofGen) {
+                    continue;
+                }
+                for (int i = 0; i < n; i++) {
+                    auto proof = mt->GenerateProof(*blocks[i]);
+                    ASSERT_TRUE(proof != std::nullopt);
+                    ASSERT_TRUE(proof->equal(*expected->GenerateProof(*blocks[i])));
+                    ASSERT_TRUE(*mt->Verify(*blocks[i], *proof));
+                }
+            }
+        }
+    }
+}
+
+TEST_F(IncrementalMerkleTreeTest, TestAppendLeaf) {
+    auto blocks = genTestDataBlocks(100);
+    pmt::IncrementalMerkleBuilder builder;
+    for (int i = 0; i < (int)blocks.size(); i++) {
+        if (i % 3 == 0) {
+            builder.appendLeaf(*blocks[i]->Digest());
+        } else {
+            builder.appendPayload(dynamic_cast<mockDataBlock*>(blocks[i].get())->data);
+        }
+    }
+    ASSERT_TRUE(builder.size() == 100);
+    auto mt = builder.finalize({});
+    ASSERT_TRUE(mt != nullptr && builder.size() == 0);
+    ASSERT_TRUE(mt->getRoot() == pmt::MerkleTree::New({}, blocks)->getRoot());
+    ASSERT_TRUE(builder.finalize({}) == nullptr);
+}
+
+// the builder is fed by the caller thread, the same as the leaves arrive one by one
+TEST_F(IncrementalMerkleTreeTest, BenchmarkCompareWithMerkleTreeNew) {
+    for (auto parallel: {false, true}) {
+        pmt::Config config;
+        config.Mode = pmt::ModeType::ModeProofGenAndTreeBuild;
+        config.RunInParallel = parallel;
+        config.LeafGenParallel = parallel;
+        for (auto n: {1000, 10000, 100000}) {
+            auto blocks = genTestDataBlocks(n);
+            const int round = 1000000 / n;
+            util::Timer timer;
+            for (int i = 0; i < round; i++) {
+                CHECK(pmt::MerkleTree::New(config, blocks, parallel ? wp : nullptr) != nullptr);
+            }
+            auto span = timer.end() / round;
+            timer.start();
+            for (int i = 0; i < round; i++) {
+                CHECK(buildIncremental(blocks, config, parallel ? wp : nullptr) != nullptr);
+            }
+            auto incrementalSpan = timer.end() / round;
+            LOG(INFO) << "leaves: " << n << ", parallel: " << parallel << ", MerkleTree::New costs: " << span
+                      << ", IncrementalMerkleBuilder costs: " << incrementalSpan << ", speedup: " << span / incrementalSpan;
+        }
+    }
+}
@@ -0,0 +1,322 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "common/pbft/pbft_replica.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+#include <deque>
+#include <random>
+#include <set>
+
+// The leader proposes maxProposals proposals, the proposals are signed with the bccsp key like LocalConsensus
+class MockReplicaStateMachine : public util::pbft::PBFTStateMachine {
+public:
+    MockReplicaStateMachine(std::shared_ptr<util::BCCSP> bccsp, int maxProposals)
+            : _bccsp(std::move(bccsp)), _maxProposals(maxProposals) { }
+
+    [[nodiscard]] std::unique_ptr<::proto::Block::SignaturePair> OnSignProposal(const ::util::NodeConfigPtr&, const std::string&) override {
+        std::unique_lock lock(_mutex);
+        if (_signatures.empty()) {
+            return nullptr;
+        }
+        auto signature = std::move(_signatures.front());
+        _signatures.pop_front();
+        return signature;
+    }
+
+    bool OnVerifyProposal(const ::util::NodeConfigPtr& localNode, const std::string& context) override {
+        sign(localNode, context);
+        return true;
+    }
+
+    bool OnDeliver(::util::NodeConfigPtr,
+                   const std::string& context,
+                   std::vector<::proto::Block::SignaturePair>&& signatures) override {
+        std::unique_lock lock(_mutex);
+        _delivered.push_back(context);
+        _deliveredSignatures.push_back(std::move(signatures));
+        if (auto it = _proposedAt.find(context); it != _proposedAt.end()) {
+            _latency += util::Timer::time_now_ns() - it->second;
+            _proposedAt.erase(it);
+        }
+        return true;
+    }
+
+    void OnLeaderStart(::util::NodeConfigPtr, int) override {
+        std::unique_lock lock(_mutex);
+        _signatures.clear();
+        _isLeader = true;
+        _leaderStartCount++;
+    }
+
+    void OnLeaderChange(::util::NodeConfigPtr, ::util::NodeConfigPtr, int) override {
+        std::unique_lock lock(_mutex);
+        _signatures.clear();
+        _isLeader = false;
+    }
+
+    std::optional<std::string> OnRequestProposal(::util::NodeConfigPtr localNode, int, const std::string&) override {
+        std::string proposal;
+        {
+            std::unique_lock lock(_mutex);
+            if (!_isLeader || _proposed >= _maxProposals) {
+                return std::nullopt;
+            }
+            proposal = "proposal_" + std::to_string(localNode->nodeId) + "_" + std::to_string(_proposed++);
+            proposal.resize(256, 'x');  // about the size of a block header
+            _proposedAt[proposal] = util::Timer::time_now_ns();
+        }
+        sign(localNode, proposal);
+        return proposal;
+    }
+
+    [[nodiscard]] std::vector<std::string> getDelivered() const {
+        std::unique_lock lock(_mutex);
+        return _delivered;
+    }
+
+    [[nodiscard]] std::vector<std::vector<::proto::Block::SignaturePair>> getDeliveredSignatures() const {
+        std::unique_lock lock(_mutex);
+        return _deliveredSignatures;
+    }
+
+    [[nodiscard]] int getLeaderStartCount() const {
+        std::unique_lock lock(_mutex);
+        return _leaderStartCount;
+    }
+
+    // the average latency from requesting a proposal to delivering it, in ms
+    [[nodiscard]] double getAverageLatencyMs(int count) const {
+        std::unique_lock lock(_mutex);
+        return (double)_latency / 1e6 / count;
+    }
+
+protected:
+    void sign(const ::util::NodeConfigPtr& localNode, const std::string& context) {
+        auto key = _bccsp->GetKey(localNode->ski);
+        CHECK(key != nullptr && key->Private());
+        auto signature = key->Sign(context.data(), context.size());
+        CHECK(signature != std::nullopt);
+        auto pair = std::make_unique<::proto::Block::SignaturePair>();
+        pair->second.ski = localNode->ski;
+        pair->second.digest = *signature;
+        std::unique_lock lock(_mutex);
+        _signatures.push_back(std::move(pair));
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::shared_ptr<util::BCCSP> _bccsp;
+    const int _maxProposals;
+    bool _isLeader = false;
+    int _proposed = 0;
+    int _leaderStartCount = 0;
+    std::deque<std::unique_ptr<::proto::Block::SignaturePair>> _signatures;
+    std::vector<std::string> _delivered;
+    std::vector<std::vector<::proto::Block::SignaturePair>> _deliveredSignatures;
+    std::unordered_map<std::string, uint64_t> _proposedAt;
+    uint64_t _latency = 0;
+};
+
+class PBFTReplicaTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        util::OpenSSLED25519::initCrypto();
+        bccsp = std::make_shared<util::BCCSP>(std::make_unique<util::DefaultKeyStorage>());
+        threadPool = std::make_shared<util::thread_pool_light>(4);
+    };
+
+    void TearDown() override {
+        for (auto& it: replicas) {
+            it->stop();
+        }
+    };
+
+    // The in-process network, a message is dropped with lossRate, all the messages from or to a crashed replica are dropped
+    void init(int n, int maxProposals, util::pbft::PBFTReplica::Config config) {
+        crashed = std::vector<std::atomic<bool>>(n);
+        for (int i = 0; i < n; i++) {
+            util::NodeConfigPtr cfg(new util::NodeConfig);
+            cfg->nodeId = i;
+            cfg->groupId = 0;
+            cfg->ski = "0_" + std::to_string(i);
+            cfg->priIp = "127.0.0.1";
+            CHECK(bccsp->generateED25519Key(cfg->ski, false) != nullptr);
+            config.nodes.push_back(std::move(cfg));
+        }
+        for (int i = 0; i < n; i++) {
+            stateMachines.push_back(std::make_shared<MockReplicaStateMachine>(bccsp, maxProposals));
+            config.localId = i;
+            auto replica = util::pbft::PBFTReplica::NewPBFTReplica(config, bccsp, threadPool, stateMachines.back());
+            CHECK(replica != nullptr);
+            replica->setBroadcastCallback([this, i](std::string raw) {
+                broadcast(i, raw);
+            });
+            replicas.push_back(std::move(replica));
+        }
+        for (auto& it: replicas) {
+            it->start();
+        }
+        for (auto& it: replicas) {
+            it->waitUntilReady();
+        }
+    }
+
+    void broadcast(int from, const std::string& raw) {
+        if (crashed[from]) {
+            return;
+        }
+        for (int i = 0; i < (int)replicas.size(); i++) {
+            if (crashed[i]) {
+                continue;
+            }
+            if (i != from && lossRate > 0) {
+                std::unique_lock lock(rngMutex);
+                if (std::uniform_real_distribution<double>(0, 1)(rng) < lossRate) {
+                    continue;
+                }
+            }
+            replicas[i]->onMessage(raw);
+        }
+    }
+
+    // wait until the replicas (except the crashed ones) delivered count proposals
+    bool waitDelivered(int count, int timeoutMs) {
+        for (int t = 0; t < timeoutMs; t += 10) {
+            bool done = true;
+            for (int i = 0; i < (int)replicas.size(); i++) {
+                done = done && (crashed[i] || replicas[i]->getLastDelivered() >= count);
+            }
+            if (done) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+
+    // all the replicas deliver the same proposals in the same order, with a quorum of valid signatures,
+    // the replicas are stopped first
+    void assertConsistent(int quorum) {
+        for (auto& it: replicas) {
+            it->stop();
+        }
+        std::vector<std::string> longest;
+        for (const auto& it: stateMachines) {
+            auto delivered = it->getDelivered();
+            if (delivered.size() > longest.size()) {
+                longest = delivered;
+            }
+        }
+        std::set<std::string> unique(longest.begin(), longest.end());
+        ASSERT_EQ(unique.size(), longest.size()) << "a proposal is delivered twice";
+        for (const auto& it: stateMachines) {
+            auto delivered = it->getDelivered();
+            auto signatures = it->getDeliveredSignatures();
+            for (int i = 0; i < (int)delivered.size(); i++) {
+                ASSERT_EQ(delivered[i], longest[i]) << "index: " << i;
+                ASSERT_GE((int)signatures[i].size(), quorum);
+                std::set<std::string> signers;
+                for (const auto& sig: signatures[i]) {
+                    auto key = bccsp->GetKey(sig.second.ski);
+                    ASSERT_TRUE(key != nullptr);
+                    ASSERT_TRUE(key->Verify(sig.second.digest, delivered[i].data(), delivered[i].size()));
+                    signers.insert(sig.second.ski);
+                }
+                ASSERT_EQ((int)signers.size(), (int)signatures[i].size());
+            }
+        }
+    }
+
+    std::shared_ptr<util::BCCSP> bccsp;
+    std::shared_ptr<util::thread_pool_light> threadPool;
+    std::vector<std::shared_ptr<MockReplicaStateMachine>> stateMachines;
+    std::vector<std::unique_ptr<util::pbft::PBFTReplica>> replicas;
+    std::vector<std::atomic<bool>> crashed;
+    std::atomic<double> lossRate = 0;
+    std::mutex rngMutex;
+    std::mt19937 rng{1};
+};
+
+TEST_F(PBFTReplicaTest, TestNormalCase) {
+    util::pbft::PBFTReplica::Config config;
+    init(4, 500, config);
+    ASSERT_TRUE(waitDelivered(500, 10000));
+    for (const auto& it: replicas) {
+        ASSERT_EQ(it->getView(), 0);
+    }
+    ASSERT_TRUE(replicas[0]->isLeader());
+    assertConsistent(3);
+    ASSERT_EQ(stateMachines[0]->getDelivered().size(), 500);
+}
+
+TEST_F(PBFTReplicaTest, TestLeaderCrash) {
+    util::pbft::PBFTReplica::Config config;
+    config.heartbeatIntervalMs = 50;
+    config.viewChangeTimeoutMs = 300;
+    init(4, 1000, config);
+    ASSERT_TRUE(waitDelivered(100, 10000));
+    crashed[0] = true;
+    auto delivered = replicas[1]->getLastDelivered();
+    // replica 1 leads view 1, and proposes its own proposals
+    ASSERT_TRUE(waitDelivered((int)delivered + 200, 20000));
+    for (int i = 1; i < 4; i++) {
+        ASSERT_GE(replicas[i]->getView(), 1);
+    }
+    int leaderStart = 0;
+    for (int i = 1; i < 4; i++) {
+        leaderStart += stateMachines[i]->getLeaderStartCount();
+    }
+    ASSERT_GE(leaderStart, 1);
+    assertConsistent(3);
+}
+
+TEST_F(PBFTReplicaTest, TestMessageLoss) {
+    util::pbft::PBFTReplica::Config config;
+    config.heartbeatIntervalMs = 20;
+    config.viewChangeTimeoutMs = 500;
+    lossRate = 0.2;
+    init(4, 200, config);
+    ASSERT_TRUE(waitDelivered(200, 30000));
+    assertConsistent(3);
+}
+
+TEST_F(PBFTReplicaTest, TestViewChangeWithLoss) {
+    util::pbft::PBFTReplica::Config config;
+    config.heartbeatIntervalMs = 50;
+    config.viewChangeTimeoutMs = 500;
+    lossRate = 0.1;
+    init(7, 1000, config);
+    ASSERT_TRUE(waitDelivered(50, 20000));
+    crashed[0] = true;
+    auto delivered = replicas[1]->getLastDelivered();
+    ASSERT_TRUE(waitDelivered((int)delivered + 50, 30000));
+    crashed[1] = true;  // the leader of view 1
+    delivered = replicas[2]->getLastDelivered();
+    ASSERT_TRUE(waitDelivered((int)delivered + 50, 30000));
+    assertConsistent(5);
+}
+
+TEST_F(PBFTReplicaTest, BenchmarkCommitLatency) {
+    for (auto n: {4, 7}) {
+        for (auto depth: {1, 8}) {
+            const int count = 2000;
+            util::pbft::PBFTReplica::Config config;
+            config.pipelineDepth = depth;
+            init(n, count, config);
+            util::Timer timer;
+            ASSERT_TRUE(waitDelivered(count, 60000));
+            auto span = timer.end();
+            LOG(INFO) << "PBFTReplica, replicas: " << n << ", pipeline depth: " << depth
+                      << ", proposals per second: " << count / span
+                      << ", average commit latency (ms): " << stateMachines[0]->getAverageLatencyMs(count);
+            assertConsistent(2 * ((n - 1) / 3) + 1);
+            TearDown();
+            replicas.clear();
+            stateMachines.clear();
+        }
+    }
+}
@@ -31,4 +31,70 @@ TEST_F(ProofGeneratorTest, TestGenerateExecResultProof) {
                                                               block->executeResult.transactionFilter);
     ASSERT_TRUE(mt != nullptr);
     LOG(INFO) << "Root hash: " << util::OpenSSLSHA256::toString(mt->getRoot());
-}
\ No newline at end of file
+}
+TEST_F(ProofGeneratorTest, TestBodyProofBuilder) {
+    auto block = tests::ProtoBlockUtils::CreateDemoBlock();
+    auto expected = util::UserRequestMTGenerator::GenerateMerkleTree(block->body.userRequests, nullptr);
+    ASSERT_TRUE(expected != nullptr);
+    util::UserRequestMTGenerator::Builder builder;
+    for (const auto& it: block->body.userRequests) {
+        builder.append(*it);
+    }
+    auto mt = builder.build(nullptr);
+    ASSERT_TRUE(mt != nullptr && builder.size() == 0);
+    ASSERT_TRUE(mt->getRoot() == expected->getRoot());
+    for (const auto& it: block->body.userRequests) {
+        auto proof = util::UserRequestMTGenerator::GenerateProof(*mt, *it);
+        ASSERT_TRUE(proof != std::nullopt);
+        ASSERT_TRUE(util::UserRequestMTGenerator::ValidateProof(mt->getRoot(), *proof, *it));
+    }
+    // the signatures are checked with the leaf hashes
+    for (const auto& it: block->body.userRequests) {
+        builder.append(*it);
+    }
+    mt = builder.build([](const auto&, const auto&) { return false; });
+    ASSERT_TRUE(mt == nullptr && builder.size() == 0);
+}
+
+TEST_F(ProofGeneratorTest, TestExecResultDigestAtCommit) {
+    auto block = tests::ProtoBlockUtils::CreateDemoBlock();
+    auto& rwSets = block->executeResult.txReadWriteSet;
+    auto& filters = block->executeResult.transactionFilter;
+    // a value larger than the buffer of the digest writer
+    rwSets[3]->getWrites().push_back(std::make_unique<proto::KV>("key3", std::string(1000, 'v')));
+    auto expected = util::ExecResultMTGenerator::GenerateMerkleTree(rwSets, filters);
+    ASSERT_TRUE(expected != nullptr);
+    // the digest is streamed over the fields, the same as hashing them in a buffer
+    auto appendSized = [](std::string& buf, std::string_view sv) {
+        auto size = (uint32_t)sv.size();
+        buf.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        buf.append(sv);
+    };
+    std::string buf(reinterpret_cast<const char*>(rwSets[3]->getRequestDigest().data()), rwSets[3]->getRequestDigest().size());
+    appendSized(buf, rwSets[3]->getRetValueSV());
+    auto retCode = rwSets[3]->getRetCode();
+    buf.append(reinterpret_cast<const char*>(&retCode), sizeof(retCode));
+    for (const auto* list: {&rwSets[3]->getReads(), &rwSets[3]->getWrites()}) {
+        auto size = (uint32_t)list->size();
+        buf.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        for (const auto& kv: *list) {
+            appendSized(buf, kv->getKeySV());
+            appendSized(buf, kv->getValueSV());
+        }
+    }
+    buf.push_back((char)filters[3]);
+    ASSERT_TRUE(*rwSets[3]->computeDigest(filters[3]) == *util::OpenSSLSHA256::generateDigest(buf.data(), buf.size()));
+    ASSERT_TRUE(*rwSets[3]->computeDigest(filters[3]) != *rwSets[3]->computeDigest((std::byte)1));
+    // the digests computed at commit are reused
+    for (int i = 0; i < (int)rwSets.size(); i++) {
+        rwSets[i]->updateDigest(filters[i]);
+    }
+    auto mt = util::ExecResultMTGenerator::GenerateMerkleTree(rwSets, filters);
+    ASSERT_TRUE(mt != nullptr && mt->getRoot() == expected->getRoot());
+    for (int i = 0; i < 10; i++) {
+        auto proof = util::ExecResultMTGenerator::GenerateProof(*mt, *rwSets[i], filters[i]);
+        ASSERT_TRUE(proof != std::nullopt);
+        ASSERT_TRUE(util::ExecResultMTGenerator::ValidateProof(mt->getRoot(), *proof, *rwSets[i], filters[i]));
+        ASSERT_FALSE(util::ExecResultMTGenerator::ValidateProof(mt->getRoot(), *proof, *rwSets[i], (std::byte)2));
+    }
+}
@@ -0,0 +1,121 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/chaincode/chaincode.h"
+#include "client/tpcc/tpcc_workload.h"
+#include "client/tpcc/tpcc_property.h"
+#include "tests/workload_trace_utils.h"
+#include "tests/mock_property_generator.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+namespace {
+    // count the heap allocations of the benchmark thread only
+    thread_local bool countAllocation = false;
+    thread_local uint64_t allocationCount = 0;
+}
+
+void* operator new(size_t size) {
+    if (countAllocation) {
+        allocationCount++;
+    }
+    if (auto* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+class ORMArenaTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tests::MockPropertyGenerator::GenerateDefaultProperties(1, 1);
+        tests::MockPropertyGenerator::SetLocalId(0, 0);
+        client::tpcc::TPCCProperties::SetProperties(client::tpcc::TPCCProperties::USE_RANDOM_SEED, false);
+        client::tpcc::TPCCProperties::SetProperties(client::tpcc::TPCCProperties::NEW_ORDER_PROPORTION_PROPERTY, 1.0);
+        client::tpcc::TPCCProperties::SetProperties(client::tpcc::TPCCProperties::PAYMENT_PROPORTION_PROPERTY, 0.0);
+    };
+
+    void TearDown() override {
+    };
+
+    struct Result {
+        uint64_t allocationCount = 0;
+        double timeSec = 0;
+        int txnCount = 0;
+        std::vector<std::unique_ptr<proto::TxReadWriteSet>> rwSets;
+    };
+
+    // Decode and execute the transactions block by block without committing,
+    // the transactions of a block share the same arena if useArena is true.
+    static Result RunNewOrder(const std::shared_ptr<peer::db::DBConnection>& dbc,
+                              const tests::WorkloadTraceUtils::BlockTrace& trace,
+                              bool useArena) {
+        auto orm = peer::chaincode::ORM::NewORMFromDBInterface(dbc);
+        auto chaincode = peer::chaincode::NewChaincodeByName(client::tpcc::InvokeRequestType::TPCC, std::move(orm));
+        CHECK(chaincode != nullptr);
+        Result result;
+        for (const auto& block: trace) {
+            auto envelops = tests::WorkloadTraceUtils::CopyEnvelops(block);
+            util::Timer timer;
+            countAllocation = true;
+            std::shared_ptr<util::Arena> arena;
+            if (useArena) {
+                arena = std::make_shared<util::Arena>();
+                chaincode->setArena(arena.get());
+            }
+            for (auto& envelop: envelops) {
+                auto txn = proto::Transaction::NewTransactionFromEnvelop(std::move(envelop));
+                auto& userRequest = txn->getUserRequest();
+                // some NewOrder transactions abort on purpose, the rw sets are compared anyway
+                chaincode->InvokeChaincode(userRequest.getFuncNameSV(), userRequest.getArgs());
+                txn->setRetValue(chaincode->reset(txn->getReads(), txn->getWrites()));
+                txn->setArena(arena);
+                result.rwSets.push_back(proto::Transaction::DestroyTransaction(std::move(txn)).second);
+            }
+            countAllocation = false;
+            result.timeSec += timer.end();
+            result.allocationCount += allocationCount;
+            allocationCount = 0;
+            result.txnCount += (int)block.size();
+            chaincode->setArena(nullptr);
+        }
+        return result;
+    }
+};
+
+TEST_F(ORMArenaTest, NewOrderBenchmark) {
+    client::tpcc::TPCCWorkload workload;
+    workload.init(*util::Properties::GetProperties());
+    auto trace = tests::WorkloadTraceUtils::GenerateBlockTrace(workload, 20, 500);
+    auto dbc = tests::WorkloadTraceUtils::InitDB(client::tpcc::InvokeRequestType::TPCC);
+    auto before = RunNewOrder(dbc, trace, false);
+    auto after = RunNewOrder(dbc, trace, true);
+    // the rw sets must be the same
+    ASSERT_TRUE(before.rwSets.size() == after.rwSets.size());
+    for (int i=0; i<(int)before.rwSets.size(); i++) {
+        auto& lhs = before.rwSets[i];
+        auto& rhs = after.rwSets[i];
+        ASSERT_TRUE(lhs->getReads().size() == rhs->getReads().size());
+        ASSERT_TRUE(lhs->getWrites().size() == rhs->getWrites().size());
+        for (int j=0; j<(int)lhs->getReads().size(); j++) {
+            ASSERT_TRUE(lhs->getReads()[j]->equals(*rhs->getReads()[j]));
+        }
+        for (int j=0; j<(int)lhs->getWrites().size(); j++) {
+            ASSERT_TRUE(lhs->getWrites()[j]->equals(*rhs->getWrites()[j]));
+        }
+    }
+    LOG(INFO) << "NewOrder without arena, allocation/txn: " << (double)before.allocationCount / before.txnCount
+              << ", ns/txn: " << before.timeSec * 1e9 / before.txnCount;
+    LOG(INFO) << "NewOrder with arena, allocation/txn: " << (double)after.allocationCount / after.txnCount
+              << ", ns/txn: " << after.timeSec * 1e9 / after.txnCount;
+    ASSERT_TRUE(after.allocationCount < before.allocationCount);
+    // the arena is released with the last rw set
+    after.rwSets.clear();
+}
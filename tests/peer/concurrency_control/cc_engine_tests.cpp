@@ -0,0 +1,89 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/concurrency_control/cc_engine.h"
+#include "peer/concurrency_control/serial/serial_coordinator.h"
+#include "client/ycsb/ycsb_property.h"
+#include "client/small_bank/small_bank_property.h"
+#include "tests/workload_trace_utils.h"
+#include "tests/mock_property_generator.h"
+#include "common/property.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+class CCEngineTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tests::MockPropertyGenerator::GenerateDefaultProperties(1, 1);
+        tests::MockPropertyGenerator::SetLocalId(0, 0);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::RECORD_COUNT_PROPERTY, 10000);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::READ_PROPORTION_PROPERTY, 0.50);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::UPDATE_PROPORTION_PROPERTY, 0.50);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::REQUEST_DISTRIBUTION_PROPERTY, "zipfian");
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::ACCOUNTS_COUNT_PROPERTY, 10000);
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::PROB_ACCOUNT_HOTSPOT, 0.5);
+    };
+
+    void TearDown() override {
+    };
+
+    // Run the same trace on every registered engine
+    static void SweepEngines(const std::string& ccName, const tests::WorkloadTraceUtils::BlockTrace& trace) {
+        auto& registry = peer::cc::CCEngineRegistry::Instance();
+        auto* properties = util::Properties::GetProperties();
+        for (const auto& engineName: registry.getEngineNames()) {
+            if (engineName == "crdt") {
+                continue;   // only runs the crdt chaincodes
+            }
+            auto dbc = tests::WorkloadTraceUtils::InitDB(ccName, "ccEngineDB");
+            auto engine = registry.newEngine(engineName, dbc, properties->getCCWorkerCount(engineName), properties);
+            ASSERT_TRUE(engine != nullptr && engine->getName() == engineName);
+            auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+            int totalCommit = 0;
+            util::Timer timer;
+            for (auto& block: blocks) {
+                ASSERT_TRUE(engine->processValidatedRequests(block->body.userRequests,
+                                                             block->executeResult.txReadWriteSet,
+                                                             block->executeResult.transactionFilter));
+                for (const auto& it: block->executeResult.transactionFilter) {
+                    totalCommit += (int)it;
+                }
+            }
+            auto span = timer.end();
+            LOG(INFO) << ccName << ", engine: " << engineName << ", total commit: " << totalCommit << ", tps: " << totalCommit / span;
+        }
+    }
+};
+
+TEST_F(CCEngineTest, TestRegistry) {
+    auto& registry = peer::cc::CCEngineRegistry::Instance();
+    auto names = registry.getEngineNames();
+    for (const auto* it: {"aria", "aria_wb", "serial", "crdt", "dag"}) {
+        ASSERT_TRUE(std::find(names.begin(), names.end(), it) != names.end()) << it << " is not registered!";
+    }
+    auto dbc = peer::db::DBConnection::NewConnection("ccEngineDB");
+    ASSERT_TRUE(registry.newEngine("unknown", dbc, 4) == nullptr);
+    ASSERT_TRUE(registry.newEngine("aria", dbc, 0) == nullptr);
+    // per-engine worker count
+    util::Properties::SetProperties(util::Properties::ARIA_WORKER_COUNT, 3);
+    util::Properties::GetProperties()->getCustomProperties(util::Properties::CC_WORKER_COUNT)["dag"] = 5;
+    ASSERT_TRUE(util::Properties::GetProperties()->getCCWorkerCount("dag") == 5);
+    ASSERT_TRUE(util::Properties::GetProperties()->getCCWorkerCount("aria") == 3);
+    // register a custom engine
+    registry.registerCoordinator<peer::cc::serial::SerialCoordinator>("serial_copy");
+    auto engine = registry.newEngine("serial_copy", dbc, 1);
+    ASSERT_TRUE(engine != nullptr && engine->getName() == "serial_copy");
+}
+
+TEST_F(CCEngineTest, YCSBSweep) {
+    auto trace = tests::WorkloadTraceUtils::GenerateYCSBTrace(50, 1000);
+    SweepEngines(client::ycsb::InvokeRequestType::YCSB, trace);
+}
+
+TEST_F(CCEngineTest, SmallBankSweep) {
+    auto trace = tests::WorkloadTraceUtils::GenerateSmallBankTrace(50, 1000);
+    SweepEngines(client::small_bank::InvokeRequestType::SMALL_BANK, trace);
+}
@@ -0,0 +1,199 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/concurrency_control/dag/dag_coordinator.h"
+#include "peer/concurrency_control/deterministic/coordinator_impl.h"
+#include "peer/concurrency_control/serial/serial_coordinator.h"
+#include "client/ycsb/ycsb_property.h"
+#include "client/small_bank/small_bank_property.h"
+#include "tests/workload_trace_utils.h"
+#include "tests/transaction_utils.h"
+#include "tests/mock_property_generator.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+#include <mutex>
+#include <thread>
+
+class DAGCoordinatorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tests::MockPropertyGenerator::GenerateDefaultProperties(1, 1);
+        tests::MockPropertyGenerator::SetLocalId(0, 0);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::RECORD_COUNT_PROPERTY, 10000);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::READ_PROPORTION_PROPERTY, 0.50);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::UPDATE_PROPORTION_PROPERTY, 0.50);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::REQUEST_DISTRIBUTION_PROPERTY, "zipfian");
+        // high contention: 90% of the txns access 100 accounts
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::ACCOUNTS_COUNT_PROPERTY, 10000);
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::PROB_ACCOUNT_HOTSPOT, 0.9);
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::HOTSPOT_USE_FIXED_SIZE, true);
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::HOTSPOT_FIXED_SIZE, 100);
+    };
+
+    void TearDown() override {
+    };
+
+    using BlockList = std::vector<std::shared_ptr<proto::Block>>;
+
+    template<class CoordinatorType>
+    static auto Run(const std::string& ccName, const std::string& engineName, BlockList& blocks) {
+        auto dbc = tests::WorkloadTraceUtils::InitDB(ccName, "dagTestDB");
+        auto cc = CoordinatorType::NewCoordinator(dbc, workerCount);
+        CHECK(cc != nullptr);
+        int totalCommit = 0;
+        util::Timer timer;
+        for (auto& block: blocks) {
+            CHECK(cc->processValidatedRequests(block->body.userRequests,
+                                               block->executeResult.txReadWriteSet,
+                                               block->executeResult.transactionFilter));
+            for (const auto& it: block->executeResult.transactionFilter) {
+                totalCommit += (int)it;
+            }
+        }
+        auto span = timer.end();
+        LOG(INFO) << ccName << " " << engineName << " total commit: " << totalCommit << ", tps: " << totalCommit / span;
+        return cc;
+    }
+
+    static void RunBenchmark(const std::string& ccName, const tests::WorkloadTraceUtils::BlockTrace& trace) {
+        auto serialBlocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        auto ariaBlocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        auto dagBlocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        Run<peer::cc::serial::SerialCoordinator>(ccName, "serial", serialBlocks);
+        auto aria = Run<peer::cc::CoordinatorImpl>(ccName, "aria", ariaBlocks);
+        auto dag = Run<peer::cc::dag::DAGCoordinator>(ccName, "dag", dagBlocks);
+        const auto& as = aria->getStatistics();
+        const auto& ds = dag->getStatistics();
+        LOG(INFO) << ccName << " aria abort rate: " << as.finalAbortRate();
+        LOG(INFO) << ccName << " dag edges per txn: " << (double)ds.totalEdgeCount / (double)ds.totalTxnCount
+                  << ", re-executed: " << ds.reExecutedCount << ", serial: " << ds.serialCount;
+        // without the serial tail, the graph order is equivalent to the batch order
+        if (ds.serialCount != 0) {
+            return;
+        }
+        for (int i = 0; i < (int)trace.size(); i++) {
+            auto& lhs = serialBlocks[i]->executeResult;
+            auto& rhs = dagBlocks[i]->executeResult;
+            ASSERT_TRUE(lhs.transactionFilter == rhs.transactionFilter) << "Block " << i << " is not equivalent!";
+            for (int j = 0; j < (int)lhs.transactionFilter.size(); j++) {
+                ASSERT_TRUE(lhs.txReadWriteSet[j]->getRetValueSV() == rhs.txReadWriteSet[j]->getRetValueSV());
+            }
+        }
+    }
+
+    // txnList[i] reads readKeys[i] and writes writeKeys[i] (empty if none)
+    static auto CreateTxnList(const std::vector<std::string>& readKeys, const std::vector<std::string>& writeKeys) {
+        std::vector<std::unique_ptr<proto::Transaction>> txnList;
+        tests::TransactionUtils::CreateMockTxn(&txnList, (int)readKeys.size(), 100);
+        for (int i = 0; i < (int)txnList.size(); i++) {
+            if (!readKeys[i].empty()) {
+                txnList[i]->getReads().push_back(std::make_unique<proto::KV>(readKeys[i], ""));
+            }
+            if (!writeKeys[i].empty()) {
+                txnList[i]->getWrites().push_back(std::make_unique<proto::KV>(writeKeys[i], ""));
+            }
+        }
+        return txnList;
+    }
+
+    static void RunGraph(peer::cc::dag::DependencyGraph& graph, int workers, const auto& execute) {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < workers; i++) {
+            threads.emplace_back([&, i] { graph.run(i, execute); });
+        }
+        for (auto& it: threads) {
+            it.join();
+        }
+    }
+
+    constexpr static const int workerCount = 10;
+};
+
+// t0 writes x, t1 reads and writes x but aborts in the middle, t2 reads x.
+// t2 must still see the write of t0, though its last writer t1 did not write.
+TEST_F(DAGCoordinatorTest, StaleAfterAbortedWriter) {
+    auto txnList = CreateTxnList({"", "x", "x"}, {"x", "x", ""});
+    std::vector<proto::Transaction*> txnPtrList;
+    for (auto& it: txnList) {
+        txnPtrList.push_back(it.get());
+    }
+    peer::cc::dag::DependencyGraph graph(2);
+    graph.build(txnPtrList);
+    std::vector<int> stale(txnList.size(), -1);
+    RunGraph(graph, 2, [&](proto::Transaction* txn, bool isStale) {
+        stale[txn->getBatchIndex()] = isStale;
+        // t1 aborts without writing
+        txn->setExecutionResult(txn->getBatchIndex() == 1 ? proto::Transaction::ExecutionResult::ABORT_NO_RETRY
+                                                          : proto::Transaction::ExecutionResult::COMMIT);
+        return true;
+    });
+    ASSERT_TRUE((stale == std::vector<int>{false, true, true}));
+    ASSERT_TRUE(graph.getDeferred().empty());
+}
+
+// t1 is deferred (it touched a key out of its rw sets), t2 reads the write of t1,
+// t2 is blocked until t1 is finished, then re-executed.
+TEST_F(DAGCoordinatorTest, DeferredBeforeSuccessors) {
+    auto txnList = CreateTxnList({"", "x", "y", "z"}, {"x", "y", "", ""});
+    std::vector<proto::Transaction*> txnPtrList;
+    for (auto& it: txnList) {
+        txnPtrList.push_back(it.get());
+    }
+    peer::cc::dag::DependencyGraph graph(2);
+    graph.build(txnPtrList);
+    std::vector<int> order;
+    std::mutex mutex;
+    auto execute = [&](proto::Transaction* txn, bool isStale) {
+        std::unique_lock lock(mutex);
+        order.push_back((int)txn->getBatchIndex());
+        if (txn->getBatchIndex() == 2) {
+            EXPECT_TRUE(isStale);
+        }
+        return txn->getBatchIndex() != 1;
+    };
+    RunGraph(graph, 2, execute);
+    auto deferred = graph.getDeferred();
+    ASSERT_TRUE(deferred.size() == 1 && deferred[0] == txnPtrList[1]);
+    std::sort(order.begin(), order.end());
+    ASSERT_TRUE((order == std::vector<int>{0, 1, 3}));
+    // t1 is executed serially here
+    order.clear();
+    graph.finishDeferred();
+    RunGraph(graph, 2, execute);
+    ASSERT_TRUE((order == std::vector<int>{2}));
+    ASSERT_TRUE(graph.getDeferred().empty());
+}
+
+TEST_F(DAGCoordinatorTest, YCSBBenchmark) {
+    auto trace = tests::WorkloadTraceUtils::GenerateYCSBTrace(50, 1000);
+    RunBenchmark(client::ycsb::InvokeRequestType::YCSB, trace);
+}
+
+TEST_F(DAGCoordinatorTest, SmallBankBenchmark) {
+    auto trace = tests::WorkloadTraceUtils::GenerateSmallBankTrace(50, 1000);
+    RunBenchmark(client::small_bank::InvokeRequestType::SMALL_BANK, trace);
+}
+
+TEST_F(DAGCoordinatorTest, Deterministic) {
+    auto trace = tests::WorkloadTraceUtils::GenerateSmallBankTrace(20, 1000);
+    std::vector<std::vector<std::byte>> results;
+    for (auto workers: {1, 4, 10}) {
+        auto dbc = tests::WorkloadTraceUtils::InitDB(client::small_bank::InvokeRequestType::SMALL_BANK, "dagTestDB");
+        auto cc = peer::cc::dag::DAGCoordinator::NewCoordinator(dbc, workers);
+        ASSERT_TRUE(cc != nullptr);
+        auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        for (int i = 0; i < (int)blocks.size(); i++) {
+            ASSERT_TRUE(cc->processValidatedRequests(blocks[i]->body.userRequests,
+                                                     blocks[i]->executeResult.txReadWriteSet,
+                                                     blocks[i]->executeResult.transactionFilter));
+            if (workers == 1) {
+                results.push_back(blocks[i]->executeResult.transactionFilter);
+            } else {
+                ASSERT_TRUE(blocks[i]->executeResult.transactionFilter == results[i]) << "Block " << i << " is not deterministic!";
+            }
+        }
+    }
+}
@@ -3,7 +3,9 @@
 //
 
 #include "tests/coordinator_utils.h"
+#include "tests/workload_trace_utils.h"
 #include "peer/concurrency_control/deterministic/coordinator_impl.h"
+#include "client/ycsb/ycsb_property.h"
 
 #include "gtest/gtest.h"
 #include "glog/logging.h"
@@ -42,4 +44,48 @@ TEST_F(CoordinatorImplTest, TestSessionStore) {
     auto dbc = tests::CoordinatorUtils::initDB(recordCount);
     auto c = peer::cc::CoordinatorImpl::NewCoordinator(dbc, 10);
     tests::CoordinatorUtils::StartBenchmark([&](auto& ph) -> bool { return c->processTxnList(ph); }, recordCount);
-}
\ No newline at end of file
+}
+
+TEST_F(CoordinatorImplTest, TestAbortFallback) {
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::RECORD_COUNT_PROPERTY, 10000);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::READ_PROPORTION_PROPERTY, 0.50);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::UPDATE_PROPORTION_PROPERTY, 0.50);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::REQUEST_DISTRIBUTION_PROPERTY, "zipfian");
+    auto trace = tests::WorkloadTraceUtils::GenerateYCSBTrace(50, 1000);
+    using AbortFallback = peer::cc::CoordinatorImpl::AbortFallback;
+    std::vector<std::vector<std::byte>> serialResults;
+    for (auto fallback: { AbortFallback::NONE, AbortFallback::RESERVE_ROUND, AbortFallback::SERIAL }) {
+        auto dbc = tests::WorkloadTraceUtils::InitDB(client::ycsb::InvokeRequestType::YCSB);
+        auto c = peer::cc::CoordinatorImpl::NewCoordinator(dbc, 10);
+        c->setAbortFallback(fallback);
+        auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        for (auto& block: blocks) {
+            ASSERT_TRUE(c->processValidatedRequests(block->body.userRequests,
+                                                    block->executeResult.txReadWriteSet,
+                                                    block->executeResult.transactionFilter));
+            if (fallback == AbortFallback::SERIAL) {
+                serialResults.push_back(block->executeResult.transactionFilter);
+            }
+        }
+        const auto& s = c->getStatistics();
+        ASSERT_TRUE(s.finalAbortCount <= s.firstRoundAbortCount);
+        if (fallback == AbortFallback::SERIAL) {
+            ASSERT_TRUE(s.finalAbortCount == 0);
+        }
+        LOG(INFO) << "Fallback mode: " << (int)fallback
+                  << ", first round abort rate: " << s.firstRoundAbortRate()
+                  << ", final abort rate: " << s.finalAbortRate()
+                  << ", tps: " << s.throughput();
+    }
+    // the serial fallback must be deterministic
+    auto dbc = tests::WorkloadTraceUtils::InitDB(client::ycsb::InvokeRequestType::YCSB);
+    auto c = peer::cc::CoordinatorImpl::NewCoordinator(dbc, 7);
+    c->setAbortFallback(AbortFallback::SERIAL);
+    auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+    for (int i = 0; i < (int)blocks.size(); i++) {
+        ASSERT_TRUE(c->processValidatedRequests(blocks[i]->body.userRequests,
+                                                blocks[i]->executeResult.txReadWriteSet,
+                                                blocks[i]->executeResult.transactionFilter));
+        ASSERT_TRUE(blocks[i]->executeResult.transactionFilter == serialResults[i]);
+    }
+}
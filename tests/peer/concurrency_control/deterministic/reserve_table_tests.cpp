@@ -5,6 +5,7 @@
 #include "peer/concurrency_control/deterministic/reserve_table.h"
 #include "tests/transaction_utils.h"
 #include "common/thread_pool_light.h"
+#include "common/timer.h"
 #include "bthread/countdown_event.h"
 
 #include "gtest/gtest.h"
@@ -19,6 +20,16 @@ protected:
 
     };
 
+    // the sharded table uses the tid as priority, the new one uses the batch index
+    static auto& TxnPriority(peer::cc::ShardedReserveTable*, const auto& tidList, int i) { return tidList[i]; }
+
+    static auto TxnPriority(peer::cc::ReserveTable*, const auto&, int i) { return (peer::cc::ReserveTable::index_type)i; }
+
+    static auto& DerefPriority(const std::shared_ptr<proto::tid_type>& tid) { return *tid; }
+
+    static auto DerefPriority(peer::cc::ReserveTable::index_type index) { return index; }
+
+    template<class TableType>
     static auto testCase(util::thread_pool_light* tp=nullptr) {
         static constexpr int range = 100000;
         static constexpr int txnCnt = 5000;
@@ -28,7 +39,7 @@ protected:
         for (auto& txn: txnList) {
             txn = tests::TransactionUtils::CreateRandomKVs(keySize, range);
         }
-        peer::cc::ReserveTable table;
+        TableType table;
         std::array<std::shared_ptr<proto::tid_type>, txnCnt> tidList;
         for (uint i=0; i<(uint)tidList.size(); i++) {
             tidList[i] = std::make_shared<proto::tid_type>();
@@ -38,7 +49,7 @@ protected:
 
         if (tp == nullptr) {
             for (int i=0; i<(int)txnList.size(); i++) {
-                table.reserveRWSets(txnList[i].first, txnList[i].second, tidList[i]);
+                table.reserveRWSets(txnList[i].first, txnList[i].second, TxnPriority(&table, tidList, i));
             }
         } else {
             auto tc = (int)tp->get_thread_count();
@@ -46,7 +57,7 @@ protected:
             for (int i=0; i<tc; i++) {
                 tp->push_task([&, start=i]{
                     for (int j = start; j < (int)txnList.size(); j += tc) {
-                        table.reserveRWSets(txnList[j].first, txnList[j].second, tidList[j]);
+                        table.reserveRWSets(txnList[j].first, txnList[j].second, TxnPriority(&table, tidList, j));
                     }
                     countdown.signal();
                 });
@@ -56,7 +67,7 @@ protected:
 
         int aborted = 0;
         for (int i=0; i<(int)txnList.size(); i++) {
-            auto dep = table.analysisDependent(txnList[i].first, txnList[i].second, *tidList[i]);
+            auto dep = table.analysisDependent(txnList[i].first, txnList[i].second, DerefPriority(TxnPriority(&table, tidList, i)));
             if (!dep.waw && (!dep.war || !dep.raw)) {    //  war / raw / no dependency, commit it.
                 auto read = std::stoi(std::string(txnList[i].second[0]->getKeySV()));
                 auto write = std::stoi(std::string(txnList[i].second[1]->getKeySV()));
@@ -81,13 +92,108 @@ protected:
 
 TEST_F(ReserveTableTest, TestSerial) {
     for(int i=0; i<100; i++) {
-        testCase(nullptr);
+        testCase<peer::cc::ShardedReserveTable>(nullptr);
+        testCase<peer::cc::ReserveTable>(nullptr);
     }
 }
 
 TEST_F(ReserveTableTest, TestParallel) {
     util::thread_pool_light tp(10);
     for(int i=0; i<100; i++) {
-        testCase(&tp);
+        testCase<peer::cc::ShardedReserveTable>(&tp);
+        testCase<peer::cc::ReserveTable>(&tp);
+    }
+}
+
+TEST_F(ReserveTableTest, TestReservationArray) {
+    // a small array to test the overflow map and the resize
+    peer::cc::ReservationArray array(16);
+    std::vector<std::string> keys;
+    for (int i=0; i<100; i++) {
+        keys.push_back(std::to_string(i));
+    }
+    for (int round=0; round<3; round++) {
+        for (int i=0; i<(int)keys.size(); i++) {
+            array.reserveMin(keys[i], i + 10);
+            array.reserveMin(keys[i], i + 1);
+            array.reserveMin(keys[i], i + 5);
+        }
+        for (int i=0; i<(int)keys.size(); i++) {
+            ASSERT_TRUE(array.find(keys[i]) == (uint32_t)i + 1);
+        }
+        ASSERT_TRUE(array.find("not_exist") == peer::cc::ReservationArray::NOT_FOUND);
+        array.reset();
+        // all keys are cleared after reset
+        for (const auto& key: keys) {
+            ASSERT_TRUE(array.find(key) == peer::cc::ReservationArray::NOT_FOUND);
+        }
+    }
+    // enlarged after the first round
+    ASSERT_TRUE(array.capacity() >= 2 * keys.size());
+    for (int i=0; i<(int)keys.size(); i++) {
+        array.reserveMax(keys[i], i + 1);
+        array.reserveMax(keys[i], i + 10);
+        array.reserveMax(keys[i], i + 5);
+        ASSERT_TRUE(array.find(keys[i]) == (uint32_t)i + 10);
+    }
+}
+
+// Compare the sharded table with the reservation array based one
+TEST_F(ReserveTableTest, BenchmarkReserve) {
+    static constexpr int range = 100000;
+    static constexpr int txnCnt = 50000;
+    static constexpr int keySize = 10;
+    static constexpr int batchCount = 20;
+    std::vector<std::pair<proto::KVList, proto::KVList>> txnList(txnCnt);
+    for (auto& txn: txnList) {
+        txn = tests::TransactionUtils::CreateRandomKVs(keySize, range);
+    }
+    std::vector<std::shared_ptr<proto::tid_type>> tidList(txnCnt);
+    for (uint i=0; i<(uint)tidList.size(); i++) {
+        tidList[i] = std::make_shared<proto::tid_type>();
+        auto ptr = reinterpret_cast<uint*>(tidList[i]->data());
+        *ptr = i;
+    }
+    auto runBenchmark = [&]<class TableType>(TableType& table, util::thread_pool_light& tp) {
+        auto tc = (int)tp.get_thread_count();
+        std::atomic<int> aborted = 0;
+        util::Timer timer;
+        for (int b=0; b<batchCount; b++) {
+            table.reset();
+            bthread::CountdownEvent countdown(tc);
+            for (int i=0; i<tc; i++) {
+                tp.push_task([&, start=i]{
+                    for (int j = start; j < (int)txnList.size(); j += tc) {
+                        table.reserveRWSets(txnList[j].first, txnList[j].second, TxnPriority(&table, tidList, j));
+                    }
+                    countdown.signal();
+                });
+            }
+            countdown.wait();
+            countdown.reset(tc);
+            for (int i=0; i<tc; i++) {
+                tp.push_task([&, start=i]{
+                    for (int j = start; j < (int)txnList.size(); j += tc) {
+                        auto dep = table.analysisDependent(txnList[j].first, txnList[j].second, DerefPriority(TxnPriority(&table, tidList, j)));
+                        if (dep.waw || (dep.war && dep.raw)) {
+                            aborted.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }
+                    countdown.signal();
+                });
+            }
+            countdown.wait();
+        }
+        return std::make_pair(timer.end(), aborted.load() / batchCount);
+    };
+    for (int threadCount: {8, 16, 32}) {
+        util::thread_pool_light tp(threadCount);
+        peer::cc::ShardedReserveTable shardedTable;
+        auto [shardedCost, shardedAborted] = runBenchmark(shardedTable, tp);
+        peer::cc::ReserveTable table;
+        auto [cost, aborted] = runBenchmark(table, tp);
+        LOG(INFO) << "Worker count: " << threadCount
+                  << ", sharded table tps: " << txnCnt * batchCount / shardedCost << " (aborted: " << shardedAborted << ")"
+                  << ", reservation array tps: " << txnCnt * batchCount / cost << " (aborted: " << aborted << ")";
     }
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/concurrency_control/execution_pipeline.h"
+#include "peer/concurrency_control/deterministic/coordinator_impl.h"
+#include "client/ycsb/ycsb_property.h"
+#include "client/small_bank/small_bank_property.h"
+#include "tests/workload_trace_utils.h"
+#include "tests/mock_property_generator.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+class ExecutionPipelineTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tests::MockPropertyGenerator::GenerateDefaultProperties(1, 1);
+        tests::MockPropertyGenerator::SetLocalId(0, 0);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::RECORD_COUNT_PROPERTY, 10000);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::READ_PROPORTION_PROPERTY, 0.50);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::UPDATE_PROPORTION_PROPERTY, 0.50);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::REQUEST_DISTRIBUTION_PROPERTY, "zipfian");
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::ACCOUNTS_COUNT_PROPERTY, 10000);
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::PROB_ACCOUNT_HOTSPOT, 0.3);
+    };
+
+    void TearDown() override {
+    };
+
+    using BlockList = std::vector<std::shared_ptr<proto::Block>>;
+
+    static auto RunSerial(const std::string& ccName, BlockList& blocks) {
+        auto dbc = tests::WorkloadTraceUtils::InitDB(ccName, "serialDB");
+        auto cc = peer::cc::CoordinatorImpl::NewCoordinator(dbc, workerCount);
+        CHECK(cc != nullptr);
+        util::Timer timer;
+        for (auto& block: blocks) {
+            CHECK(cc->processValidatedRequests(block->body.userRequests,
+                                               block->executeResult.txReadWriteSet,
+                                               block->executeResult.transactionFilter));
+        }
+        return timer.end();
+    }
+
+    static auto RunPipeline(const std::string& ccName, BlockList& blocks, int depth) {
+        auto dbc = tests::WorkloadTraceUtils::InitDB(ccName, "pipelineDB");
+        auto cc = peer::cc::CoordinatorImpl::NewCoordinator(dbc, workerCount);
+        CHECK(cc != nullptr);
+        auto pipeline = peer::cc::ExecutionPipeline<peer::cc::CoordinatorImpl>::NewExecutionPipeline(cc.get(), depth, workerCount);
+        CHECK(pipeline != nullptr);
+        bthread::CountdownEvent countdown((int)blocks.size());
+        proto::BlockNumber expectBlockNumber = 0;
+        pipeline->setCommitCallback([&](int regionId, std::shared_ptr<proto::Block> block, bool success) {
+            CHECK(success);
+            // the blocks must be committed in order
+            CHECK(block->header.number == expectBlockNumber++);
+            countdown.signal();
+        });
+        util::Timer timer;
+        for (auto& block: blocks) {
+            CHECK(pipeline->addBlock(0, block));
+        }
+        countdown.wait();
+        return timer.end();
+    }
+
+    static void RunBenchmark(const std::string& ccName, const tests::WorkloadTraceUtils::BlockTrace& trace) {
+        auto serialBlocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        auto pipelineBlocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        auto serialCost = RunSerial(ccName, serialBlocks);
+        auto pipelineCost = RunPipeline(ccName, pipelineBlocks, 3);
+        // the result must be deterministic
+        int totalCommit = 0;
+        for (int i = 0; i < (int)trace.size(); i++) {
+            auto& lhs = serialBlocks[i]->executeResult;
+            auto& rhs = pipelineBlocks[i]->executeResult;
+            ASSERT_TRUE(lhs.transactionFilter == rhs.transactionFilter) << "Block " << i << " is not deterministic!";
+            for (int j = 0; j < (int)lhs.transactionFilter.size(); j++) {
+                ASSERT_TRUE(lhs.txReadWriteSet[j]->getRetCode() == rhs.txReadWriteSet[j]->getRetCode());
+                totalCommit += (int)lhs.transactionFilter[j];
+            }
+        }
+        LOG(INFO) << ccName << " total commit: " << totalCommit;
+        LOG(INFO) << ccName << " serial tps: " << totalCommit / serialCost;
+        LOG(INFO) << ccName << " pipeline tps: " << totalCommit / pipelineCost;
+    }
+
+    constexpr static const int workerCount = 10;
+};
+
+TEST_F(ExecutionPipelineTest, YCSBBenchmark) {
+    auto trace = tests::WorkloadTraceUtils::GenerateYCSBTrace(100, 1000);
+    RunBenchmark(client::ycsb::InvokeRequestType::YCSB, trace);
+}
+
+TEST_F(ExecutionPipelineTest, SmallBankBenchmark) {
+    auto trace = tests::WorkloadTraceUtils::GenerateSmallBankTrace(100, 1000);
+    RunBenchmark(client::small_bank::InvokeRequestType::SMALL_BANK, trace);
+}
+
+TEST_F(ExecutionPipelineTest, EmptyBlock) {
+    tests::WorkloadTraceUtils::BlockTrace trace(10);
+    auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+    RunPipeline(client::ycsb::InvokeRequestType::YCSB, blocks, 1);
+    for (auto& block: blocks) {
+        ASSERT_TRUE(block->executeResult.transactionFilter.empty());
+    }
+}
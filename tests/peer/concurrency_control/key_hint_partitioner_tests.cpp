@@ -0,0 +1,175 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/concurrency_control/key_hint_partitioner.h"
+#include "peer/concurrency_control/deterministic/coordinator_impl.h"
+#include "client/ycsb/ycsb_property.h"
+#include "client/small_bank/small_bank_property.h"
+#include "tests/workload_trace_utils.h"
+#include "tests/mock_property_generator.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+#include <set>
+
+class KeyHintPartitionerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        tests::MockPropertyGenerator::GenerateDefaultProperties(1, 1);
+        tests::MockPropertyGenerator::SetLocalId(0, 0);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::RECORD_COUNT_PROPERTY, 10000);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::READ_PROPORTION_PROPERTY, 0.50);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::UPDATE_PROPORTION_PROPERTY, 0.50);
+        client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::REQUEST_DISTRIBUTION_PROPERTY, "zipfian");
+        // high contention: 90% of the txns access 100 accounts
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::ACCOUNTS_COUNT_PROPERTY, 10000);
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::PROB_ACCOUNT_HOTSPOT, 0.9);
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::HOTSPOT_USE_FIXED_SIZE, true);
+        client::small_bank::SmallBankProperties::SetProperties(client::small_bank::SmallBankProperties::HOTSPOT_FIXED_SIZE, 100);
+    };
+
+    void TearDown() override {
+    };
+
+    using BlockList = std::vector<std::shared_ptr<proto::Block>>;
+
+    static std::vector<std::unique_ptr<proto::Transaction>> DecodeBlock(proto::Block& block) {
+        std::vector<std::unique_ptr<proto::Transaction>> txnList;
+        for (auto& it: block.body.userRequests) {
+            txnList.push_back(proto::Transaction::NewTransactionFromEnvelop(std::move(it)));
+            CHECK(txnList.back() != nullptr);
+        }
+        return txnList;
+    }
+
+    static std::unique_ptr<peer::cc::CoordinatorImpl> Run(const std::string& ccName, bool partition, BlockList& blocks) {
+        auto dbc = tests::WorkloadTraceUtils::InitDB(ccName, "partitionTestDB");
+        auto cc = peer::cc::CoordinatorImpl::NewCoordinator(dbc, workerCount);
+        CHECK(cc != nullptr);
+        if (partition) {
+            cc->setPartitioner(peer::cc::KeyHintPartitioner::NewDefaultPartitioner());
+        }
+        for (auto& block: blocks) {
+            CHECK(cc->processValidatedRequests(block->body.userRequests,
+                                               block->executeResult.txReadWriteSet,
+                                               block->executeResult.transactionFilter));
+        }
+        return cc;
+    }
+
+    // The written keys that are written by more than one worker in the same batch
+    static double CrossWorkerWriteRate(const tests::WorkloadTraceUtils::BlockTrace& trace,
+                                       const BlockList& executed, bool partition) {
+        auto partitioner = peer::cc::KeyHintPartitioner::NewDefaultPartitioner();
+        auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        std::vector<std::vector<uint32_t>> assignment(workerCount);
+        uint64_t sharedKeyCount = 0, totalKeyCount = 0;
+        for (int i = 0; i < (int)blocks.size(); i++) {
+            auto txnList = DecodeBlock(*blocks[i]);
+            if (partition) {
+                partitioner->partition(txnList, assignment);
+            } else {
+                for (int w = 0; w < workerCount; w++) {
+                    assignment[w].clear();
+                    for (int j = w; j < (int)txnList.size(); j += workerCount) {
+                        assignment[w].push_back(j);
+                    }
+                }
+            }
+            util::MyFlatHashMap<std::string_view, std::set<int>> writers;
+            const auto& rwSets = executed[i]->executeResult.txReadWriteSet;
+            for (int w = 0; w < workerCount; w++) {
+                for (auto j: assignment[w]) {
+                    for (const auto& kv: rwSets[j]->getWrites()) {
+                        writers[kv->getKeySV()].insert(w);
+                    }
+                }
+            }
+            for (const auto& it: writers) {
+                sharedKeyCount += it.second.size() > 1;
+            }
+            totalKeyCount += writers.size();
+        }
+        return totalKeyCount == 0 ? 0 : (double)sharedKeyCount / (double)totalKeyCount;
+    }
+
+    constexpr static const int workerCount = 10;
+};
+
+TEST_F(KeyHintPartitionerTest, TestPartition) {
+    auto trace = tests::WorkloadTraceUtils::GenerateSmallBankTrace(10, 1000);
+    auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+    auto partitioner = peer::cc::KeyHintPartitioner::NewDefaultPartitioner();
+    std::vector<std::vector<uint32_t>> assignment(workerCount);
+    uint64_t splitCount = 0;
+    for (auto& block: blocks) {
+        auto txnList = DecodeBlock(*block);
+        partitioner->partition(txnList, assignment);
+        // all txns are assigned once, in batch order
+        std::vector<int> count(txnList.size());
+        for (const auto& it: assignment) {
+            ASSERT_TRUE(std::is_sorted(it.begin(), it.end()));
+            for (auto i: it) {
+                count[i]++;
+            }
+        }
+        ASSERT_TRUE(std::all_of(count.begin(), count.end(), [](int c) { return c == 1; }));
+        // the same account is executed by one worker, unless it is split
+        util::MyFlatHashMap<client::small_bank::AccountIDType, std::set<int>> workers;
+        for (int w = 0; w < workerCount; w++) {
+            for (auto i: assignment[w]) {
+                zpp::bits::in in(txnList[i]->getUserRequest().getArgs());
+                client::small_bank::AccountIDType acctId;
+                ASSERT_FALSE(failure(in(acctId)));
+                workers[acctId].insert(w);
+            }
+        }
+        const auto spreadCount = std::count_if(workers.begin(), workers.end(), [](const auto& it) { return it.second.size() > 1; });
+        ASSERT_TRUE((uint64_t)spreadCount <= partitioner->getStatistics().splitGroupCount - splitCount);
+        splitCount = partitioner->getStatistics().splitGroupCount;
+    }
+    const auto& s = partitioner->getStatistics();
+    ASSERT_TRUE(s.hintedTxnCount == s.totalTxnCount);
+    LOG(INFO) << "groups per batch: " << (double)s.groupCount / (double)s.totalBatchCount
+              << ", split groups: " << s.splitGroupCount << ", imbalance: " << s.avgImbalance();
+    ASSERT_TRUE(s.avgImbalance() < 1.5);
+}
+
+// The assignment does not change the result of the deterministic cc
+TEST_F(KeyHintPartitionerTest, TestEquivalent) {
+    auto trace = tests::WorkloadTraceUtils::GenerateSmallBankTrace(20, 1000);
+    auto lhs = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+    auto rhs = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+    Run(client::small_bank::InvokeRequestType::SMALL_BANK, false, lhs);
+    Run(client::small_bank::InvokeRequestType::SMALL_BANK, true, rhs);
+    for (int i = 0; i < (int)trace.size(); i++) {
+        const auto& l = lhs[i]->executeResult;
+        const auto& r = rhs[i]->executeResult;
+        ASSERT_TRUE(l.transactionFilter == r.transactionFilter) << "Block " << i << " is not equivalent!";
+        for (int j = 0; j < (int)l.transactionFilter.size(); j++) {
+            ASSERT_TRUE(l.txReadWriteSet[j]->getRetValueSV() == r.txReadWriteSet[j]->getRetValueSV());
+        }
+    }
+}
+
+// Compare round-robin and key partitioned aria on skewed workloads
+TEST_F(KeyHintPartitionerTest, Benchmark) {
+    for (const std::string ccName: {client::small_bank::InvokeRequestType::SMALL_BANK, client::ycsb::InvokeRequestType::YCSB}) {
+        tests::WorkloadTraceUtils::BlockTrace trace;
+        if (ccName == client::ycsb::InvokeRequestType::YCSB) {
+            trace = tests::WorkloadTraceUtils::GenerateYCSBTrace(50, 1000);
+        } else {
+            trace = tests::WorkloadTraceUtils::GenerateSmallBankTrace(50, 1000);
+        }
+        for (auto partition: {false, true}) {
+            auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+            auto cc = Run(ccName, partition, blocks);
+            const auto& s = cc->getStatistics();
+            LOG(INFO) << ccName << (partition ? " key partition" : " round robin")
+                      << " tps: " << s.throughput() << ", abort rate: " << s.finalAbortRate()
+                      << ", cross worker written keys: " << CrossWorkerWriteRate(trace, blocks, partition);
+        }
+    }
+}
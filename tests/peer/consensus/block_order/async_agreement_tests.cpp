@@ -33,6 +33,19 @@ private:
 };
 
 
+// record when each block is delivered
+class BenchmarkACB : public v2::OrderACB {
+public:
+    BenchmarkACB() : OrderACB(nullptr) { }
+
+    void initBenchmarkACB(int groupCount, std::function<bool(int chainId, int blockNumber)> onExecute) {
+        setOnExecuteBlockCallback(std::move(onExecute));
+        auto ld = v2::LocalDistributor::NewLocalDistributor({}, -1);
+        CHECK(ld != nullptr);
+        init(groupCount, std::move(ld));
+    }
+};
+
 class AsyncAgreementTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -177,4 +190,128 @@ TEST_F(AsyncAgreementTest, TestAgreement) {
     sender_9.join();
 
     util::Timer::sleep_sec(10); // wait until finished
-}
\ No newline at end of file
+}
+
+TEST_F(AsyncAgreementTest, TestSignedBlockOrderBatch) {
+    std::vector<proto::BlockOrder> boList;
+    proto::SignedBlockOrderBatch batch;
+    for (int i = 0; i < 10; i++) {
+        boList.push_back({.chainId = i % 3, .blockId = i, .voteChainId = 2, .voteBlockId = i - 1});
+        auto& sb = batch.orders.emplace_back();
+        CHECK(boList.back().serializeToString(&sb.serializedBlockOrder));
+    }
+    std::string buffer;
+    ASSERT_TRUE(batch.serializeToString(&buffer));
+    std::vector<proto::SignedBlockOrder> orders;
+    ASSERT_TRUE(proto::SignedBlockOrderBatch::DeserializeEntry(buffer, orders));
+    ASSERT_EQ(orders.size(), boList.size());
+    for (int i = 0; i < (int)orders.size(); i++) {
+        proto::BlockOrder bo{};
+        ASSERT_TRUE(bo.deserializeFromString(orders[i].serializedBlockOrder));
+        ASSERT_EQ(bo.chainId, boList[i].chainId);
+        ASSERT_EQ(bo.blockId, boList[i].blockId);
+        ASSERT_EQ(bo.voteBlockId, boList[i].voteBlockId);
+    }
+    // a single vote entry is still accepted
+    buffer.clear();
+    ASSERT_TRUE(batch.orders[3].serializeToString(&buffer));
+    ASSERT_TRUE(proto::SignedBlockOrderBatch::DeserializeEntry(buffer, orders));
+    ASSERT_EQ(orders.size(), 1);
+    ASSERT_EQ(orders[0].serializedBlockOrder, batch.orders[3].serializedBlockOrder);
+}
+
+TEST_F(AsyncAgreementTest, BenchmarkVoteBatching) {
+    constexpr int blockCount = 2000;
+    // each group has one node (the leader), every leader votes for the blocks of all groups
+    auto runBenchmark = [](int groupCount, int maxBatchSize, int portOffset) {
+        std::vector<std::shared_ptr<util::ZMQInstanceConfig>> nodes;
+        for (int i = 0; i < groupCount; i++) {
+            auto region = tests::ProtoBlockUtils::GenerateNodesConfig(i, 1, portOffset + i);
+            nodes.insert(nodes.end(), region.begin(), region.end());
+        }
+        // the time when the leader of a group votes its own block
+        auto now = [] { return std::chrono::steady_clock::now().time_since_epoch().count(); };
+        auto voteTime = std::make_unique<std::atomic<int64_t>[]>(groupCount * blockCount);
+        std::mutex mutex;
+        std::vector<double> latency;
+        std::atomic<int> delivered = 0;
+
+        std::vector<std::unique_ptr<AsyncAgreement>> aaList;
+        std::vector<std::unique_ptr<v2::OrderAssigner>> oaList;
+        for (int i = 0; i < groupCount; i++) {
+            auto acb = std::make_shared<BenchmarkACB>();
+            acb->initBenchmarkACB(groupCount, [&, i](int chainId, int blockNumber) {
+                if (i == 0) {   // measure at the first group
+                    auto span = now() - voteTime[chainId * blockCount + blockNumber].load();
+                    std::unique_lock lock(mutex);
+                    latency.push_back((double)span / 1e6);
+                    delivered.fetch_add(1);
+                }
+                return true;
+            });
+            auto aa = AsyncAgreement::NewAsyncAgreement(nodes[i], std::move(acb));
+            CHECK(aa != nullptr) << "init failed";
+            aa->setVoteBatching(maxBatchSize, 200);
+            aaList.push_back(std::move(aa));
+            auto oa = std::make_unique<v2::OrderAssigner>();
+            oa->setLocalChainId(i);
+            oaList.push_back(std::move(oa));
+        }
+        for (int i = 0; i < groupCount; i++) {
+            for (int j = 0; j < groupCount; j++) {
+                CHECK(aaList[i]->startCluster(nodes, j));
+            }
+        }
+        for (int i = 0; i < groupCount; i++) {
+            CHECK(aaList[i]->ready());
+        }
+        auto voteFunc = [&](int myIdx, int targetGroup) {
+            for (int i = 0; i < blockCount; i++) {
+                auto localVC = oaList[myIdx]->getBlockOrder(targetGroup, i);
+                CHECK(localVC.first != -1);
+                proto::BlockOrder bo {
+                        .chainId = targetGroup,
+                        .blockId = i,
+                        .voteChainId = localVC.first,
+                        .voteBlockId = localVC.second
+                };
+                if (myIdx == targetGroup) {
+                    voteTime[targetGroup * blockCount + i].store(now());
+                }
+                CHECK(aaList[myIdx]->onLeaderVotingNewBlock(bo));
+                if (i - 3 >= 0) {   // simulate delay
+                    oaList[myIdx]->increaseLocalClock(targetGroup, i - 3);
+                }
+                util::Timer::sleep_ns(100 * 1000);    // small blocks
+            }
+        };
+        util::Timer timer;
+        std::vector<std::thread> senders;
+        for (int i = 0; i < groupCount; i++) {
+            for (int j = 0; j < groupCount; j++) {
+                senders.emplace_back(voteFunc, i, j);
+            }
+        }
+        for (auto& it: senders) {
+            it.join();
+        }
+        // the last few blocks may wait for the votes that never come
+        for (int i = 0; i < 100 && delivered.load() < groupCount * (blockCount - 10); i++) {
+            util::Timer::sleep_ms(100);
+        }
+        auto span = timer.end();
+        std::unique_lock lock(mutex);
+        std::sort(latency.begin(), latency.end());
+        CHECK(!latency.empty());
+        LOG(INFO) << "Groups: " << groupCount << ", batch size: " << maxBatchSize
+                  << ", delivered: " << latency.size() << ", throughput: " << (double)latency.size() / span
+                  << ", p50: " << latency[latency.size() / 2] << "ms, p99: " << latency[latency.size() * 99 / 100] << "ms";
+    };
+    int portOffset = 0;
+    for (auto groupCount: {3, 5, 9}) {
+        for (auto maxBatchSize: {1, 32}) {
+            runBenchmark(groupCount, maxBatchSize, portOffset);
+            portOffset += 20;
+        }
+    }
+}
@@ -0,0 +1,178 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/consensus/block_order/frontier_order_manager.h"
+#include "peer/consensus/block_order/interchain_order_manager.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+#include <random>
+
+class FrontierOrderManagerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+    };
+
+    void TearDown() override {
+    };
+
+    struct Vote {
+        int groupId;
+        int blockId;
+        int voteGroupId;
+        int voteWatermark;
+    };
+
+    // Each group votes for the blocks round by round with its (delayed) local clock,
+    // the vote streams of the groups are interleaved randomly.
+    static std::vector<Vote> GenerateVotes(int groupCount, int round, int maxDelay, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::vector<std::vector<Vote>> streams(groupCount);
+        for (int v=0; v<groupCount; v++) {
+            int clock = -1;
+            for (int i=0; i<round; i++) {
+                clock = std::max(clock, i - (int)(rng() % (maxDelay + 1)));
+                for (int j=0; j<groupCount; j++) {
+                    streams[v].push_back(Vote{j, i, v, j == v ? i : clock});
+                }
+            }
+        }
+        std::vector<Vote> votes;
+        std::vector<size_t> pos(groupCount);
+        while (true) {
+            std::vector<int> pending;
+            for (int v=0; v<groupCount; v++) {
+                if (pos[v] < streams[v].size()) {
+                    pending.push_back(v);
+                }
+            }
+            if (pending.empty()) {
+                break;
+            }
+            auto v = pending[rng() % pending.size()];
+            // a burst of votes from the same group
+            for (int k = (int)(rng() % 8); k >= 0 && pos[v] < streams[v].size(); k--) {
+                votes.push_back(streams[v][pos[v]++]);
+            }
+        }
+        return votes;
+    }
+
+    using Result = std::vector<std::pair<int, int>>;
+
+    // If invalidateAt >= 0, the last group is invalidated after invalidateAt votes, its later votes are dropped.
+    static Result RunLegacy(int groupCount, const std::vector<Vote>& votes, int invalidateAt) {
+        peer::consensus::v2::InterChainOrderManager om;
+        om.setGroupCount(groupCount);
+        Result result;
+        om.setDeliverCallback([&](const peer::consensus::v2::InterChainOrderManager::Cell* cell) {
+            result.emplace_back(cell->groupId, cell->blockId);
+        });
+        for (int i=0; i<(int)votes.size(); i++) {
+            if (i == invalidateAt) {
+                om.invalidateChain(groupCount - 1);
+            }
+            const auto& it = votes[i];
+            if (invalidateAt >= 0 && i >= invalidateAt && (it.groupId == groupCount - 1 || it.voteGroupId == groupCount - 1)) {
+                continue;
+            }
+            om.pushDecision(it.groupId, it.blockId, it.voteGroupId, it.voteWatermark);
+        }
+        return result;
+    }
+
+    static Result RunFrontier(int groupCount, const std::vector<Vote>& votes, int invalidateAt) {
+        peer::consensus::v2::FrontierOrderManager om;
+        om.setGroupCount(groupCount);
+        Result result;
+        om.setDeliverCallback([&](int groupId, int blockId) {
+            result.emplace_back(groupId, blockId);
+        });
+        for (int i=0; i<(int)votes.size(); i++) {
+            if (i == invalidateAt) {
+                om.invalidateChain(groupCount - 1);
+            }
+            const auto& it = votes[i];
+            if (invalidateAt >= 0 && i >= invalidateAt && (it.groupId == groupCount - 1 || it.voteGroupId == groupCount - 1)) {
+                continue;
+            }
+            om.pushDecision(it.groupId, it.blockId, it.voteGroupId, it.voteWatermark);
+        }
+        return result;
+    }
+
+    static void AssertEquivalent(int groupCount, int round, int maxDelay, bool invalidate) {
+        for (unsigned seed=1; seed<=5; seed++) {
+            auto votes = GenerateVotes(groupCount, round, maxDelay, seed);
+            int invalidateAt = invalidate ? (int)votes.size() / 2 : -1;
+            auto expected = RunLegacy(groupCount, votes, invalidateAt);
+            auto actual = RunFrontier(groupCount, votes, invalidateAt);
+            ASSERT_FALSE(expected.empty());
+            ASSERT_EQ(expected.size(), actual.size()) << "seed: " << seed;
+            for (int i=0; i<(int)expected.size(); i++) {
+                ASSERT_EQ(expected[i], actual[i]) << "seed: " << seed << ", index: " << i;
+            }
+        }
+    }
+};
+
+TEST_F(FrontierOrderManagerTest, TestEquivalence3) {
+    AssertEquivalent(3, 2000, 10, false);
+}
+
+TEST_F(FrontierOrderManagerTest, TestEquivalence32) {
+    AssertEquivalent(32, 100, 10, false);
+}
+
+TEST_F(FrontierOrderManagerTest, TestEquivalenceInvalidate) {
+    AssertEquivalent(3, 2000, 10, true);
+    AssertEquivalent(8, 200, 5, true);
+}
+
+TEST_F(FrontierOrderManagerTest, TestSingleGroup) {
+    peer::consensus::v2::FrontierOrderManager om;
+    om.setGroupCount(1);
+    Result result;
+    om.setDeliverCallback([&](int groupId, int blockId) {
+        result.emplace_back(groupId, blockId);
+    });
+    for (int i=0; i<10; i++) {
+        om.pushDecision(0, i, 0, i);
+    }
+    ASSERT_EQ(result.size(), 10);
+    ASSERT_EQ(result.back(), std::make_pair(0, 9));
+}
+
+TEST_F(FrontierOrderManagerTest, BenchmarkDeliver) {
+    for (int groupCount: {32, 64}) {
+        auto votes = GenerateVotes(groupCount, 20000 / groupCount, 10, 1);
+        int delivered = 0;
+        peer::consensus::v2::FrontierOrderManager om;
+        om.setGroupCount(groupCount);
+        om.setDeliverCallback([&](int, int) { delivered++; });
+        util::Timer timer;
+        for (const auto& it: votes) {
+            om.pushDecision(it.groupId, it.blockId, it.voteGroupId, it.voteWatermark);
+        }
+        auto span = timer.end();
+        LOG(INFO) << "FrontierOrderManager, groups: " << groupCount << ", votes: " << votes.size() << ", delivered: " << delivered
+                  << ", us per delivered block: " << span * 1e6 / delivered << ", ns per vote: " << span * 1e9 / (double)votes.size();
+
+        if (groupCount > 32) {
+            continue;   // too slow
+        }
+        delivered = 0;
+        peer::consensus::v2::InterChainOrderManager legacy;
+        legacy.setGroupCount(groupCount);
+        legacy.setDeliverCallback([&](const auto*) { delivered++; });
+        timer.start();
+        for (const auto& it: votes) {
+            legacy.pushDecision(it.groupId, it.blockId, it.voteGroupId, it.voteWatermark);
+        }
+        span = timer.end();
+        LOG(INFO) << "InterChainOrderManager, groups: " << groupCount << ", votes: " << votes.size() << ", delivered: " << delivered
+                  << ", us per delivered block: " << span * 1e6 / delivered;
+    }
+}
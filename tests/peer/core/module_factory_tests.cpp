@@ -68,10 +68,10 @@ TEST_F(BootstrapTest, TestBFTController) {
         CHECK(bftControllerList[i] != nullptr);
     }
     for (int i=0; i<4; i++) {
-        bftControllerList[i]->pbftController->startInstance();
+        bftControllerList[i]->startInstance();
     }
     for (int i=0; i<4; i++) {
-        bftControllerList[i]->pbftController->waitUntilReady();
+        bftControllerList[i]->waitUntilReady();
     }
     util::Timer::sleep_sec(2);
 }
@@ -0,0 +1,115 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/db/db_interface.h"
+#include "peer/concurrency_control/cc_engine.h"
+#include "client/ycsb/ycsb_property.h"
+#include "tests/workload_trace_utils.h"
+#include "tests/mock_property_generator.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+class HotKeyCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+    };
+
+    void TearDown() override {
+    };
+
+    static std::unique_ptr<peer::db::CachedDBConnection> NewCachedConnection(size_t capacity) {
+        peer::db::DBConfig config;
+        config.cacheCapacity = capacity;
+        auto dbc = peer::db::DBConnection::NewConnection("testDB", config);
+        CHECK(dbc != nullptr);
+        return std::unique_ptr<peer::db::CachedDBConnection>(dynamic_cast<peer::db::CachedDBConnection*>(dbc.release()));
+    }
+};
+
+TEST_F(HotKeyCacheTest, TestReadThrough) {
+    auto dbc = NewCachedConnection(2);
+    ASSERT_TRUE(dbc != nullptr);
+    ASSERT_TRUE(dbc->syncPut("key1", "value1"));
+    ASSERT_TRUE(dbc->syncPut("key2", "value2"));
+    ASSERT_TRUE(dbc->syncPut("key3", "value3"));
+    std::string value;
+    // key1 and key2 are admitted, key3 is missed only once
+    for (int i = 0; i < 2; i++) {
+        ASSERT_TRUE(dbc->get("key1", &value) && value == "value1");
+        ASSERT_TRUE(dbc->get("key2", &value) && value == "value2");
+    }
+    ASSERT_TRUE(dbc->get("key3", &value) && value == "value3");
+    ASSERT_FALSE(dbc->get("key4", &value));
+    ASSERT_FALSE(dbc->get("key4", &value));
+    dbc->onBlockCommitted();
+    auto s = dbc->getCacheStatistics();
+    ASSERT_TRUE(s.size == 2 && s.hitCount == 0 && s.missCount == 7);
+    ASSERT_TRUE(dbc->get("key1", &value) && value == "value1");
+    ASSERT_TRUE(dbc->get("key2", &value) && value == "value2");
+    ASSERT_TRUE(dbc->getCacheStatistics().hitCount == 2);
+    // the write is visible immediately, and cached again after the block
+    ASSERT_TRUE(dbc->syncWriteBatch([](auto* batch) {
+        batch->Put("key1", "value1_new");
+        batch->Delete("key2");
+        return true;
+    }));
+    ASSERT_TRUE(dbc->get("key1", &value) && value == "value1_new");
+    ASSERT_FALSE(dbc->get("key2", &value));
+    s = dbc->getCacheStatistics();
+    ASSERT_TRUE(s.hitCount == 2 && s.invalidateCount == 2);
+    dbc->onBlockCommitted();
+    ASSERT_TRUE(dbc->getCacheStatistics().size == 1);
+    ASSERT_TRUE(dbc->get("key1", &value) && value == "value1_new");
+    ASSERT_TRUE(dbc->getCacheStatistics().hitCount == 3);
+}
+
+// YCSB-B (95% read, zipfian 0.99) on the aria engine, compare with the uncached hashmap
+TEST_F(HotKeyCacheTest, YCSBBenchmark) {
+    tests::MockPropertyGenerator::GenerateDefaultProperties(1, 1);
+    tests::MockPropertyGenerator::SetLocalId(0, 0);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::RECORD_COUNT_PROPERTY, 100000);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::READ_PROPORTION_PROPERTY, 0.95);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::UPDATE_PROPORTION_PROPERTY, 0.05);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::REQUEST_DISTRIBUTION_PROPERTY, "zipfian");
+    auto trace = tests::WorkloadTraceUtils::GenerateYCSBTrace(100, 1000);
+    std::vector<std::vector<std::byte>> results;
+    for (auto capacity: {0, 256, 1024, 4096}) {
+        peer::db::DBConfig config;
+        config.cacheCapacity = capacity;
+        std::shared_ptr<peer::db::DBConnection> dbc = peer::db::DBConnection::NewConnection("testDB", config);
+        CHECK(dbc != nullptr);
+        tests::WorkloadTraceUtils::LoadDB(client::ycsb::InvokeRequestType::YCSB, dbc);
+        auto engine = peer::cc::CCEngineRegistry::Instance().newEngine("aria", dbc, 10);
+        CHECK(engine != nullptr);
+        auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        int totalCommit = 0;
+        util::Timer timer;
+        for (int i = 0; i < (int)blocks.size(); i++) {
+            auto& block = blocks[i];
+            CHECK(engine->processValidatedRequests(block->body.userRequests,
+                                                   block->executeResult.txReadWriteSet,
+                                                   block->executeResult.transactionFilter));
+            for (const auto& it: block->executeResult.transactionFilter) {
+                totalCommit += (int)it;
+            }
+            if (capacity == 0) {
+                results.push_back(block->executeResult.transactionFilter);
+            } else {
+                ASSERT_TRUE(block->executeResult.transactionFilter == results[i]) << "Block " << i << " is not equivalent!";
+            }
+        }
+        auto span = timer.end();
+        LOG(INFO) << "cache capacity: " << capacity << ", total commit: " << totalCommit << ", tps: " << totalCommit / span;
+        auto* cached = dynamic_cast<peer::db::CachedDBConnection*>(dbc.get());
+        if (cached == nullptr) {
+            continue;
+        }
+        auto s = cached->getCacheStatistics();
+        LOG(INFO) << "cache capacity: " << capacity << ", hit rate: " << s.hitRate()
+                  << ", hit latency (ns): " << s.avgHitLatencyNs << ", miss latency (ns): " << s.avgMissLatencyNs
+                  << ", invalidated: " << s.invalidateCount;
+    }
+}
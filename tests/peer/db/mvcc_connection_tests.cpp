@@ -0,0 +1,168 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/db/mvcc_connection.h"
+#include "common/thread_pool_light.h"
+#include "bthread/countdown_event.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+
+class MVCCConnectionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dbc = peer::db::MVCCConnection::NewConnection("mvccDB");
+        CHECK(dbc != nullptr) << "create db failed!";
+    };
+
+    void TearDown() override {
+    };
+
+    std::unique_ptr<peer::db::MVCCConnection> dbc;
+};
+
+TEST_F(MVCCConnectionTest, TestGetPutDelete) {
+    auto key = "testKey";
+    std::string value;
+    ASSERT_TRUE(dbc->syncPut(key, "testValue"));
+    ASSERT_TRUE(dbc->get(key, &value));
+    ASSERT_TRUE(value == "testValue");
+    ASSERT_TRUE(dbc->syncDelete(key));
+    ASSERT_TRUE(!dbc->get(key, &value)) << "get after delete!";
+
+    auto ret = dbc->syncWriteBatch([&](peer::db::MVCCConnection::WriteBatch* batch){
+        batch->Put(key, "testValue");
+        return true;
+    });
+    ASSERT_TRUE(ret);
+    ASSERT_TRUE(dbc->get(key, &value));
+    ASSERT_TRUE(value == "testValue");
+}
+
+TEST_F(MVCCConnectionTest, TestSnapshot) {
+    // block 1 and block 2 update the same key
+    dbc->setWriteVersion(1);
+    dbc->syncPut("key", "v1");
+    dbc->syncPut("deleted", "v1");
+    auto snapshot1 = dbc->getSnapshot(1);
+    dbc->setWriteVersion(2);
+    dbc->syncPut("key", "v2");
+    dbc->syncPut("new", "v2");
+    dbc->syncDelete("deleted");
+
+    std::string_view valueSV;
+    ASSERT_TRUE(snapshot1->get("key", &valueSV) && valueSV == "v1");
+    ASSERT_TRUE(snapshot1->get("deleted", &valueSV) && valueSV == "v1");
+    ASSERT_TRUE(!snapshot1->get("new", &valueSV));
+    auto snapshot2 = dbc->getSnapshot(2);
+    ASSERT_TRUE(snapshot2->get("key", &valueSV) && valueSV == "v2");
+    ASSERT_TRUE(snapshot2->get("new", &valueSV) && valueSV == "v2");
+    ASSERT_TRUE(!snapshot2->get("deleted", &valueSV));
+
+    // the versions visible to snapshot1 are pinned
+    std::string_view pinned;
+    ASSERT_TRUE(snapshot1->get("key", &pinned));
+    dbc->setWriteVersion(3);
+    dbc->syncPut("key", "v3");
+    ASSERT_TRUE(dbc->garbageCollect() == 0);
+    ASSERT_TRUE(pinned == "v1");
+
+    // only the newest version <= 2 and the newer versions are kept, the tombstone is removed
+    snapshot1.reset();
+    ASSERT_TRUE(dbc->garbageCollect() == 3);
+    ASSERT_TRUE(snapshot2->get("key", &valueSV) && valueSV == "v2");
+    ASSERT_TRUE(!snapshot2->get("deleted", &valueSV));
+    snapshot2.reset();
+    ASSERT_TRUE(dbc->garbageCollect() == 1);
+    std::string value;
+    ASSERT_TRUE(dbc->get("key", &value) && value == "v3");
+    ASSERT_TRUE(!dbc->get("deleted", &value));
+}
+
+TEST_F(MVCCConnectionTest, TestSnapshotAfterGC) {
+    dbc->setWriteVersion(1);
+    dbc->syncPut("key", "v1");
+    dbc->setWriteVersion(2);
+    dbc->syncPut("key", "v2");
+    dbc->setWriteVersion(3);
+    dbc->syncPut("key", "v3");
+    auto snapshot2 = dbc->getSnapshot(2);
+    // v1 is removed, the watermark is 2
+    ASSERT_TRUE(dbc->garbageCollect() == 1);
+    // the snapshot older than the watermark would miss v1
+    ASSERT_TRUE(dbc->getSnapshot(1) == nullptr);
+    std::string_view valueSV;
+    auto snapshot = dbc->getSnapshot(2);
+    ASSERT_TRUE(snapshot != nullptr && snapshot->get("key", &valueSV) && valueSV == "v2");
+    snapshot.reset();
+    snapshot2.reset();
+    ASSERT_TRUE(dbc->garbageCollect() == 1);
+    ASSERT_TRUE(dbc->getSnapshot(2) == nullptr);
+    snapshot = dbc->getSnapshot(3);
+    ASSERT_TRUE(snapshot != nullptr && snapshot->get("key", &valueSV) && valueSV == "v3");
+}
+
+TEST_F(MVCCConnectionTest, TestOverwriteWithSnapshot) {
+    dbc->setWriteVersion(1);
+    dbc->syncPut("key", "v1");
+    auto snapshot = dbc->getSnapshot(1);
+    std::string_view valueSV;
+    ASSERT_TRUE(snapshot->get("key", &valueSV) && valueSV == "v1");
+    // the view of the snapshot is still valid
+    dbc->syncPut("key", "v1'");
+    ASSERT_TRUE(valueSV == "v1");
+    std::string_view newValueSV;
+    ASSERT_TRUE(snapshot->get("key", &newValueSV) && newValueSV == "v1'");
+    // the overwritten value is kept while the snapshot is active
+    ASSERT_TRUE(dbc->garbageCollect() == 0);
+    ASSERT_TRUE(valueSV == "v1");
+    snapshot.reset();
+    dbc->setWriteVersion(2);
+    ASSERT_TRUE(dbc->garbageCollect() == 0);
+    // without a snapshot, the same version is overwritten in place
+    dbc->syncPut("key", "v2");
+    dbc->syncPut("key", "v2'");
+    ASSERT_TRUE(dbc->garbageCollect() == 2);
+    std::string value;
+    ASSERT_TRUE(dbc->get("key", &value) && value == "v2'");
+}
+
+TEST_F(MVCCConnectionTest, TestConcurrentReadWrite) {
+    static constexpr int keyCount = 10000;
+    static constexpr int blockCount = 20;
+    for (int i=0; i<keyCount; i++) {
+        dbc->syncPut(std::to_string(i), "0");
+    }
+    util::thread_pool_light tp(8);
+    for (int block=1; block<=blockCount; block++) {
+        // the readers of block use the snapshot of block-1, while the writer commits block
+        auto snapshot = dbc->getSnapshot(block - 1);
+        dbc->setWriteVersion(block);
+        bthread::CountdownEvent countdown((int)tp.get_thread_count() + 1);
+        for (int t=0; t<(int)tp.get_thread_count(); t++) {
+            tp.push_task([&] {
+                for (int i=0; i<keyCount; i++) {
+                    std::string_view valueSV;
+                    CHECK(snapshot->get(std::to_string(i), &valueSV));
+                    CHECK(valueSV == std::to_string(block - 1));
+                }
+                countdown.signal();
+            });
+        }
+        tp.push_task([&] {
+            dbc->syncWriteBatch([&](peer::db::MVCCConnection::WriteBatch* batch){
+                for (int i=0; i<keyCount; i++) {
+                    batch->Put(std::to_string(i), std::to_string(block));
+                }
+                return true;
+            });
+            countdown.signal();
+        });
+        countdown.wait();
+        snapshot.reset();
+        dbc->garbageCollect();
+    }
+    std::string value;
+    ASSERT_TRUE(dbc->get("0", &value) && value == std::to_string(blockCount));
+}
@@ -0,0 +1,149 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/db/db_interface.h"
+#include "peer/concurrency_control/deterministic/coordinator_impl.h"
+#include "client/ycsb/ycsb_property.h"
+#include "tests/workload_trace_utils.h"
+#include "tests/mock_property_generator.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+#include <filesystem>
+
+class RocksdbConnectionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::filesystem::remove_all(dbPath);
+    };
+
+    void TearDown() override {
+        std::filesystem::remove_all(dbPath);
+    };
+
+    static peer::db::DBConfig NewRocksdbConfig(std::string_view walSync) {
+        peer::db::DBConfig config;
+        config.backend = "rocksdb";
+        config.rocksdb.columnFamilies["ycsb"] = {"user"};
+        config.rocksdb.columnFamilies["small_bank"] = {"a_", "s_", "c_"};
+        config.rocksdb.walSync = peer::db::RocksdbConfig::ParseWALSync(walSync);
+        return config;
+    }
+
+    const std::string dbPath = std::filesystem::temp_directory_path().append("rocksdb_connection_test");
+};
+
+TEST_F(RocksdbConnectionTest, TestColumnFamilies) {
+    auto dbc = peer::db::DBConnection::NewConnection(dbPath, NewRocksdbConfig("group"));
+    ASSERT_TRUE(dbc != nullptr && dbc->isPersistent());
+    ASSERT_TRUE(dbc->syncWriteBatch([](auto* batch) {
+        batch->Put("user1", "ycsb");
+        batch->Put("a_1", "small_bank");
+        batch->Put("other", "default");
+        batch->Delete("c_1");
+        return true;
+    }));
+    // reopen with the same column families
+    dbc.reset();
+    dbc = peer::db::DBConnection::NewConnection(dbPath, NewRocksdbConfig("group"));
+    ASSERT_TRUE(dbc != nullptr);
+    std::string value;
+    ASSERT_TRUE(dbc->get("user1", &value) && value == "ycsb");
+    ASSERT_TRUE(dbc->get("a_1", &value) && value == "small_bank");
+    ASSERT_TRUE(dbc->get("other", &value) && value == "default");
+    ASSERT_FALSE(dbc->get("c_1", &value));
+    // reopen without column families, the existing ones are opened but not routed
+    dbc.reset();
+    peer::db::DBConfig config;
+    config.backend = "rocksdb";
+    dbc = peer::db::DBConnection::NewConnection(dbPath, config);
+    ASSERT_TRUE(dbc != nullptr);
+    ASSERT_FALSE(dbc->get("user1", &value));
+    ASSERT_TRUE(dbc->get("other", &value) && value == "default");
+}
+
+TEST_F(RocksdbConnectionTest, TestGroupCommit) {
+    auto dbc = peer::db::DBConnection::NewConnection(dbPath, NewRocksdbConfig("group"));
+    ASSERT_TRUE(dbc != nullptr);
+    ASSERT_TRUE(dbc->syncPut("user0", "0"));
+    dbc->beginGroupCommit();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&, i=i] {
+            for (int j = 0; j < 100; j++) {
+                CHECK(dbc->syncWriteBatch([&](auto* batch) {
+                    batch->Put("user" + std::to_string(i * 100 + j + 1), std::to_string(i));
+                    return true;
+                }));
+            }
+        });
+    }
+    for (auto& it: threads) {
+        it.join();
+    }
+    dbc->syncWriteBatch([](auto* batch) {
+        batch->Delete("user0");
+        return true;
+    });
+    std::string value;
+    // not visible until the group is committed
+    ASSERT_FALSE(dbc->get("user1", &value));
+    ASSERT_TRUE(dbc->endGroupCommit());
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 100; j++) {
+            ASSERT_TRUE(dbc->get("user" + std::to_string(i * 100 + j + 1), &value) && value == std::to_string(i));
+        }
+    }
+    ASSERT_FALSE(dbc->get("user0", &value));
+    // an empty group
+    dbc->beginGroupCommit();
+    ASSERT_TRUE(dbc->endGroupCommit());
+}
+
+TEST_F(RocksdbConnectionTest, TestUnknownBackend) {
+    peer::db::DBConfig config;
+    config.backend = "unknown";
+    ASSERT_TRUE(peer::db::DBConnection::NewConnection("testDB", config) == nullptr);
+    auto dbc = peer::db::DBConnection::NewConnection("testDB");
+    ASSERT_TRUE(dbc != nullptr && !dbc->isPersistent());
+}
+
+// YCSB-A (50% read, 50% update, zipfian) on the deterministic cc, compare rocksdb with the hashmap
+TEST_F(RocksdbConnectionTest, YCSBABenchmark) {
+    tests::MockPropertyGenerator::GenerateDefaultProperties(1, 1);
+    tests::MockPropertyGenerator::SetLocalId(0, 0);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::RECORD_COUNT_PROPERTY, 100000);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::READ_PROPORTION_PROPERTY, 0.50);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::UPDATE_PROPORTION_PROPERTY, 0.50);
+    client::ycsb::YCSBProperties::SetProperties(client::ycsb::YCSBProperties::REQUEST_DISTRIBUTION_PROPERTY, "zipfian");
+    auto trace = tests::WorkloadTraceUtils::GenerateYCSBTrace(100, 1000);
+    auto runBenchmark = [&](const std::string& name, const peer::db::DBConfig& config) {
+        std::filesystem::remove_all(dbPath);
+        std::shared_ptr<peer::db::DBConnection> dbc = peer::db::DBConnection::NewConnection(dbPath, config);
+        CHECK(dbc != nullptr);
+        tests::WorkloadTraceUtils::LoadDB(client::ycsb::InvokeRequestType::YCSB, dbc);
+        auto cc = peer::cc::CoordinatorImpl::NewCoordinator(dbc, 10);
+        CHECK(cc != nullptr);
+        auto blocks = tests::WorkloadTraceUtils::CopyToBlocks(trace);
+        int totalCommit = 0;
+        util::Timer timer;
+        for (auto& block: blocks) {
+            CHECK(cc->processValidatedRequests(block->body.userRequests,
+                                               block->executeResult.txReadWriteSet,
+                                               block->executeResult.transactionFilter));
+            for (const auto& it: block->executeResult.transactionFilter) {
+                totalCommit += (int)it;
+            }
+        }
+        auto span = timer.end();
+        LOG(INFO) << name << " total commit: " << totalCommit << ", tps: " << totalCommit / span
+                  << ", block latency (ms): " << span * 1000 / (double)blocks.size();
+    };
+    peer::db::DBConfig hashmapConfig;
+    runBenchmark("phmap", hashmapConfig);
+    runBenchmark("rocksdb (wal sync: none)", NewRocksdbConfig("none"));
+    runBenchmark("rocksdb (wal sync: group)", NewRocksdbConfig("group"));
+    runBenchmark("rocksdb (wal sync: always)", NewRocksdbConfig("always"));
+}
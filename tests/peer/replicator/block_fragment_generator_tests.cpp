@@ -239,4 +239,42 @@ TEST_F(BFGTest, IntrgrateTestMultiInstanceParallel) {
     }
     LOG(INFO) << "Total time: " << timer.end();
     // LOG(INFO) << "Ratio: " << (double)segList[0].size()/4*33/(int)message.size();
-}
\ No newline at end of file
+}
+// The receivers get the same fragments for every block, the decode matrix is inverted once
+TEST_F(BFGTest, IntrgrateTestDecodeMatrixCache) {
+    util::OpenSSLSHA256::initCrypto();
+
+    std::vector<peer::BlockFragmentGenerator::Config> cfgList;
+    cfgList.push_back({
+                              .dataShardCnt=11,
+                              .parityShardCnt=22,
+                              .instanceCount = 2,
+                              .concurrency = 2,
+                      });
+    auto tpForGenerator = std::make_unique<util::thread_pool_light>();
+    peer::BlockFragmentGenerator bfg(cfgList, tpForGenerator.get(), std::type_identity<util::ReedSolomonErasureCode>());
+    std::string message, messageOut;
+    fillDummy(message, 1024*1024*2);
+    std::vector<std::string> segList(3);
+
+    for (int i = 0; i < 100; i++) {
+        auto context = bfg.getEmptyContext(cfgList[0]);
+        context->initWithMessage(message);
+        ASSERT_TRUE(context->serializeFragments(4, 8, segList[0]));
+        ASSERT_TRUE(context->serializeFragments(12, 16, segList[1]));
+        ASSERT_TRUE(context->serializeFragments(16, 19, segList[2]));
+        auto root = context->getRoot();
+
+        auto contextReconstruct = bfg.getEmptyContext(cfgList[0]);
+        ASSERT_TRUE(contextReconstruct->validateAndDeserializeFragments(root, segList[1], 12, 16));
+        ASSERT_TRUE(contextReconstruct->validateAndDeserializeFragments(root, segList[0], 4, 8));
+        ASSERT_TRUE(contextReconstruct->validateAndDeserializeFragments(root, segList[2], 16, 19));
+        ASSERT_TRUE(contextReconstruct->regenerateMessage((int)message.size(), messageOut));
+        ASSERT_TRUE(messageOut == message) << messageOut.substr(0, 100) << " vs " << message.substr(0, 100);
+    }
+    auto s = bfg.getDecodeMatrixCacheStatistics(cfgList[0]);
+    ASSERT_TRUE(s.has_value());
+    LOG(INFO) << "Decode matrix cache size: " << s->size << ", hit rate: " << s->hitRate();
+    // all instances have the same erasure pattern, they may only miss concurrently in the first block
+    ASSERT_TRUE(s->missCount <= (uint64_t)cfgList[0].instanceCount && s->hitRate() > 0.9);
+}
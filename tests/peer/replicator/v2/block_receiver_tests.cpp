@@ -6,10 +6,12 @@
 #include "tests/block_fragment_generator_utils.h"
 #include "tests/proto_block_utils.h"
 #include "common/matrix_2d.h"
+#include "common/timer.h"
 
 #include "gtest/gtest.h"
 #include "glog/logging.h"
 #include "peer/replicator/v2/fragment_util.h"
+#include <ctime>
 
 class FragmentReceiverTestV2 : public ::testing::Test {
 public:
@@ -289,4 +291,122 @@ TEST_F(BlockReceiverTestV2, SendingAsync) {
     // join the thread
     f1.wait();
     LOG(INFO) << "Exit.";
-}
\ No newline at end of file
+}
+
+// Compare repeating the remote fragments by copy and by sharing the received buffer
+TEST_F(FragmentReceiverTestV2, RelayBenchmark) {
+    constexpr int fragmentCount = 64;
+    constexpr int fragmentSize = 64 * 1024;    // 4 MB in total
+    std::string payload;
+    tests::BFGUtils::FillDummy(payload, fragmentSize);
+    for (auto shareBuffer: {false, true}) {
+        auto repeater = peer::v2::FragmentRepeater::NewServer<zmq::socket_type::pub>(51210 + shareBuffer);
+        ASSERT_TRUE(repeater != nullptr) << "Create instance failed";
+        auto local = util::ZMQInstance::NewClient<zmq::socket_type::sub>("127.0.0.1", 51210 + shareBuffer);
+        ASSERT_TRUE(local != nullptr) << "Create instance failed";
+        std::atomic<uint64_t> receivedBytes = 0;
+        std::thread subscriber([&] {
+            local->receive([&](zmq::message_t&& msg, auto*) {
+                receivedBytes.fetch_add(msg.size(), std::memory_order_relaxed);
+                return true;
+            });
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        // the received fragments, held by the ring buffer until the block is regenerated
+        std::vector<zmq::message_t> received;
+        received.reserve(fragmentCount);
+        for (int i = 0; i < fragmentCount; i++) {
+            received.emplace_back(payload.data(), payload.size());
+        }
+        uint64_t copiedBytes = 0;
+        auto cpuStart = std::clock();
+        util::Timer timer;
+        for (auto& it: received) {
+            if (shareBuffer) {
+                CHECK(peer::v2::BlockReceiver::RelayFragment(*repeater, it));
+            } else {
+                CHECK(repeater->send(it.to_string()));
+                copiedBytes += it.size();
+            }
+        }
+        auto span = timer.end();
+        auto cpuSpan = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        local->shutdown();
+        subscriber.join();
+        LOG(INFO) << (shareBuffer ? "Shared buffer" : "Copy") << " relay: "
+                  << (double)fragmentCount * fragmentSize * 8 / span / 1e9 << " Gbps, cpu time: " << cpuSpan
+                  << "s, copied: " << copiedBytes / 1024 / 1024 << "MB, received by local: "
+                  << receivedBytes.load() / 1024 / 1024 << "MB";
+    }
+}
+
+// The remote fragment of every 4th block is delayed, the following blocks are
+// reassembled during the delay if the reassembly window is larger than 1
+TEST_F(BlockReceiverTestV2, PipelinedReassembly) {
+    int regionId = 0;
+    int nodesPerRegion = 4;
+    int blockCount = 40;
+    std::vector<std::unique_ptr<util::ZMQInstance>> servers(nodesPerRegion);
+    for (int i = 1; i < (int) servers.size(); i++) {
+        auto sender = util::ZMQInstance::NewServer<zmq::socket_type::pub>(51200 + i);
+        ASSERT_TRUE(sender != nullptr) << "Create instance failed";
+        servers[i] = std::move(sender);
+    }
+    int shardPerNode = (parityShardCnt + dataShardCnt) / nodesPerRegion;    // must be divisible
+    // prepare the fragments of server 0 (remote) and server 1 (local)
+    std::vector<std::string> msgList(blockCount);
+    std::vector<std::vector<std::string>> fragmentList(blockCount);
+    for (int blockNumber = 0; blockNumber < blockCount; blockNumber++) {
+        tests::BFGUtils::FillDummy(msgList[blockNumber], 1024 * 1024);
+        bfgUtils.message = msgList[blockNumber];
+        auto senderContext = bfgUtils.getContext(cfgPosition);
+        for (int i = 0; i < 2; i++) {
+            fragmentList[blockNumber].push_back(bfgUtils.generateMockFragment(senderContext.get(), blockNumber, i * shardPerNode, (i + 1) * shardPerNode));
+        }
+    }
+    auto configList = tests::ProtoBlockUtils::GenerateNodesConfig(regionId, nodesPerRegion, 0);
+    auto localNodeConfig = tests::ProtoBlockUtils::GenerateNodesConfig(1, 1, (int)configList.size())[0]->nodeConfig;
+
+    for (auto window: {1, 4}) {
+        auto rfrPort = 51199 - window * 2, frPort = 51198 - window * 2;
+        auto receiver = peer::v2::BlockReceiver::NewBlockReceiver(localNodeConfig, rfrPort, configList, frPort, 0, 64);
+        ASSERT_TRUE(receiver != nullptr) << "Create instance failed";
+        receiver->setBFG(bfgUtils.bfg);
+        receiver->setBFGConfig(bfgUtils.cfgList[regionId]);
+        ASSERT_TRUE(receiver->setReassemblyWindow(window));
+        ASSERT_TRUE(receiver->activeStart(0));
+        // Give the subscribers a chance to connect, so they don't lose any messages
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        auto remoteSender = util::ReliableZmqClient::NewPublishClient("127.0.0.1", rfrPort);
+        ASSERT_TRUE(remoteSender != nullptr);
+
+        util::Timer timer;
+        for (int blockNumber = 0; blockNumber < blockCount; blockNumber++) {
+            auto fragment = fragmentList[blockNumber][1];
+            servers[1]->send(std::move(fragment));
+        }
+        std::thread delayedSender([&] {
+            for (int blockNumber = 0; blockNumber < blockCount; blockNumber += 4) {
+                for (int i = blockNumber + 1; i < std::min(blockNumber + 4, blockCount); i++) {
+                    auto fragment = fragmentList[i][0];
+                    remoteSender->send(std::move(fragment));
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                auto fragment = fragmentList[blockNumber][0];
+                remoteSender->send(std::move(fragment));
+            }
+        });
+        std::vector<std::unique_ptr<std::string>> blockList(blockCount);
+        for (auto& it: blockList) {
+            it = receiver->activeGet();
+        }
+        auto span = timer.end();
+        delayedSender.join();
+        for (int blockNumber = 0; blockNumber < blockCount; blockNumber++) {
+            ASSERT_TRUE(blockList[blockNumber] != nullptr) << "Can not get block fragments!";
+            ASSERT_TRUE(*blockList[blockNumber] == msgList[blockNumber]) << "Message mismatch!";
+        }
+        LOG(INFO) << "Reassembly window: " << window << ", throughput: " << blockCount / span << " blocks/s";
+    }
+}
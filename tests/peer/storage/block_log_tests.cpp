@@ -0,0 +1,146 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/storage/block_log.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+class BlockLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::filesystem::remove_all(path);
+    };
+
+    void TearDown() override {
+        std::filesystem::remove_all(path);
+    };
+
+    static std::shared_ptr<const std::string> Payload(int regionId, proto::BlockNumber blockNumber, size_t size = 1000) {
+        auto raw = std::make_shared<std::string>(size, 'a');
+        auto tag = std::to_string(regionId) + "_" + std::to_string(blockNumber);
+        std::copy(tag.begin(), tag.end(), raw->begin());
+        return raw;
+    }
+
+    const std::string path = "block_log_test";
+};
+
+TEST_F(BlockLogTest, TestAppendAndRead) {
+    auto log = peer::BlockLog::NewBlockLog(path, 2);
+    ASSERT_TRUE(log != nullptr);
+    ASSERT_EQ(log->getMaxBlockNumber(0), -1);
+    for (int i = 0; i < 100; i++) {
+        log->append(0, i, Payload(0, i));
+        log->append(1, i, Payload(1, i, i + 1));
+    }
+    log->flush();
+    ASSERT_EQ(log->getMaxBlockNumber(0), 99);
+    ASSERT_EQ(log->getMaxBlockNumber(1), 99);
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(log->read(0, i), *Payload(0, i));
+        ASSERT_EQ(log->read(1, i), *Payload(1, i, i + 1));
+    }
+    ASSERT_EQ(log->read(0, 100), std::nullopt);
+    ASSERT_EQ(log->read(2, 0), std::nullopt);
+    // the index grows
+    log->append(0, 10000, Payload(0, 10000));
+    log->flush();
+    ASSERT_EQ(log->read(0, 10000), *Payload(0, 10000));
+    ASSERT_EQ(log->read(0, 5), *Payload(0, 5));
+}
+
+TEST_F(BlockLogTest, TestSegmentRollAndReopen) {
+    peer::BlockLog::Config config;
+    config.segmentSize = 16 * 1024;
+    {
+        auto log = peer::BlockLog::NewBlockLog(path, 1, config);
+        ASSERT_TRUE(log != nullptr);
+        for (int i = 0; i < 200; i++) {
+            // some records are larger than a segment
+            log->append(0, i, Payload(0, i, i % 50 == 0 ? 20000 : 1000));
+        }
+    }
+    ASSERT_GT(std::distance(std::filesystem::directory_iterator(path + "/0"), std::filesystem::directory_iterator{}), 10);
+    auto log = peer::BlockLog::NewBlockLog(path, 1, config);
+    ASSERT_TRUE(log != nullptr);
+    ASSERT_EQ(log->getMaxBlockNumber(0), 199);
+    for (int i = 0; i < 200; i++) {
+        ASSERT_EQ(log->read(0, i), *Payload(0, i, i % 50 == 0 ? 20000 : 1000));
+    }
+    log->append(0, 200, Payload(0, 200));
+    log->flush();
+    ASSERT_EQ(log->read(0, 200), *Payload(0, 200));
+}
+
+TEST_F(BlockLogTest, TestRecoverTornTail) {
+    {
+        auto log = peer::BlockLog::NewBlockLog(path, 1);
+        ASSERT_TRUE(log != nullptr);
+        for (int i = 0; i < 10; i++) {
+            log->append(0, i, Payload(0, i));
+        }
+    }
+    // lose the index, and corrupt the payload of the last record
+    std::filesystem::remove(path + "/0/index");
+    auto lastOffset = 9 * ((sizeof(peer::BlockLog::RecordHeader) + 1000 + 7) & ~7ul);
+    auto fd = ::open((path + "/0/0.seg").c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(::pwrite(fd, "x", 1, (off_t)(lastOffset + sizeof(peer::BlockLog::RecordHeader) + 10)), 1);
+    ::close(fd);
+
+    auto log = peer::BlockLog::NewBlockLog(path, 1);
+    ASSERT_TRUE(log != nullptr);
+    ASSERT_EQ(log->getMaxBlockNumber(0), 8);
+    for (int i = 0; i < 9; i++) {
+        ASSERT_EQ(log->read(0, i), *Payload(0, i));
+    }
+    ASSERT_EQ(log->read(0, 9), std::nullopt);
+    // rewrite the dropped block
+    log->append(0, 9, Payload(0, 9));
+    log->flush();
+    ASSERT_EQ(log->read(0, 9), *Payload(0, 9));
+}
+
+TEST_F(BlockLogTest, TestReadBlock) {
+    auto log = peer::BlockLog::NewBlockLog(path, 1);
+    ASSERT_TRUE(log != nullptr);
+    auto block = std::make_shared<proto::Block>();
+    block->header.number = 3;
+    block->header.dataHash = {1, 2, 3};
+    block->metadata.consensusSignatures.push_back({});
+    log->append(0, block);
+    log->flush();
+    auto ret = log->readBlock(0, 3);
+    ASSERT_TRUE(ret != nullptr);
+    ASSERT_EQ(ret->header.number, 3);
+    ASSERT_EQ(ret->header.dataHash, block->header.dataHash);
+    ASSERT_EQ(ret->metadata.consensusSignatures.size(), 1);
+    ASSERT_TRUE(ret->haveSerializedMessage());
+    ASSERT_TRUE(log->readBlock(0, 4) == nullptr);
+}
+
+TEST_F(BlockLogTest, TestReadBlockZeroCopy) {
+    std::shared_ptr<peer::BlockLog> log = peer::BlockLog::NewBlockLog(path, 1);
+    ASSERT_TRUE(log != nullptr);
+    auto block = std::make_shared<proto::Block>();
+    block->header.number = 0;
+    block->header.dataHash = {1, 2, 3};
+    log->append(0, block);
+    log->flush();
+    // the block refers to the mapped segment instead of a copy
+    auto ret = log->readBlock(0, 0);
+    ASSERT_TRUE(ret != nullptr);
+    ASSERT_FALSE(ret->haveSerializedMessage());
+    ASSERT_EQ(ret->header.dataHash, block->header.dataHash);
+    // and keeps the log alive
+    std::weak_ptr<peer::BlockLog> weakLog = log;
+    log.reset();
+    ASSERT_FALSE(weakLog.expired());
+    ret.reset();
+    ASSERT_TRUE(weakLog.expired());
+}
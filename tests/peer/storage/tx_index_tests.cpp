@@ -0,0 +1,151 @@
+//
+// Created by user on 23-10-17.
+//
+
+#include "peer/storage/mr_block_storage.h"
+#include "common/timer.h"
+
+#include "gtest/gtest.h"
+#include "glog/logging.h"
+#include <random>
+
+class TxIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+    };
+
+    void TearDown() override {
+    };
+
+    static proto::DigestString RandomDigest(std::mt19937_64& rng) {
+        proto::DigestString digest;
+        for (auto& it: digest) {
+            it = (uint8_t)rng();
+        }
+        return digest;
+    }
+
+    // a committed block, the rw sets are in the order of the requests
+    static std::shared_ptr<proto::Block> CreateBlock(proto::BlockNumber number, int txCount, std::mt19937_64& rng) {
+        auto block = std::make_shared<proto::Block>();
+        block->header.number = number;
+        for (int i = 0; i < txCount; i++) {
+            auto digest = RandomDigest(rng);
+            auto envelop = std::make_unique<proto::Envelop>();
+            envelop->setSignature(proto::SignatureString{"ski", digest});
+            envelop->setPayload("payload");
+            block->body.userRequests.push_back(std::move(envelop));
+            block->executeResult.txReadWriteSet.push_back(std::make_unique<proto::TxReadWriteSet>(digest));
+        }
+        block->executeResult.transactionFilter.resize(txCount);
+        return block;
+    }
+
+    static std::string TxId(const proto::Block& block, int position) {
+        const auto& digest = block.body.userRequests[position]->getSignature().digest;
+        return {reinterpret_cast<const char*>(digest.data()), digest.size()};
+    }
+};
+
+TEST_F(TxIndexTest, TestInsertAndFind) {
+    std::mt19937_64 rng(1);
+    peer::TxIndex index(1024);
+    std::vector<std::shared_ptr<proto::Block>> blocks;
+    for (int i = 0; i < 4; i++) {
+        blocks.push_back(CreateBlock(i, 50, rng));
+        index.insertBlock(i % 2, *blocks.back());
+    }
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 50; j++) {
+            auto txId = TxId(*blocks[i], j);
+            auto location = index.find(txId);
+            ASSERT_TRUE(location != std::nullopt);
+            ASSERT_EQ(location->regionId, i % 2);
+            ASSERT_EQ(location->blockNumber, (proto::BlockNumber)i);
+            ASSERT_EQ(location->position, (uint32_t)j);
+            ASSERT_TRUE(blocks[i]->body.getEnvelop(j, txId) != nullptr);
+            proto::TxReadWriteSet* rwSet;
+            std::byte valid;
+            ASSERT_TRUE(blocks[i]->executeResult.getRWSet(j, txId, rwSet, valid));
+            // a wrong position never matches
+            ASSERT_TRUE(blocks[i]->body.getEnvelop((j + 1) % 50, txId) == nullptr);
+            ASSERT_FALSE(blocks[i]->executeResult.getRWSet((j + 1) % 50, txId, rwSet, valid));
+        }
+    }
+    ASSERT_EQ(index.find(TxId(*CreateBlock(0, 1, rng), 0)), std::nullopt);
+    ASSERT_EQ(index.find("short"), std::nullopt);
+}
+
+TEST_F(TxIndexTest, TestBoundedWithPersistedTier) {
+    std::mt19937_64 rng(2);
+    auto db = std::shared_ptr<peer::db::DBConnection>(peer::db::DBConnection::NewConnection("txIndexDB"));
+    peer::TxIndex memoryOnly(256);
+    peer::TxIndex persisted(256, db);
+    std::vector<std::shared_ptr<proto::Block>> blocks;
+    for (int i = 0; i < 100; i++) {
+        blocks.push_back(CreateBlock(i, 20, rng));
+        memoryOnly.insertBlock(0, *blocks.back());
+        persisted.insertBlock(0, *blocks.back());
+    }
+    ASSERT_LE(memoryOnly.size(), 256);
+    // the latest transactions are in memory
+    for (int j = 0; j < 20; j++) {
+        ASSERT_TRUE(memoryOnly.find(TxId(*blocks.back(), j)) != std::nullopt);
+    }
+    // the evicted transactions are found in the persisted tier only
+    ASSERT_EQ(memoryOnly.find(TxId(*blocks.front(), 0)), std::nullopt);
+    for (int i = 0; i < 100; i++) {
+        auto location = persisted.find(TxId(*blocks[i], 7));
+        ASSERT_TRUE(location != std::nullopt);
+        ASSERT_EQ(location->blockNumber, (proto::BlockNumber)i);
+        ASSERT_EQ(location->position, 7u);
+    }
+}
+
+TEST_F(TxIndexTest, BenchmarkLocateTx) {
+    constexpr int blockCount = 1000;
+    constexpr int txPerBlock = 1000;
+    std::mt19937_64 rng(3);
+    auto storage = std::make_shared<peer::BlockLRUCache>(1, blockCount);
+    storage->setTxIndex(std::make_shared<peer::TxIndex>(2 * blockCount * txPerBlock));
+    std::vector<std::string> txIds;
+    for (int i = 0; i < blockCount; i++) {
+        auto block = CreateBlock(i, txPerBlock, rng);
+        txIds.push_back(TxId(*block, (int)(rng() % txPerBlock)));
+        storage->insertBlockAndNotify(0, std::move(block));
+    }
+    auto percentile = [](std::vector<double>& latency, double p) {
+        std::sort(latency.begin(), latency.end());
+        return latency[(size_t)((double)(latency.size() - 1) * p)];
+    };
+    // locate by the index and the direct indexing in the block
+    std::vector<double> latency;
+    for (const auto& txId: txIds) {
+        util::Timer timer;
+        auto location = storage->getTxIndex()->find(txId);
+        ASSERT_TRUE(location != std::nullopt);
+        auto block = storage->waitForBlock(location->regionId, location->blockNumber);
+        proto::TxReadWriteSet* rwSet;
+        std::byte valid;
+        ASSERT_TRUE(block->body.getEnvelop((int)location->position, txId) != nullptr);
+        ASSERT_TRUE(block->executeResult.getRWSet((int)location->position, txId, rwSet, valid));
+        latency.push_back(timer.end());
+    }
+    LOG(INFO) << "Index, p50: " << percentile(latency, 0.5) * 1e6 << "us, p99: " << percentile(latency, 0.99) * 1e6 << "us";
+    // scan the blocks from 0, like the client without a block hint
+    latency.clear();
+    for (int i = 0; i < (int)txIds.size(); i += 10) {
+        util::Timer timer;
+        for (int j = 0; j < blockCount; j++) {
+            auto block = storage->waitForBlock(0, j);
+            if (block->body.findEnvelop(txIds[i]) != nullptr) {
+                proto::TxReadWriteSet* rwSet;
+                std::byte valid;
+                ASSERT_TRUE(block->executeResult.findRWSet(txIds[i], rwSet, valid));
+                break;
+            }
+        }
+        latency.push_back(timer.end());
+    }
+    LOG(INFO) << "Scan, p50: " << percentile(latency, 0.5) * 1e6 << "us, p99: " << percentile(latency, 0.99) * 1e6 << "us";
+}